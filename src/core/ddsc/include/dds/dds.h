@@ -97,9 +97,10 @@ typedef enum dds_status_id {
   DDS_LIVELINESS_LOST_STATUS_ID,
   DDS_LIVELINESS_CHANGED_STATUS_ID,
   DDS_PUBLICATION_MATCHED_STATUS_ID,
-  DDS_SUBSCRIPTION_MATCHED_STATUS_ID
+  DDS_SUBSCRIPTION_MATCHED_STATUS_ID,
+  DDS_WRITER_READY_STATUS_ID
 } dds_status_id_t;
-#define DDS_STATUS_ID_MAX (DDS_SUBSCRIPTION_MATCHED_STATUS_ID)
+#define DDS_STATUS_ID_MAX (DDS_WRITER_READY_STATUS_ID)
 
 /** Another topic exists with the same name but with different characteristics. */
 #define DDS_INCONSISTENT_TOPIC_STATUS          (1u << DDS_INCONSISTENT_TOPIC_STATUS_ID)
@@ -127,6 +128,8 @@ typedef enum dds_status_id {
 #define DDS_PUBLICATION_MATCHED_STATUS         (1u << DDS_PUBLICATION_MATCHED_STATUS_ID)
 /** The reader has found a writer that matches the topic and has a compatible QoS. */
 #define DDS_SUBSCRIPTION_MATCHED_STATUS        (1u << DDS_SUBSCRIPTION_MATCHED_STATUS_ID)
+/** The writer's history cache has dropped below the low-water mark after a dds_write_nonblocking was refused (non-standard, there is no listener for it). */
+#define DDS_WRITER_READY_STATUS                (1u << DDS_WRITER_READY_STATUS_ID)
 /** @}*/
 
 /** Read state for a data value */
@@ -1439,6 +1442,53 @@ dds_get_topic_filter_extended (
   dds_entity_t topic,
   struct dds_topic_filter *filter);
 
+/** Names of the reader QoS properties specifying the content filter class,
+    expression and expression parameters that are advertised to remote
+    writers in discovery.  The parameters are numbered consecutively starting
+    at 0, i.e., "dds.content_filter.parameter.0", ".1", etc. */
+#define DDS_CONTENT_FILTER_CLASS_PROPERTY "dds.content_filter.class"
+#define DDS_CONTENT_FILTER_EXPRESSION_PROPERTY "dds.content_filter.expression"
+#define DDS_CONTENT_FILTER_PARAMETER_PROPERTY_PREFIX "dds.content_filter.parameter."
+
+/** Content filter class function: returns whether the sample passes the
+    filter expression given the expression parameters; no guarantee of
+    backwards compatibility */
+typedef bool (*dds_content_filter_class_fn) (const void *sample, const char *expression, uint32_t nparams, const char * const *params, void *arg);
+
+/**
+ * @brief Registers a content filter class in a domain, allowing writers in
+ * that domain to filter samples on behalf of remote readers. No guarantee
+ * that this will be maintained for backwards compatibility.
+ *
+ * A reader advertises a content filter by setting the
+ * DDS_CONTENT_FILTER_CLASS_PROPERTY and DDS_CONTENT_FILTER_EXPRESSION_PROPERTY
+ * properties in its QoS, plus any expression parameters. Writers that know the filter class evaluate the
+ * expression and send a GAP instead of the sample to readers that reject it;
+ * readers apply their own filter as well, as writers that don't know the
+ * class send all data.
+ *
+ * Filter classes can't be unregistered and should be registered in all
+ * processes using them, before creating the readers and writers.
+ *
+ * @param[in]  entity  A domain entity or an entity bound to a domain.
+ * @param[in]  name    Name of the filter class.
+ * @param[in]  fn      Function evaluating an expression for a sample.
+ * @param[in]  arg     Argument passed to fn.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK  Filter class registered successfully
+ * @retval DDS_RETCODE_BAD_PARAMETER  The entity handle is invalid, name or fn is a null pointer
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION  The entity is not bound to a domain
+ * @retval DDS_RETCODE_PRECONDITION_NOT_MET  A filter class with this name exists already
+ */
+DDS_EXPORT dds_return_t
+dds_register_content_filter_class (
+  dds_entity_t entity,
+  const char *name,
+  dds_content_filter_class_fn fn,
+  void *arg);
+
 /**
  * @brief Creates a new instance of a DDS subscriber
  *
@@ -1629,6 +1679,34 @@ dds_reader_wait_for_historical_data(
   dds_entity_t reader,
   dds_duration_t max_wait);
 
+/**
+ * @brief Writer QoS property for keeping the history of a writer in a file
+ *
+ * If set on a writer with TRANSIENT or PERSISTENT durability, the value is the
+ * name of a file in which the writer's history is kept instead of in memory.
+ * The durability service history settings determine how much history is
+ * retained, as they do for TRANSIENT_LOCAL writers. A new writer given the
+ * same file takes over the history of the previous one, and serves it to
+ * late-joining readers like any other historical data. The file should only
+ * be used by one writer at a time.
+ *
+ * Not supported in combination with the deadline and lifespan QoS, nor on
+ * all platforms; in these cases the history is kept in memory and is lost
+ * when the writer is deleted.
+ */
+#define DDS_WRITER_PROP_DURABLE_STORE "dds.writer.durable_store"
+
+/**
+ * @brief Writer QoS property for the interval at which a durable store is synced
+ *
+ * The value is the number of milliseconds that may pass between writing a sample
+ * to the file set by @ref DDS_WRITER_PROP_DURABLE_STORE and forcing it to disk,
+ * which bounds what is lost on a system crash. 0 syncs on every write, at a
+ * significant cost in throughput. The store is always synced when the writer is
+ * deleted. Default: 1000.
+ */
+#define DDS_WRITER_PROP_DURABLE_STORE_SYNC_INTERVAL "dds.writer.durable_store.sync_interval"
+
 /**
  * @brief Creates a new instance of a DDS writer.
  *
@@ -2056,6 +2134,39 @@ dds_dispose_ih_ts(
 DDS_EXPORT dds_return_t
 dds_write(dds_entity_t writer, const void *data);
 
+/**
+ * @brief Write the value of a data instance without blocking
+ *
+ * Same as dds_write, except that it never blocks when the writer's history
+ * cache is full of unacknowledged data, i.e., when dds_write would block for
+ * up to the reliability QoS' max_blocking_time.  Instead, it returns
+ * DDS_RETCODE_TRY_AGAIN without writing the sample, resets the writer's
+ * DDS_WRITER_READY_STATUS and sets it again once the readers have
+ * acknowledged enough data for the write to succeed.  Attaching the writer
+ * to a waitset with the DDS_WRITER_READY_STATUS enabled allows applications
+ * to handle back-pressure in an event loop.
+ *
+ * @param[in]  writer The writer entity.
+ * @param[in]  data Value to be written.
+ *
+ * @returns dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             The sample has been written.
+ * @retval DDS_RETCODE_TRY_AGAIN
+ *             The writer's history cache is full, the sample was not written.
+ * @retval DDS_RETCODE_ERROR
+ *             An internal error has occurred.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             At least one of the arguments is invalid.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_ALREADY_DELETED
+ *             The entity has already been deleted.
+ */
+DDS_EXPORT dds_return_t
+dds_write_nonblocking(dds_entity_t writer, const void *data);
+
 /*TODO: What is it for and is it really needed? */
 DDS_EXPORT void
 dds_write_flush(dds_entity_t writer);
@@ -2088,6 +2199,68 @@ dds_write_flush(dds_entity_t writer);
 DDS_EXPORT dds_return_t
 dds_writecdr(dds_entity_t writer, struct ddsi_serdata *serdata);
 
+/**
+ * @brief Write the values of a number of data instances in one operation
+ *
+ * Equivalent to writing the samples one after the other with dds_write_ts
+ * (or dds_write if timestamps is a null pointer), but much cheaper: the
+ * samples get consecutive sequence numbers while the writer is locked only
+ * once, the history cache is updated in a single pass and they are packed in
+ * as few messages as possible, followed by a single heartbeat.
+ *
+ * If an error occurs, a prefix of the samples may have been written.
+ *
+ * @param[in]  writer The writer entity.
+ * @param[in]  data Array of count pointers to the values to be written.
+ * @param[in]  timestamps Array of count source timestamps, or NULL for the current time.
+ * @param[in]  count Number of samples to write.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             The writer successfully wrote all samples.
+ * @retval DDS_RETCODE_ERROR
+ *             An internal error has occurred.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             One of the given arguments is not valid.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_ALREADY_DELETED
+ *             The entity has already been deleted.
+ * @retval DDS_RETCODE_TIMEOUT
+ *             The writer failed to write the samples reliably within the specified max_blocking_time.
+ */
+DDS_EXPORT dds_return_t
+dds_write_batch(dds_entity_t writer, const void * const *data, const dds_time_t *timestamps, uint32_t count);
+
+/**
+ * @brief Write a number of serialized values in one operation
+ *
+ * The batch equivalent of dds_writecdr, see dds_write_batch.  Like
+ * dds_writecdr, it consumes a reference to each of the serdata.
+ *
+ * @param[in]  writer The writer entity.
+ * @param[in]  serdata Array of count serialized values to be written.
+ * @param[in]  count Number of samples to write.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             The writer successfully wrote all serialized values.
+ * @retval DDS_RETCODE_ERROR
+ *             An internal error has occurred.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             One of the given arguments is not valid.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_ALREADY_DELETED
+ *             The entity has already been deleted.
+ * @retval DDS_RETCODE_TIMEOUT
+ *             The writer failed to write the serialized values reliably within the specified max_blocking_time.
+ */
+DDS_EXPORT dds_return_t
+dds_writecdr_batch(dds_entity_t writer, struct ddsi_serdata **serdata, uint32_t count);
+
 /**
  * @brief Write a serialized value of a data instance
  *
@@ -2611,6 +2784,55 @@ dds_waitset_wait_until(
   size_t nxs,
   dds_time_t abstimeout);
 
+/**
+ * @brief Waits for data on the readers attached to a waitset and takes it
+ *
+ * This operation blocks like "dds_waitset_wait", and then takes up to "maxs"
+ * serialized samples from the triggered readers and read conditions, in a
+ * single pass over the attached entities. Per sample, the reader from which
+ * it was taken is stored in "readers". Other kinds of attached entities are
+ * ignored apart from their effect on the wait.
+ *
+ * When there is more data than fits in the buffer, the reader taken from first
+ * rotates between calls, so that no reader can starve the others.
+ *
+ * The samples must be released by the caller with "ddsi_serdata_unref", as
+ * for "dds_takecdr".
+ *
+ * @param[in]  waitset    The waitset to wait on.
+ * @param[out] buf        An array of "maxs" pointers to \ref ddsi_serdata
+ *                        structures that will contain the serialized data.
+ * @param[out] si         An array of "maxs" sample infos.
+ * @param[out] readers    An array of "maxs" reader handles.
+ * @param[in]  maxs       Maximum number of samples to take.
+ * @param[in]  reltimeout Relative timeout
+ *
+ * @returns A dds_return_t with the number of samples taken or an error code.
+ *
+ * @retval >0
+ *             Number of samples taken.
+ * @retval  0
+ *             Time out, or the waitset triggered without any data being
+ *             available in the attached readers and read conditions.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             One of the given arguments is not valid.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_ALREADY_DELETED
+ *             The waitset has already been deleted.
+ * @retval <0
+ *             Taking from a triggered reader failed before any samples
+ *             were taken (readers deleted concurrently are skipped).
+ */
+DDS_EXPORT dds_return_t
+dds_waitset_takecdr(
+  dds_entity_t waitset,
+  struct ddsi_serdata **buf,
+  dds_sample_info_t *si,
+  dds_entity_t *readers,
+  uint32_t maxs,
+  dds_duration_t reltimeout);
+
 /*
   There are a number of read and take variations.
 
@@ -3529,6 +3751,22 @@ dds_read_next_wl(
   void **buf,
   dds_sample_info_t *si);
 
+/**
+ * @brief Reader QoS property for loaning received data without copying it
+ *
+ * If set to "true" on a reader of a type for which the memory layout is identical
+ * to the CDR representation (roughly: structs of primitive types and arrays
+ * thereof, without strings, sequences or unions), a read/take operation with an empty buffer (a reader-loan) returns
+ * pointers into the received data instead of deserializing it into a buffer owned
+ * by the reader. The data remains referenced until the loan is returned with
+ * dds_return_loan and must not be modified by the application.
+ *
+ * Only applies to read/take operations on the reader itself, and only one such
+ * loan can be outstanding at any time; in all other cases the samples are copied
+ * as usual. Invalid samples are always copied.
+ */
+#define DDS_READER_PROP_SERDATA_LOANS "dds.reader.serdata_loans"
+
 /**
  * @brief Return loaned samples to a reader or writer
  *
@@ -25,6 +25,14 @@ void dds_reader_status_cb (void *entity, const struct status_cb_data * data);
 
 dds_return_t dds_return_reader_loan (dds_reader *rd, void **buf, int32_t bufsz);
 
+/* Releases the serdatas (and copies) of an outstanding serdata loan, rd->m_entity.m_mutex
+   must be held unless the reader is being deleted */
+void dds_reader_drop_serdata_loan (struct dds_reader *rd);
+
+/* Core of readcdr/takecdr, for a reader that is pinned by the caller, with the
+   calling thread awake in the reader's domain */
+dds_return_t dds_readcdr_pinned (bool take, struct dds_reader *rd, struct ddsi_serdata **buf, uint32_t maxs, dds_sample_info_t *si, uint32_t mask, dds_instance_handle_t hand, bool lock);
+
 /*
   dds_reader_lock_samples: Returns number of samples in read cache and locks the
   reader cache to make sure that the samples content doesn't change.
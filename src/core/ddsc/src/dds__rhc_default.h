@@ -27,6 +27,11 @@ struct rhc_sample;
 
 DDS_EXPORT struct dds_rhc *dds_rhc_default_new_xchecks (dds_reader *reader, struct ddsi_domaingv *gv, const struct ddsi_sertype *type, bool xchecks);
 DDS_EXPORT struct dds_rhc *dds_rhc_default_new (struct dds_reader *reader, const struct ddsi_sertype *type);
+
+/* Returns false if rhc is not a default RHC, else the number of samples and
+   instances in use and allocated in the sample and instance slabs (samples
+   stored inside an instance are not counted) */
+DDS_EXPORT bool dds_rhc_default_get_slab_stats (struct dds_rhc *rhc, uint32_t * __restrict samples_inuse, uint32_t * __restrict samples_allocated, uint32_t * __restrict instances_inuse, uint32_t * __restrict instances_allocated);
 #ifdef DDS_HAS_LIFESPAN
 DDS_EXPORT ddsrt_mtime_t dds_rhc_default_sample_expired_cb(void *hc, ddsrt_mtime_t tnow);
 #endif
@@ -333,6 +333,12 @@ typedef struct dds_reader {
   void *m_loan;
   uint32_t m_loan_size;
   unsigned m_wrapped_sertopic : 1; /* set iff reader's topic is a wrapped ddsi_sertopic for backwards compatibility */
+  unsigned m_serdata_loans : 1; /* set iff loans point into the received serdata, see DDS_READER_PROP_SERDATA_LOANS */
+  bool m_serdata_loan_out; /* [m_mutex] */
+  uint32_t m_serdata_loan_n; /* [m_mutex] number of samples in outstanding serdata loan */
+  uint32_t m_serdata_loan_size; /* [m_mutex] allocated size of m_serdata_loan, m_serdata_loan_copy */
+  struct ddsi_serdata **m_serdata_loan; /* [m_mutex] serdatas referenced by the outstanding loan */
+  void **m_serdata_loan_copy; /* [m_mutex] deserialized copy if the payload couldn't be loaned, else NULL */
 #ifdef DDS_HAS_SHM
   iox_sub_storage_extension_t m_iox_sub_stor;
   iox_sub_t m_iox_sub;
@@ -413,6 +419,7 @@ typedef struct dds_waitset {
   ddsrt_cond_t wait_cond;
   size_t nentities;         /* [wait_lock] */
   size_t ntriggered;        /* [wait_lock] */
+  size_t take_start;        /* [wait_lock] rotating start index for dds_waitset_takecdr */
   dds_attachment *entities; /* [wait_lock] 0 .. ntriggered are triggred, ntriggred .. nentities are not */
 } dds_waitset;
 
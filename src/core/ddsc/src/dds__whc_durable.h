@@ -0,0 +1,37 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDS__WHC_DURABLE_H
+#define DDS__WHC_DURABLE_H
+
+#include "dds/ddsi/q_whc.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct ddsi_domaingv;
+struct ddsi_sertype;
+
+/* WHC for transient/persistent writers that keeps the history in an append-only,
+   memory-mapped log in the file "path", loading whatever history a previous
+   incarnation left in that file.  Appended samples are forced to disk within
+   "sync_interval" (0 = immediately) and when the WHC is freed.  The history
+   depth parameters are as in the default WHC (0 = KEEP_ALL).  Returns NULL
+   (after logging the reason) if the file can't be opened or another writer
+   owns it. */
+struct whc *whc_durable_new (struct ddsi_domaingv *gv, const struct ddsi_sertype *type, const char *path, dds_duration_t sync_interval, uint32_t hdepth, uint32_t tldepth);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDS__WHC_DURABLE_H */
@@ -19,6 +19,7 @@ extern "C" {
 #define DDS_WR_KEY_BIT 0x01
 #define DDS_WR_DISPOSE_BIT 0x02
 #define DDS_WR_UNREGISTER_BIT 0x04
+#define DDS_WR_NONBLOCKING_BIT 0x08 /* fail with TRY_AGAIN rather than block on a full WHC */
 
 struct ddsi_serdata;
 
@@ -28,6 +28,7 @@
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_gc.h"
 #include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_content_filter.h"
 
 #ifdef DDS_HAS_SHM
 #include "shm__monitor.h"
@@ -373,6 +374,22 @@ dds_return_t dds_domain_set_deafmute (dds_entity_t entity, bool deaf, bool mute,
   return rc;
 }
 
+dds_return_t dds_register_content_filter_class (dds_entity_t entity, const char *name, dds_content_filter_class_fn fn, void *arg)
+{
+  struct dds_entity *e;
+  dds_return_t rc;
+  if (name == NULL || fn == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+  if ((rc = dds_entity_pin (entity, &e)) < 0)
+    return rc;
+  if (e->m_domain == NULL)
+    rc = DDS_RETCODE_ILLEGAL_OPERATION;
+  else
+    rc = ddsi_content_filter_class_register (&e->m_domain->gv, name, fn, arg);
+  dds_entity_unpin (e);
+  return rc;
+}
+
 #include "dds__entity.h"
 static void pushdown_set_batch (struct dds_entity *e, bool enable)
 {
@@ -11,6 +11,7 @@
  */
 #include <assert.h>
 #include <string.h>
+#include "dds/ddsrt/heap.h"
 #include "dds__entity.h"
 #include "dds__reader.h"
 #include "dds/ddsi/ddsi_tkmap.h"
@@ -20,8 +21,98 @@
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/ddsi_sertype.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
 #include "dds/ddsi/ddsi_sertopic.h" // for extern ddsi_sertopic_serdata_ops_wrap
 
+static bool serdata_loan_claim (struct dds_reader *rd, uint32_t maxs)
+{
+  bool claimed = false;
+  ddsrt_mutex_lock (&rd->m_entity.m_mutex);
+  if (!rd->m_serdata_loan_out)
+  {
+    if (rd->m_serdata_loan_size < maxs)
+    {
+      rd->m_serdata_loan = ddsrt_realloc (rd->m_serdata_loan, maxs * sizeof (*rd->m_serdata_loan));
+      rd->m_serdata_loan_copy = ddsrt_realloc (rd->m_serdata_loan_copy, maxs * sizeof (*rd->m_serdata_loan_copy));
+      rd->m_serdata_loan_size = maxs;
+    }
+    rd->m_serdata_loan_out = true;
+    claimed = true;
+  }
+  ddsrt_mutex_unlock (&rd->m_entity.m_mutex);
+  return claimed;
+}
+
+static const void *serdata_loanable_payload (const struct ddsi_sertype_default *st, const struct ddsi_serdata *sd)
+{
+  const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *) sd;
+  if (sd->type == NULL || sd->kind != SDK_DATA || sd->ops != st->c.serdata_ops)
+    return NULL;
+#ifdef DDS_HAS_SHM
+  if (sd->iox_chunk != NULL)
+    return NULL;
+#endif
+  /* the application may access the trailing padding of the type as well,
+     so that too must fit in the allocated memory */
+  if (d->hdr.identifier != st->native_encoding_identifier || d->pos < st->opt_size || d->size < st->type.size)
+    return NULL;
+  return d->data;
+}
+
+/* Read/take for a reader with serdata loans enabled and an outstanding loan
+   claimed by the caller: the samples point into the payloads of the
+   serdatas, which are kept referenced until the loan is returned */
+static dds_return_t dds_read_serdata_loan (bool take, struct dds_reader *rd, void **buf, uint32_t maxs, dds_sample_info_t *si, uint32_t mask, dds_instance_handle_t hand, bool lock)
+{
+  const struct ddsi_sertype_default *st = (const struct ddsi_sertype_default *) rd->m_topic->m_stype;
+  struct ddsi_serdata ** const sds = rd->m_serdata_loan;
+  void ** const copies = rd->m_serdata_loan_copy;
+  dds_return_t ret;
+
+  assert (rd->m_serdata_loans && rd->m_serdata_loan_out && rd->m_serdata_loan_size >= maxs);
+  if (mask == NO_STATE_MASK_SET)
+    mask = DDS_ANY_STATE;
+  ret = dds_readcdr_pinned (take, rd, sds, maxs, si, mask, hand, lock);
+  for (int32_t i = 0; i < ret; i++)
+  {
+    const void *payload = serdata_loanable_payload (st, sds[i]);
+    if (payload != NULL)
+    {
+      copies[i] = NULL;
+      buf[i] = (void *) payload;
+    }
+    else
+    {
+      copies[i] = ddsi_sertype_alloc_sample (&st->c);
+      if (sds[i]->type == NULL)
+        (void) ddsi_serdata_untyped_to_sample (&st->c, sds[i], copies[i], NULL, NULL);
+      else
+        (void) ddsi_serdata_to_sample (sds[i], copies[i], NULL, NULL);
+      buf[i] = copies[i];
+    }
+  }
+
+  ddsrt_mutex_lock (&rd->m_entity.m_mutex);
+  if (ret > 0)
+    rd->m_serdata_loan_n = (uint32_t) ret;
+  else
+    rd->m_serdata_loan_out = false;
+  ddsrt_mutex_unlock (&rd->m_entity.m_mutex);
+  return ret;
+}
+
+void dds_reader_drop_serdata_loan (struct dds_reader *rd)
+{
+  for (uint32_t i = 0; i < rd->m_serdata_loan_n; i++)
+  {
+    if (rd->m_serdata_loan_copy[i])
+      ddsi_sertype_free_sample (rd->m_topic->m_stype, rd->m_serdata_loan_copy[i], DDS_FREE_ALL);
+    ddsi_serdata_unref (rd->m_serdata_loan[i]);
+  }
+  rd->m_serdata_loan_n = 0;
+  rd->m_serdata_loan_out = false;
+}
+
 /*
   dds_read_impl: Core read/take function. Usually maxs is size of buf and si
   into which samples/status are written, when set to zero is special case
@@ -62,6 +153,16 @@ static dds_return_t dds_read_impl (bool take, dds_entity_t reader_or_condition,
 
   thread_state_awake (ts1, &entity->m_domain->gv);
 
+  /* Loan the received data if possible; falls back to the regular loan if
+     there already is a loan of serdatas outstanding */
+  if (buf[0] == NULL && cond == NULL && rd->m_serdata_loans && serdata_loan_claim (rd, maxs))
+  {
+    ret = dds_read_serdata_loan (take, rd, buf, maxs, si, mask, hand, lock);
+    dds_entity_unpin (entity);
+    thread_state_asleep (ts1);
+    return ret;
+  }
+
   /* Allocate samples if not provided (assuming all or none provided) */
   if (buf[0] == NULL)
   {
@@ -139,28 +240,9 @@ fail:
   return ret;
 }
 
-static dds_return_t dds_readcdr_impl (bool take, dds_entity_t reader_or_condition, struct ddsi_serdata **buf, uint32_t maxs, dds_sample_info_t *si, uint32_t mask, dds_instance_handle_t hand, bool lock)
+dds_return_t dds_readcdr_pinned (bool take, struct dds_reader *rd, struct ddsi_serdata **buf, uint32_t maxs, dds_sample_info_t *si, uint32_t mask, dds_instance_handle_t hand, bool lock)
 {
-  struct thread_state1 * const ts1 = lookup_thread_state ();
-  dds_return_t ret = DDS_RETCODE_OK;
-  struct dds_reader *rd;
-  struct dds_entity *entity;
-
-  if (buf == NULL || si == NULL || maxs == 0 || maxs > INT32_MAX)
-    return DDS_RETCODE_BAD_PARAMETER;
-
-  if ((ret = dds_entity_pin (reader_or_condition, &entity)) < 0) {
-    return ret;
-  } else if (dds_entity_kind (entity) == DDS_KIND_READER) {
-    rd = (dds_reader *) entity;
-  } else if (dds_entity_kind (entity) != DDS_KIND_COND_READ && dds_entity_kind (entity) != DDS_KIND_COND_QUERY) {
-    dds_entity_unpin (entity);
-    return DDS_RETCODE_ILLEGAL_OPERATION;
-  } else {
-    rd = (dds_reader *) entity->m_parent;
-  }
-
-  thread_state_awake (ts1, &entity->m_domain->gv);
+  dds_return_t ret;
 
   /* read/take resets data available status -- must reset before reading because
      the actual writing is protected by RHC lock, not by rd->m_entity.m_lock */
@@ -194,7 +276,32 @@ static dds_return_t dds_readcdr_impl (bool take, dds_entity_t reader_or_conditio
       ddsi_serdata_unref (&wrapper->c);
     }
   }
+  return ret;
+}
 
+static dds_return_t dds_readcdr_impl (bool take, dds_entity_t reader_or_condition, struct ddsi_serdata **buf, uint32_t maxs, dds_sample_info_t *si, uint32_t mask, dds_instance_handle_t hand, bool lock)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  dds_return_t ret = DDS_RETCODE_OK;
+  struct dds_reader *rd;
+  struct dds_entity *entity;
+
+  if (buf == NULL || si == NULL || maxs == 0 || maxs > INT32_MAX)
+    return DDS_RETCODE_BAD_PARAMETER;
+
+  if ((ret = dds_entity_pin (reader_or_condition, &entity)) < 0) {
+    return ret;
+  } else if (dds_entity_kind (entity) == DDS_KIND_READER) {
+    rd = (dds_reader *) entity;
+  } else if (dds_entity_kind (entity) != DDS_KIND_COND_READ && dds_entity_kind (entity) != DDS_KIND_COND_QUERY) {
+    dds_entity_unpin (entity);
+    return DDS_RETCODE_ILLEGAL_OPERATION;
+  } else {
+    rd = (dds_reader *) entity->m_parent;
+  }
+
+  thread_state_awake (ts1, &entity->m_domain->gv);
+  ret = dds_readcdr_pinned (take, rd, buf, maxs, si, mask, hand, lock);
   dds_entity_unpin (entity);
   thread_state_asleep (ts1);
   return ret;
@@ -526,7 +633,13 @@ dds_return_t dds_return_reader_loan (dds_reader *rd, void **buf, int32_t bufsz)
      the observer_lock), so holding it for a bit longer in return for simpler
      code is a fair trade-off. */
   ddsrt_mutex_lock (&rd->m_entity.m_mutex);
-  if (buf[0] != rd->m_loan)
+  if (rd->m_serdata_loan_n > 0 && buf[0] == (rd->m_serdata_loan_copy[0] ? rd->m_serdata_loan_copy[0] : serdata_loanable_payload ((const struct ddsi_sertype_default *) st, rd->m_serdata_loan[0])))
+  {
+    /* Samples point into (or were copied from) serdatas that are still referenced */
+    dds_reader_drop_serdata_loan (rd);
+    buf[0] = NULL;
+  }
+  else if (buf[0] != rd->m_loan)
   {
     /* Not so much a loan as a buffer allocated by the middleware on behalf of the
        application.  So it really is no more than a sophisticated variant of "free". */
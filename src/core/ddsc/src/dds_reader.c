@@ -32,6 +32,7 @@
 #include "dds__statistics.h"
 #include "dds__data_allocator.h"
 #include "dds/ddsi/ddsi_sertype.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
 #include "dds/ddsi/ddsi_entity_index.h"
 #include "dds/ddsi/ddsi_security_omg.h"
 #include "dds/ddsi/ddsi_statistics.h"
@@ -97,6 +98,9 @@ static dds_return_t dds_reader_delete (dds_entity *e)
     ddsi_sertype_free_samples (rd->m_topic->m_stype, ptrs, rd->m_loan_size, DDS_FREE_ALL);
     ddsrt_free (ptrs);
   }
+  dds_reader_drop_serdata_loan (rd);
+  ddsrt_free (rd->m_serdata_loan);
+  ddsrt_free (rd->m_serdata_loan_copy);
 
   thread_state_awake (lookup_thread_state (), &e->m_domain->gv);
   dds_rhc_free (rd->m_rhc);
@@ -117,6 +121,20 @@ static dds_return_t dds_reader_delete (dds_entity *e)
   return DDS_RETCODE_OK;
 }
 
+static bool reader_supports_serdata_loans (const dds_qos_t *rqos, const struct ddsi_sertype *stype)
+{
+  char *value;
+  if (!dds_qget_prop (rqos, DDS_READER_PROP_SERDATA_LOANS, &value))
+    return false;
+  const bool enabled = (strcmp (value, "true") == 0);
+  dds_free (value);
+  /* Loaning the payload requires the CDR representation to be identical to the
+     in-memory one, which is exactly when the default serializer uses memcpy */
+  if (!enabled || stype->ops != &ddsi_sertype_ops_default)
+    return false;
+  return ((const struct ddsi_sertype_default *) stype)->opt_size != 0;
+}
+
 static dds_return_t validate_reader_qos (const dds_qos_t *rqos)
 {
 #ifndef DDS_HAS_DEADLINE_MISSED
@@ -427,6 +445,7 @@ void dds_reader_status_cb (void *ventity, const status_cb_data_t *data)
     case DDS_PUBLICATION_MATCHED_STATUS_ID:
     case DDS_OFFERED_DEADLINE_MISSED_STATUS_ID:
     case DDS_OFFERED_INCOMPATIBLE_QOS_STATUS_ID:
+    case DDS_WRITER_READY_STATUS_ID:
       assert (0);
   }
 
@@ -436,9 +455,34 @@ void dds_reader_status_cb (void *ventity, const status_cb_data_t *data)
   ddsrt_mutex_unlock (&rd->m_entity.m_observers_lock);
 }
 
+/* Histogram of the latencies of a stage in the receive path summed over all
+   matched proxy writers (see DDSI_LATENCY_NBUCKETS), only non-zero when
+   Internal/MeasureReceiveLatency is enabled */
+#define LATENCY_HIST_KV(stage) \
+  { "latency_" stage "_lt1us", DDS_STAT_KIND_UINT32 }, \
+  { "latency_" stage "_lt4us", DDS_STAT_KIND_UINT32 }, \
+  { "latency_" stage "_lt16us", DDS_STAT_KIND_UINT32 }, \
+  { "latency_" stage "_lt64us", DDS_STAT_KIND_UINT32 }, \
+  { "latency_" stage "_lt256us", DDS_STAT_KIND_UINT32 }, \
+  { "latency_" stage "_lt1ms", DDS_STAT_KIND_UINT32 }, \
+  { "latency_" stage "_lt4ms", DDS_STAT_KIND_UINT32 }, \
+  { "latency_" stage "_ge4ms", DDS_STAT_KIND_UINT32 }
+
 static const struct dds_stat_keyvalue_descriptor dds_reader_statistics_kv[] = {
-  { "discarded_bytes", DDS_STAT_KIND_UINT64 }
+  { "discarded_bytes", DDS_STAT_KIND_UINT64 },
+  { "rhc_samples_inuse", DDS_STAT_KIND_UINT32 },
+  { "rhc_samples_allocated", DDS_STAT_KIND_UINT32 },
+  { "rhc_instances_inuse", DDS_STAT_KIND_UINT32 },
+  { "rhc_instances_allocated", DDS_STAT_KIND_UINT32 },
+  LATENCY_HIST_KV ("kernel"),
+  LATENCY_HIST_KV ("receive"),
+  LATENCY_HIST_KV ("dqueue"),
+  LATENCY_HIST_KV ("rhc")
 };
+#define LATENCY_HIST_KV_OFFSET 5
+DDSRT_STATIC_ASSERT (DDSI_LATENCY_NBUCKETS == 8 && DDSI_LATENCY_NSTAGES == 4);
+DDSRT_STATIC_ASSERT (sizeof (dds_reader_statistics_kv) / sizeof (dds_reader_statistics_kv[0]) == LATENCY_HIST_KV_OFFSET + DDSI_LATENCY_NSTAGES * DDSI_LATENCY_NBUCKETS);
+#undef LATENCY_HIST_KV
 
 static const struct dds_stat_descriptor dds_reader_statistics_desc = {
   .count = sizeof (dds_reader_statistics_kv) / sizeof (dds_reader_statistics_kv[0]),
@@ -454,7 +498,14 @@ static void dds_reader_refresh_statistics (const struct dds_entity *entity, stru
 {
   const struct dds_reader *rd = (const struct dds_reader *) entity;
   if (rd->m_rd)
-    ddsi_get_reader_stats (rd->m_rd, &stat->kv[0].u.u64);
+  {
+    uint32_t latency_hist[DDSI_LATENCY_NSTAGES * DDSI_LATENCY_NBUCKETS];
+    ddsi_get_reader_stats (rd->m_rd, &stat->kv[0].u.u64, latency_hist);
+    for (int i = 0; i < DDSI_LATENCY_NSTAGES * DDSI_LATENCY_NBUCKETS; i++)
+      stat->kv[LATENCY_HIST_KV_OFFSET + i].u.u32 = latency_hist[i];
+  }
+  if (rd->m_rhc)
+    (void) dds_rhc_default_get_slab_stats (rd->m_rhc, &stat->kv[1].u.u32, &stat->kv[2].u.u32, &stat->kv[3].u.u32, &stat->kv[4].u.u32);
 }
 
 const struct dds_entity_deriver dds_entity_deriver_reader = {
@@ -621,6 +672,7 @@ static dds_entity_t dds_create_reader_int (dds_entity_t participant_or_subscribe
   rd->m_sample_rejected_status.last_reason = DDS_NOT_REJECTED;
   rd->m_topic = tp;
   rd->m_wrapped_sertopic = (tp->m_stype->wrapped_sertopic != NULL) ? 1 : 0;
+  rd->m_serdata_loans = reader_supports_serdata_loans (rqos, tp->m_stype) ? 1 : 0;
   rd->m_rhc = rhc ? rhc : dds_rhc_default_new (rd, tp->m_stype);
   if (dds_rhc_associate (rd->m_rhc, rd, tp->m_stype, rd->m_entity.m_domain->gv.m_tkmap) < 0)
   {
@@ -10,6 +10,7 @@
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 
@@ -46,6 +47,7 @@
 #ifdef DDS_HAS_DEADLINE_MISSED
 #include "dds/ddsi/ddsi_deadline.h"
 #endif
+#include "dds/ddsi/ddsi_content_filter.h"
 #include "dds/ddsi/sysdeps.h"
 
 /* INSTANCE MANAGEMENT
@@ -248,7 +250,7 @@ struct rhc_sample {
   uint32_t disposed_gen;       /* snapshot of instance counter at time of insertion */
   uint32_t no_writers_gen;     /* __/ */
 #ifdef DDS_HAS_LIFESPAN
-  struct lifespan_fhnode lifespan;  /* fibheap node for lifespan */
+  struct lifespan_node lifespan;    /* timing wheel node for lifespan */
   struct rhc_instance *inst;   /* reference to rhc instance */
 #endif
 };
@@ -282,6 +284,43 @@ struct rhc_instance {
   struct rhc_sample a_sample;  /* pre-allocated storage for 1 sample */
 };
 
+/* Samples beyond the one embedded in the instance and the instances themselves
+   are allocated from per-RHC slabs: all allocations and deallocations are done
+   while holding the RHC lock, so a simple free list suffices.  Once the number
+   of free objects exceeds the trim threshold, chunks that are entirely free are
+   returned to the heap, retaining RHC_SLAB_KEEP_CHUNKS chunks worth of free
+   objects (the low-water mark).  Trimming means scanning the free list, and
+   so the threshold also includes twice the number of free objects that remain
+   in partially used chunks and 1/8 of the slab.  An empty slab is always
+   trimmed to the low-water mark. */
+#define RHC_SLAB_CHUNK_NOBJS 64
+#define RHC_SLAB_KEEP_CHUNKS 4
+#define RHC_SLAB_LOW_WATER (RHC_SLAB_KEEP_CHUNKS * RHC_SLAB_CHUNK_NOBJS)
+
+union rhc_slab_align {
+  void *p;
+  uint64_t u;
+  double d;
+};
+
+struct rhc_slab_chunk {
+  struct rhc_slab_chunk *next;
+  union rhc_slab_align objs[];
+};
+
+struct rhc_slab_freeobj {
+  struct rhc_slab_freeobj *next;
+};
+
+struct rhc_slab {
+  size_t objsize;                    /* object size rounded up for alignment */
+  struct rhc_slab_chunk *chunks;     /* all chunks */
+  struct rhc_slab_freeobj *freelist; /* free objects in any of the chunks */
+  uint32_t nchunks;                  /* number of chunks */
+  uint32_t ninuse;                   /* number of objects handed out */
+  uint32_t trim_threshold;           /* trim once more than this many objects are free */
+};
+
 typedef enum rhc_store_result {
   RHC_STORED,
   RHC_FILTERED,
@@ -327,6 +366,8 @@ struct dds_rhc_default {
   uint32_t nqconds;                  /* Number of associated query conditions */
   dds_querycond_mask_t qconds_samplest;  /* Mask of associated query conditions that check the sample state */
   void *qcond_eval_samplebuf;        /* Temporary storage for evaluating query conditions, NULL if no qconds */
+  struct rhc_slab sample_slab;       /* Slab for samples not stored in rhc_instance::a_sample */
+  struct rhc_slab instance_slab;     /* Slab for instances */
 #ifdef DDS_HAS_LIFESPAN
   struct lifespan_adm lifespan;      /* Lifespan administration */
 #endif
@@ -364,6 +405,156 @@ struct trigger_info_post {
 
 static const struct dds_rhc_ops dds_rhc_default_ops;
 
+static void rhc_slab_set_trim_threshold (struct rhc_slab *slab, uint32_t nfragmented)
+{
+  slab->trim_threshold = RHC_SLAB_LOW_WATER + RHC_SLAB_CHUNK_NOBJS + 2 * nfragmented + slab->nchunks * (RHC_SLAB_CHUNK_NOBJS / 8);
+}
+
+static void rhc_slab_init (struct rhc_slab *slab, size_t objsize)
+{
+  const size_t a = sizeof (union rhc_slab_align);
+  assert (objsize >= sizeof (struct rhc_slab_freeobj));
+  slab->objsize = (objsize + a - 1) / a * a;
+  slab->chunks = NULL;
+  slab->freelist = NULL;
+  slab->nchunks = 0;
+  slab->ninuse = 0;
+  rhc_slab_set_trim_threshold (slab, 0);
+}
+
+static void rhc_slab_fini (struct rhc_slab *slab)
+{
+  struct rhc_slab_chunk *c;
+  assert (slab->ninuse == 0);
+  while ((c = slab->chunks) != NULL)
+  {
+    slab->chunks = c->next;
+    ddsrt_free (c);
+  }
+  slab->freelist = NULL;
+  slab->nchunks = 0;
+}
+
+static void *rhc_slab_alloc (struct rhc_slab *slab)
+{
+  struct rhc_slab_freeobj *obj;
+  if (slab->freelist == NULL)
+  {
+    struct rhc_slab_chunk *c = ddsrt_malloc (sizeof (*c) + RHC_SLAB_CHUNK_NOBJS * slab->objsize);
+    char *objs = (char *) c->objs;
+    c->next = slab->chunks;
+    slab->chunks = c;
+    slab->nchunks++;
+    /* no free objects left in the existing chunks, so no fragmentation either */
+    rhc_slab_set_trim_threshold (slab, 0);
+    for (uint32_t i = RHC_SLAB_CHUNK_NOBJS; i > 0; i--)
+    {
+      obj = (struct rhc_slab_freeobj *) (objs + (i - 1) * slab->objsize);
+      obj->next = slab->freelist;
+      slab->freelist = obj;
+    }
+  }
+  obj = slab->freelist;
+  slab->freelist = obj->next;
+  slab->ninuse++;
+  return obj;
+}
+
+static int rhc_slab_chunk_cmp (const void *va, const void *vb)
+{
+  const uintptr_t a = (uintptr_t) *(struct rhc_slab_chunk * const *) va;
+  const uintptr_t b = (uintptr_t) *(struct rhc_slab_chunk * const *) vb;
+  return (a == b) ? 0 : (a < b) ? -1 : 1;
+}
+
+static uint32_t rhc_slab_chunk_index (const struct rhc_slab *slab, struct rhc_slab_chunk * const *cs, const void *obj)
+{
+  /* cs is sorted on address: find the last chunk starting at or before obj */
+  const uintptr_t o = (uintptr_t) obj;
+  uint32_t lo = 0, hi = slab->nchunks;
+  while (hi - lo > 1)
+  {
+    const uint32_t m = lo + (hi - lo) / 2;
+    if ((uintptr_t) cs[m] <= o)
+      lo = m;
+    else
+      hi = m;
+  }
+  assert (o >= (uintptr_t) cs[lo]->objs && o < (uintptr_t) cs[lo]->objs + RHC_SLAB_CHUNK_NOBJS * slab->objsize);
+  return lo;
+}
+
+static void rhc_slab_trim (struct rhc_slab *slab)
+{
+  const uint32_t nchunks = slab->nchunks;
+  struct rhc_slab_chunk **cs = ddsrt_malloc (nchunks * sizeof (*cs));
+  uint32_t *nfree = ddsrt_malloc (nchunks * sizeof (*nfree));
+  struct rhc_slab_chunk *c;
+  uint32_t i;
+  for (c = slab->chunks, i = 0; c; c = c->next, i++)
+  {
+    cs[i] = c;
+    nfree[i] = 0;
+  }
+  qsort (cs, nchunks, sizeof (*cs), rhc_slab_chunk_cmp);
+  for (struct rhc_slab_freeobj *obj = slab->freelist; obj; obj = obj->next)
+    nfree[rhc_slab_chunk_index (slab, cs, obj)]++;
+
+  /* release entirely free chunks, but only down to the low-water mark */
+  const uint32_t released = UINT32_MAX;
+  uint32_t free_objs = slab->nchunks * RHC_SLAB_CHUNK_NOBJS - slab->ninuse, nreleased = 0, nfragmented = 0;
+  for (i = 0; i < nchunks; i++)
+  {
+    if (nfree[i] != RHC_SLAB_CHUNK_NOBJS)
+      nfragmented += nfree[i];
+    else if (free_objs >= RHC_SLAB_LOW_WATER + RHC_SLAB_CHUNK_NOBJS)
+    {
+      nfree[i] = released;
+      free_objs -= RHC_SLAB_CHUNK_NOBJS;
+      nreleased++;
+    }
+  }
+  if (nreleased > 0)
+  {
+    struct rhc_slab_freeobj **pobj = &slab->freelist;
+    while (*pobj)
+    {
+      if (nfree[rhc_slab_chunk_index (slab, cs, *pobj)] == released)
+        *pobj = (*pobj)->next;
+      else
+        pobj = &(*pobj)->next;
+    }
+    slab->chunks = NULL;
+    for (i = nchunks; i > 0; i--)
+    {
+      if (nfree[i - 1] == released)
+        ddsrt_free (cs[i - 1]);
+      else
+      {
+        cs[i - 1]->next = slab->chunks;
+        slab->chunks = cs[i - 1];
+      }
+    }
+    slab->nchunks -= nreleased;
+  }
+  assert (slab->nchunks * RHC_SLAB_CHUNK_NOBJS - slab->ninuse == free_objs);
+  rhc_slab_set_trim_threshold (slab, nfragmented);
+  ddsrt_free (nfree);
+  ddsrt_free (cs);
+}
+
+static void rhc_slab_free (struct rhc_slab *slab, void *vobj)
+{
+  struct rhc_slab_freeobj *obj = vobj;
+  assert (slab->ninuse > 0);
+  obj->next = slab->freelist;
+  slab->freelist = obj;
+  slab->ninuse--;
+  if (slab->nchunks * RHC_SLAB_CHUNK_NOBJS - slab->ninuse > slab->trim_threshold ||
+      (slab->ninuse == 0 && slab->nchunks > RHC_SLAB_KEEP_CHUNKS))
+    rhc_slab_trim (slab);
+}
+
 static uint32_t qmask_of_sample (const struct rhc_sample *s)
 {
   return s->isread ? DDS_READ_SAMPLE_STATE : DDS_NOT_READ_SAMPLE_STATE;
@@ -573,6 +764,8 @@ struct dds_rhc *dds_rhc_default_new_xchecks (dds_reader *reader, struct ddsi_dom
   rhc->tkmap = gv->m_tkmap;
   rhc->gv = gv;
   rhc->xchecks = xchecks;
+  rhc_slab_init (&rhc->sample_slab, sizeof (struct rhc_sample));
+  rhc_slab_init (&rhc->instance_slab, sizeof (struct rhc_instance));
 
 #ifdef DDS_HAS_LIFESPAN
   lifespan_init (gv, &rhc->lifespan, offsetof(struct dds_rhc_default, lifespan), offsetof(struct rhc_sample, lifespan), dds_rhc_default_sample_expired_cb);
@@ -591,6 +784,20 @@ struct dds_rhc *dds_rhc_default_new (dds_reader *reader, const struct ddsi_serty
   return dds_rhc_default_new_xchecks (reader, &reader->m_entity.m_domain->gv, type, (reader->m_entity.m_domain->gv.config.enabled_xchecks & DDSI_XCHECK_RHC) != 0);
 }
 
+bool dds_rhc_default_get_slab_stats (struct dds_rhc *rhc_common, uint32_t * __restrict samples_inuse, uint32_t * __restrict samples_allocated, uint32_t * __restrict instances_inuse, uint32_t * __restrict instances_allocated)
+{
+  struct dds_rhc_default * const rhc = (struct dds_rhc_default *) rhc_common;
+  if (rhc_common->common.ops != &dds_rhc_default_ops)
+    return false;
+  ddsrt_mutex_lock (&rhc->lock);
+  *samples_inuse = rhc->sample_slab.ninuse;
+  *samples_allocated = rhc->sample_slab.nchunks * RHC_SLAB_CHUNK_NOBJS;
+  *instances_inuse = rhc->instance_slab.ninuse;
+  *instances_allocated = rhc->instance_slab.nchunks * RHC_SLAB_CHUNK_NOBJS;
+  ddsrt_mutex_unlock (&rhc->lock);
+  return true;
+}
+
 static dds_return_t dds_rhc_default_associate (struct dds_rhc *rhc, dds_reader *reader, const struct ddsi_sertype *type, struct ddsi_tkmap *tkmap)
 {
   /* ignored out of laziness */
@@ -629,7 +836,7 @@ static bool eval_predicate_invsample (const struct dds_rhc_default *rhc, const s
   return ret;
 }
 
-static struct rhc_sample *alloc_sample (struct rhc_instance *inst)
+static struct rhc_sample *alloc_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst)
 {
   if (inst->a_sample_free)
   {
@@ -641,18 +848,12 @@ static struct rhc_sample *alloc_sample (struct rhc_instance *inst)
   }
   else
   {
-    /* This instead of sizeof(rhc_sample) gets us type checking */
-    struct rhc_sample *s;
-    s = ddsrt_malloc (sizeof (*s));
-    return s;
+    return rhc_slab_alloc (&rhc->sample_slab);
   }
 }
 
 static void free_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst, struct rhc_sample *s)
 {
-#ifndef DDS_HAS_LIFESPAN
-  DDSRT_UNUSED_ARG (rhc);
-#endif
   ddsi_serdata_unref (s->sample);
 #ifdef DDS_HAS_LIFESPAN
   lifespan_unregister_sample_locked (&rhc->lifespan, &s->lifespan);
@@ -667,7 +868,7 @@ static void free_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
   }
   else
   {
-    ddsrt_free (s);
+    rhc_slab_free (&rhc->sample_slab, s);
   }
 }
 
@@ -719,7 +920,7 @@ static void free_empty_instance (struct rhc_instance *inst, struct dds_rhc_defau
   if (inst->deadline_reg)
     deadline_unregister_instance_locked (&rhc->deadline, &inst->deadline);
 #endif
-  ddsrt_free (inst);
+  rhc_slab_free (&rhc->instance_slab, inst);
 }
 
 static void free_instance_rhc_free (struct rhc_instance *inst, struct dds_rhc_default *rhc)
@@ -785,6 +986,8 @@ static void dds_rhc_default_free (struct ddsi_rhc *rhc_common)
   deadline_fini (&rhc->deadline);
 #endif
   ddsrt_hh_free (rhc->instances);
+  rhc_slab_fini (&rhc->sample_slab);
+  rhc_slab_fini (&rhc->instance_slab);
   lwregs_fini (&rhc->registrations);
   if (rhc->qcond_eval_samplebuf != NULL)
     ddsi_sertype_free_sample (rhc->type, rhc->qcond_eval_samplebuf, DDS_FREE_ALL);
@@ -896,7 +1099,7 @@ static bool add_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
     }
 
     /* add new latest sample */
-    s = alloc_sample (inst);
+    s = alloc_sample (rhc, inst);
     inst_clear_invsample_if_exists (rhc, inst, trig_qc);
     if (inst->latest == NULL)
     {
@@ -1008,6 +1211,10 @@ static bool content_filter_accepts (const dds_reader *reader, const struct ddsi_
         break;
       }
     }
+    /* Writers only filter on behalf of readers if they know the filter class,
+       so the reader has to apply its filter itself as well */
+    if (ret && reader->m_rd && reader->m_rd->content_filter)
+      ret = ddsi_content_filter_accepts (&reader->m_entity.m_domain->gv, reader->m_rd->content_filter, sample);
   }
   return ret;
 }
@@ -1384,7 +1591,7 @@ static struct rhc_instance *alloc_new_instance (struct dds_rhc_default *rhc, con
   struct rhc_instance *inst;
 
   ddsi_tkmap_instance_ref (tk);
-  inst = ddsrt_malloc (sizeof (*inst));
+  inst = rhc_slab_alloc (&rhc->instance_slab);
   memset (inst, 0, sizeof (*inst));
   inst->iid = tk->m_iid;
   inst->tk = tk;
@@ -19,6 +19,7 @@
 #include "dds__readcond.h"
 #include "dds__init.h"
 #include "dds__subscriber.h" // only for (de)materializing data_on_readers
+#include "dds__reader.h"
 #include "dds/ddsc/dds_rhc.h"
 #include "dds/ddsi/ddsi_iid.h"
 
@@ -42,30 +43,26 @@ static bool is_triggered (struct dds_entity *e)
   return t;
 }
 
-static dds_return_t dds_waitset_wait_impl (dds_entity_t waitset, dds_attach_t *xs, size_t nxs, dds_time_t abstimeout)
+static dds_return_t dds_waitset_pin (dds_entity_t waitset, dds_waitset **ws)
 {
-  dds_waitset *ws;
+  /* Pinning the waitset here will delay a possible deletion until it is
+   * unpinned. Even when the related mutex is unlocked by a conditioned wait. */
+  dds_entity *ent;
   dds_return_t ret;
-
-  if ((xs == NULL) != (nxs == 0))
-    return DDS_RETCODE_BAD_PARAMETER;
-
-  /* Locking the waitset here will delay a possible deletion until it is
-   * unlocked. Even when the related mutex is unlocked by a conditioned wait. */
+  if ((ret = dds_entity_pin (waitset, &ent)) != DDS_RETCODE_OK)
+    return ret;
+  if (dds_entity_kind (ent) != DDS_KIND_WAITSET)
   {
-    dds_entity *ent;
-    if ((ret = dds_entity_pin (waitset, &ent)) != DDS_RETCODE_OK)
-      return ret;
-    if (dds_entity_kind (ent) != DDS_KIND_WAITSET)
-    {
-      dds_entity_unpin (ent);
-      return DDS_RETCODE_ILLEGAL_OPERATION;
-    }
-    ws = (dds_waitset *) ent;
+    dds_entity_unpin (ent);
+    return DDS_RETCODE_ILLEGAL_OPERATION;
   }
+  *ws = (dds_waitset *) ent;
+  return DDS_RETCODE_OK;
+}
 
+static void dds_waitset_wait_locked (dds_waitset *ws, dds_time_t abstimeout)
+{
   /* Move any previously but no longer triggering entities back to the observed list */
-  ddsrt_mutex_lock (&ws->wait_lock);
   ws->ntriggered = 0;
   for (size_t i = 0; i < ws->nentities; i++)
   {
@@ -81,7 +78,20 @@ static dds_return_t dds_waitset_wait_impl (dds_entity_t waitset, dds_attach_t *x
   while (ws->nentities > 0 && ws->ntriggered == 0 && !dds_handle_is_closed (&ws->m_entity.m_hdllink))
     if (!ddsrt_cond_waituntil (&ws->wait_cond, &ws->wait_lock, abstimeout))
       break;
+}
+
+static dds_return_t dds_waitset_wait_impl (dds_entity_t waitset, dds_attach_t *xs, size_t nxs, dds_time_t abstimeout)
+{
+  dds_waitset *ws;
+  dds_return_t ret;
 
+  if ((xs == NULL) != (nxs == 0))
+    return DDS_RETCODE_BAD_PARAMETER;
+  if ((ret = dds_waitset_pin (waitset, &ws)) != DDS_RETCODE_OK)
+    return ret;
+
+  ddsrt_mutex_lock (&ws->wait_lock);
+  dds_waitset_wait_locked (ws, abstimeout);
   ret = (int32_t) ws->ntriggered;
   for (size_t i = 0; i < ws->ntriggered && i < nxs; i++)
     xs[i] = ws->entities[i].arg;
@@ -178,6 +188,7 @@ dds_entity_t dds_create_waitset (dds_entity_t owner)
   dds_entity_register_child (e, &waitset->m_entity);
   waitset->nentities = 0;
   waitset->ntriggered = 0;
+  waitset->take_start = 0;
   waitset->entities = NULL;
   dds_entity_init_complete (&waitset->m_entity);
   dds_entity_unlock (e);
@@ -394,6 +405,93 @@ dds_return_t dds_waitset_wait (dds_entity_t waitset, dds_attach_t *xs, size_t nx
   return dds_waitset_wait_impl (waitset, xs, nxs, abstimeout);
 }
 
+dds_return_t dds_waitset_takecdr (dds_entity_t waitset, struct ddsi_serdata **buf, dds_sample_info_t *si, dds_entity_t *readers, uint32_t maxs, dds_duration_t reltimeout)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  dds_entity_t hdls_buf[32], *hdls = hdls_buf;
+  size_t nhdls = 0;
+  dds_waitset *ws;
+  dds_return_t ret;
+
+  if (buf == NULL || si == NULL || readers == NULL || maxs == 0 || maxs > INT32_MAX || reltimeout < 0)
+    return DDS_RETCODE_BAD_PARAMETER;
+  if ((ret = dds_waitset_pin (waitset, &ws)) != DDS_RETCODE_OK)
+    return ret;
+
+  const dds_time_t tnow = dds_time ();
+  const dds_time_t abstimeout = (DDS_INFINITY - reltimeout <= tnow) ? DDS_NEVER : (tnow + reltimeout);
+  ddsrt_mutex_lock (&ws->wait_lock);
+  dds_waitset_wait_locked (ws, abstimeout);
+
+  /* The waitset lock doesn't prevent a concurrent delete of an attached
+     entity (it is only detached after its handle has been closed), so only
+     collect the handles of the triggered entities here and pin them after
+     releasing the lock: pinning fails for entities that are being deleted.
+     Taking data requires the RHC lock, and that one may not be acquired
+     while holding the waitset lock anyway. */
+  if (ws->ntriggered > sizeof (hdls_buf) / sizeof (hdls_buf[0]))
+    hdls = ddsrt_malloc (ws->ntriggered * sizeof (*hdls));
+  for (size_t i = 0; i < ws->ntriggered; i++)
+  {
+    const dds_attachment * const a = &ws->entities[(ws->take_start + i) % ws->ntriggered];
+    if (dds_entity_kind (a->entity) == DDS_KIND_READER || dds_entity_kind (a->entity) == DDS_KIND_COND_READ)
+      hdls[nhdls++] = a->handle;
+  }
+  /* Rotate the starting point so a reader with lots of data doesn't starve
+     the others when maxs is small */
+  ws->take_start++;
+  ddsrt_mutex_unlock (&ws->wait_lock);
+
+  uint32_t n = 0;
+  ret = DDS_RETCODE_OK;
+  for (size_t i = 0; i < nhdls && n < maxs && ret == DDS_RETCODE_OK; i++)
+  {
+    dds_entity *e;
+    if (dds_entity_pin (hdls[i], &e) != DDS_RETCODE_OK)
+      continue;
+    struct dds_reader *rd;
+    uint32_t mask;
+    if (dds_entity_kind (e) == DDS_KIND_READER)
+    {
+      rd = (struct dds_reader *) e;
+      mask = DDS_ANY_STATE;
+    }
+    else
+    {
+      const struct dds_readcond *cond = (const struct dds_readcond *) e;
+      rd = (struct dds_reader *) e->m_parent;
+      mask = cond->m_sample_states | cond->m_view_states | cond->m_instance_states;
+    }
+    thread_state_awake (ts1, &e->m_domain->gv);
+    const dds_return_t nrd = dds_readcdr_pinned (true, rd, buf + n, maxs - n, si + n, mask, DDS_HANDLE_NIL, true);
+    thread_state_asleep (ts1);
+    if (nrd < 0)
+      ret = nrd;
+    else
+    {
+      for (int32_t j = 0; j < nrd; j++)
+        readers[n + (uint32_t) j] = rd->m_entity.m_hdllink.hdl;
+      n += (uint32_t) nrd;
+    }
+    if (n == maxs && e == &rd->m_entity)
+    {
+      /* Taking reset DATA_AVAILABLE but there may be more data: set it
+         again rather than leave it to the next write */
+      ddsrt_mutex_lock (&e->m_observers_lock);
+      if (dds_entity_status_set (e, DDS_DATA_AVAILABLE_STATUS))
+        dds_entity_observers_signal (e, DDS_DATA_AVAILABLE_STATUS);
+      ddsrt_mutex_unlock (&e->m_observers_lock);
+    }
+    dds_entity_unpin (e);
+  }
+  if (hdls != hdls_buf)
+    ddsrt_free (hdls);
+  dds_entity_unpin (&ws->m_entity);
+  /* samples already taken are owned by the caller, so an error can only be
+     returned if there are none */
+  return (n > 0 || ret == DDS_RETCODE_OK) ? (dds_return_t) n : ret;
+}
+
 dds_return_t dds_waitset_set_trigger (dds_entity_t waitset, bool trigger)
 {
   dds_entity *ent;
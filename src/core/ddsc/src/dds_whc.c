@@ -18,6 +18,7 @@
 #include "dds/ddsrt/avl.h"
 #include "dds/ddsrt/fibheap.h"
 #include "dds/ddsrt/hopscotch.h"
+#include "dds/ddsrt/strtol.h"
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/features.h"
 #ifdef DDS_HAS_LIFESPAN
@@ -34,6 +35,10 @@
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds__whc.h"
+#include "dds__whc_ring.h"
+#ifdef DDS_HAS_DURABLE_WHC
+#include "dds__whc_durable.h"
+#endif
 #include "dds__entity.h"
 #include "dds__writer.h"
 
@@ -54,11 +59,14 @@ struct whc_node {
   ddsrt_mtime_t last_rexmit_ts;
   uint32_t rexmit_count;
 #ifdef DDS_HAS_LIFESPAN
-  struct lifespan_fhnode lifespan; /* fibheap node for lifespan */
+  struct lifespan_node lifespan; /* timing wheel node for lifespan */
 #endif
   struct ddsi_serdata *serdata;
 };
 
+struct whc_node whc_deferred_work_marker;
+struct whc_node whc_deferred_slow_work_marker;
+
 struct whc_intvnode {
   ddsrt_avl_node_t avlnode;
   seqno_t min;
@@ -73,7 +81,7 @@ struct whc_idxnode {
   struct ddsi_tkmap_instance *tk;
   uint32_t headidx;
 #ifdef DDS_HAS_DEADLINE_MISSED
-  struct deadline_elem deadline; /* list element for deadline missed */
+  struct deadline_elem deadline; /* timing wheel node for deadline missed */
 #endif
   struct whc_node *hist[];
 };
@@ -89,9 +97,13 @@ struct whc_writer_info {
   dds_writer * writer; /* can be NULL, eg in case of whc for built-in writers */
   unsigned is_transient_local: 1;
   unsigned has_deadline: 1;
+  unsigned has_lifespan: 1;
+  unsigned is_keyless: 1;
   uint32_t hdepth; /* 0 = unlimited */
   uint32_t tldepth; /* 0 = disabled/unlimited (no need to maintain an index if KEEP_ALL <=> is_transient_local + tldepth=0) */
   uint32_t idxdepth; /* = max (hdepth, tldepth) */
+  char *durable_store; /* log file for transient/persistent data, or NULL */
+  dds_duration_t durable_sync_interval; /* max time between writing to the log and syncing it */
 };
 
 struct whc_impl {
@@ -427,8 +439,25 @@ struct whc_writer_info *whc_make_wrinfo (struct dds_writer *wr, const dds_qos_t
   assert (qos->present & QP_DURABILITY);
   assert (qos->present & QP_DURABILITY_SERVICE);
   wrinfo->writer = wr;
-  wrinfo->is_transient_local = (qos->durability.kind == DDS_DURABILITY_TRANSIENT_LOCAL);
+  if (wr == NULL || qos->durability.kind < DDS_DURABILITY_TRANSIENT || !dds_qget_prop (qos, DDS_WRITER_PROP_DURABLE_STORE, &wrinfo->durable_store))
+    wrinfo->durable_store = NULL;
+  wrinfo->durable_sync_interval = DDS_SECS (1);
+  if (wrinfo->durable_store != NULL)
+  {
+    char *interval;
+    long long ms;
+    if (dds_qget_prop (qos, DDS_WRITER_PROP_DURABLE_STORE_SYNC_INTERVAL, &interval))
+    {
+      if (ddsrt_atoll (interval, &ms) == DDS_RETCODE_OK && ms >= 0 && ms < INT64_MAX / DDS_NSECS_IN_MSEC)
+        wrinfo->durable_sync_interval = DDS_MSECS (ms);
+      ddsrt_free (interval);
+    }
+  }
+  /* matches writer::handle_as_transient_local */
+  wrinfo->is_transient_local = (qos->durability.kind == DDS_DURABILITY_TRANSIENT_LOCAL || wrinfo->durable_store != NULL);
   wrinfo->has_deadline = (qos->deadline.deadline != DDS_INFINITY);
+  wrinfo->has_lifespan = ((qos->present & QP_LIFESPAN) && qos->lifespan.duration != DDS_INFINITY);
+  wrinfo->is_keyless = (wr != NULL && wr->m_topic->m_stype->typekind_no_key);
   wrinfo->hdepth = (qos->history.kind == DDS_HISTORY_KEEP_ALL) ? 0 : (unsigned) qos->history.depth;
   if (!wrinfo->is_transient_local)
     wrinfo->tldepth = 0;
@@ -440,6 +469,7 @@ struct whc_writer_info *whc_make_wrinfo (struct dds_writer *wr, const dds_qos_t
 
 void whc_free_wrinfo (struct whc_writer_info *wrinfo)
 {
+  ddsrt_free (wrinfo->durable_store);
   ddsrt_free (wrinfo);
 }
 
@@ -451,6 +481,24 @@ struct whc *whc_new (struct ddsi_domaingv *gv, const struct whc_writer_info *wri
 
   assert ((wrinfo->hdepth == 0 || wrinfo->tldepth <= wrinfo->hdepth) || wrinfo->is_transient_local);
 
+  /* Without a key, a history depth or durability, the samples are only ever
+     dropped in sequence number order and an index is useless */
+  if (wrinfo->is_keyless && wrinfo->hdepth == 0 && !wrinfo->is_transient_local && !wrinfo->has_deadline && !wrinfo->has_lifespan)
+    return whc_ring_new (gv);
+
+#ifdef DDS_HAS_DURABLE_WHC
+  if (wrinfo->durable_store != NULL)
+  {
+    struct whc *dwhc;
+    if (wrinfo->has_deadline || wrinfo->has_lifespan)
+      GVWARNING ("durable writer history %s: not supported with deadline or lifespan, history kept in memory\n", wrinfo->durable_store);
+    else if ((dwhc = whc_durable_new (gv, wrinfo->writer->m_topic->m_stype, wrinfo->durable_store, wrinfo->durable_sync_interval, wrinfo->hdepth, wrinfo->tldepth)) != NULL)
+      return dwhc;
+    else
+      GVWARNING ("durable writer history %s: history kept in memory\n", wrinfo->durable_store);
+  }
+#endif
+
   whc = ddsrt_malloc (sizeof (*whc));
   whc->common.ops = &whc_ops;
   ddsrt_mutex_init (&whc->lock);
@@ -0,0 +1,1144 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/mh3.h"
+#include "dds/ddsrt/hopscotch.h"
+#include "dds/ddsrt/static_assert.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_sertype.h"
+#include "dds/ddsi/ddsi_plist.h"
+#include "dds/ddsi/ddsi_tkmap.h"
+#include "dds/ddsi/q_rtps.h"
+#include "dds/ddsi/q_log.h"
+#include "dds/ddsi/q_xevent.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds__whc.h"
+#include "dds__whc_durable.h"
+
+/* WHC for transient and persistent writers that keeps the history in an
+   append-only log in a memory-mapped file, so it survives the writer and
+   doesn't need to be held in memory.
+
+   Every sample is appended to the log when it is written; in memory there
+   is only a record of its sequence number and location (plus the sample
+   itself for as long as it hasn't been acknowledged, to make retransmits
+   cheap).  Which samples are retained once acknowledged follows the
+   durability service history setting exactly like the default WHC does it
+   for transient-local data, including the per-instance index for
+   KEEP_LAST.  Samples that are no longer retained become garbage in the
+   log, which gets compacted by copying the remaining ones into a new file
+   once there is more garbage than live data.
+
+   On creation, the log is read back: every record is handled as if it were
+   written and acknowledged, which reconstructs the index and the set of
+   retained samples.  The writer continues numbering its samples after the
+   highest sequence number in the history, so these can be served to late
+   joining readers like any other transient-local data.
+
+   The log starts with a header identifying it and the type name, followed
+   by the records, each a header followed by the serialised sample padded to
+   a multiple of 8 bytes.  A torn record at the end (e.g., after a crash)
+   fails the checksum and is discarded.
+
+   A log has a single owner: the writer holds an exclusive lock on it for as
+   long as it exists, and another writer (in this process or another) that
+   is configured to use the same store keeps its history in memory. */
+
+#define WHC_DURABLE_MAGIC "DDSWHC\0\0"
+#define WHC_DURABLE_VERSION 1u
+#define WHC_DURABLE_INITIAL_SIZE ((size_t) 1 << 20)
+#define WHC_DURABLE_MIN_COMPACT ((size_t) 1 << 16)
+#define NOT_IN_LOG UINT64_MAX
+
+struct whc_durable_filehdr {
+  char magic[8];
+  uint32_t version;
+  uint32_t type_name_len; /* including terminating 0, padded to multiple of 8 */
+  /* followed by type name */
+};
+
+struct whc_durable_rechdr {
+  uint32_t size; /* size of serialised data */
+  uint32_t check; /* checksum over header (with check = 0) and data */
+  int64_t seq;
+  int64_t tstamp;
+  uint32_t statusinfo;
+  uint32_t kind;
+};
+
+DDSRT_STATIC_ASSERT (sizeof (struct whc_durable_filehdr) % 8 == 0);
+DDSRT_STATIC_ASSERT (sizeof (struct whc_durable_rechdr) % 8 == 0);
+
+struct whc_durable_idxnode {
+  uint64_t iid;
+  struct ddsi_tkmap_instance *tk; /* holds a reference, which keeps iid stable */
+  uint32_t headidx;
+  seqno_t hist[]; /* 0 if unused */
+};
+
+struct whc_durable_rec {
+  seqno_t seq;
+  uint64_t off; /* offset of record in log, NOT_IN_LOG if not in the log */
+  uint32_t logsize; /* size of record in log */
+  uint32_t idxpos; /* position in idxnode->hist if idxnode != NULL */
+  struct whc_durable_idxnode *idxnode;
+  struct ddsi_serdata *serdata; /* only while unacked */
+  struct ddsi_plist *plist; /* 0 if nothing special */
+  size_t size;
+  ddsrt_mtime_t last_rexmit_ts;
+  uint32_t rexmit_count;
+  unsigned live: 1;
+  unsigned unacked: 1; /* counted in whc::unacked_bytes iff 1 */
+  unsigned borrowed: 1; /* at most one can borrow it at any time */
+};
+
+struct whc_durable {
+  struct whc common;
+  ddsrt_mutex_t lock;
+  struct ddsi_domaingv *gv;
+  struct ddsi_tkmap *tkmap;
+  const struct ddsi_sertype *type;
+  uint32_t hdepth; /* 0 = unlimited */
+  uint32_t tldepth; /* 0 = unlimited */
+  uint32_t idxdepth; /* = max (hdepth, tldepth) */
+  bool is_volatile; /* set by downgrade_to_volatile */
+  seqno_t max_drop_seq;
+  size_t unacked_bytes;
+  size_t sample_overhead;
+  uint32_t fragment_size;
+  struct ddsrt_hh *idx_hash;
+
+  /* records in order of sequence number, [first,n) may contain dead ones, but
+     recs[first] and recs[n-1] are always live */
+  struct whc_durable_rec *recs;
+  uint32_t first, n, cap, ndead;
+
+  /* log */
+  char *path;
+  int fd;
+  unsigned char *map;
+  size_t mapsize; /* = file size */
+  size_t data_start; /* offset of first record */
+  size_t used; /* offset of end of last record */
+  size_t live_bytes, dead_bytes;
+  size_t compact_threshold;
+  size_t synced; /* offset up to which the log is known to be on disk */
+  dds_duration_t sync_interval;
+  struct xevent *sync_xev;
+  bool sync_scheduled;
+};
+
+struct whc_durable_sample_iter {
+  struct whc_sample_iter_base c;
+  bool first;
+};
+
+DDSRT_STATIC_ASSERT (sizeof (struct whc_durable_sample_iter) <= sizeof (struct whc_sample_iter));
+
+#define TRACE(...) DDS_CLOG (DDS_LC_WHC, &whc->gv->logconfig, __VA_ARGS__)
+
+static uint32_t whc_durable_idxnode_hash_key (const void *vn)
+{
+  const struct whc_durable_idxnode *n = vn;
+  return (uint32_t) n->iid;
+}
+
+static int whc_durable_idxnode_eq_key (const void *va, const void *vb)
+{
+  const struct whc_durable_idxnode *a = va;
+  const struct whc_durable_idxnode *b = vb;
+  return (a->iid == b->iid);
+}
+
+static size_t align8 (size_t x)
+{
+  return (x + 7) & ~(size_t) 7;
+}
+
+static uint32_t rec_check (const struct whc_durable_rechdr *hdr, const void *data)
+{
+  struct whc_durable_rechdr tmp = *hdr;
+  tmp.check = 0;
+  return ddsrt_mh3 (data, hdr->size, ddsrt_mh3 (&tmp, sizeof (tmp), 0));
+}
+
+/*************** LOG ***************/
+
+static bool log_allocate (int fd, size_t size)
+{
+#if defined (__linux__)
+  /* reserve the space, so running out of disk space is an error here
+     instead of a SIGBUS when writing to the mapped file */
+  return posix_fallocate (fd, 0, (off_t) size) == 0;
+#else
+  return ftruncate (fd, (off_t) size) == 0;
+#endif
+}
+
+static bool log_lock (int fd)
+{
+  /* flock rather than fcntl: the latter locks are owned by the process and
+     don't stop a second writer in the same process */
+  return flock (fd, LOCK_EX | LOCK_NB) == 0;
+}
+
+static int log_open_locked (const char *path, struct stat *st)
+{
+  while (true)
+  {
+    struct stat st_path;
+    int fd, err;
+    if ((fd = open (path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0)
+      return -1;
+    if (!log_lock (fd) || fstat (fd, st) != 0 || stat (path, &st_path) != 0)
+    {
+      err = errno;
+      close (fd);
+      errno = err;
+      return -1;
+    }
+    if (st->st_dev == st_path.st_dev && st->st_ino == st_path.st_ino)
+      return fd;
+    /* the owner compacted it in between opening and locking */
+    close (fd);
+  }
+}
+
+static unsigned char *log_map (int fd, size_t size)
+{
+  void *p = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  return (p == MAP_FAILED) ? NULL : p;
+}
+
+static bool log_grow (struct whc_durable *whc, size_t need)
+{
+  unsigned char *map;
+  size_t size = whc->mapsize;
+  while (size - whc->used < need)
+    size *= 2;
+  if (!log_allocate (whc->fd, size) || (map = log_map (whc->fd, size)) == NULL)
+    return false;
+  munmap (whc->map, whc->mapsize);
+  whc->map = map;
+  whc->mapsize = size;
+  return true;
+}
+
+static void log_sync (struct whc_durable *whc)
+{
+  /* msync gets the mapped data to the file, fsync the file size and
+     allocation changes that the data depends on */
+  if (whc->synced == whc->used)
+    return;
+  if (msync (whc->map, whc->used, MS_SYNC) != 0 || fsync (whc->fd) != 0)
+  {
+    struct ddsi_domaingv * const gv = whc->gv;
+    GVWARNING ("durable writer history %s: sync failed: %s\n", whc->path, strerror (errno));
+    return;
+  }
+  whc->synced = whc->used;
+}
+
+static void log_sync_cb (struct xevent *xev, void *varg, ddsrt_mtime_t tnow)
+{
+  struct whc_durable * const whc = varg;
+  (void) xev;
+  (void) tnow;
+  ddsrt_mutex_lock (&whc->lock);
+  log_sync (whc);
+  whc->sync_scheduled = false;
+  ddsrt_mutex_unlock (&whc->lock);
+}
+
+static void log_sync_after_append (struct whc_durable *whc)
+{
+  if (whc->sync_interval == 0)
+    log_sync (whc);
+  else if (!whc->sync_scheduled)
+  {
+    whc->sync_scheduled = true;
+    (void) resched_xevent_if_earlier (whc->sync_xev, ddsrt_mtime_add_duration (ddsrt_time_monotonic (), whc->sync_interval));
+  }
+}
+
+static bool log_append (struct whc_durable *whc, seqno_t seq, const struct ddsi_serdata *serdata, uint64_t *off, uint32_t *logsize)
+{
+  struct whc_durable_rechdr hdr;
+  const size_t size = ddsi_serdata_size (serdata);
+  const size_t recsize = sizeof (hdr) + align8 (size);
+  if (recsize > UINT32_MAX || (whc->mapsize - whc->used < recsize && !log_grow (whc, recsize)))
+    return false;
+  unsigned char * const dst = whc->map + whc->used;
+  ddsi_serdata_to_ser (serdata, 0, size, dst + sizeof (hdr));
+  memset (dst + sizeof (hdr) + size, 0, recsize - sizeof (hdr) - size);
+  hdr.size = (uint32_t) size;
+  hdr.seq = seq;
+  hdr.tstamp = serdata->timestamp.v;
+  hdr.statusinfo = serdata->statusinfo;
+  hdr.kind = (uint32_t) serdata->kind;
+  hdr.check = rec_check (&hdr, dst + sizeof (hdr));
+  /* header last, so that a partially written record never looks valid */
+  memcpy (dst, &hdr, sizeof (hdr));
+  *off = whc->used;
+  *logsize = (uint32_t) recsize;
+  whc->used += recsize;
+  return true;
+}
+
+static struct ddsi_serdata *log_load (const struct whc_durable *whc, uint64_t off)
+{
+  struct whc_durable_rechdr hdr;
+  struct ddsi_serdata *sd;
+  ddsrt_iovec_t iov;
+  memcpy (&hdr, whc->map + off, sizeof (hdr));
+  iov.iov_base = whc->map + off + sizeof (hdr);
+  iov.iov_len = (ddsrt_iov_len_t) hdr.size;
+  if ((sd = ddsi_serdata_from_ser_iov (whc->type, (enum ddsi_serdata_kind) hdr.kind, 1, &iov, hdr.size)) == NULL)
+    return NULL;
+  sd->statusinfo = hdr.statusinfo;
+  sd->timestamp.v = hdr.tstamp;
+  return sd;
+}
+
+static size_t log_header_size (const struct ddsi_sertype *type)
+{
+  return sizeof (struct whc_durable_filehdr) + align8 (strlen (type->type_name) + 1);
+}
+
+static void log_write_header (unsigned char *map, const struct ddsi_sertype *type)
+{
+  struct whc_durable_filehdr hdr;
+  const size_t size = log_header_size (type);
+  memcpy (hdr.magic, WHC_DURABLE_MAGIC, sizeof (hdr.magic));
+  hdr.version = WHC_DURABLE_VERSION;
+  hdr.type_name_len = (uint32_t) (size - sizeof (hdr));
+  memset (map, 0, size);
+  memcpy (map, &hdr, sizeof (hdr));
+  memcpy (map + sizeof (hdr), type->type_name, strlen (type->type_name));
+}
+
+static bool log_check_header (const unsigned char *map, size_t size, const struct ddsi_sertype *type)
+{
+  struct whc_durable_filehdr hdr;
+  const size_t hdrsize = log_header_size (type);
+  if (size < hdrsize)
+    return false;
+  memcpy (&hdr, map, sizeof (hdr));
+  return (memcmp (hdr.magic, WHC_DURABLE_MAGIC, sizeof (hdr.magic)) == 0 &&
+          hdr.version == WHC_DURABLE_VERSION &&
+          hdr.type_name_len == hdrsize - sizeof (hdr) &&
+          strcmp ((const char *) map + sizeof (hdr), type->type_name) == 0);
+}
+
+static bool log_needs_compaction (const struct whc_durable *whc)
+{
+  return whc->dead_bytes >= whc->compact_threshold && whc->dead_bytes > whc->live_bytes;
+}
+
+/*************** RECORDS ***************/
+
+/* Returns the index in [first,n) of the first record with a sequence number >= seq, n if none */
+static uint32_t lower_bound (const struct whc_durable *whc, seqno_t seq)
+{
+  uint32_t lo = whc->first, hi = whc->n;
+  while (lo < hi)
+  {
+    const uint32_t m = lo + (hi - lo) / 2;
+    if (whc->recs[m].seq < seq)
+      lo = m + 1;
+    else
+      hi = m;
+  }
+  return lo;
+}
+
+static uint32_t next_live (const struct whc_durable *whc, uint32_t i)
+{
+  while (i < whc->n && !whc->recs[i].live)
+    i++;
+  return i;
+}
+
+static struct whc_durable_rec *find_live (const struct whc_durable *whc, seqno_t seq)
+{
+  const uint32_t i = lower_bound (whc, seq);
+  if (i == whc->n || whc->recs[i].seq != seq || !whc->recs[i].live)
+    return NULL;
+  return &whc->recs[i];
+}
+
+static void squeeze_recs (struct whc_durable *whc)
+{
+  uint32_t k = 0;
+  for (uint32_t i = whc->first; i < whc->n; i++)
+  {
+    if (whc->recs[i].live)
+      whc->recs[k++] = whc->recs[i];
+  }
+  whc->first = 0;
+  whc->n = k;
+  whc->ndead = 0;
+}
+
+static struct whc_durable_rec *append_rec (struct whc_durable *whc)
+{
+  if (whc->n == whc->cap)
+  {
+    if (whc->ndead > 0 || whc->first > 0)
+      squeeze_recs (whc);
+    if (whc->n > whc->cap / 2)
+    {
+      whc->cap *= 2;
+      whc->recs = ddsrt_realloc (whc->recs, whc->cap * sizeof (*whc->recs));
+    }
+  }
+  return &whc->recs[whc->n++];
+}
+
+static void drop_rec (struct whc_durable *whc, struct whc_durable_rec *rec)
+{
+  assert (rec->live);
+  TRACE ("  drop seq %"PRId64"\n", rec->seq);
+  rec->live = 0;
+  if (rec->unacked)
+  {
+    assert (whc->unacked_bytes >= rec->size);
+    whc->unacked_bytes -= rec->size;
+    rec->unacked = 0;
+  }
+  if (rec->serdata)
+  {
+    ddsi_serdata_unref (rec->serdata);
+    rec->serdata = NULL;
+  }
+  /* ownership of plist of a borrowed sample shifts to the borrower */
+  if (rec->plist && !rec->borrowed)
+  {
+    ddsi_plist_fini (rec->plist);
+    ddsrt_free (rec->plist);
+  }
+  rec->plist = NULL;
+  if (rec->idxnode)
+  {
+    rec->idxnode->hist[rec->idxpos] = 0;
+    rec->idxnode = NULL;
+  }
+  if (rec->off != NOT_IN_LOG)
+  {
+    whc->live_bytes -= rec->logsize;
+    whc->dead_bytes += rec->logsize;
+  }
+  whc->ndead++;
+  while (whc->first < whc->n && !whc->recs[whc->first].live)
+  {
+    whc->first++;
+    whc->ndead--;
+  }
+  while (whc->n > whc->first && !whc->recs[whc->n - 1].live)
+  {
+    whc->n--;
+    whc->ndead--;
+  }
+}
+
+static void drop_seq (struct whc_durable *whc, seqno_t seq)
+{
+  struct whc_durable_rec * const rec = find_live (whc, seq);
+  assert (rec != NULL);
+  drop_rec (whc, rec);
+}
+
+static bool in_tlidx (const struct whc_durable *whc, const struct whc_durable_rec *rec)
+{
+  if (rec->idxnode == NULL)
+    return false;
+  const uint32_t headidx = rec->idxnode->headidx, pos = rec->idxpos;
+  const uint32_t d = (headidx + (pos > headidx ? whc->idxdepth : 0)) - pos;
+  assert (d < whc->idxdepth);
+  return d < whc->tldepth;
+}
+
+/* Whether an acknowledged sample must be retained */
+static bool is_durable (const struct whc_durable *whc, const struct whc_durable_rec *rec)
+{
+  if (rec->off == NOT_IN_LOG || whc->is_volatile)
+    return false;
+  else if (whc->tldepth == 0)
+    return true;
+  else
+    return in_tlidx (whc, rec);
+}
+
+static void delete_instance_from_idx (struct whc_durable *whc, seqno_t max_drop_seq, struct whc_durable_idxnode *idxn)
+{
+  if (!ddsrt_hh_remove (whc->idx_hash, idxn))
+    assert (0);
+  for (uint32_t i = 0; i < whc->idxdepth; i++)
+  {
+    if (idxn->hist[i] == 0)
+      continue;
+    struct whc_durable_rec * const rec = find_live (whc, idxn->hist[i]);
+    assert (rec != NULL && rec->idxnode == idxn);
+    rec->idxnode = NULL;
+    if (rec->seq <= max_drop_seq)
+      drop_rec (whc, rec);
+  }
+  ddsi_tkmap_instance_unref (whc->tkmap, idxn->tk);
+  ddsrt_free (idxn);
+}
+
+static void update_idx (struct whc_durable *whc, seqno_t max_drop_seq, struct whc_durable_rec *rec, struct ddsi_tkmap_instance *tk)
+{
+  const bool unregister = (rec->serdata ? rec->serdata->statusinfo : 0) & NN_STATUSINFO_UNREGISTER;
+  union {
+    struct whc_durable_idxnode idxn;
+    char pad[sizeof (struct whc_durable_idxnode) + sizeof (seqno_t)];
+  } template;
+  struct whc_durable_idxnode *idxn;
+  template.idxn.iid = tk->m_iid;
+  if ((idxn = ddsrt_hh_lookup (whc->idx_hash, &template.idxn)) != NULL)
+  {
+    if (unregister)
+    {
+      delete_instance_from_idx (whc, max_drop_seq, idxn);
+      if (rec->seq <= max_drop_seq)
+        drop_rec (whc, rec);
+    }
+    else
+    {
+      if (++idxn->headidx == whc->idxdepth)
+        idxn->headidx = 0;
+      if (idxn->hist[idxn->headidx] != 0)
+      {
+        struct whc_durable_rec * const oldrec = find_live (whc, idxn->hist[idxn->headidx]);
+        assert (oldrec != NULL && oldrec->idxnode == idxn);
+        oldrec->idxnode = NULL;
+        if ((whc->hdepth > 0 || oldrec->seq <= max_drop_seq) && whc->tldepth > 0)
+          drop_rec (whc, oldrec);
+      }
+      idxn->hist[idxn->headidx] = rec->seq;
+      rec->idxnode = idxn;
+      rec->idxpos = idxn->headidx;
+      /* the sample that just dropped out of the durability history can go if acked */
+      if (whc->tldepth > 0 && whc->idxdepth > whc->tldepth)
+      {
+        const uint32_t pos = (idxn->headidx + whc->idxdepth - whc->tldepth) % whc->idxdepth;
+        if (idxn->hist[pos] != 0 && idxn->hist[pos] <= max_drop_seq)
+          drop_seq (whc, idxn->hist[pos]);
+      }
+    }
+  }
+  else if (!unregister)
+  {
+    idxn = ddsrt_malloc (sizeof (*idxn) + whc->idxdepth * sizeof (idxn->hist[0]));
+    ddsi_tkmap_instance_ref (tk);
+    idxn->iid = tk->m_iid;
+    idxn->tk = tk;
+    idxn->headidx = 0;
+    idxn->hist[0] = rec->seq;
+    for (uint32_t i = 1; i < whc->idxdepth; i++)
+      idxn->hist[i] = 0;
+    rec->idxnode = idxn;
+    rec->idxpos = 0;
+    if (!ddsrt_hh_add (whc->idx_hash, idxn))
+      assert (0);
+  }
+  else if (rec->seq <= max_drop_seq)
+  {
+    drop_rec (whc, rec);
+  }
+}
+
+/* Inserts a sample; if "off" is NOT_IN_LOG it gets appended to the log, else
+   it is a sample read back from the log at that offset */
+static void insert_locked (struct whc_durable *whc, seqno_t max_drop_seq, seqno_t seq, struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk, uint64_t off, uint32_t logsize)
+{
+  assert (whc->first == whc->n || seq > whc->recs[whc->n - 1].seq);
+  struct whc_durable_rec * const rec = append_rec (whc);
+  rec->seq = seq;
+  rec->off = off;
+  rec->logsize = logsize;
+  rec->idxnode = NULL;
+  rec->idxpos = 0;
+  rec->plist = plist;
+  rec->last_rexmit_ts.v = 0;
+  rec->rexmit_count = 0;
+  rec->live = 1;
+  rec->borrowed = 0;
+  const size_t sz = ddsi_serdata_size (serdata);
+  rec->size = sz + ((sz + whc->fragment_size - 1) / whc->fragment_size) * whc->sample_overhead;
+
+  if (rec->off == NOT_IN_LOG && serdata->kind != SDK_EMPTY)
+  {
+    if (!log_append (whc, seq, serdata, &rec->off, &rec->logsize))
+    {
+      struct ddsi_domaingv * const gv = whc->gv;
+      GVWARNING ("durable writer history %s: failed to append sample %"PRId64" to log\n", whc->path, seq);
+    }
+  }
+  if (rec->off != NOT_IN_LOG)
+    whc->live_bytes += rec->logsize;
+
+  /* the sample is kept in memory only for as long as it is needed for
+     retransmits; for the index, unregisters are recognised by the statusinfo,
+     so keep the serdata around until the index has been updated */
+  rec->serdata = ddsi_serdata_ref (serdata);
+  rec->unacked = (seq > max_drop_seq);
+  if (rec->unacked)
+    whc->unacked_bytes += rec->size;
+
+  if (serdata->kind != SDK_EMPTY && whc->idxdepth > 0 && tk != NULL)
+    update_idx (whc, max_drop_seq, rec, tk);
+  else if ((serdata->statusinfo & NN_STATUSINFO_UNREGISTER) && seq <= max_drop_seq)
+    drop_rec (whc, rec);
+
+  /* rec remains valid: dropping records doesn't move them */
+  if (rec->live && !rec->unacked)
+  {
+    ddsi_serdata_unref (rec->serdata);
+    rec->serdata = NULL;
+    if (!is_durable (whc, rec))
+      drop_rec (whc, rec);
+  }
+}
+
+static bool compact_locked (struct whc_durable *whc)
+{
+  struct ddsi_domaingv * const gv = whc->gv;
+  char *tmppath = NULL;
+  unsigned char *map = NULL;
+  int fd = -1;
+  size_t size = WHC_DURABLE_INITIAL_SIZE;
+  const size_t need = whc->data_start + whc->live_bytes;
+  while (size < need + need / 2)
+    size *= 2;
+
+  TRACE ("whc_durable_compact(%p %s live %"PRIuSIZE" dead %"PRIuSIZE")\n", (void *) whc, whc->path, whc->live_bytes, whc->dead_bytes);
+  (void) ddsrt_asprintf (&tmppath, "%s.tmp", whc->path);
+  if ((fd = open (tmppath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0 || !log_lock (fd))
+    goto err;
+  if (!log_allocate (fd, size) || (map = log_map (fd, size)) == NULL)
+    goto err;
+
+  memcpy (map, whc->map, whc->data_start);
+  size_t pos = whc->data_start;
+  for (uint32_t i = whc->first; i < whc->n; i++)
+  {
+    const struct whc_durable_rec * const rec = &whc->recs[i];
+    if (!rec->live || rec->off == NOT_IN_LOG)
+      continue;
+    memcpy (map + pos, whc->map + rec->off, rec->logsize);
+    pos += rec->logsize;
+  }
+  assert (pos == need);
+  if (msync (map, pos, MS_SYNC) != 0 || fsync (fd) != 0 || rename (tmppath, whc->path) != 0)
+    goto err;
+
+  /* only now the new log has replaced the old one can the offsets be updated */
+  pos = whc->data_start;
+  for (uint32_t i = whc->first; i < whc->n; i++)
+  {
+    struct whc_durable_rec * const rec = &whc->recs[i];
+    if (!rec->live || rec->off == NOT_IN_LOG)
+      continue;
+    rec->off = pos;
+    pos += rec->logsize;
+  }
+  munmap (whc->map, whc->mapsize);
+  close (whc->fd);
+  whc->map = map;
+  whc->fd = fd;
+  whc->mapsize = size;
+  whc->used = whc->synced = pos;
+  whc->dead_bytes = 0;
+  whc->compact_threshold = WHC_DURABLE_MIN_COMPACT;
+  squeeze_recs (whc);
+  ddsrt_free (tmppath);
+  return true;
+
+err:
+  GVWARNING ("durable writer history %s: compaction failed: %s\n", whc->path, strerror (errno));
+  if (map)
+    munmap (map, size);
+  if (fd >= 0)
+  {
+    close (fd);
+    (void) unlink (tmppath);
+  }
+  ddsrt_free (tmppath);
+  /* don't retry until there is quite a bit more garbage */
+  whc->compact_threshold = 2 * whc->dead_bytes;
+  return false;
+}
+
+/*************** OPS ***************/
+
+static void get_state_locked (const struct whc_durable *whc, struct whc_state *st)
+{
+  if (whc->first == whc->n)
+  {
+    st->min_seq = st->max_seq = -1;
+    st->unacked_bytes = 0;
+  }
+  else
+  {
+    st->min_seq = whc->recs[whc->first].seq;
+    st->max_seq = whc->recs[whc->n - 1].seq;
+    st->unacked_bytes = whc->unacked_bytes;
+  }
+}
+
+static int whc_durable_insert (struct whc *whc_generic, seqno_t max_drop_seq, seqno_t seq, ddsrt_mtime_t exp, struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
+{
+  struct whc_durable * const whc = (struct whc_durable *) whc_generic;
+  (void) exp;
+  ddsrt_mutex_lock (&whc->lock);
+  TRACE ("whc_durable_insert(%p max_drop_seq %"PRId64" seq %"PRId64" plist %p serdata %p:%"PRIx32")\n",
+         (void *) whc, max_drop_seq, seq, (void *) plist, (void *) serdata, serdata->hash);
+  assert (max_drop_seq < MAX_SEQ_NUMBER);
+  assert (max_drop_seq >= whc->max_drop_seq);
+  insert_locked (whc, max_drop_seq, seq, plist, serdata, tk, NOT_IN_LOG, 0);
+  log_sync_after_append (whc);
+  ddsrt_mutex_unlock (&whc->lock);
+  return 0;
+}
+
+static uint32_t whc_durable_remove_acked_messages (struct whc *whc_generic, seqno_t max_drop_seq, struct whc_state *whcst, struct whc_node **deferred_free_list)
+{
+  struct whc_durable * const whc = (struct whc_durable *) whc_generic;
+  uint32_t cnt = 0;
+  ddsrt_mutex_lock (&whc->lock);
+  assert (max_drop_seq < MAX_SEQ_NUMBER);
+  assert (max_drop_seq >= whc->max_drop_seq);
+  TRACE ("whc_durable_remove_acked_messages(%p max_drop_seq %"PRId64")\n", (void *) whc, max_drop_seq);
+  for (uint32_t i = lower_bound (whc, whc->max_drop_seq + 1); i < whc->n && whc->recs[i].seq <= max_drop_seq; i++)
+  {
+    struct whc_durable_rec * const rec = &whc->recs[i];
+    if (!rec->live)
+      continue;
+    if (rec->unacked)
+    {
+      whc->unacked_bytes -= rec->size;
+      rec->unacked = 0;
+    }
+    if (rec->serdata)
+    {
+      ddsi_serdata_unref (rec->serdata);
+      rec->serdata = NULL;
+    }
+    if (!is_durable (whc, rec))
+    {
+      drop_rec (whc, rec);
+      cnt++;
+    }
+  }
+  whc->max_drop_seq = max_drop_seq;
+  get_state_locked (whc, whcst);
+  /* compacting the log is expensive, so do it outside the writer lock and
+     preferably not in the thread that handles the acknowledgement: the caller
+     only needs to know whether there is something to do and pass it to
+     free_deferred_free_list */
+  *deferred_free_list = log_needs_compaction (whc) ? &whc_deferred_slow_work_marker : NULL;
+  ddsrt_mutex_unlock (&whc->lock);
+  return cnt;
+}
+
+static void whc_durable_free_deferred_free_list (struct whc *whc_generic, struct whc_node *deferred_free_list)
+{
+  struct whc_durable * const whc = (struct whc_durable *) whc_generic;
+  if (deferred_free_list == NULL)
+    return;
+  assert (deferred_free_list == &whc_deferred_slow_work_marker);
+  ddsrt_mutex_lock (&whc->lock);
+  if (log_needs_compaction (whc))
+    (void) compact_locked (whc);
+  ddsrt_mutex_unlock (&whc->lock);
+}
+
+static void whc_durable_get_state (const struct whc *whc_generic, struct whc_state *st)
+{
+  const struct whc_durable * const whc = (const struct whc_durable *) whc_generic;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  get_state_locked (whc, st);
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+}
+
+static seqno_t whc_durable_next_seq (const struct whc *whc_generic, seqno_t seq)
+{
+  const struct whc_durable * const whc = (const struct whc_durable *) whc_generic;
+  seqno_t nseq;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  const uint32_t i = (seq == MAX_SEQ_NUMBER) ? whc->n : next_live (whc, lower_bound (whc, seq + 1));
+  nseq = (i == whc->n) ? MAX_SEQ_NUMBER : whc->recs[i].seq;
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+  return nseq;
+}
+
+static bool make_borrowed_sample (const struct whc_durable *whc, struct whc_borrowed_sample *sample, struct whc_durable_rec *rec)
+{
+  assert (!rec->borrowed);
+  if (rec->serdata)
+    sample->serdata = ddsi_serdata_ref (rec->serdata);
+  else if ((sample->serdata = log_load (whc, rec->off)) == NULL)
+    return false;
+  rec->borrowed = 1;
+  sample->seq = rec->seq;
+  sample->plist = rec->plist;
+  sample->unacked = rec->unacked;
+  sample->rexmit_count = rec->rexmit_count;
+  sample->last_rexmit_ts = rec->last_rexmit_ts;
+  return true;
+}
+
+static bool whc_durable_borrow_sample (const struct whc *whc_generic, seqno_t seq, struct whc_borrowed_sample *sample)
+{
+  const struct whc_durable * const whc = (const struct whc_durable *) whc_generic;
+  struct whc_durable_rec *rec;
+  bool found;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  if ((rec = find_live (whc, seq)) == NULL)
+    found = false;
+  else
+    found = make_borrowed_sample (whc, sample, rec);
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+  return found;
+}
+
+static bool whc_durable_borrow_sample_key (const struct whc *whc_generic, const struct ddsi_serdata *serdata_key, struct whc_borrowed_sample *sample)
+{
+  const struct whc_durable * const whc = (const struct whc_durable *) whc_generic;
+  union {
+    struct whc_durable_idxnode idxn;
+    char pad[sizeof (struct whc_durable_idxnode) + sizeof (seqno_t)];
+  } template;
+  struct whc_durable_idxnode *idxn;
+  struct whc_durable_rec *rec;
+  bool found = false;
+  if (whc->idxdepth == 0)
+    return false;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  template.idxn.iid = ddsi_tkmap_lookup (whc->tkmap, serdata_key);
+  if ((idxn = ddsrt_hh_lookup (whc->idx_hash, &template.idxn)) != NULL && (rec = find_live (whc, idxn->hist[idxn->headidx])) != NULL)
+    found = make_borrowed_sample (whc, sample, rec);
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+  return found;
+}
+
+static void return_sample_locked (struct whc_durable *whc, struct whc_borrowed_sample *sample, bool update_retransmit_info)
+{
+  struct whc_durable_rec *rec;
+  /* the borrowed sample always has a reference of its own */
+  ddsi_serdata_unref (sample->serdata);
+  if ((rec = find_live (whc, sample->seq)) == NULL)
+  {
+    /* removed while borrowed: ownership of plist shifted to the borrowed copy */
+    if (sample->plist)
+    {
+      ddsi_plist_fini (sample->plist);
+      ddsrt_free (sample->plist);
+    }
+  }
+  else
+  {
+    assert (rec->borrowed);
+    rec->borrowed = 0;
+    if (update_retransmit_info)
+    {
+      rec->rexmit_count = sample->rexmit_count;
+      rec->last_rexmit_ts = sample->last_rexmit_ts;
+    }
+  }
+}
+
+static void whc_durable_return_sample (struct whc *whc_generic, struct whc_borrowed_sample *sample, bool update_retransmit_info)
+{
+  struct whc_durable * const whc = (struct whc_durable *) whc_generic;
+  ddsrt_mutex_lock (&whc->lock);
+  return_sample_locked (whc, sample, update_retransmit_info);
+  ddsrt_mutex_unlock (&whc->lock);
+}
+
+static void whc_durable_sample_iter_init (const struct whc *whc_generic, struct whc_sample_iter *opaque_it)
+{
+  struct whc_durable_sample_iter *it = (struct whc_durable_sample_iter *) opaque_it;
+  it->c.whc = (struct whc *) whc_generic;
+  it->first = true;
+}
+
+static bool whc_durable_sample_iter_borrow_next (struct whc_sample_iter *opaque_it, struct whc_borrowed_sample *sample)
+{
+  struct whc_durable_sample_iter * const it = (struct whc_durable_sample_iter *) opaque_it;
+  struct whc_durable * const whc = (struct whc_durable *) it->c.whc;
+  seqno_t seq;
+  bool valid = false;
+  ddsrt_mutex_lock (&whc->lock);
+  if (!it->first)
+  {
+    seq = sample->seq;
+    return_sample_locked (whc, sample, false);
+  }
+  else
+  {
+    it->first = false;
+    seq = 0;
+  }
+  /* skip samples that can't be read back from the log */
+  for (uint32_t i = next_live (whc, lower_bound (whc, seq + 1)); i < whc->n && !valid; i = next_live (whc, i + 1))
+    valid = make_borrowed_sample (whc, sample, &whc->recs[i]);
+  ddsrt_mutex_unlock (&whc->lock);
+  return valid;
+}
+
+static uint32_t whc_durable_downgrade_to_volatile (struct whc *whc_generic, struct whc_state *st)
+{
+  struct whc_durable * const whc = (struct whc_durable *) whc_generic;
+  uint32_t cnt = 0;
+  ddsrt_mutex_lock (&whc->lock);
+  whc->is_volatile = true;
+  for (uint32_t i = whc->first; i < whc->n; i++)
+  {
+    if (whc->recs[i].live && !whc->recs[i].unacked)
+    {
+      drop_rec (whc, &whc->recs[i]);
+      cnt++;
+    }
+  }
+  get_state_locked (whc, st);
+  ddsrt_mutex_unlock (&whc->lock);
+  return cnt;
+}
+
+static void free_idxnode (void *vnode, void *varg)
+{
+  struct whc_durable_idxnode * const idxn = vnode;
+  struct whc_durable * const whc = varg;
+  ddsi_tkmap_instance_unref (whc->tkmap, idxn->tk);
+  ddsrt_free (idxn);
+}
+
+static void whc_durable_free (struct whc *whc_generic)
+{
+  struct whc_durable * const whc = (struct whc_durable *) whc_generic;
+  for (uint32_t i = whc->first; i < whc->n; i++)
+  {
+    struct whc_durable_rec * const rec = &whc->recs[i];
+    if (!rec->live)
+      continue;
+    assert (!rec->borrowed);
+    if (rec->serdata)
+      ddsi_serdata_unref (rec->serdata);
+    if (rec->plist)
+    {
+      ddsi_plist_fini (rec->plist);
+      ddsrt_free (rec->plist);
+    }
+  }
+  ddsrt_hh_enum (whc->idx_hash, free_idxnode, whc);
+  ddsrt_hh_free (whc->idx_hash);
+  delete_xevent_callback (whc->sync_xev);
+  log_sync (whc);
+  munmap (whc->map, whc->mapsize);
+  if (ftruncate (whc->fd, (off_t) whc->used) != 0 || fsync (whc->fd) != 0)
+  {
+    struct ddsi_domaingv * const gv = whc->gv;
+    GVWARNING ("durable writer history %s: truncate failed: %s\n", whc->path, strerror (errno));
+  }
+  close (whc->fd);
+  ddsi_sertype_unref ((struct ddsi_sertype *) whc->type);
+  ddsrt_free (whc->recs);
+  ddsrt_free (whc->path);
+  ddsrt_mutex_destroy (&whc->lock);
+  ddsrt_free (whc);
+}
+
+static const struct whc_ops whc_durable_ops = {
+  .insert = whc_durable_insert,
+  .remove_acked_messages = whc_durable_remove_acked_messages,
+  .free_deferred_free_list = whc_durable_free_deferred_free_list,
+  .get_state = whc_durable_get_state,
+  .next_seq = whc_durable_next_seq,
+  .borrow_sample = whc_durable_borrow_sample,
+  .borrow_sample_key = whc_durable_borrow_sample_key,
+  .return_sample = whc_durable_return_sample,
+  .sample_iter_init = whc_durable_sample_iter_init,
+  .sample_iter_borrow_next = whc_durable_sample_iter_borrow_next,
+  .downgrade_to_volatile = whc_durable_downgrade_to_volatile,
+  .free = whc_durable_free
+};
+
+/*************** CREATION ***************/
+
+/* Whether the last record in the log is live */
+static bool log_tail_live (const struct whc_durable *whc)
+{
+  if (whc->used == whc->data_start)
+    return true;
+  else if (whc->first == whc->n)
+    return false;
+  else
+  {
+    const struct whc_durable_rec * const rec = &whc->recs[whc->n - 1];
+    return rec->off != NOT_IN_LOG && rec->off + rec->logsize == whc->used;
+  }
+}
+
+static bool load_log (struct whc_durable *whc, size_t filesize)
+{
+  struct ddsi_domaingv * const gv = whc->gv;
+  size_t pos = whc->data_start;
+  seqno_t prev_seq = 0;
+  while (pos + sizeof (struct whc_durable_rechdr) <= filesize)
+  {
+    struct whc_durable_rechdr hdr;
+    memcpy (&hdr, whc->map + pos, sizeof (hdr));
+    const size_t recsize = sizeof (hdr) + align8 (hdr.size);
+    if (hdr.seq <= prev_seq || hdr.seq >= MAX_SEQ_NUMBER || (hdr.kind != SDK_KEY && hdr.kind != SDK_DATA) ||
+        hdr.size > filesize - pos - sizeof (hdr) || recsize > filesize - pos ||
+        hdr.check != rec_check (&hdr, whc->map + pos + sizeof (hdr)))
+      break;
+
+    struct ddsi_serdata *sd;
+    if ((sd = log_load (whc, pos)) == NULL)
+    {
+      GVERROR ("durable writer history %s: sample %"PRId64" can't be interpreted as a %s\n", whc->path, hdr.seq, whc->type->type_name);
+      return false;
+    }
+    struct ddsi_tkmap_instance *tk = ddsi_tkmap_lookup_instance_ref (whc->tkmap, sd);
+    insert_locked (whc, hdr.seq, hdr.seq, NULL, sd, tk, pos, (uint32_t) recsize);
+    ddsi_tkmap_instance_unref (whc->tkmap, tk);
+    ddsi_serdata_unref (sd);
+    prev_seq = hdr.seq;
+    pos += recsize;
+  }
+  if (pos < filesize)
+    GVLOG (DDS_LC_WHC, "durable writer history %s: discarding %"PRIuSIZE" bytes at end of log\n", whc->path, filesize - pos);
+  whc->used = pos;
+  whc->max_drop_seq = (whc->first == whc->n) ? 0 : whc->recs[whc->n - 1].seq;
+  return true;
+}
+
+struct whc *whc_durable_new (struct ddsi_domaingv *gv, const struct ddsi_sertype *type, const char *path, dds_duration_t sync_interval, uint32_t hdepth, uint32_t tldepth)
+{
+  struct whc_durable *whc;
+  struct stat st;
+  int fd;
+
+  if ((fd = log_open_locked (path, &st)) < 0)
+  {
+    if (errno == EWOULDBLOCK)
+      GVWARNING ("durable writer history %s: in use by another writer\n", path);
+    else
+      GVERROR ("durable writer history %s: can't open: %s\n", path, strerror (errno));
+    return NULL;
+  }
+
+  whc = ddsrt_malloc (sizeof (*whc));
+  whc->common.ops = &whc_durable_ops;
+  ddsrt_mutex_init (&whc->lock);
+  whc->gv = gv;
+  whc->tkmap = gv->m_tkmap;
+  whc->type = ddsi_sertype_ref (type);
+  whc->hdepth = hdepth;
+  whc->tldepth = tldepth;
+  whc->idxdepth = hdepth > tldepth ? hdepth : tldepth;
+  whc->is_volatile = false;
+  whc->max_drop_seq = 0;
+  whc->unacked_bytes = 0;
+  whc->sample_overhead = 80; /* INFO_TS, DATA (estimate), inline QoS */
+  whc->fragment_size = gv->config.fragment_size;
+  whc->idx_hash = ddsrt_hh_new (1, whc_durable_idxnode_hash_key, whc_durable_idxnode_eq_key);
+  whc->first = whc->n = whc->ndead = 0;
+  whc->cap = 256;
+  whc->recs = ddsrt_malloc (whc->cap * sizeof (*whc->recs));
+  whc->path = ddsrt_strdup (path);
+  whc->fd = fd;
+  whc->data_start = log_header_size (type);
+  whc->live_bytes = whc->dead_bytes = 0;
+  whc->compact_threshold = WHC_DURABLE_MIN_COMPACT;
+  whc->sync_interval = sync_interval;
+  whc->sync_scheduled = false;
+
+  const size_t filesize = (size_t) st.st_size;
+  whc->mapsize = WHC_DURABLE_INITIAL_SIZE;
+  while (whc->mapsize < filesize)
+    whc->mapsize *= 2;
+  if (!log_allocate (fd, whc->mapsize) || (whc->map = log_map (fd, whc->mapsize)) == NULL)
+  {
+    GVERROR ("durable writer history %s: can't map: %s\n", path, strerror (errno));
+    goto err;
+  }
+  if (filesize == 0)
+  {
+    log_write_header (whc->map, type);
+    whc->used = whc->data_start;
+  }
+  else if (!log_check_header (whc->map, filesize, type))
+  {
+    GVERROR ("durable writer history %s: not a history of %s\n", path, type->type_name);
+    goto err_map;
+  }
+  else if (!load_log (whc, filesize))
+  {
+    goto err_map;
+  }
+  /* The writer continues after the last sample in the history, and the log
+     mustn't contain anything with a higher sequence number than that */
+  if (!((log_needs_compaction (whc) || !log_tail_live (whc)) && compact_locked (whc)))
+  {
+    if (!log_tail_live (whc))
+      goto err_map;
+    /* whatever follows the last valid record is garbage that mustn't
+       resurface after new records get appended; the file is modified only
+       now that nothing can fail anymore */
+    if (whc->used < filesize)
+      memset (whc->map + whc->used, 0, filesize - whc->used);
+  }
+  /* a sync of the loaded log would be pointless, but the header of a new one
+     has to be written out with the first sample */
+  whc->synced = (filesize == 0) ? 0 : whc->used;
+  whc->sync_xev = qxev_callback (gv->xevents, DDSRT_MTIME_NEVER, log_sync_cb, whc);
+  TRACE ("whc_durable_new(%p %s depth %"PRIu32"/%"PRIu32"): %"PRIu32" samples, log %"PRIuSIZE" bytes\n", (void *) whc, path, hdepth, tldepth, whc->n - whc->first - whc->ndead, whc->used);
+  return (struct whc *) whc;
+
+err_map:
+  munmap (whc->map, whc->mapsize);
+err:
+  /* nothing has been written, so this leaves the file as it was */
+  (void) ftruncate (fd, (off_t) filesize);
+  close (fd);
+  for (uint32_t i = whc->first; i < whc->n; i++)
+  {
+    if (whc->recs[i].live && whc->recs[i].serdata)
+      ddsi_serdata_unref (whc->recs[i].serdata);
+  }
+  ddsrt_hh_enum (whc->idx_hash, free_idxnode, whc);
+  ddsrt_hh_free (whc->idx_hash);
+  ddsi_sertype_unref ((struct ddsi_sertype *) whc->type);
+  ddsrt_free (whc->recs);
+  ddsrt_free (whc->path);
+  ddsrt_mutex_destroy (&whc->lock);
+  ddsrt_free (whc);
+  return NULL;
+}
@@ -0,0 +1,475 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/static_assert.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_plist.h"
+#include "dds/ddsi/q_rtps.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds__whc.h"
+#include "dds__whc_ring.h"
+
+/* WHC for writers that never need to look up samples by key and only ever
+   drop samples in sequence number order: volatile, KEEP_ALL writers of
+   keyless topics.  The samples are stored in a power-of-two ring in order
+   of sequence number, so that (absent gaps in the sequence numbers) the
+   position of a sample follows from subtracting the lowest sequence number
+   from it.  Gaps can only occur when there were no reliable readers for a
+   while, in which case it falls back to a binary search.
+
+   The ring is indexed by free-running 32-bit counters:
+
+     reclaim <= head <= tail
+
+   [head,tail) are the samples in the WHC; [reclaim,head) have been removed
+   but their serdata and plist are only released by free_deferred_free_list,
+   i.e., outside the writer lock. */
+
+struct whc_ring_node {
+  seqno_t seq;
+  struct ddsi_serdata *serdata;
+  struct ddsi_plist *plist; /* 0 if nothing special */
+  size_t size;
+  ddsrt_mtime_t last_rexmit_ts;
+  uint32_t rexmit_count;
+  unsigned unacked: 1; /* counted in whc::unacked_bytes iff 1 */
+  unsigned borrowed: 1; /* at most one can borrow it at any time */
+#ifdef DDS_HAS_LIFESPAN
+  ddsrt_mtime_t t_expire;
+#endif
+};
+
+struct whc_ring {
+  struct whc common;
+  ddsrt_mutex_t lock;
+  struct ddsi_domaingv *gv;
+  struct whc_ring_node *nodes;
+  uint32_t mask; /* size of nodes - 1, size is a power of 2 */
+  uint32_t reclaim, head, tail;
+  size_t unacked_bytes;
+  size_t sample_overhead;
+  uint32_t fragment_size;
+  seqno_t max_drop_seq;
+};
+
+struct whc_ring_sample_iter {
+  struct whc_sample_iter_base c;
+  bool first;
+};
+
+DDSRT_STATIC_ASSERT (sizeof (struct whc_ring_sample_iter) <= sizeof (struct whc_sample_iter));
+
+#define WHC_RING_INITIAL_SIZE 256u
+
+#define TRACE(...) DDS_CLOG (DDS_LC_WHC, &whc->gv->logconfig, __VA_ARGS__)
+
+static struct whc_ring_node *node_at (const struct whc_ring *whc, uint32_t idx)
+{
+  return &whc->nodes[idx & whc->mask];
+}
+
+static uint32_t whc_ring_count (const struct whc_ring *whc)
+{
+  return whc->tail - whc->head;
+}
+
+/* Returns the index in [head,tail) of the first sample with a sequence number >= seq, tail if none */
+static uint32_t lower_bound (const struct whc_ring *whc, seqno_t seq)
+{
+  const uint32_t n = whc_ring_count (whc);
+  if (n == 0)
+    return whc->tail;
+  const seqno_t min_seq = node_at (whc, whc->head)->seq;
+  const seqno_t max_seq = node_at (whc, whc->tail - 1)->seq;
+  if (seq <= min_seq)
+    return whc->head;
+  else if (seq > max_seq)
+    return whc->tail;
+  else if (max_seq - min_seq == (seqno_t) (n - 1))
+    return whc->head + (uint32_t) (seq - min_seq);
+  else
+  {
+    uint32_t lo = 0, hi = n;
+    while (lo < hi)
+    {
+      const uint32_t m = lo + (hi - lo) / 2;
+      if (node_at (whc, whc->head + m)->seq < seq)
+        lo = m + 1;
+      else
+        hi = m;
+    }
+    return whc->head + lo;
+  }
+}
+
+static struct whc_ring_node *whc_ring_findseq (const struct whc_ring *whc, seqno_t seq)
+{
+  const uint32_t idx = lower_bound (whc, seq);
+  if (idx == whc->tail)
+    return NULL;
+  struct whc_ring_node * const n = node_at (whc, idx);
+  return (n->seq == seq) ? n : NULL;
+}
+
+static void free_node_contents (struct whc_ring_node *n)
+{
+  ddsi_serdata_unref (n->serdata);
+  if (n->plist)
+  {
+    ddsi_plist_fini (n->plist);
+    ddsrt_free (n->plist);
+  }
+}
+
+static void reclaim_locked (struct whc_ring *whc)
+{
+  while (whc->reclaim != whc->head)
+  {
+    struct whc_ring_node * const n = node_at (whc, whc->reclaim++);
+    /* a borrowed sample is freed by whoever borrowed it */
+    if (!n->borrowed)
+      free_node_contents (n);
+  }
+}
+
+static void grow_locked (struct whc_ring *whc)
+{
+  const uint32_t size = whc->mask + 1, nsize = 2 * size;
+  const uint32_t first = whc->reclaim & whc->mask;
+  assert (whc->tail - whc->reclaim == size);
+  assert (nsize > size);
+  /* the oldest entry ends up at position reclaim & (nsize - 1), which is either at
+     "first" or at "first + size"; any entries that wrapped around move to the other half */
+  whc->nodes = ddsrt_realloc (whc->nodes, nsize * sizeof (*whc->nodes));
+  if ((whc->reclaim & (nsize - 1)) == first)
+    memcpy (whc->nodes + size, whc->nodes, first * sizeof (*whc->nodes));
+  else
+    memcpy (whc->nodes + size + first, whc->nodes + first, (size - first) * sizeof (*whc->nodes));
+  whc->mask = nsize - 1;
+}
+
+static void get_state_locked (const struct whc_ring *whc, struct whc_state *st)
+{
+  if (whc->head == whc->tail)
+  {
+    st->min_seq = st->max_seq = -1;
+    st->unacked_bytes = 0;
+  }
+  else
+  {
+    st->min_seq = node_at (whc, whc->head)->seq;
+    st->max_seq = node_at (whc, whc->tail - 1)->seq;
+    st->unacked_bytes = whc->unacked_bytes;
+  }
+}
+
+static void drop_head_locked (struct whc_ring *whc)
+{
+  struct whc_ring_node * const n = node_at (whc, whc->head++);
+  if (n->unacked)
+  {
+    assert (whc->unacked_bytes >= n->size);
+    whc->unacked_bytes -= n->size;
+    n->unacked = 0;
+  }
+}
+
+#ifdef DDS_HAS_LIFESPAN
+/* Lifespan is never set when the ring is selected, but it can be changed
+   afterward.  Expiry times are non-decreasing while the lifespan doesn't
+   change, so just drop expired samples from the front. */
+static void drop_expired_locked (struct whc_ring *whc)
+{
+  if (whc->head == whc->tail || node_at (whc, whc->head)->t_expire.v == DDS_NEVER)
+    return;
+  const ddsrt_mtime_t tnow = ddsrt_time_monotonic ();
+  while (whc->head != whc->tail && node_at (whc, whc->head)->t_expire.v <= tnow.v)
+    drop_head_locked (whc);
+}
+#endif
+
+static int whc_ring_insert (struct whc *whc_generic, seqno_t max_drop_seq, seqno_t seq, ddsrt_mtime_t exp, struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  (void) tk;
+#ifndef DDS_HAS_LIFESPAN
+  DDSRT_UNUSED_ARG (exp);
+#endif
+
+  ddsrt_mutex_lock (&whc->lock);
+  TRACE ("whc_ring_insert(%p max_drop_seq %"PRId64" seq %"PRId64" exp %"PRId64" plist %p serdata %p:%"PRIx32")\n",
+         (void *) whc, max_drop_seq, seq, exp.v, (void *) plist, (void *) serdata, serdata->hash);
+  assert (max_drop_seq < MAX_SEQ_NUMBER);
+  assert (max_drop_seq >= whc->max_drop_seq);
+  assert (whc->head == whc->tail || seq > node_at (whc, whc->tail - 1)->seq);
+
+  /* an unregister that is acknowledged already has no further purpose: the
+     instance disappears from the index in the default WHC, and with it the
+     sample */
+  if ((serdata->statusinfo & NN_STATUSINFO_UNREGISTER) && seq <= max_drop_seq)
+  {
+    TRACE ("  unreg:seq <= max_drop_seq: skip\n");
+    if (plist)
+    {
+      ddsi_plist_fini (plist);
+      ddsrt_free (plist);
+    }
+    ddsrt_mutex_unlock (&whc->lock);
+    return 0;
+  }
+
+  if (whc->tail - whc->reclaim == whc->mask + 1)
+  {
+    /* reclaiming here rather than growing is fine because insert and
+       remove_acked_messages are both called with the writer lock held */
+    if (whc->reclaim != whc->head)
+      reclaim_locked (whc);
+    else
+      grow_locked (whc);
+  }
+
+  struct whc_ring_node * const n = node_at (whc, whc->tail++);
+  n->seq = seq;
+  n->serdata = ddsi_serdata_ref (serdata);
+  n->plist = plist;
+  n->last_rexmit_ts.v = 0;
+  n->rexmit_count = 0;
+  n->borrowed = 0;
+  const size_t sz = ddsi_serdata_size (serdata);
+  n->size = sz + ((sz + whc->fragment_size - 1) / whc->fragment_size) * whc->sample_overhead;
+  n->unacked = (seq > max_drop_seq);
+  if (n->unacked)
+    whc->unacked_bytes += n->size;
+#ifdef DDS_HAS_LIFESPAN
+  n->t_expire = exp;
+  drop_expired_locked (whc);
+#endif
+  ddsrt_mutex_unlock (&whc->lock);
+  return 0;
+}
+
+static uint32_t whc_ring_remove_acked_messages (struct whc *whc_generic, seqno_t max_drop_seq, struct whc_state *whcst, struct whc_node **deferred_free_list)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  uint32_t cnt = 0;
+  ddsrt_mutex_lock (&whc->lock);
+  assert (max_drop_seq < MAX_SEQ_NUMBER);
+  assert (max_drop_seq >= whc->max_drop_seq);
+  TRACE ("whc_ring_remove_acked_messages(%p max_drop_seq %"PRId64")\n", (void *) whc, max_drop_seq);
+  while (whc->head != whc->tail && node_at (whc, whc->head)->seq <= max_drop_seq)
+  {
+    drop_head_locked (whc);
+    cnt++;
+  }
+#ifdef DDS_HAS_LIFESPAN
+  drop_expired_locked (whc);
+#endif
+  whc->max_drop_seq = max_drop_seq;
+  get_state_locked (whc, whcst);
+  /* the nodes are not in a list, the caller only needs to know whether there's
+     anything to free and pass it to free_deferred_free_list */
+  *deferred_free_list = (whc->reclaim != whc->head) ? &whc_deferred_work_marker : NULL;
+  ddsrt_mutex_unlock (&whc->lock);
+  return cnt;
+}
+
+static void whc_ring_free_deferred_free_list (struct whc *whc_generic, struct whc_node *deferred_free_list)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  if (deferred_free_list == NULL)
+    return;
+  assert (deferred_free_list == &whc_deferred_work_marker);
+  ddsrt_mutex_lock (&whc->lock);
+  reclaim_locked (whc);
+  ddsrt_mutex_unlock (&whc->lock);
+}
+
+static void whc_ring_get_state (const struct whc *whc_generic, struct whc_state *st)
+{
+  const struct whc_ring * const whc = (const struct whc_ring *) whc_generic;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  get_state_locked (whc, st);
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+}
+
+static seqno_t whc_ring_next_seq (const struct whc *whc_generic, seqno_t seq)
+{
+  const struct whc_ring * const whc = (const struct whc_ring *) whc_generic;
+  seqno_t nseq;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  const uint32_t idx = (seq == MAX_SEQ_NUMBER) ? whc->tail : lower_bound (whc, seq + 1);
+  nseq = (idx == whc->tail) ? MAX_SEQ_NUMBER : node_at (whc, idx)->seq;
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+  return nseq;
+}
+
+static void make_borrowed_sample (struct whc_borrowed_sample *sample, struct whc_ring_node *n)
+{
+  assert (!n->borrowed);
+  n->borrowed = 1;
+  sample->seq = n->seq;
+  sample->plist = n->plist;
+  sample->serdata = n->serdata;
+  sample->unacked = n->unacked;
+  sample->rexmit_count = n->rexmit_count;
+  sample->last_rexmit_ts = n->last_rexmit_ts;
+}
+
+static bool whc_ring_borrow_sample (const struct whc *whc_generic, seqno_t seq, struct whc_borrowed_sample *sample)
+{
+  const struct whc_ring * const whc = (const struct whc_ring *) whc_generic;
+  struct whc_ring_node *n;
+  bool found;
+  ddsrt_mutex_lock ((ddsrt_mutex_t *) &whc->lock);
+  if ((n = whc_ring_findseq (whc, seq)) == NULL)
+    found = false;
+  else
+  {
+    make_borrowed_sample (sample, n);
+    found = true;
+  }
+  ddsrt_mutex_unlock ((ddsrt_mutex_t *) &whc->lock);
+  return found;
+}
+
+static bool whc_ring_borrow_sample_key (const struct whc *whc_generic, const struct ddsi_serdata *serdata_key, struct whc_borrowed_sample *sample)
+{
+  /* no instance index: only used for transient-local data, which never ends up here */
+  (void) whc_generic; (void) serdata_key; (void) sample;
+  return false;
+}
+
+static void return_sample_locked (struct whc_ring *whc, struct whc_borrowed_sample *sample, bool update_retransmit_info)
+{
+  struct whc_ring_node *n;
+  if ((n = whc_ring_findseq (whc, sample->seq)) == NULL)
+  {
+    /* removed while borrowed: ownership of serdata, plist shifted to the borrowed copy */
+    ddsi_serdata_unref (sample->serdata);
+    if (sample->plist)
+    {
+      ddsi_plist_fini (sample->plist);
+      ddsrt_free (sample->plist);
+    }
+  }
+  else
+  {
+    assert (n->borrowed);
+    n->borrowed = 0;
+    if (update_retransmit_info)
+    {
+      n->rexmit_count = sample->rexmit_count;
+      n->last_rexmit_ts = sample->last_rexmit_ts;
+    }
+  }
+}
+
+static void whc_ring_return_sample (struct whc *whc_generic, struct whc_borrowed_sample *sample, bool update_retransmit_info)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  ddsrt_mutex_lock (&whc->lock);
+  return_sample_locked (whc, sample, update_retransmit_info);
+  ddsrt_mutex_unlock (&whc->lock);
+}
+
+static void whc_ring_sample_iter_init (const struct whc *whc_generic, struct whc_sample_iter *opaque_it)
+{
+  struct whc_ring_sample_iter *it = (struct whc_ring_sample_iter *) opaque_it;
+  it->c.whc = (struct whc *) whc_generic;
+  it->first = true;
+}
+
+static bool whc_ring_sample_iter_borrow_next (struct whc_sample_iter *opaque_it, struct whc_borrowed_sample *sample)
+{
+  struct whc_ring_sample_iter * const it = (struct whc_ring_sample_iter *) opaque_it;
+  struct whc_ring * const whc = (struct whc_ring *) it->c.whc;
+  seqno_t seq;
+  bool valid;
+  ddsrt_mutex_lock (&whc->lock);
+  if (!it->first)
+  {
+    seq = sample->seq;
+    return_sample_locked (whc, sample, false);
+  }
+  else
+  {
+    it->first = false;
+    seq = 0;
+  }
+  const uint32_t idx = lower_bound (whc, seq + 1);
+  if (idx == whc->tail)
+    valid = false;
+  else
+  {
+    make_borrowed_sample (sample, node_at (whc, idx));
+    valid = true;
+  }
+  ddsrt_mutex_unlock (&whc->lock);
+  return valid;
+}
+
+static uint32_t whc_ring_downgrade_to_volatile (struct whc *whc_generic, struct whc_state *st)
+{
+  /* never transient-local, so nothing to do */
+  whc_ring_get_state (whc_generic, st);
+  return 0;
+}
+
+static void whc_ring_free (struct whc *whc_generic)
+{
+  struct whc_ring * const whc = (struct whc_ring *) whc_generic;
+  whc->head = whc->tail;
+  reclaim_locked (whc);
+  ddsrt_free (whc->nodes);
+  ddsrt_mutex_destroy (&whc->lock);
+  ddsrt_free (whc);
+}
+
+static const struct whc_ops whc_ring_ops = {
+  .insert = whc_ring_insert,
+  .remove_acked_messages = whc_ring_remove_acked_messages,
+  .free_deferred_free_list = whc_ring_free_deferred_free_list,
+  .get_state = whc_ring_get_state,
+  .next_seq = whc_ring_next_seq,
+  .borrow_sample = whc_ring_borrow_sample,
+  .borrow_sample_key = whc_ring_borrow_sample_key,
+  .return_sample = whc_ring_return_sample,
+  .sample_iter_init = whc_ring_sample_iter_init,
+  .sample_iter_borrow_next = whc_ring_sample_iter_borrow_next,
+  .downgrade_to_volatile = whc_ring_downgrade_to_volatile,
+  .free = whc_ring_free
+};
+
+bool whc_is_ring (const struct whc *whc)
+{
+  return whc->ops == &whc_ring_ops;
+}
+
+struct whc *whc_ring_new (struct ddsi_domaingv *gv)
+{
+  struct whc_ring *whc = ddsrt_malloc (sizeof (*whc));
+  whc->common.ops = &whc_ring_ops;
+  ddsrt_mutex_init (&whc->lock);
+  whc->gv = gv;
+  whc->nodes = ddsrt_malloc (WHC_RING_INITIAL_SIZE * sizeof (*whc->nodes));
+  whc->mask = WHC_RING_INITIAL_SIZE - 1;
+  whc->reclaim = whc->head = whc->tail = 0;
+  whc->unacked_bytes = 0;
+  whc->sample_overhead = 80; /* INFO_TS, DATA (estimate), inline QoS */
+  whc->fragment_size = gv->config.fragment_size;
+  whc->max_drop_seq = 0;
+  return (struct whc *) whc;
+}
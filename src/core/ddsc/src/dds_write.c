@@ -11,6 +11,7 @@
  */
 #include <assert.h>
 #include <string.h>
+#include "dds/ddsrt/heap.h"
 #include "dds__writer.h"
 #include "dds__write.h"
 #include "dds/ddsi/ddsi_tkmap.h"
@@ -197,6 +198,21 @@ dds_return_t dds_write (dds_entity_t writer, const void *data)
   return ret;
 }
 
+dds_return_t dds_write_nonblocking (dds_entity_t writer, const void *data)
+{
+  dds_return_t ret;
+  dds_writer *wr;
+
+  if (data == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+
+  if ((ret = dds_writer_lock (writer, &wr)) != DDS_RETCODE_OK)
+    return ret;
+  ret = dds_write_impl (wr, data, dds_time (), DDS_WR_NONBLOCKING_BIT);
+  dds_writer_unlock (wr);
+  return ret;
+}
+
 dds_return_t dds_writecdr (dds_entity_t writer, struct ddsi_serdata *serdata)
 {
   dds_return_t ret;
@@ -390,22 +406,22 @@ static struct ddsi_serdata *convert_serdata(struct writer *ddsi_wr, struct ddsi_
   return dout;
 }
 
-static dds_return_t deliver_data (struct writer *ddsi_wr, dds_writer *wr, struct ddsi_serdata *d, struct nn_xpack *xp, bool flush) {
+static dds_return_t deliver_data (struct writer *ddsi_wr, dds_writer *wr, struct ddsi_serdata *d, struct nn_xpack *xp, bool flush, bool nonblocking) {
   struct thread_state1 * const ts1 = lookup_thread_state ();
 
   struct ddsi_tkmap_instance *tk = ddsi_tkmap_lookup_instance_ref (ddsi_wr->e.gv->m_tkmap, d);
   // write_sample_gc always consumes 1 refc from d
-  int ret = write_sample_gc (ts1, xp, ddsi_wr, d, tk);
+  int ret = nonblocking ? write_sample_gc_nonblocking (ts1, xp, ddsi_wr, d, tk) : write_sample_gc (ts1, xp, ddsi_wr, d, tk);
   if (ret >= 0)
   {
-    /* Flush out write unless configured to batch */
+    /* Flush out write unless configured to batch, adaptive batching may defer it */
     if (flush && xp != NULL)
-      nn_xpack_send (xp, false);
+      nn_xpack_send_or_defer (xp);
     ret = DDS_RETCODE_OK;
   }
   else
   {
-    if (ret != DDS_RETCODE_TIMEOUT)
+    if (ret != DDS_RETCODE_TIMEOUT && ret != DDS_RETCODE_TRY_AGAIN)
       ret = DDS_RETCODE_ERROR;
   }
 
@@ -427,7 +443,7 @@ static dds_return_t deliver_data (struct writer *ddsi_wr, dds_writer *wr, struct
   return ret;
 }
 
-static dds_return_t dds_writecdr_impl_common (struct writer *ddsi_wr, struct nn_xpack *xp, struct ddsi_serdata *din, bool flush, dds_writer *wr)
+static dds_return_t dds_writecdr_impl_common (struct writer *ddsi_wr, struct nn_xpack *xp, struct ddsi_serdata *din, bool flush, bool nonblocking, dds_writer *wr)
 {
   // consumes 1 refc from din in all paths (weird, but ... history ...)
   // let refc(din) be r, so upon returning it must be r-1
@@ -453,7 +469,7 @@ static dds_return_t dds_writecdr_impl_common (struct writer *ddsi_wr, struct nn_
   din->iox_chunk = NULL;
 #endif
 
-  ret = deliver_data(ddsi_wr, wr, d, xp, flush); // d = din: refc(d) = r, otherwise refc(d) = 1
+  ret = deliver_data(ddsi_wr, wr, d, xp, flush, nonblocking); // d = din: refc(d) = r, otherwise refc(d) = 1
 
   if(d != din)
     ddsi_serdata_unref(din); // d != din: refc(din) = r - 1 as required, refc(d) unchanged
@@ -594,7 +610,7 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
     // this may convert the input data if needed (convert_serdata) and then deliver it using
     // network and/or iceoryx as required
     // d refc(d) = 1, call will reduce refcount by 1
-    ret = dds_writecdr_impl_common(ddsi_wr, wr->m_xp, d, !wr->whc_batch, wr);
+    ret = dds_writecdr_impl_common(ddsi_wr, wr->m_xp, d, !wr->whc_batch, (action & DDS_WR_NONBLOCKING_BIT) != 0, wr);
   }
 
 finalize_write:
@@ -634,14 +650,17 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
     ddsi_serdata_ref (d);
 
     tk = ddsi_tkmap_lookup_instance_ref (wr->m_entity.m_domain->gv.m_tkmap, d);
-    ret = write_sample_gc (ts1, wr->m_xp, ddsi_wr, d, tk);
+    if (action & DDS_WR_NONBLOCKING_BIT)
+      ret = write_sample_gc_nonblocking (ts1, wr->m_xp, ddsi_wr, d, tk);
+    else
+      ret = write_sample_gc (ts1, wr->m_xp, ddsi_wr, d, tk);
 
     if (ret >= 0) {
-      /* Flush out write unless configured to batch */
+      /* Flush out write unless configured to batch, adaptive batching may defer it */
       if (!wr->whc_batch)
-        nn_xpack_send (wr->m_xp, false);
+        nn_xpack_send_or_defer (wr->m_xp);
       ret = DDS_RETCODE_OK;
-    } else if (ret != DDS_RETCODE_TIMEOUT) {
+    } else if (ret != DDS_RETCODE_TIMEOUT && ret != DDS_RETCODE_TRY_AGAIN) {
       ret = DDS_RETCODE_ERROR;
     } 
 
@@ -657,12 +676,177 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
 
 dds_return_t dds_writecdr_impl (dds_writer *wr, struct nn_xpack *xp, struct ddsi_serdata *dinp, bool flush)
 {
-  return dds_writecdr_impl_common (wr->m_wr, xp, dinp, flush, wr);
+  return dds_writecdr_impl_common (wr->m_wr, xp, dinp, flush, false, wr);
 }
 
 dds_return_t dds_writecdr_local_orphan_impl (struct local_orphan_writer *lowr, struct nn_xpack *xp, struct ddsi_serdata *dinp)
 {
-  return dds_writecdr_impl_common (&lowr->wr, xp, dinp, true, NULL);
+  return dds_writecdr_impl_common (&lowr->wr, xp, dinp, true, false, NULL);
+}
+
+static dds_return_t dds_write_batch_impl (dds_writer *wr, struct ddsi_serdata **ds, uint32_t n)
+{
+  // consumes 1 refc from each of ds[0 .. n-1], thread must be awake
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct writer * const ddsi_wr = wr->m_wr;
+  struct ddsi_domaingv * const gv = &wr->m_entity.m_domain->gv;
+  struct ddsi_tkmap_instance **tks = ddsrt_malloc (n * sizeof (*tks));
+  uint32_t nwritten;
+  dds_return_t ret;
+
+  for (uint32_t i = 0; i < n; i++)
+  {
+    tks[i] = ddsi_tkmap_lookup_instance_ref (gv->m_tkmap, ds[i]);
+    ddsi_serdata_ref (ds[i]);
+  }
+  // write_sample_batch_gc consumes 1 refc from each ds[i]
+  ret = write_sample_batch_gc (ts1, wr->m_xp, ddsi_wr, n, ds, tks, &nwritten);
+  if (nwritten > 0 && !wr->whc_batch)
+    nn_xpack_send_or_defer (wr->m_xp);
+  if (ret != DDS_RETCODE_OK && ret != DDS_RETCODE_TIMEOUT)
+    ret = DDS_RETCODE_ERROR;
+  for (uint32_t i = 0; i < n; i++)
+  {
+    if (i < nwritten)
+    {
+      dds_return_t lret = deliver_locally (ddsi_wr, ds[i], tks[i]);
+      if (ret == DDS_RETCODE_OK)
+        ret = lret;
+    }
+    ddsi_serdata_unref (ds[i]);
+    ddsi_tkmap_instance_unref (gv->m_tkmap, tks[i]);
+  }
+  ddsrt_free (tks);
+  return ret;
+}
+
+dds_return_t dds_write_batch (dds_entity_t writer, const void * const *data, const dds_time_t *timestamps, uint32_t count)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct ddsi_serdata **ds;
+  dds_return_t ret;
+  dds_writer *wr;
+  uint32_t n = 0;
+
+  if (data == NULL && count > 0)
+    return DDS_RETCODE_BAD_PARAMETER;
+  for (uint32_t i = 0; i < count; i++)
+    if (data[i] == NULL || (timestamps && timestamps[i] < 0))
+      return DDS_RETCODE_BAD_PARAMETER;
+
+  if ((ret = dds_writer_lock (writer, &wr)) != DDS_RETCODE_OK || count == 0)
+  {
+    if (ret == DDS_RETCODE_OK)
+      dds_writer_unlock (wr);
+    return ret;
+  }
+#ifdef DDS_HAS_SHM
+  if (wr->m_iox_pub != NULL)
+  {
+    // the batch path bypasses iceoryx
+    for (uint32_t i = 0; i < count && ret == DDS_RETCODE_OK; i++)
+      ret = dds_write_impl (wr, data[i], timestamps ? timestamps[i] : dds_time (), 0);
+    dds_writer_unlock (wr);
+    return ret;
+  }
+#endif
+
+  const dds_time_t tnow = dds_time ();
+  ds = ddsrt_malloc (count * sizeof (*ds));
+  thread_state_awake (ts1, &wr->m_entity.m_domain->gv);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    if (!evalute_topic_filter (wr, data[i], false))
+      continue;
+    if ((ds[n] = ddsi_serdata_from_sample (wr->m_wr->type, SDK_DATA, data[i])) == NULL)
+    {
+      ret = DDS_RETCODE_BAD_PARAMETER;
+      break;
+    }
+    ds[n]->statusinfo = 0;
+    ds[n]->timestamp.v = timestamps ? timestamps[i] : tnow;
+    n++;
+  }
+  if (ret == DDS_RETCODE_OK)
+    ret = (n > 0) ? dds_write_batch_impl (wr, ds, n) : DDS_RETCODE_OK;
+  else
+  {
+    for (uint32_t i = 0; i < n; i++)
+      ddsi_serdata_unref (ds[i]);
+  }
+  thread_state_asleep (ts1);
+  ddsrt_free (ds);
+  dds_writer_unlock (wr);
+  return ret;
+}
+
+dds_return_t dds_writecdr_batch (dds_entity_t writer, struct ddsi_serdata **serdata, uint32_t count)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct ddsi_serdata **ds;
+  dds_return_t ret;
+  dds_writer *wr;
+  uint32_t n = 0;
+
+  if (serdata == NULL && count > 0)
+    return DDS_RETCODE_BAD_PARAMETER;
+  for (uint32_t i = 0; i < count; i++)
+    if (serdata[i] == NULL)
+      return DDS_RETCODE_BAD_PARAMETER;
+
+  if ((ret = dds_writer_lock (writer, &wr)) != DDS_RETCODE_OK)
+    return ret;
+  if (wr->m_topic->m_filter.mode != DDS_TOPIC_FILTER_NONE || count == 0)
+  {
+    dds_writer_unlock (wr);
+    return (count == 0) ? DDS_RETCODE_OK : DDS_RETCODE_ERROR;
+  }
+  const dds_time_t tnow = dds_time ();
+  for (uint32_t i = 0; i < count; i++)
+  {
+    serdata[i]->statusinfo = 0;
+    serdata[i]->timestamp.v = tnow;
+  }
+#ifdef DDS_HAS_SHM
+  if (wr->m_iox_pub != NULL)
+  {
+    // the batch path bypasses iceoryx
+    for (uint32_t i = 0; i < count; i++)
+    {
+      dds_return_t ret1 = dds_writecdr_impl (wr, wr->m_xp, serdata[i], !wr->whc_batch);
+      if (ret == DDS_RETCODE_OK)
+        ret = ret1;
+    }
+    dds_writer_unlock (wr);
+    return ret;
+  }
+#endif
+
+  ds = ddsrt_malloc (count * sizeof (*ds));
+  thread_state_awake (ts1, &wr->m_entity.m_domain->gv);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    // same reference counting as dds_writecdr_impl_common: if converted, the
+    // input is no longer needed
+    struct ddsi_serdata *d = convert_serdata (wr->m_wr, serdata[i]);
+    if (d != serdata[i])
+      ddsi_serdata_unref (serdata[i]);
+    if (d == NULL)
+      ret = DDS_RETCODE_ERROR;
+    else
+      ds[n++] = d;
+  }
+  if (ret == DDS_RETCODE_OK)
+    ret = (n > 0) ? dds_write_batch_impl (wr, ds, n) : DDS_RETCODE_OK;
+  else
+  {
+    for (uint32_t i = 0; i < n; i++)
+      ddsi_serdata_unref (ds[i]);
+  }
+  thread_state_asleep (ts1);
+  ddsrt_free (ds);
+  dds_writer_unlock (wr);
+  return ret;
 }
 
 void dds_write_flush (dds_entity_t writer)
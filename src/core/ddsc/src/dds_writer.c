@@ -41,7 +41,8 @@ DECL_ENTITY_LOCK_UNLOCK (dds_writer)
                         (DDS_LIVELINESS_LOST_STATUS              |\
                          DDS_OFFERED_DEADLINE_MISSED_STATUS      |\
                          DDS_OFFERED_INCOMPATIBLE_QOS_STATUS     |\
-                         DDS_PUBLICATION_MATCHED_STATUS)
+                         DDS_PUBLICATION_MATCHED_STATUS          |\
+                         DDS_WRITER_READY_STATUS)
 
 static dds_return_t dds_writer_status_validate (uint32_t mask)
 {
@@ -114,6 +115,19 @@ void dds_writer_status_cb (void *entity, const struct status_cb_data *data)
     return;
   }
 
+  /* Writer readiness has no listener and is signalled while the DDSI writer is
+     locked, so it must not wait for listener invocations in progress */
+  if (data->raw_status_id == (int) DDS_WRITER_READY_STATUS_ID)
+  {
+    ddsrt_mutex_lock (&wr->m_entity.m_observers_lock);
+    if (!data->add)
+      dds_entity_status_reset (&wr->m_entity, DDS_WRITER_READY_STATUS);
+    else if (dds_entity_status_set (&wr->m_entity, DDS_WRITER_READY_STATUS))
+      dds_entity_observers_signal (&wr->m_entity, DDS_WRITER_READY_STATUS);
+    ddsrt_mutex_unlock (&wr->m_entity.m_observers_lock);
+    return;
+  }
+
   /* FIXME: why wait if no listener is set? */
   ddsrt_mutex_lock (&wr->m_entity.m_observers_lock);
   wr->m_entity.m_cb_pending_count++;
@@ -145,6 +159,7 @@ void dds_writer_status_cb (void *entity, const struct status_cb_data *data)
     case DDS_SUBSCRIPTION_MATCHED_STATUS_ID:
     case DDS_REQUESTED_DEADLINE_MISSED_STATUS_ID:
     case DDS_REQUESTED_INCOMPATIBLE_QOS_STATUS_ID:
+    case DDS_WRITER_READY_STATUS_ID:
       assert (0);
   }
 
@@ -183,6 +198,7 @@ static void dds_writer_close (dds_entity *e)
   struct ddsi_domaingv * const gv = &e->m_domain->gv;
   struct thread_state1 * const ts1 = lookup_thread_state ();
   thread_state_awake (ts1, gv);
+  nn_xpack_disable_adaptive (wr->m_xp);
   nn_xpack_send (wr->m_xp, false);
   (void) delete_writer (gv, &e->m_guid);
   thread_state_asleep (ts1);
@@ -251,7 +267,12 @@ static const struct dds_stat_keyvalue_descriptor dds_writer_statistics_kv[] = {
   { "rexmit_bytes", DDS_STAT_KIND_UINT64 },
   { "throttle_count", DDS_STAT_KIND_UINT32 },
   { "time_throttle", DDS_STAT_KIND_UINT64 },
-  { "time_rexmit", DDS_STAT_KIND_UINT64 }
+  { "time_rexmit", DDS_STAT_KIND_UINT64 },
+  { "rexmit_reader_bytes", DDS_STAT_KIND_UINT64 },
+  { "rexmit_reader_rate_total", DDS_STAT_KIND_UINT32 },
+  { "rexmit_reader_rate_max", DDS_STAT_KIND_UINT32 },
+  { "rexmit_reader_queued", DDS_STAT_KIND_UINT32 },
+  { "rexmit_reader_dropped", DDS_STAT_KIND_UINT32 }
 };
 
 static const struct dds_stat_descriptor dds_writer_statistics_desc = {
@@ -268,7 +289,10 @@ static void dds_writer_refresh_statistics (const struct dds_entity *entity, stru
 {
   const struct dds_writer *wr = (const struct dds_writer *) entity;
   if (wr->m_wr)
+  {
     ddsi_get_writer_stats (wr->m_wr, &stat->kv[0].u.u64, &stat->kv[1].u.u32, &stat->kv[2].u.u64, &stat->kv[3].u.u64);
+    ddsi_get_writer_rexmit_reader_stats (wr->m_wr, &stat->kv[4].u.u64, &stat->kv[5].u.u32, &stat->kv[6].u.u32, &stat->kv[7].u.u32, &stat->kv[8].u.u32);
+  }
 }
 
 const struct dds_entity_deriver dds_entity_deriver_writer = {
@@ -405,6 +429,8 @@ dds_entity_t dds_create_writer (dds_entity_t participant_or_publisher, dds_entit
   wr->m_whc = whc_new (gv, wrinfo);
   whc_free_wrinfo (wrinfo);
   wr->whc_batch = gv->config.whc_batch;
+  if (async_mode && gv->config.whc_batch_adaptive)
+    nn_xpack_enable_adaptive (wr->m_xp, &wr->m_entity.m_mutex);
 
 #ifdef DDS_HAS_SHM
   assert(wqos->present & QP_LOCATOR_MASK);
@@ -414,6 +440,7 @@ dds_entity_t dds_create_writer (dds_entity_t participant_or_publisher, dds_entit
 
   rc = new_writer (&wr->m_wr, &wr->m_entity.m_guid, NULL, pp, tp->m_name, tp->m_stype, wqos, wr->m_whc, dds_writer_status_cb, wr);
   assert(rc == DDS_RETCODE_OK);
+  nn_xpack_select_xmit_conn (wr->m_xp, &wr->m_entity.m_guid);
   thread_state_asleep (lookup_thread_state ());
 
 #ifdef DDS_HAS_SHM
@@ -0,0 +1,105 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <limits.h>
+
+#include "dds/dds.h"
+
+#include "test_common.h"
+
+#define DDS_CONFIG_ADAPTIVE_BATCH "<Internal><AdaptiveWriteBatch>true</AdaptiveWriteBatch></Internal>"
+
+#define LATENCY_BUDGET DDS_SECS (1)
+#define BURST_SIZE 50
+
+static struct test_domains g_doms;
+
+static void adaptive_batch_init (void)
+{
+  create_test_domains (&g_doms, DDS_CONFIG_ADAPTIVE_BATCH, NULL);
+}
+
+static void adaptive_batch_fini (void)
+{
+  delete_test_domains (&g_doms);
+}
+
+static int32_t take_all (dds_entity_t rd, int32_t n)
+{
+  Space_Type1 sample;
+  void *raw = &sample;
+  dds_sample_info_t si;
+  dds_return_t ret;
+  while ((ret = dds_take (rd, &raw, &si, 1, 1)) == 1)
+  {
+    /* KEEP_ALL, reliable: it must all arrive and in order */
+    CU_ASSERT_FATAL (sample.long_2 == n);
+    n++;
+  }
+  CU_ASSERT_FATAL (ret == 0);
+  return n;
+}
+
+CU_Test(ddsc_adaptive_batch, latency_budget, .init = adaptive_batch_init, .fini = adaptive_batch_fini, .timeout = 30)
+{
+  char topicname[100];
+  dds_return_t ret;
+  create_unique_topic_name ("ddsc_adaptive_batch", topicname, sizeof (topicname));
+  dds_entity_t tp_pub = dds_create_topic (g_doms.pub_participant, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_pub > 0);
+  dds_entity_t tp_sub = dds_create_topic (g_doms.sub_participant, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_sub > 0);
+
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_qset_latency_budget (qos, LATENCY_BUDGET);
+  dds_entity_t wr = dds_create_writer (g_doms.pub_participant, tp_pub, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_entity_t rd = dds_create_reader (g_doms.sub_participant, tp_sub, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+  sync_reader_writer (g_doms.sub_participant, rd, g_doms.pub_participant, wr);
+
+  /* A lone write: the rate is too low for batching to be of any use, so it
+     must go out straight away */
+  int32_t n = 0;
+  dds_time_t tstart = dds_time ();
+  ret = dds_write (wr, &(Space_Type1){ 0, n, 0 });
+  CU_ASSERT_FATAL (ret == 0);
+  while (n < 1 && dds_time () < tstart + LATENCY_BUDGET / 2)
+  {
+    dds_sleepfor (DDS_MSECS (1));
+    n = take_all (rd, n);
+  }
+  CU_ASSERT_FATAL (n == 1);
+
+  /* A burst: batching kicks in after a few writes and the remainder lingers
+     until the latency budget expires, without any need for dds_write_flush */
+  for (int32_t i = 1; i <= BURST_SIZE; i++)
+  {
+    ret = dds_write (wr, &(Space_Type1){ 0, i, 0 });
+    CU_ASSERT_FATAL (ret == 0);
+  }
+  tstart = dds_time ();
+  dds_sleepfor (LATENCY_BUDGET / 10);
+  n = take_all (rd, n);
+  CU_ASSERT (n < BURST_SIZE + 1);
+  while (n < BURST_SIZE + 1 && dds_time () < tstart + 5 * LATENCY_BUDGET)
+  {
+    dds_sleepfor (DDS_MSECS (10));
+    n = take_all (rd, n);
+  }
+  CU_ASSERT_FATAL (n == BURST_SIZE + 1);
+  /* the remainder goes out once the latency budget expires, not much later */
+  CU_ASSERT (dds_time () - tstart < LATENCY_BUDGET + LATENCY_BUDGET / 2);
+}
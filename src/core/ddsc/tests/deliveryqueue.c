@@ -0,0 +1,134 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <limits.h>
+
+#include "dds/dds.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+#define DDS_CONFIG_WORKERS "<Internal><DeliveryQueueWorkers>4</DeliveryQueueWorkers></Internal>"
+
+#define NWRITERS 8
+#define SAMPLE_COUNT 500
+
+/* Returns the index of the worker queue the proxy writer for the writer is
+   assigned to, or -1 if it is not assigned to a worker queue */
+static int get_proxy_writer_worker (dds_entity_t sub_participant, dds_entity_t writer)
+{
+  struct dds_entity *x;
+  int idx = -1;
+  struct proxy_writer * const pwr = pin_ddsi_proxy_writer (sub_participant, writer, &x);
+  const struct ddsi_domaingv * const gv = &x->m_domain->gv;
+  CU_ASSERT (!pwr->deliver_synchronously);
+  for (uint32_t i = 0; i < gv->config.delivery_queue_workers; i++)
+    if (pwr->dqueue == gv->user_dqueue_workers[i])
+      idx = (int) i;
+  unpin_ddsi_entity (x);
+  return idx;
+}
+
+CU_Test(ddsc_deliveryqueue, workers_per_writer_order, .timeout = 30)
+{
+  struct test_domains doms;
+  create_test_domains (&doms, NULL, DDS_CONFIG_WORKERS);
+  const dds_entity_t pp_pub = doms.pub_participant, pp_sub = doms.sub_participant;
+
+  char topicname[100];
+  create_unique_topic_name ("ddsc_deliveryqueue", topicname, sizeof (topicname));
+  const dds_entity_t tp_pub = dds_create_topic (pp_pub, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_pub > 0);
+  const dds_entity_t tp_sub = dds_create_topic (pp_sub, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_sub > 0);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t rd = dds_create_reader (pp_sub, tp_sub, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_entity_t wrs[NWRITERS];
+  for (int i = 0; i < NWRITERS; i++)
+  {
+    wrs[i] = dds_create_writer (pp_pub, tp_pub, qos, NULL);
+    CU_ASSERT_FATAL (wrs[i] > 0);
+    sync_reader_writer (pp_sub, rd, pp_pub, wrs[i]);
+  }
+  dds_delete_qos (qos);
+  dds_subscription_matched_status_t sm;
+  const dds_time_t tmatch = dds_time () + DDS_SECS (10);
+  do {
+    CU_ASSERT_FATAL (dds_get_subscription_matched_status (rd, &sm) == 0);
+    if (sm.current_count < NWRITERS)
+      dds_sleepfor (DDS_MSECS (10));
+  } while (sm.current_count < NWRITERS && dds_time () < tmatch);
+  CU_ASSERT_FATAL (sm.current_count == NWRITERS);
+
+  /* With 8 writers hashed over 4 workers, it is (nearly) impossible for all
+     of them to end up in the same queue */
+  uint32_t used = 0;
+  for (int i = 0; i < NWRITERS; i++)
+  {
+    const int w = get_proxy_writer_worker (pp_sub, wrs[i]);
+    CU_ASSERT_FATAL (w >= 0);
+    used |= 1u << w;
+  }
+  CU_ASSERT ((used & (used - 1)) != 0);
+
+  /* Data arriving before the proxy writer has seen a heartbeat is not
+     delivered to a volatile reader, so first make sure it has */
+  for (int32_t i = 0; i < NWRITERS; i++)
+  {
+    dds_return_t ret = dds_write (wrs[i], &(Space_Type1){ i, -1, 0 });
+    CU_ASSERT_FATAL (ret == 0);
+    ret = dds_wait_for_acks (wrs[i], DDS_SECS (5));
+    CU_ASSERT_FATAL (ret == 0);
+  }
+
+  /* Interleaving the writes means consecutive samples in the receive path
+     alternate between the queues; each writer's key is its own instance, so
+     the reader must see each writer's samples in order */
+  for (int32_t s = 0; s < SAMPLE_COUNT; s++)
+  {
+    for (int32_t i = 0; i < NWRITERS; i++)
+    {
+      dds_return_t ret = dds_write (wrs[i], &(Space_Type1){ i, s, 0 });
+      CU_ASSERT_FATAL (ret == 0);
+    }
+  }
+  int32_t next[NWRITERS] = { 0 };
+  int32_t n = 0;
+  const dds_time_t tend = dds_time () + DDS_SECS (10);
+  while (n < NWRITERS * SAMPLE_COUNT && dds_time () < tend)
+  {
+    Space_Type1 sample;
+    void *raw = &sample;
+    dds_sample_info_t si;
+    if (dds_take (rd, &raw, &si, 1, 1) == 1)
+    {
+      CU_ASSERT_FATAL (sample.long_1 >= 0 && sample.long_1 < NWRITERS);
+      if (sample.long_2 < 0)
+        continue;
+      CU_ASSERT_FATAL (sample.long_2 == next[sample.long_1]);
+      next[sample.long_1]++;
+      n++;
+    }
+    else
+    {
+      dds_sleepfor (DDS_MSECS (1));
+    }
+  }
+  CU_ASSERT_FATAL (n == NWRITERS * SAMPLE_COUNT);
+
+  delete_test_domains (&doms);
+}
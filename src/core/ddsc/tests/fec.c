@@ -0,0 +1,143 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsi/ddsi_fec.h"
+#include "dds/ddsi/q_entity.h"
+
+#include "test_common.h"
+
+/* Dropping 10% of the packets on the publishing side, the data as well as
+   the FEC submessages and everything else */
+#define DDS_CONFIG_LOSSY_FEC "<Internal><FECGroupSize>%d</FECGroupSize><Test><XmitLossiness>100</XmitLossiness></Test></Internal>"
+
+#define FEC_SAMPLE_COUNT 400
+
+struct fec_result {
+  uint32_t nacks;
+  struct ddsi_fec_decoder_stats stats;
+};
+
+static void get_writer_nacks (dds_entity_t writer, uint32_t *nacks)
+{
+  struct dds_entity *x;
+  struct writer * const wr = pin_ddsi_writer (writer, &x);
+  ddsrt_mutex_lock (&wr->e.lock);
+  *nacks = wr->num_nacks_received;
+  ddsrt_mutex_unlock (&wr->e.lock);
+  unpin_ddsi_entity (x);
+}
+
+static void get_proxy_writer_fec_stats (dds_entity_t reader, dds_entity_t writer, struct ddsi_fec_decoder_stats *st)
+{
+  struct dds_entity *x;
+  struct proxy_writer * const pwr = pin_ddsi_proxy_writer (reader, writer, &x);
+  ddsrt_mutex_lock (&pwr->e.lock);
+  if (pwr->fec)
+    ddsi_fec_decoder_get_stats (pwr->fec, st);
+  else
+    memset (st, 0, sizeof (*st));
+  ddsrt_mutex_unlock (&pwr->e.lock);
+  unpin_ddsi_entity (x);
+}
+
+static void run_lossy (int fec_group_size, struct fec_result *res)
+{
+  struct test_domains doms;
+  char *conf_pub, topicname[100];
+  dds_entity_t tp_pub, tp_sub, wr, rd;
+  dds_return_t ret;
+  dds_qos_t *qos;
+
+  ddsrt_asprintf (&conf_pub, DDS_CONFIG_LOSSY_FEC, fec_group_size);
+  create_test_domains (&doms, conf_pub, NULL);
+  ddsrt_free (conf_pub);
+  create_unique_topic_name ("ddsc_fec", topicname, sizeof (topicname));
+  tp_pub = dds_create_topic (doms.pub_participant, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_pub > 0);
+  tp_sub = dds_create_topic (doms.sub_participant, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_sub > 0);
+
+  qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  wr = dds_create_writer (doms.pub_participant, tp_pub, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  rd = dds_create_reader (doms.sub_participant, tp_sub, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+  ret = dds_set_status_mask (wr, DDS_PUBLICATION_MATCHED_STATUS);
+  CU_ASSERT_FATAL (ret == 0);
+  while (1)
+  {
+    dds_publication_matched_status_t st;
+    ret = dds_get_publication_matched_status (wr, &st);
+    CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+    if (st.current_count == 1)
+      break;
+    dds_sleepfor (DDS_MSECS (10));
+  }
+
+  /* One sample per packet: a lost packet is a lost submessage */
+  for (int32_t i = 0; i < FEC_SAMPLE_COUNT; i++)
+  {
+    Space_Type1 sample = { 0, i, 0 };
+    ret = dds_write (wr, &sample);
+    CU_ASSERT_FATAL (ret == 0);
+    dds_sleepfor (DDS_USECS (200));
+  }
+
+  int32_t n = 0;
+  const dds_time_t tend = dds_time () + DDS_SECS (30);
+  while (n < FEC_SAMPLE_COUNT && dds_time () < tend)
+  {
+    Space_Type1 sample;
+    void *raw = &sample;
+    dds_sample_info_t si;
+    if ((ret = dds_take (rd, &raw, &si, 1, 1)) == 1)
+    {
+      /* KEEP_ALL, reliable: it must all arrive and in order */
+      CU_ASSERT_FATAL (sample.long_2 == n);
+      n++;
+    }
+    else
+    {
+      CU_ASSERT_FATAL (ret == 0);
+      dds_sleepfor (DDS_MSECS (1));
+    }
+  }
+  CU_ASSERT_FATAL (n == FEC_SAMPLE_COUNT);
+
+  get_writer_nacks (wr, &res->nacks);
+  get_proxy_writer_fec_stats (rd, wr, &res->stats);
+  if (test_benchmarks_enabled ())
+    printf ("FECGroupSize %d: %"PRIu32" NACKs, %"PRIu64" recovered, %"PRIu64" unrecoverable, %"PRIu64" failed\n",
+            fec_group_size, res->nacks, res->stats.recovered, res->stats.unrecoverable, res->stats.failed);
+  delete_test_domains (&doms);
+}
+
+CU_Test(ddsc_fec, lossy_recovery, .timeout = 90)
+{
+  struct fec_result plain, fec;
+  run_lossy (0, &plain);
+  CU_ASSERT (plain.stats.recovered == 0);
+  run_lossy (4, &fec);
+  /* with a 10% packet loss rate, about a quarter of the groups lose exactly
+     one sample and the parity arrives, failures should never occur */
+  CU_ASSERT (fec.stats.recovered > 0);
+  CU_ASSERT (fec.stats.failed == 0);
+}
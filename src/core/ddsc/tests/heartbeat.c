@@ -0,0 +1,133 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <limits.h>
+
+#include "dds/dds.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_xevent.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+#define DDS_CONFIG_ADAPTIVE_HB "<Internal><HeartbeatInterval adaptive=\"true\">100ms</HeartbeatInterval></Internal>"
+
+static struct test_domains g_doms;
+
+static void heartbeat_init (void)
+{
+  create_test_domains (&g_doms, DDS_CONFIG_ADAPTIVE_HB, NULL);
+}
+
+static void heartbeat_fini (void)
+{
+  delete_test_domains (&g_doms);
+}
+
+static int64_t get_ack_latency (dds_entity_t writer)
+{
+  struct dds_entity *x;
+  struct writer * const wr = pin_ddsi_writer (writer, &x);
+  int64_t lat;
+  ddsrt_mutex_lock (&wr->e.lock);
+  CU_ASSERT_FATAL (!ddsrt_avl_is_empty (&wr->readers));
+  lat = ((struct wr_prd_match *) ddsrt_avl_root (&wr_readers_treedef, &wr->readers))->max_ack_latency;
+  ddsrt_mutex_unlock (&wr->e.lock);
+  unpin_ddsi_entity (x);
+  return lat;
+}
+
+CU_Test(ddsc_heartbeat, adaptive_ack_latency, .init = heartbeat_init, .fini = heartbeat_fini, .timeout = 30)
+{
+  char topicname[100];
+  dds_return_t ret;
+  create_unique_topic_name ("ddsc_heartbeat", topicname, sizeof (topicname));
+  dds_entity_t tp_pub = dds_create_topic (g_doms.pub_participant, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_pub > 0);
+  dds_entity_t tp_sub = dds_create_topic (g_doms.sub_participant, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_sub > 0);
+
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_entity_t wr = dds_create_writer (g_doms.pub_participant, tp_pub, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_entity_t rd = dds_create_reader (g_doms.sub_participant, tp_sub, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+  sync_reader_writer (g_doms.sub_participant, rd, g_doms.pub_participant, wr);
+
+  /* Every sample written after the previous one has been acknowledged
+     results in one heartbeat requesting an ACK, and the estimate becomes
+     available once the median filter has filled up */
+  int64_t lat = 0;
+  for (int32_t i = 0; i < 50 && lat == 0; i++)
+  {
+    ret = dds_write (wr, &(Space_Type1){ 0, i, 0 });
+    CU_ASSERT_FATAL (ret == 0);
+    ret = dds_wait_for_acks (wr, DDS_SECS (5));
+    CU_ASSERT_FATAL (ret == 0);
+    lat = get_ack_latency (wr);
+  }
+  CU_ASSERT (lat > 0);
+  CU_ASSERT (lat < DDS_SECS (1));
+}
+
+CU_Test(ddsc_heartbeat, aggregation, .init = heartbeat_init, .fini = heartbeat_fini, .timeout = 30)
+{
+#define NWRITERS 50
+  char topicname[100];
+  dds_entity_t wrs[NWRITERS];
+  dds_return_t ret;
+  create_unique_topic_name ("ddsc_heartbeat", topicname, sizeof (topicname));
+  dds_entity_t tp_pub = dds_create_topic (g_doms.pub_participant, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_pub > 0);
+  dds_entity_t tp_sub = dds_create_topic (g_doms.sub_participant, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_sub > 0);
+
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_entity_t rd = dds_create_reader (g_doms.sub_participant, tp_sub, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  for (int i = 0; i < NWRITERS; i++)
+  {
+    wrs[i] = dds_create_writer (g_doms.pub_participant, tp_pub, qos, NULL);
+    CU_ASSERT_FATAL (wrs[i] > 0);
+    sync_reader_writer (g_doms.sub_participant, rd, g_doms.pub_participant, wrs[i]);
+  }
+  dds_delete_qos (qos);
+
+  struct dds_entity *x;
+  struct xeventq_heartbeat_stats st0, st1;
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (g_doms.pub_participant, &x), 0);
+  xeventq_get_heartbeat_stats (x->m_domain->gv.xevents, &st0);
+
+  /* The writers' heartbeats are all due at about the same time, to the same
+     destination, so should mostly be packed together */
+  for (int i = 0; i < NWRITERS; i++)
+  {
+    ret = dds_write (wrs[i], &(Space_Type1){ i, 0, 0 });
+    CU_ASSERT_FATAL (ret == 0);
+  }
+  for (int i = 0; i < NWRITERS; i++)
+  {
+    ret = dds_wait_for_acks (wrs[i], DDS_SECS (5));
+    CU_ASSERT_FATAL (ret == 0);
+  }
+
+  xeventq_get_heartbeat_stats (x->m_domain->gv.xevents, &st1);
+  dds_entity_unpin (x);
+  CU_ASSERT (st1.packets_saved > st0.packets_saved);
+#undef NWRITERS
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <limits.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+#define NSUB 2
+#define SAMPLE_COUNT 10000
+
+/* Multicast disabled so that each message is sent to the readers in both
+   subscribing domains, which is what gets batched when using io_uring */
+#define DDS_CONFIG_LOOPBACK "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<General><NetworkInterfaceAddress>127.0.0.1</NetworkInterfaceAddress><AllowMulticast>false</AllowMulticast></General><Discovery><ExternalDomainId>0</ExternalDomainId><ParticipantIndex>auto</ParticipantIndex><Peers><Peer address=\"127.0.0.1\"/></Peers></Discovery>"
+#define DDS_CONFIG_URING DDS_CONFIG_LOOPBACK ",<Internal><UseIoUring>true</UseIoUring></Internal>"
+
+static bool uses_io_uring (dds_entity_t pp)
+{
+  struct dds_entity *x;
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (pp, &x), 0);
+  const bool res = x->m_domain->gv.config.use_io_uring;
+  dds_entity_unpin (x);
+  return res;
+}
+
+static void do_loopback_throughput (bool uring)
+{
+  dds_entity_t dom[NSUB + 1], pp[NSUB + 1], tp[NSUB + 1], rd[NSUB];
+  for (dds_domainid_t d = 0; d <= NSUB; d++)
+  {
+    char *conf = ddsrt_expand_envvars (uring ? DDS_CONFIG_URING : DDS_CONFIG_LOOPBACK, d);
+    dom[d] = dds_create_domain (d, conf);
+    CU_ASSERT_FATAL (dom[d] > 0);
+    dds_free (conf);
+    pp[d] = dds_create_participant (d, NULL, NULL);
+    CU_ASSERT_FATAL (pp[d] > 0);
+  }
+  /* falls back to plain UDP if io_uring is not available */
+  const bool using_uring = uses_io_uring (pp[0]);
+  CU_ASSERT (!using_uring || uring);
+
+  char topicname[100];
+  create_unique_topic_name ("ddsc_iouring", topicname, sizeof (topicname));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  for (int d = 0; d <= NSUB; d++)
+  {
+    tp[d] = dds_create_topic (pp[d], &Space_Type1_desc, topicname, NULL, NULL);
+    CU_ASSERT_FATAL (tp[d] > 0);
+  }
+  for (int i = 0; i < NSUB; i++)
+  {
+    rd[i] = dds_create_reader (pp[i + 1], tp[i + 1], qos, NULL);
+    CU_ASSERT_FATAL (rd[i] > 0);
+  }
+  const dds_entity_t wr = dds_create_writer (pp[0], tp[0], qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+  for (int i = 0; i < NSUB; i++)
+    sync_reader_writer (pp[i + 1], rd[i], pp[0], wr);
+  dds_publication_matched_status_t pm;
+  const dds_time_t tmatch = dds_time () + DDS_SECS (10);
+  do {
+    CU_ASSERT_FATAL (dds_get_publication_matched_status (wr, &pm) == 0);
+    if (pm.current_count < NSUB)
+      dds_sleepfor (DDS_MSECS (10));
+  } while (pm.current_count < NSUB && dds_time () < tmatch);
+  CU_ASSERT_FATAL (pm.current_count == NSUB);
+
+  /* Data arriving before the proxy writer has seen a heartbeat is not
+     delivered to a volatile reader, so first make sure it has */
+  CU_ASSERT_FATAL (dds_write (wr, &(Space_Type1){ 0, -1, 0 }) == 0);
+  CU_ASSERT_FATAL (dds_wait_for_acks (wr, DDS_SECS (5)) == 0);
+
+  const dds_time_t tstart = dds_time ();
+  for (int32_t i = 0; i < SAMPLE_COUNT; i++)
+    CU_ASSERT_FATAL (dds_write (wr, &(Space_Type1){ 0, i, 0 }) == 0);
+  CU_ASSERT_FATAL (dds_wait_for_acks (wr, DDS_SECS (20)) == 0);
+  const dds_time_t tend = dds_time ();
+  if (test_benchmarks_enabled ())
+    printf ("%s: %.0f samples/s\n", using_uring ? "io_uring" : "udp",
+            (double) SAMPLE_COUNT / ((double) (tend - tstart) / 1e9));
+
+  /* Check the data got through, in order */
+  for (int k = 0; k < NSUB; k++)
+  {
+    int32_t next = 0;
+    const dds_time_t tdeliv = dds_time () + DDS_SECS (10);
+    while (next < SAMPLE_COUNT && dds_time () < tdeliv)
+    {
+      Space_Type1 sample;
+      void *raw = &sample;
+      dds_sample_info_t si;
+      if (dds_take (rd[k], &raw, &si, 1, 1) != 1)
+        dds_sleepfor (DDS_MSECS (1));
+      else if (sample.long_2 >= 0)
+      {
+        CU_ASSERT_FATAL (sample.long_2 == next);
+        next++;
+      }
+    }
+    CU_ASSERT_FATAL (next == SAMPLE_COUNT);
+  }
+
+  for (int d = 0; d <= NSUB; d++)
+    dds_delete (dom[d]);
+}
+
+CU_Test(ddsc_iouring, loopback_throughput, .timeout = 60)
+{
+  /* plain UDP only serves as a baseline for the throughput */
+  if (test_benchmarks_enabled ())
+    do_loopback_throughput (false);
+  do_loopback_throughput (true);
+}
+
+CU_Test(ddsc_iouring, many_sockets, .timeout = 30)
+{
+  /* the receive thread handles all transmit sockets, of which there can be
+     arbitrarily many */
+  const char *confs[2] = { DDS_CONFIG_URING ",<Internal><TransmitSockets>40</TransmitSockets></Internal>", DDS_CONFIG_URING };
+  dds_entity_t dom[2], pp[2], tp[2];
+  char topicname[100];
+  create_unique_topic_name ("ddsc_iouring_many_sockets", topicname, sizeof (topicname));
+  for (dds_domainid_t d = 0; d < 2; d++)
+  {
+    char *conf = ddsrt_expand_envvars (confs[d], d);
+    dom[d] = dds_create_domain (d, conf);
+    CU_ASSERT_FATAL (dom[d] > 0);
+    dds_free (conf);
+    pp[d] = dds_create_participant (d, NULL, NULL);
+    CU_ASSERT_FATAL (pp[d] > 0);
+    tp[d] = dds_create_topic (pp[d], &Space_Type1_desc, topicname, NULL, NULL);
+    CU_ASSERT_FATAL (tp[d] > 0);
+  }
+  if (!uses_io_uring (pp[0]))
+  {
+    for (dds_domainid_t d = 0; d < 2; d++)
+      dds_delete (dom[d]);
+    CU_PASS ("io_uring not available");
+    return;
+  }
+
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_durability (qos, DDS_DURABILITY_TRANSIENT_LOCAL);
+  const dds_entity_t wr = dds_create_writer (pp[0], tp[0], qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  const dds_entity_t rd = dds_create_reader (pp[1], tp[1], qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+  sync_reader_writer (pp[1], rd, pp[0], wr);
+  CU_ASSERT_FATAL (dds_write (wr, &(Space_Type1){ 1, 2, 3 }) == 0);
+  CU_ASSERT_FATAL (dds_wait_for_acks (wr, DDS_SECS (5)) == 0);
+
+  Space_Type1 sample;
+  void *raw = &sample;
+  dds_sample_info_t si;
+  CU_ASSERT_FATAL (dds_take (rd, &raw, &si, 1, 1) == 1);
+  CU_ASSERT_FATAL (si.valid_data && sample.long_1 == 1 && sample.long_2 == 2 && sample.long_3 == 3);
+  for (dds_domainid_t d = 0; d < 2; d++)
+    dds_delete (dom[d]);
+}
@@ -319,3 +319,82 @@ CU_Test (ddsc_loan, read_cleanup, .init = create_entities, .fini = delete_entiti
   result = dds_return_loan (reader, ptrs, n);
   CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
 }
+
+CU_Test (ddsc_loan, serdata)
+{
+  char topicname[100];
+  dds_return_t result;
+  dds_entity_t pp, tp, rd, wr;
+  dds_qos_t *qos;
+
+  pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  create_unique_topic_name ("ddsc_loan_serdata", topicname, sizeof topicname);
+  tp = dds_create_topic (pp, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  qos = dds_create_qos ();
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_qset_prop (qos, DDS_READER_PROP_SERDATA_LOANS, "true");
+  rd = dds_create_reader (pp, tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+  wr = dds_create_writer (pp, tp, NULL, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  for (int32_t i = 0; i < 3; i++)
+  {
+    result = dds_write (wr, &(Space_Type1){ i, 10 * i, 100 * i });
+    CU_ASSERT_FATAL (result == 0);
+  }
+
+  int32_t n, n2;
+  void *ptrs[3] = { NULL }, *ptrs2[3] = { NULL };
+  void *ptr0copy;
+  dds_sample_info_t si[3];
+
+  /* the samples point into the received data, so reading twice gives the
+     same address */
+  n = dds_read (rd, ptrs, si, 3, 3);
+  CU_ASSERT_FATAL (n == 3);
+  for (int32_t i = 0; i < n; i++)
+  {
+    const Space_Type1 *s = ptrs[i];
+    CU_ASSERT (s->long_1 == i && s->long_2 == 10 * i && s->long_3 == 100 * i);
+  }
+  ptr0copy = ptrs[0];
+  result = dds_return_loan (rd, ptrs, n);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  CU_ASSERT_FATAL (ptrs[0] == NULL);
+  n = dds_read (rd, ptrs, si, 3, 3);
+  CU_ASSERT_FATAL (n == 3);
+  CU_ASSERT (ptrs[0] == ptr0copy);
+
+  /* with the loan still out, a second read uses a different buffer */
+  n2 = dds_read (rd, ptrs2, si, 3, 3);
+  CU_ASSERT_FATAL (n2 == 3);
+  CU_ASSERT (ptrs2[0] != ptrs[0]);
+  CU_ASSERT (((const Space_Type1 *) ptrs2[2])->long_3 == 200);
+  result = dds_return_loan (rd, ptrs2, n2);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  result = dds_return_loan (rd, ptrs, n);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+
+  /* invalid samples are deserialized, leaving a loan outstanding while deleting
+     the reader must release everything */
+  n = dds_take (rd, ptrs, si, 3, 3);
+  CU_ASSERT_FATAL (n == 3);
+  result = dds_return_loan (rd, ptrs, n);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  result = dds_dispose (wr, &(Space_Type1){ 1, 0, 0 });
+  CU_ASSERT_FATAL (result == 0);
+  n = dds_read (rd, ptrs, si, 3, 3);
+  CU_ASSERT_FATAL (n == 1);
+  CU_ASSERT (!si[0].valid_data && ((const Space_Type1 *) ptrs[0])->long_1 == 1);
+  result = dds_write (wr, &(Space_Type1){ 2, 0, 0 });
+  CU_ASSERT_FATAL (result == 0);
+  n = dds_take (rd, ptrs2, si, 3, 3);
+  CU_ASSERT_FATAL (n == 2);
+  result = dds_return_loan (rd, ptrs2, n);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+  result = dds_delete (pp);
+  CU_ASSERT_FATAL (result == DDS_RETCODE_OK);
+}
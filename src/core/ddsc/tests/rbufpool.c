@@ -0,0 +1,106 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <limits.h>
+
+#include "dds/dds.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/q_radmin.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+/* Receive buffers of the minimum size hold only a single message, and with
+   asynchronous delivery the message is still referenced when the next packet
+   arrives, so nearly every packet received requires a new one */
+#define DDS_CONFIG_RECYCLE "<Sizing><ReceiveBufferSize>1 B</ReceiveBufferSize><RecycledReceiveBuffers>4</RecycledReceiveBuffers><ReceiveBufferHugePages>true</ReceiveBufferHugePages></Sizing><Internal><SynchronousDeliveryPriorityThreshold>1</SynchronousDeliveryPriorityThreshold></Internal>"
+
+#define SAMPLE_COUNT 200
+
+static void get_rbufpool_stats (dds_entity_t participant, struct nn_rbufpool_stats *st)
+{
+  struct dds_entity *x;
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (participant, &x), 0);
+  const struct ddsi_domaingv *gv = &x->m_domain->gv;
+  st->recycled = st->hits = st->misses = 0;
+  for (uint32_t i = 0; i < gv->n_recv_threads; i++)
+  {
+    struct nn_rbufpool_stats st1;
+    nn_rbufpool_get_stats (gv->recv_threads[i].arg.rbpool, &st1);
+    st->recycled += st1.recycled;
+    st->hits += st1.hits;
+    st->misses += st1.misses;
+  }
+  dds_entity_unpin (x);
+}
+
+CU_Test(ddsc_rbufpool, recycle, .timeout = 30)
+{
+  struct test_domains doms;
+  create_test_domains (&doms, NULL, DDS_CONFIG_RECYCLE);
+  const dds_entity_t pp_pub = doms.pub_participant, pp_sub = doms.sub_participant;
+
+  char topicname[100];
+  create_unique_topic_name ("ddsc_rbufpool", topicname, sizeof (topicname));
+  const dds_entity_t tp_pub = dds_create_topic (pp_pub, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_pub > 0);
+  const dds_entity_t tp_sub = dds_create_topic (pp_sub, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_sub > 0);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t wr = dds_create_writer (pp_pub, tp_pub, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  const dds_entity_t rd = dds_create_reader (pp_sub, tp_sub, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+  sync_reader_writer (pp_sub, rd, pp_pub, wr);
+
+  struct nn_rbufpool_stats st0, st1;
+  get_rbufpool_stats (pp_sub, &st0);
+  for (int32_t i = 0; i < SAMPLE_COUNT; i++)
+  {
+    dds_return_t ret = dds_write (wr, &(Space_Type1){ 0, i, 0 });
+    CU_ASSERT_FATAL (ret == 0);
+    /* pacing gives the delivery thread the opportunity to release buffers
+       before the next packet arrives */
+    dds_sleepfor (DDS_MSECS (1));
+  }
+  int32_t n = 0;
+  const dds_time_t tend = dds_time () + DDS_SECS (10);
+  while (n < SAMPLE_COUNT && dds_time () < tend)
+  {
+    Space_Type1 sample;
+    void *raw = &sample;
+    dds_sample_info_t si;
+    if (dds_take (rd, &raw, &si, 1, 1) == 1)
+    {
+      CU_ASSERT_FATAL (sample.long_2 == n);
+      n++;
+    }
+    else
+    {
+      dds_sleepfor (DDS_MSECS (1));
+    }
+  }
+  CU_ASSERT_FATAL (n == SAMPLE_COUNT);
+  get_rbufpool_stats (pp_sub, &st1);
+  /* Once delivered, the data no longer references the buffer, so it gets
+     recycled and new buffers come from the free list; how many are needed
+     depends on how many samples end up in a packet and how far behind the
+     delivery thread is, so only check that recycling happens */
+  CU_ASSERT (st1.recycled > st0.recycled);
+  CU_ASSERT (st1.hits > st0.hits);
+  CU_ASSERT (st1.hits <= st1.recycled);
+
+  delete_test_domains (&doms);
+}
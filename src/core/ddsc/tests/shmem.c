@@ -0,0 +1,386 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <limits.h>
+#include <errno.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_addrset.h"
+#include "dds/ddsi/q_protocol.h"
+#include "dds/ddsi/ddsi_tran.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+#define SAMPLE_COUNT 10000
+#define STALL_SAMPLE_COUNT 1000
+
+/* Two domains in one process are as good as two processes: each has its own
+   receive rings */
+#define DDS_CONFIG_LOOPBACK "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<General><NetworkInterfaceAddress>127.0.0.1</NetworkInterfaceAddress></General><Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+#define DDS_CONFIG_SHMEM DDS_CONFIG_LOOPBACK ",<Internal><SharedMemoryTransport>true</SharedMemoryTransport></Internal>"
+
+static bool uses_shmem (dds_entity_t pp)
+{
+  struct dds_entity *x;
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (pp, &x), 0);
+  const struct ddsi_domaingv * const gv = &x->m_domain->gv;
+  const bool res = (gv->config.shmem_transport != 0);
+  /* if enabled, there must be receive rings */
+  CU_ASSERT (!res || (gv->disc_conn_shmem != NULL && gv->data_conn_shmem != NULL));
+  dds_entity_unpin (x);
+  return res;
+}
+
+static void count_shmem_locators (const ddsi_xlocator_t *loc, void *varg)
+{
+  int * const n = varg;
+  if (loc->c.kind == NN_LOCATOR_KIND_SHMEM)
+    (*n)++;
+}
+
+static int writer_shmem_locators (dds_entity_t wrhandle)
+{
+  struct dds_entity *x;
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (wrhandle, &x), 0);
+  struct writer * const wr = ((struct dds_writer *) x)->m_wr;
+  int n = 0;
+  ddsrt_mutex_lock (&wr->e.lock);
+  addrset_forall (wr->as, count_shmem_locators, &n);
+  ddsrt_mutex_unlock (&wr->e.lock);
+  dds_entity_unpin (x);
+  return n;
+}
+
+static void do_loopback_throughput (bool shmem)
+{
+  dds_entity_t dom[2], pp[2], tp[2];
+  for (dds_domainid_t d = 0; d < 2; d++)
+  {
+    char *conf = ddsrt_expand_envvars (shmem ? DDS_CONFIG_SHMEM : DDS_CONFIG_LOOPBACK, d);
+    dom[d] = dds_create_domain (d, conf);
+    CU_ASSERT_FATAL (dom[d] > 0);
+    dds_free (conf);
+    pp[d] = dds_create_participant (d, NULL, NULL);
+    CU_ASSERT_FATAL (pp[d] > 0);
+  }
+  /* disables itself (with a warning) if /dev/shm is not available */
+  const bool using_shmem = uses_shmem (pp[0]) && uses_shmem (pp[1]);
+  CU_ASSERT (!using_shmem || shmem);
+
+  char topicname[100];
+  create_unique_topic_name ("ddsc_shmem", topicname, sizeof (topicname));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  for (int d = 0; d < 2; d++)
+  {
+    tp[d] = dds_create_topic (pp[d], &Space_Type1_desc, topicname, NULL, NULL);
+    CU_ASSERT_FATAL (tp[d] > 0);
+  }
+  const dds_entity_t rd = dds_create_reader (pp[1], tp[1], qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  const dds_entity_t wr = dds_create_writer (pp[0], tp[0], qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+  sync_reader_writer (pp[1], rd, pp[0], wr);
+
+  /* Data arriving before the proxy writer has seen a heartbeat is not
+     delivered to a volatile reader, so first make sure it has */
+  CU_ASSERT_FATAL (dds_write (wr, &(Space_Type1){ 0, -1, 0 }) == 0);
+  CU_ASSERT_FATAL (dds_wait_for_acks (wr, DDS_SECS (5)) == 0);
+
+  /* the reader is in the same shared memory, so that's the way to reach it */
+  CU_ASSERT ((writer_shmem_locators (wr) > 0) == using_shmem);
+
+  const dds_time_t tstart = dds_time ();
+  for (int32_t i = 0; i < SAMPLE_COUNT; i++)
+    CU_ASSERT_FATAL (dds_write (wr, &(Space_Type1){ 0, i, 0 }) == 0);
+  CU_ASSERT_FATAL (dds_wait_for_acks (wr, DDS_SECS (20)) == 0);
+  const dds_time_t tend = dds_time ();
+  if (test_benchmarks_enabled ())
+    printf ("%s: %.0f samples/s\n", using_shmem ? "shmem" : "udp",
+            (double) SAMPLE_COUNT / ((double) (tend - tstart) / 1e9));
+
+  /* Check the data got through, in order */
+  int32_t next = 0;
+  const dds_time_t tdeliv = dds_time () + DDS_SECS (10);
+  while (next < SAMPLE_COUNT && dds_time () < tdeliv)
+  {
+    Space_Type1 sample;
+    void *raw = &sample;
+    dds_sample_info_t si;
+    if (dds_take (rd, &raw, &si, 1, 1) != 1)
+      dds_sleepfor (DDS_MSECS (1));
+    else if (sample.long_2 >= 0)
+    {
+      CU_ASSERT_FATAL (sample.long_2 == next);
+      next++;
+    }
+  }
+  CU_ASSERT_FATAL (next == SAMPLE_COUNT);
+
+  for (int d = 0; d < 2; d++)
+    dds_delete (dom[d]);
+}
+
+CU_Test(ddsc_shmem, loopback_throughput, .timeout = 60)
+{
+  /* plain UDP only serves as a baseline for the throughput */
+  if (test_benchmarks_enabled ())
+    do_loopback_throughput (false);
+  do_loopback_throughput (true);
+}
+
+CU_Test(ddsc_shmem, interop_with_udp, .timeout = 30)
+{
+  /* one side without shared memory: it must ignore the other's locators and
+     the data must go over UDP */
+  const char *confs[2] = { DDS_CONFIG_SHMEM, DDS_CONFIG_LOOPBACK };
+  dds_entity_t dom[2], pp[2], tp[2];
+  for (dds_domainid_t d = 0; d < 2; d++)
+  {
+    char *conf = ddsrt_expand_envvars (confs[d], d);
+    dom[d] = dds_create_domain (d, conf);
+    CU_ASSERT_FATAL (dom[d] > 0);
+    dds_free (conf);
+    pp[d] = dds_create_participant (d, NULL, NULL);
+    CU_ASSERT_FATAL (pp[d] > 0);
+  }
+  CU_ASSERT (!uses_shmem (pp[1]));
+
+  char topicname[100];
+  create_unique_topic_name ("ddsc_shmem", topicname, sizeof (topicname));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  for (int d = 0; d < 2; d++)
+  {
+    tp[d] = dds_create_topic (pp[d], &Space_Type1_desc, topicname, NULL, NULL);
+    CU_ASSERT_FATAL (tp[d] > 0);
+  }
+  const dds_entity_t rd = dds_create_reader (pp[1], tp[1], qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  const dds_entity_t wr = dds_create_writer (pp[0], tp[0], qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+  sync_reader_writer (pp[1], rd, pp[0], wr);
+
+  CU_ASSERT_FATAL (dds_write (wr, &(Space_Type1){ 0, -1, 0 }) == 0);
+  CU_ASSERT_FATAL (dds_wait_for_acks (wr, DDS_SECS (5)) == 0);
+  CU_ASSERT (writer_shmem_locators (wr) == 0);
+  CU_ASSERT_FATAL (dds_write (wr, &(Space_Type1){ 0, 1, 0 }) == 0);
+  CU_ASSERT_FATAL (dds_wait_for_acks (wr, DDS_SECS (5)) == 0);
+
+  int n = 0;
+  const dds_time_t tdeliv = dds_time () + DDS_SECS (5);
+  while (n == 0 && dds_time () < tdeliv)
+  {
+    Space_Type1 sample;
+    void *raw = &sample;
+    dds_sample_info_t si;
+    if (dds_take (rd, &raw, &si, 1, 1) != 1)
+      dds_sleepfor (DDS_MSECS (1));
+    else if (sample.long_2 == 1)
+      n++;
+  }
+  CU_ASSERT (n == 1);
+
+  for (int d = 0; d < 2; d++)
+    dds_delete (dom[d]);
+}
+
+/* Mirrors the layout of a receive ring in ddsi_shmem.c, for faking a sender
+   that claimed a slot and then never got round to publishing it */
+#define RING_NSLOTS_OFF 8
+#define RING_TAIL_OFF 64
+#define RING_SLOTS_OFF 128
+#define SLOT_SIZE (64 + 65536)
+#define SLOT_SEQ_OFF 0
+#define SLOT_OWNER_OFF 12
+#define SEQ_FILLING 2u
+
+static void ring_path (char *path, size_t size, uint32_t port)
+{
+  struct stat st;
+  const uint32_t netns = (stat ("/proc/self/ns/net", &st) == 0) ? (uint32_t) st.st_ino : 0;
+  (void) snprintf (path, size, "/dev/shm/cyclonedds-%"PRIu32"-%"PRIu32"-%"PRIu32, (uint32_t) geteuid (), netns, port);
+}
+
+static void stall_data_ring (dds_entity_t pp, uint32_t owner)
+{
+  struct dds_entity *x;
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (pp, &x), 0);
+  char path[100];
+  ring_path (path, sizeof (path), ddsi_conn_port (x->m_domain->gv.data_conn_shmem));
+  dds_entity_unpin (x);
+
+  struct stat st;
+  const int fd = open (path, O_RDWR);
+  CU_ASSERT_FATAL (fd >= 0);
+  CU_ASSERT_FATAL (fstat (fd, &st) == 0);
+  unsigned char *base = mmap (NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  CU_ASSERT_FATAL (base != MAP_FAILED);
+  close (fd);
+
+  const uint32_t nslots = *(uint32_t *) (base + RING_NSLOTS_OFF);
+  ddsrt_atomic_uint32_t * const tail = (ddsrt_atomic_uint32_t *) (base + RING_TAIL_OFF);
+  ddsrt_atomic_uint32_t *seq, *own;
+  uint32_t pos;
+  do {
+    pos = ddsrt_atomic_ld32 (tail);
+    unsigned char *slot = base + RING_SLOTS_OFF + (size_t) (pos & (nslots - 1)) * SLOT_SIZE;
+    seq = (ddsrt_atomic_uint32_t *) (slot + SLOT_SEQ_OFF);
+    own = (ddsrt_atomic_uint32_t *) (slot + SLOT_OWNER_OFF);
+    CU_ASSERT_FATAL (ddsrt_atomic_ld32 (seq) - pos == 0 || ddsrt_atomic_ld32 (seq) - pos > nslots);
+  } while (ddsrt_atomic_ld32 (seq) != pos || !ddsrt_atomic_cas32 (tail, pos, pos + 1));
+  if (owner != 0)
+  {
+    ddsrt_atomic_st32 (own, owner);
+    CU_ASSERT_FATAL (ddsrt_atomic_cas32 (seq, pos, pos + SEQ_FILLING));
+  }
+  (void) munmap (base, (size_t) st.st_size);
+}
+
+static void do_stalled_sender (uint32_t owner, bool expect_shmem)
+{
+  dds_entity_t dom[2], pp[2], tp[2];
+  for (dds_domainid_t d = 0; d < 2; d++)
+  {
+    char *conf = ddsrt_expand_envvars (DDS_CONFIG_SHMEM, d);
+    dom[d] = dds_create_domain (d, conf);
+    CU_ASSERT_FATAL (dom[d] > 0);
+    dds_free (conf);
+    pp[d] = dds_create_participant (d, NULL, NULL);
+    CU_ASSERT_FATAL (pp[d] > 0);
+  }
+  if (!uses_shmem (pp[0]) || !uses_shmem (pp[1]))
+  {
+    for (int d = 0; d < 2; d++)
+      dds_delete (dom[d]);
+    CU_PASS ("shared memory transport not available");
+    return;
+  }
+
+  char topicname[100];
+  create_unique_topic_name ("ddsc_shmem", topicname, sizeof (topicname));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  for (int d = 0; d < 2; d++)
+  {
+    tp[d] = dds_create_topic (pp[d], &Space_Type1_desc, topicname, NULL, NULL);
+    CU_ASSERT_FATAL (tp[d] > 0);
+  }
+  const dds_entity_t rd = dds_create_reader (pp[1], tp[1], qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  const dds_entity_t wr = dds_create_writer (pp[0], tp[0], qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+  sync_reader_writer (pp[1], rd, pp[0], wr);
+  CU_ASSERT_FATAL (dds_write (wr, &(Space_Type1){ 0, -1, 0 }) == 0);
+  CU_ASSERT_FATAL (dds_wait_for_acks (wr, DDS_SECS (5)) == 0);
+  CU_ASSERT_FATAL (writer_shmem_locators (wr) > 0);
+
+  /* everything written after the stalled slot must still arrive, either
+     because the reader skips it, or because the writer gives up on the ring
+     (for which it has to fill it first) */
+  stall_data_ring (pp[1], owner);
+  for (int32_t i = 0; i < STALL_SAMPLE_COUNT; i++)
+    CU_ASSERT_FATAL (dds_write (wr, &(Space_Type1){ 0, i, 0 }) == 0);
+  CU_ASSERT_FATAL (dds_wait_for_acks (wr, DDS_SECS (10)) == 0);
+  int32_t next = 0;
+  const dds_time_t tdeliv = dds_time () + DDS_SECS (5);
+  while (next < STALL_SAMPLE_COUNT && dds_time () < tdeliv)
+  {
+    Space_Type1 sample;
+    void *raw = &sample;
+    dds_sample_info_t si;
+    if (dds_take (rd, &raw, &si, 1, 1) != 1)
+      dds_sleepfor (DDS_MSECS (1));
+    else if (sample.long_2 >= 0)
+    {
+      CU_ASSERT_FATAL (sample.long_2 == next);
+      next++;
+    }
+  }
+  CU_ASSERT_FATAL (next == STALL_SAMPLE_COUNT);
+  CU_ASSERT ((writer_shmem_locators (wr) > 0) == expect_shmem);
+
+  for (int d = 0; d < 2; d++)
+    dds_delete (dom[d]);
+}
+
+CU_Test(ddsc_shmem, stalled_sender_never_marked, .timeout = 30)
+{
+  do_stalled_sender (0, true);
+}
+
+CU_Test(ddsc_shmem, stalled_sender_died, .timeout = 30)
+{
+  /* a process that no longer exists */
+  const pid_t pid = fork ();
+  CU_ASSERT_FATAL (pid >= 0);
+  if (pid == 0)
+    _exit (0);
+  CU_ASSERT_FATAL (waitpid (pid, NULL, 0) == pid);
+  do_stalled_sender ((uint32_t) pid, true);
+}
+
+CU_Test(ddsc_shmem, stalled_sender_alive, .timeout = 30)
+{
+  /* the reader has to wait for a live sender, so the ring fills up and the
+     writer must switch to UDP */
+  do_stalled_sender ((uint32_t) getpid (), false);
+}
+
+CU_Test(ddsc_shmem, ring_creation_fails, .timeout = 30)
+{
+  /* something in the way of the rings for all ports it may use: the domain
+     must come up without shared memory instead of failing */
+  char path[100];
+  for (uint32_t port = 7410; port < 7430; port++)
+  {
+    ring_path (path, sizeof (path), port);
+    CU_ASSERT_FATAL (mkdir (path, 0700) == 0 || errno == EEXIST);
+  }
+  char *conf = ddsrt_expand_envvars (DDS_CONFIG_SHMEM ",<Discovery><ParticipantIndex>auto</ParticipantIndex><MaxAutoParticipantIndex>9</MaxAutoParticipantIndex><Ports><Base>7400</Base></Ports></Discovery>", 0);
+  const dds_entity_t dom = dds_create_domain (0, conf);
+  dds_free (conf);
+  const dds_entity_t pp = (dom > 0) ? dds_create_participant (0, NULL, NULL) : 0;
+  for (uint32_t port = 7410; port < 7430; port++)
+  {
+    ring_path (path, sizeof (path), port);
+    (void) rmdir (path);
+  }
+  CU_ASSERT_FATAL (dom > 0);
+  CU_ASSERT_FATAL (pp > 0);
+  CU_ASSERT (!uses_shmem (pp));
+
+  struct dds_entity *x;
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (pp, &x), 0);
+  const struct ddsi_domaingv * const gv = &x->m_domain->gv;
+  for (int i = 0; i < gv->n_interfaces; i++)
+    CU_ASSERT (gv->interfaces[i].loc.kind != NN_LOCATOR_KIND_SHMEM);
+  dds_entity_unpin (x);
+  dds_delete (dom);
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsc/dds_statistics.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sockets.h"
+
+#include "test_common.h"
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+#define DDS_CONFIG_NO_PORT_GAIN "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+#define DDS_CONFIG_MEAS_LATENCY DDS_CONFIG_NO_PORT_GAIN ",<Internal><MeasureReceiveLatency>true</MeasureReceiveLatency></Internal>"
+
+#define SAMPLE_COUNT 100
+
+static uint32_t sum_latency_hist (const struct dds_statistics *stat, const char *stage)
+{
+  static const char *buckets[] = { "lt1us", "lt4us", "lt16us", "lt64us", "lt256us", "lt1ms", "lt4ms", "ge4ms" };
+  uint32_t sum = 0;
+  for (size_t i = 0; i < sizeof (buckets) / sizeof (buckets[0]); i++)
+  {
+    char name[64];
+    (void) snprintf (name, sizeof (name), "latency_%s_%s", stage, buckets[i]);
+    const struct dds_stat_keyvalue *kv = dds_lookup_statistic (stat, name);
+    CU_ASSERT_FATAL (kv != NULL && kv->kind == DDS_STAT_KIND_UINT32);
+    sum += kv->u.u32;
+  }
+  return sum;
+}
+
+static void do_receive_latency (bool enable, int32_t transport_priority)
+{
+  char *conf_pub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_PUB);
+  char *conf_sub = ddsrt_expand_envvars (enable ? DDS_CONFIG_MEAS_LATENCY : DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_SUB);
+  const dds_entity_t dom_pub = dds_create_domain (DDS_DOMAINID_PUB, conf_pub);
+  CU_ASSERT_FATAL (dom_pub > 0);
+  const dds_entity_t dom_sub = dds_create_domain (DDS_DOMAINID_SUB, conf_sub);
+  CU_ASSERT_FATAL (dom_sub > 0);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+  const dds_entity_t pp_pub = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pp_pub > 0);
+  const dds_entity_t pp_sub = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (pp_sub > 0);
+
+  char topicname[100];
+  create_unique_topic_name ("ddsc_statistics", topicname, sizeof (topicname));
+  const dds_entity_t tp_pub = dds_create_topic (pp_pub, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_pub > 0);
+  const dds_entity_t tp_sub = dds_create_topic (pp_sub, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_sub > 0);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t rd = dds_create_reader (pp_sub, tp_sub, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  /* a negative transport priority causes asynchronous delivery (given the
+     default SynchronousDeliveryPriorityThreshold of 0) */
+  dds_qset_transport_priority (qos, transport_priority);
+  const dds_entity_t wr = dds_create_writer (pp_pub, tp_pub, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+  sync_reader_writer (pp_sub, rd, pp_pub, wr);
+
+  for (int32_t i = 0; i < SAMPLE_COUNT; i++)
+  {
+    dds_return_t ret = dds_write (wr, &(Space_Type1){ 0, i, 0 });
+    CU_ASSERT_FATAL (ret == 0);
+  }
+  CU_ASSERT_FATAL (dds_wait_for_acks (wr, DDS_SECS (5)) == 0);
+
+  /* Samples written before the proxy writer got its first heartbeat may
+     have been dropped, so count the ones that were received */
+  uint32_t n = 0;
+  Space_Type1 sample;
+  void *raw = &sample;
+  dds_sample_info_t si;
+  while (dds_take (rd, &raw, &si, 1, 1) == 1)
+    n++;
+  CU_ASSERT_FATAL (n > 0);
+
+  /* Recording happens after delivery, so it may lag a little */
+  struct dds_statistics *stat = dds_create_statistics (rd);
+  CU_ASSERT_FATAL (stat != NULL);
+  const uint32_t expected = enable ? n : 0;
+  const dds_time_t tend = dds_time () + DDS_SECS (5);
+  while (sum_latency_hist (stat, "rhc") != expected && dds_time () < tend)
+  {
+    dds_sleepfor (DDS_MSECS (10));
+    CU_ASSERT_FATAL (dds_refresh_statistics (stat) == 0);
+  }
+  printf ("received %"PRIu32": kernel %"PRIu32" receive %"PRIu32" dqueue %"PRIu32" rhc %"PRIu32"\n", n,
+          sum_latency_hist (stat, "kernel"), sum_latency_hist (stat, "receive"),
+          sum_latency_hist (stat, "dqueue"), sum_latency_hist (stat, "rhc"));
+  CU_ASSERT (sum_latency_hist (stat, "rhc") == expected);
+  CU_ASSERT (sum_latency_hist (stat, "receive") == expected);
+  CU_ASSERT (sum_latency_hist (stat, "dqueue") == (transport_priority < 0 ? expected : 0));
+#ifdef SO_TIMESTAMPNS
+  CU_ASSERT (sum_latency_hist (stat, "kernel") == expected);
+#endif
+  dds_delete_statistics (stat);
+
+  dds_delete (dom_sub);
+  dds_delete (dom_pub);
+}
+
+CU_Test(ddsc_statistics, receive_latency_disabled, .timeout = 30)
+{
+  do_receive_latency (false, 0);
+}
+
+CU_Test(ddsc_statistics, receive_latency_sync, .timeout = 30)
+{
+  do_receive_latency (true, 0);
+}
+
+CU_Test(ddsc_statistics, receive_latency_async, .timeout = 30)
+{
+  do_receive_latency (true, -1);
+}
+
+#define SLAB_INSTANCE_COUNT 1000
+#define SLAB_LOW_WATER 256 /* RHC_SLAB_KEEP_CHUNKS * RHC_SLAB_CHUNK_NOBJS */
+
+static uint32_t get_u32_stat (struct dds_statistics *stat, const char *name)
+{
+  CU_ASSERT_FATAL (dds_refresh_statistics (stat) == 0);
+  const struct dds_stat_keyvalue *kv = dds_lookup_statistic (stat, name);
+  CU_ASSERT_FATAL (kv != NULL && kv->kind == DDS_STAT_KIND_UINT32);
+  return kv->u.u32;
+}
+
+static uint32_t take_all (dds_entity_t rd, int32_t max)
+{
+  uint32_t n = 0;
+  Space_Type1 sample;
+  void *raw = &sample;
+  dds_sample_info_t si;
+  while (max-- > 0 && dds_take (rd, &raw, &si, 1, 1) == 1)
+    n++;
+  return n;
+}
+
+CU_Test(ddsc_statistics, rhc_slab, .timeout = 30)
+{
+  const dds_entity_t pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  char topicname[100];
+  create_unique_topic_name ("ddsc_statistics", topicname, sizeof (topicname));
+  const dds_entity_t tp = dds_create_topic (pp, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t rd = dds_create_reader (pp, tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  const dds_entity_t wr = dds_create_writer (pp, tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+  struct dds_statistics *stat = dds_create_statistics (rd);
+  CU_ASSERT_FATAL (stat != NULL);
+
+  /* local delivery is synchronous; the first sample of an instance is stored
+     in the instance, the second comes from the sample slab */
+  for (int32_t s = 0; s < 2; s++)
+    for (int32_t i = 0; i < SLAB_INSTANCE_COUNT; i++)
+    {
+      dds_return_t ret = dds_write (wr, &(Space_Type1){ i, s, 0 });
+      CU_ASSERT_FATAL (ret == 0);
+    }
+  CU_ASSERT_EQUAL_FATAL (get_u32_stat (stat, "rhc_instances_inuse"), SLAB_INSTANCE_COUNT);
+  CU_ASSERT_FATAL (get_u32_stat (stat, "rhc_instances_allocated") >= SLAB_INSTANCE_COUNT);
+  CU_ASSERT_EQUAL_FATAL (get_u32_stat (stat, "rhc_samples_inuse"), SLAB_INSTANCE_COUNT);
+  CU_ASSERT_FATAL (get_u32_stat (stat, "rhc_samples_allocated") >= SLAB_INSTANCE_COUNT);
+
+  /* taking the samples of most instances (take goes instance by instance, in
+     the order they were created) leaves the sample slab mostly empty, and it
+     should be trimmed down to the low-water mark even though it is in use */
+  const uint32_t keep = SLAB_INSTANCE_COUNT / 10;
+  CU_ASSERT_EQUAL_FATAL (take_all (rd, 2 * (SLAB_INSTANCE_COUNT - (int32_t) keep)), 2 * (SLAB_INSTANCE_COUNT - keep));
+  CU_ASSERT_EQUAL_FATAL (get_u32_stat (stat, "rhc_samples_inuse"), keep);
+  CU_ASSERT_FATAL (get_u32_stat (stat, "rhc_samples_allocated") <= 2 * (keep + SLAB_LOW_WATER));
+  CU_ASSERT_EQUAL_FATAL (get_u32_stat (stat, "rhc_instances_inuse"), SLAB_INSTANCE_COUNT);
+
+  /* deleting the writer unregisters (and disposes) all instances; once the
+     resulting invalid samples have been taken the instances are freed and
+     the instance slab gets trimmed as well */
+  CU_ASSERT_FATAL (dds_delete (wr) == 0);
+  CU_ASSERT_EQUAL_FATAL (take_all (rd, INT32_MAX), keep * 2 + (SLAB_INSTANCE_COUNT - keep));
+  CU_ASSERT_EQUAL_FATAL (get_u32_stat (stat, "rhc_instances_inuse"), 0);
+  CU_ASSERT_FATAL (get_u32_stat (stat, "rhc_instances_allocated") <= SLAB_LOW_WATER);
+  CU_ASSERT_EQUAL_FATAL (get_u32_stat (stat, "rhc_samples_inuse"), 0);
+  CU_ASSERT_FATAL (get_u32_stat (stat, "rhc_samples_allocated") <= SLAB_LOW_WATER);
+
+  dds_delete_statistics (stat);
+  dds_delete (pp);
+}
+
+/* Dropping 20% of the packets on the publishing side forces plenty of retransmits,
+   which are limited to REXMIT_RATE B/s for the (only) reader */
+#define REXMIT_RATE 5000
+#define REXMIT_BURST 1000
+#define DDS_CONFIG_REXMIT_LIMIT "<Internal><RexmitReaderBandwidthLimit>5kB/s</RexmitReaderBandwidthLimit><RexmitReaderBurstSize>1000B</RexmitReaderBurstSize><Test><XmitLossiness>200</XmitLossiness></Test></Internal>"
+#define REXMIT_SAMPLE_COUNT 1000
+
+CU_Test(ddsc_statistics, rexmit_reader_rate, .timeout = 60)
+{
+  char *conf_pub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN "," DDS_CONFIG_REXMIT_LIMIT, DDS_DOMAINID_PUB);
+  char *conf_sub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_SUB);
+  const dds_entity_t dom_pub = dds_create_domain (DDS_DOMAINID_PUB, conf_pub);
+  CU_ASSERT_FATAL (dom_pub > 0);
+  const dds_entity_t dom_sub = dds_create_domain (DDS_DOMAINID_SUB, conf_sub);
+  CU_ASSERT_FATAL (dom_sub > 0);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+  const dds_entity_t pp_pub = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pp_pub > 0);
+  const dds_entity_t pp_sub = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (pp_sub > 0);
+
+  char topicname[100];
+  create_unique_topic_name ("ddsc_statistics", topicname, sizeof (topicname));
+  const dds_entity_t tp_pub = dds_create_topic (pp_pub, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_pub > 0);
+  const dds_entity_t tp_sub = dds_create_topic (pp_sub, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_sub > 0);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t rd = dds_create_reader (pp_sub, tp_sub, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  const dds_entity_t wr = dds_create_writer (pp_pub, tp_pub, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+  sync_reader_writer (pp_sub, rd, pp_pub, wr);
+
+  const dds_time_t t0 = dds_time ();
+  for (int32_t i = 0; i < REXMIT_SAMPLE_COUNT; i++)
+  {
+    dds_return_t ret = dds_write (wr, &(Space_Type1){ 0, i, 0 });
+    CU_ASSERT_FATAL (ret == 0);
+  }
+  CU_ASSERT_FATAL (dds_wait_for_acks (wr, DDS_SECS (40)) == 0);
+  const dds_time_t t1 = dds_time ();
+
+  /* the rate is estimated over windows of at least 1s */
+  dds_sleepfor (DDS_MSECS (1100));
+  struct dds_statistics *stat = dds_create_statistics (wr);
+  CU_ASSERT_FATAL (stat != NULL);
+  const struct dds_stat_keyvalue *rexmit_bytes = dds_lookup_statistic (stat, "rexmit_reader_bytes");
+  const struct dds_stat_keyvalue *rate_total = dds_lookup_statistic (stat, "rexmit_reader_rate_total");
+  const struct dds_stat_keyvalue *rate_max = dds_lookup_statistic (stat, "rexmit_reader_rate_max");
+  const struct dds_stat_keyvalue *queued = dds_lookup_statistic (stat, "rexmit_reader_queued");
+  const struct dds_stat_keyvalue *dropped = dds_lookup_statistic (stat, "rexmit_reader_dropped");
+  CU_ASSERT_FATAL (rexmit_bytes && rate_total && rate_max && queued && dropped);
+  printf ("rexmit %"PRIu64" bytes in %.3fs, rate %"PRIu32" B/s (max %"PRIu32"), queued %"PRIu32" dropped %"PRIu32"\n",
+          rexmit_bytes->u.u64, (double) (t1 - t0) / 1e9, rate_total->u.u32, rate_max->u.u32, queued->u.u32, dropped->u.u32);
+
+  /* the token bucket allows a burst on top of the rate */
+  CU_ASSERT_FATAL (rexmit_bytes->u.u64 > REXMIT_BURST);
+  CU_ASSERT ((double) (t1 - t0) / 1e9 >= (double) (rexmit_bytes->u.u64 - REXMIT_BURST) / REXMIT_RATE);
+  CU_ASSERT (rate_max->u.u32 > 0 && rate_max->u.u32 <= 2 * REXMIT_RATE);
+  CU_ASSERT (rate_total->u.u32 == rate_max->u.u32);
+  CU_ASSERT (queued->u.u32 == 0);
+  dds_delete_statistics (stat);
+
+  dds_delete (dom_sub);
+  dds_delete (dom_pub);
+}
@@ -9,10 +9,22 @@
  *
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
+#include <assert.h>
+#include <string.h>
+
 #include "dds/dds.h"
 #include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/io.h"
 #include "dds/ddsrt/process.h"
+#include "dds/ddsrt/string.h"
 #include "dds/ddsrt/threads.h"
+#include "dds/ddsi/ddsi_entity_index.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds__entity.h"
 #include "test_common.h"
 
 void sync_reader_writer (dds_entity_t participant_rd, dds_entity_t reader, dds_entity_t participant_wr, dds_entity_t writer)
@@ -48,3 +60,65 @@ void sync_reader_writer (dds_entity_t participant_rd, dds_entity_t reader, dds_e
   CU_ASSERT_EQUAL_FATAL (ret, DDS_RETCODE_OK);
   dds_delete (waitset_wr);
 }
+
+static dds_entity_t create_test_domain (dds_domainid_t domainid, const char *extra_config, dds_entity_t *participant)
+{
+  char *conf_raw, *conf;
+  ddsrt_asprintf (&conf_raw, "%s%s%s", TEST_CONFIG_NO_PORT_GAIN, extra_config ? "," : "", extra_config ? extra_config : "");
+  conf = ddsrt_expand_envvars (conf_raw, domainid);
+  const dds_entity_t domain = dds_create_domain (domainid, conf);
+  CU_ASSERT_FATAL (domain > 0);
+  ddsrt_free (conf_raw);
+  dds_free (conf);
+  *participant = dds_create_participant (domainid, NULL, NULL);
+  CU_ASSERT_FATAL (*participant > 0);
+  return domain;
+}
+
+void create_test_domains (struct test_domains *doms, const char *pub_config, const char *sub_config)
+{
+  doms->pub_domain = create_test_domain (TEST_DOMAINID_PUB, pub_config, &doms->pub_participant);
+  doms->sub_domain = create_test_domain (TEST_DOMAINID_SUB, sub_config, &doms->sub_participant);
+}
+
+void delete_test_domains (struct test_domains *doms)
+{
+  dds_delete (doms->sub_domain);
+  dds_delete (doms->pub_domain);
+}
+
+struct writer *pin_ddsi_writer (dds_entity_t writer, struct dds_entity **x)
+{
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (writer, x), 0);
+  thread_state_awake (lookup_thread_state (), &(*x)->m_domain->gv);
+  struct writer * const wr = entidx_lookup_writer_guid ((*x)->m_domain->gv.entity_index, &(*x)->m_guid);
+  CU_ASSERT_FATAL (wr != NULL);
+  assert (wr != NULL); /* for Clang's static analyzer */
+  return wr;
+}
+
+struct proxy_writer *pin_ddsi_proxy_writer (dds_entity_t participant, dds_entity_t writer, struct dds_entity **x)
+{
+  struct dds_entity *wr_entity;
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (writer, &wr_entity), 0);
+  const ddsi_guid_t pwrguid = wr_entity->m_guid;
+  dds_entity_unpin (wr_entity);
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (participant, x), 0);
+  thread_state_awake (lookup_thread_state (), &(*x)->m_domain->gv);
+  struct proxy_writer * const pwr = entidx_lookup_proxy_writer_guid ((*x)->m_domain->gv.entity_index, &pwrguid);
+  CU_ASSERT_FATAL (pwr != NULL);
+  assert (pwr != NULL); /* for Clang's static analyzer */
+  return pwr;
+}
+
+void unpin_ddsi_entity (struct dds_entity *x)
+{
+  thread_state_asleep (lookup_thread_state ());
+  dds_entity_unpin (x);
+}
+
+bool test_benchmarks_enabled (void)
+{
+  const char *value;
+  return ddsrt_getenv ("CYCLONEDDS_TEST_BENCHMARKS", &value) == DDS_RETCODE_OK && value[0] != '\0' && strcmp (value, "0") != 0;
+}
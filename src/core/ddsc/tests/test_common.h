@@ -14,7 +14,9 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
+#include "dds/dds.h"
 #include "CUnit/Test.h"
 #include "CUnit/Theory.h"
 
@@ -23,4 +25,36 @@
 #include "Space.h"
 #include "RoundTrip.h"
 
+struct dds_entity;
+struct writer;
+struct proxy_writer;
+
+/* Two domains in a single process, using the same ports, give network traffic
+   between a writer in one and a reader in the other */
+#define TEST_DOMAINID_PUB 0
+#define TEST_DOMAINID_SUB 1
+#define TEST_CONFIG_NO_PORT_GAIN "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+
+struct test_domains {
+  dds_entity_t pub_domain;
+  dds_entity_t pub_participant;
+  dds_entity_t sub_domain;
+  dds_entity_t sub_participant;
+};
+
+/* Create the publishing and subscribing domains with a participant in each,
+   the extra configuration (if not NULL) is appended to TEST_CONFIG_NO_PORT_GAIN */
+void create_test_domains (struct test_domains *doms, const char *pub_config, const char *sub_config);
+void delete_test_domains (struct test_domains *doms);
+
+/* Look up the DDSI writer of a writer, respectively the proxy writer for it
+   in the domain of participant, with the entity pinned and the thread awake;
+   unpin_ddsi_entity undoes both */
+struct writer *pin_ddsi_writer (dds_entity_t writer, struct dds_entity **x);
+struct proxy_writer *pin_ddsi_proxy_writer (dds_entity_t participant, dds_entity_t writer, struct dds_entity **x);
+void unpin_ddsi_entity (struct dds_entity *x);
+
+/* Throughput measurements are only done when CYCLONEDDS_TEST_BENCHMARKS is set */
+bool test_benchmarks_enabled (void);
+
 #endif /* _TEST_COMMON_H_ */
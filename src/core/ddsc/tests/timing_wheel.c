@@ -0,0 +1,232 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_timing_wheel.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+#define REVOLUTION (DDSI_TWHEEL_RESOLUTION * (int64_t) DDSI_TWHEEL_NSLOTS)
+#define MAX_NODES 2
+
+/* Plays the role of a history cache with a timing wheel: the callback counts
+   how often it is invoked and removes the expired nodes, recording the time */
+struct twtest {
+  ddsrt_mutex_t lock;
+  struct ddsi_twheel tw;
+  struct ddsi_twheel_node nodes[MAX_NODES];
+  ddsrt_mtime_t texp[MAX_NODES];
+  ddsrt_mtime_t tfired[MAX_NODES];
+  uint32_t ncalls;
+  uint32_t nexpired;
+};
+
+static dds_entity_t g_participant = 0;
+static struct dds_entity *g_pp_entity;
+
+static void timing_wheel_init (void)
+{
+  g_participant = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  CU_ASSERT_FATAL (g_participant > 0);
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (g_participant, &g_pp_entity), 0);
+}
+
+static void timing_wheel_fini (void)
+{
+  dds_entity_unpin (g_pp_entity);
+  dds_delete (g_participant);
+}
+
+static ddsrt_mtime_t twtest_expired (void *hc, ddsrt_mtime_t tnow)
+{
+  struct twtest * const t = hc;
+  struct ddsi_twheel_node *node;
+  ddsrt_mtime_t tnext;
+  ddsrt_mutex_lock (&t->lock);
+  t->ncalls++;
+  while ((node = ddsi_twheel_next_expired_locked (&t->tw, tnow, &tnext)) != NULL)
+  {
+    const ptrdiff_t i = node - t->nodes;
+    CU_ASSERT_FATAL (i >= 0 && i < MAX_NODES);
+    ddsi_twheel_remove_locked (&t->tw, node);
+    t->tfired[i] = tnow;
+    t->nexpired++;
+  }
+  ddsrt_mutex_unlock (&t->lock);
+  return tnext;
+}
+
+static void twtest_init (struct twtest *t)
+{
+  ddsrt_mutex_init (&t->lock);
+  ddsi_twheel_init (&g_pp_entity->m_domain->gv, &t->tw, twtest_expired, t);
+  for (int i = 0; i < MAX_NODES; i++)
+    t->tfired[i] = DDSRT_MTIME_NEVER;
+  t->ncalls = 0;
+  t->nexpired = 0;
+}
+
+static void twtest_fini (struct twtest *t)
+{
+  ddsi_twheel_stop (&t->tw);
+  ddsi_twheel_fini (&t->tw);
+  ddsrt_mutex_destroy (&t->lock);
+}
+
+static void twtest_insert (struct twtest *t, int i, ddsrt_mtime_t texp)
+{
+  ddsrt_mutex_lock (&t->lock);
+  t->texp[i] = texp;
+  ddsi_twheel_insert_locked (&t->tw, &t->nodes[i], texp);
+  ddsrt_mutex_unlock (&t->lock);
+}
+
+static void twtest_get (struct twtest *t, uint32_t *ncalls, uint32_t *nexpired)
+{
+  ddsrt_mutex_lock (&t->lock);
+  *ncalls = t->ncalls;
+  *nexpired = t->nexpired;
+  ddsrt_mutex_unlock (&t->lock);
+}
+
+static bool twtest_wait_expired (struct twtest *t, uint32_t nexpired, ddsrt_mtime_t tend)
+{
+  uint32_t nc, ne;
+  twtest_get (t, &nc, &ne);
+  while (ne < nexpired && ddsrt_time_monotonic ().v < tend.v)
+  {
+    dds_sleepfor (DDS_MSECS (1));
+    twtest_get (t, &nc, &ne);
+  }
+  return ne >= nexpired;
+}
+
+static void sleep_until_mtime (ddsrt_mtime_t t)
+{
+  const ddsrt_mtime_t tnow = ddsrt_time_monotonic ();
+  if (tnow.v < t.v)
+    dds_sleepfor (t.v - tnow.v);
+}
+
+static void check_fired (const struct twtest *t, int i)
+{
+  /* never early, and late by at most a tick plus a generous allowance for scheduling */
+  CU_ASSERT_FATAL (t->tfired[i].v >= t->texp[i].v);
+  CU_ASSERT_FATAL (t->tfired[i].v <= t->texp[i].v + DDSI_TWHEEL_RESOLUTION + DDS_MSECS (100));
+}
+
+CU_Test (ddsc_timing_wheel, near, .init = timing_wheel_init, .fini = timing_wheel_fini)
+{
+  struct twtest t;
+  uint32_t ncalls, nexpired;
+  twtest_init (&t);
+  twtest_insert (&t, 0, ddsrt_mtime_add_duration (ddsrt_time_monotonic (), DDS_MSECS (50)));
+  CU_ASSERT_FATAL (twtest_wait_expired (&t, 1, ddsrt_mtime_add_duration (t.texp[0], DDS_SECS (1))));
+  twtest_get (&t, &ncalls, &nexpired);
+  CU_ASSERT_EQUAL_FATAL (ncalls, 1);
+  CU_ASSERT_EQUAL_FATAL (nexpired, 1);
+  check_fired (&t, 0);
+  twtest_fini (&t);
+}
+
+CU_Test (ddsc_timing_wheel, far, .init = timing_wheel_init, .fini = timing_wheel_fini, .timeout = 10)
+{
+  /* The far deadline ends up in the same slot as the near one, two revolutions
+     later: it must neither expire with the near one nor cause any callbacks
+     while the wheel goes round */
+  struct twtest t;
+  uint32_t ncalls, nexpired;
+  twtest_init (&t);
+  const ddsrt_mtime_t tnear = ddsrt_mtime_add_duration (ddsrt_time_monotonic (), DDS_MSECS (100));
+  twtest_insert (&t, 0, tnear);
+  twtest_insert (&t, 1, ddsrt_mtime_add_duration (tnear, 2 * REVOLUTION));
+  CU_ASSERT_FATAL (twtest_wait_expired (&t, 1, ddsrt_mtime_add_duration (tnear, DDS_SECS (1))));
+  check_fired (&t, 0);
+
+  sleep_until_mtime ((ddsrt_mtime_t) { t.texp[1].v - DDS_MSECS (100) });
+  twtest_get (&t, &ncalls, &nexpired);
+  CU_ASSERT_EQUAL_FATAL (ncalls, 1);
+  CU_ASSERT_EQUAL_FATAL (nexpired, 1);
+
+  CU_ASSERT_FATAL (twtest_wait_expired (&t, 2, ddsrt_mtime_add_duration (t.texp[1], DDS_SECS (1))));
+  twtest_get (&t, &ncalls, &nexpired);
+  CU_ASSERT_EQUAL_FATAL (ncalls, 2);
+  CU_ASSERT_EQUAL_FATAL (nexpired, 2);
+  check_fired (&t, 1);
+  twtest_fini (&t);
+}
+
+CU_Test (ddsc_timing_wheel, cancelled, .init = timing_wheel_init, .fini = timing_wheel_fini, .timeout = 10)
+{
+  /* Removing a node doesn't reschedule the callback, so it may still happen
+     once, but it mustn't report anything as expired, nor happen again when
+     the wheel comes round */
+  struct twtest t;
+  uint32_t ncalls, nexpired;
+  twtest_init (&t);
+  const ddsrt_mtime_t tnear = ddsrt_mtime_add_duration (ddsrt_time_monotonic (), DDS_MSECS (100));
+  twtest_insert (&t, 0, tnear);
+  ddsrt_mutex_lock (&t.lock);
+  ddsi_twheel_remove_locked (&t.tw, &t.nodes[0]);
+  ddsrt_mutex_unlock (&t.lock);
+  sleep_until_mtime (ddsrt_mtime_add_duration (tnear, REVOLUTION + DDS_MSECS (100)));
+  twtest_get (&t, &ncalls, &nexpired);
+  CU_ASSERT_FATAL (ncalls <= 1);
+  CU_ASSERT_EQUAL_FATAL (nexpired, 0);
+
+  /* a renewed deadline is a removal followed by an insert */
+  twtest_insert (&t, 0, ddsrt_mtime_add_duration (ddsrt_time_monotonic (), DDS_MSECS (50)));
+  ddsrt_mutex_lock (&t.lock);
+  ddsi_twheel_remove_locked (&t.tw, &t.nodes[0]);
+  ddsi_twheel_insert_locked (&t.tw, &t.nodes[0], ddsrt_mtime_add_duration (t.texp[0], DDS_MSECS (200)));
+  t.texp[0] = ddsrt_mtime_add_duration (t.texp[0], DDS_MSECS (200));
+  ddsrt_mutex_unlock (&t.lock);
+  CU_ASSERT_FATAL (twtest_wait_expired (&t, 1, ddsrt_mtime_add_duration (t.texp[0], DDS_SECS (1))));
+  twtest_get (&t, &ncalls, &nexpired);
+  CU_ASSERT_EQUAL_FATAL (nexpired, 1);
+  check_fired (&t, 0);
+  twtest_fini (&t);
+}
+
+CU_Test (ddsc_timing_wheel, far_cancelled, .init = timing_wheel_init, .fini = timing_wheel_fini, .timeout = 10)
+{
+  /* Deadlines more than a revolution away are kept outside the slots until
+     the wheel gets there: removing one from there and inserting it again
+     closer by must work like it does for one in the slots */
+  struct twtest t;
+  uint32_t ncalls, nexpired;
+  twtest_init (&t);
+  const ddsrt_mtime_t tnear = ddsrt_mtime_add_duration (ddsrt_time_monotonic (), DDS_MSECS (100));
+  twtest_insert (&t, 0, ddsrt_mtime_add_duration (tnear, 3 * REVOLUTION));
+  twtest_insert (&t, 1, ddsrt_mtime_add_duration (tnear, 2 * REVOLUTION));
+  ddsrt_mutex_lock (&t.lock);
+  ddsi_twheel_remove_locked (&t.tw, &t.nodes[0]);
+  ddsi_twheel_insert_locked (&t.tw, &t.nodes[0], tnear);
+  t.texp[0] = tnear;
+  ddsrt_mutex_unlock (&t.lock);
+  CU_ASSERT_FATAL (twtest_wait_expired (&t, 1, ddsrt_mtime_add_duration (tnear, DDS_SECS (1))));
+  check_fired (&t, 0);
+
+  ddsrt_mutex_lock (&t.lock);
+  ddsi_twheel_remove_locked (&t.tw, &t.nodes[1]);
+  ddsrt_mutex_unlock (&t.lock);
+  sleep_until_mtime (ddsrt_mtime_add_duration (tnear, 3 * REVOLUTION + DDS_MSECS (100)));
+  twtest_get (&t, &ncalls, &nexpired);
+  CU_ASSERT_FATAL (ncalls <= 2);
+  CU_ASSERT_EQUAL_FATAL (nexpired, 1);
+  twtest_fini (&t);
+}
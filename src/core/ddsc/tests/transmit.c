@@ -0,0 +1,203 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <limits.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/threads.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_tran.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+#define DDS_CONFIG_XMIT_POOL "<Internal><TransmitSockets>4</TransmitSockets></Internal>"
+
+#define MAX_THREADS 32
+#define SAMPLES_PER_THREAD 1000
+
+CU_Test(ddsc_transmit, socket_pool, .timeout = 10)
+{
+  char *conf = ddsrt_expand_envvars (TEST_CONFIG_NO_PORT_GAIN "," DDS_CONFIG_XMIT_POOL, TEST_DOMAINID_PUB);
+  const dds_entity_t dom = dds_create_domain (TEST_DOMAINID_PUB, conf);
+  CU_ASSERT_FATAL (dom > 0);
+  dds_free (conf);
+  const dds_entity_t pp = dds_create_participant (TEST_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+
+  struct dds_entity *x;
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (pp, &x), 0);
+  struct ddsi_domaingv * const gv = &x->m_domain->gv;
+  CU_ASSERT_FATAL (gv->xmit_conn_pool != NULL);
+  for (int i = 0; i < gv->n_interfaces; i++)
+  {
+    /* all sockets of an interface must be distinct */
+    uint32_t ports[4] = { ddsi_conn_port (gv->xmit_conns[i]) };
+    for (uint32_t k = 1; k < 4; k++)
+    {
+      struct ddsi_tran_conn * const conn = gv->xmit_conn_pool[(uint32_t) i * 3 + k - 1];
+      CU_ASSERT_FATAL (conn != NULL && conn != gv->xmit_conns[i]);
+      ports[k] = ddsi_conn_port (conn);
+      for (uint32_t j = 0; j < k; j++)
+        CU_ASSERT (ports[j] != ports[k]);
+    }
+  }
+  dds_entity_unpin (x);
+  dds_delete (dom);
+}
+
+struct writethread_arg {
+  dds_entity_t wr;
+  int32_t key;
+  ddsrt_atomic_uint32_t *start;
+  dds_return_t ret;
+};
+
+static uint32_t writethread (void *varg)
+{
+  struct writethread_arg * const arg = varg;
+  dds_return_t ret = 0;
+  while (!ddsrt_atomic_ld32 (arg->start))
+    dds_sleepfor (DDS_USECS (100));
+  for (int32_t i = 0; i < SAMPLES_PER_THREAD && ret == 0; i++)
+    ret = dds_write (arg->wr, &(Space_Type1){ arg->key, i, 0 });
+  arg->ret = ret;
+  return 0;
+}
+
+static void do_write_scaling (dds_entity_t pp_pub, dds_entity_t pp_sub, bool async, int nthreads)
+{
+  char topicname[100];
+  create_unique_topic_name ("ddsc_transmit", topicname, sizeof (topicname));
+  const dds_entity_t tp_pub = dds_create_topic (pp_pub, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_pub > 0);
+  const dds_entity_t tp_sub = dds_create_topic (pp_sub, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp_sub > 0);
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  /* a latency budget causes the data to be sent by the sendq thread */
+  if (async)
+    dds_qset_latency_budget (qos, DDS_MSECS (1));
+  const dds_entity_t rd = dds_create_reader (pp_sub, tp_sub, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_entity_t wrs[MAX_THREADS];
+  for (int i = 0; i < nthreads; i++)
+  {
+    wrs[i] = dds_create_writer (pp_pub, tp_pub, qos, NULL);
+    CU_ASSERT_FATAL (wrs[i] > 0);
+    sync_reader_writer (pp_sub, rd, pp_pub, wrs[i]);
+  }
+  dds_delete_qos (qos);
+  dds_subscription_matched_status_t sm;
+  const dds_time_t tmatch = dds_time () + DDS_SECS (10);
+  do {
+    CU_ASSERT_FATAL (dds_get_subscription_matched_status (rd, &sm) == 0);
+    if (sm.current_count < nthreads)
+      dds_sleepfor (DDS_MSECS (10));
+  } while (sm.current_count < nthreads && dds_time () < tmatch);
+  CU_ASSERT_FATAL (sm.current_count == nthreads);
+
+  /* Data arriving before the proxy writer has seen a heartbeat is not
+     delivered to a volatile reader, so first make sure it has */
+  for (int32_t i = 0; i < nthreads; i++)
+  {
+    CU_ASSERT_FATAL (dds_write (wrs[i], &(Space_Type1){ i, -1, 0 }) == 0);
+    dds_write_flush (wrs[i]);
+    CU_ASSERT_FATAL (dds_wait_for_acks (wrs[i], DDS_SECS (5)) == 0);
+  }
+
+  ddsrt_atomic_uint32_t start = DDSRT_ATOMIC_UINT32_INIT (0);
+  struct writethread_arg args[MAX_THREADS];
+  ddsrt_thread_t tids[MAX_THREADS];
+  ddsrt_threadattr_t tattr;
+  ddsrt_threadattr_init (&tattr);
+  for (int i = 0; i < nthreads; i++)
+  {
+    args[i] = (struct writethread_arg) { .wr = wrs[i], .key = i, .start = &start, .ret = 0 };
+    CU_ASSERT_FATAL (ddsrt_thread_create (&tids[i], "writer", &tattr, writethread, &args[i]) == 0);
+  }
+  const dds_time_t tstart = dds_time ();
+  ddsrt_atomic_st32 (&start, 1);
+  for (int i = 0; i < nthreads; i++)
+  {
+    CU_ASSERT_FATAL (ddsrt_thread_join (tids[i], NULL) == 0);
+    CU_ASSERT (args[i].ret == 0);
+  }
+  const dds_time_t tend = dds_time ();
+  if (test_benchmarks_enabled ())
+    printf ("%s, %2d threads: %.0f samples/s\n", async ? "async" : "sync", nthreads,
+            (double) (nthreads * SAMPLES_PER_THREAD) / ((double) (tend - tstart) / 1e9));
+
+  /* Check the data got through, in order per writer (= key) */
+  for (int i = 0; i < nthreads; i++)
+  {
+    dds_write_flush (wrs[i]);
+    CU_ASSERT_FATAL (dds_wait_for_acks (wrs[i], DDS_SECS (10)) == 0);
+  }
+  int32_t next[MAX_THREADS] = { 0 };
+  int32_t n = 0;
+  const dds_time_t tdeliv = dds_time () + DDS_SECS (10);
+  while (n < nthreads * SAMPLES_PER_THREAD && dds_time () < tdeliv)
+  {
+    Space_Type1 sample;
+    void *raw = &sample;
+    dds_sample_info_t si;
+    if (dds_take (rd, &raw, &si, 1, 1) == 1)
+    {
+      CU_ASSERT_FATAL (sample.long_1 >= 0 && sample.long_1 < nthreads);
+      if (sample.long_2 < 0)
+        continue;
+      CU_ASSERT_FATAL (sample.long_2 == next[sample.long_1]);
+      next[sample.long_1]++;
+      n++;
+    }
+    else
+    {
+      dds_sleepfor (DDS_MSECS (1));
+    }
+  }
+  CU_ASSERT_FATAL (n == nthreads * SAMPLES_PER_THREAD);
+
+  for (int i = 0; i < nthreads; i++)
+    dds_delete (wrs[i]);
+  dds_delete (rd);
+  dds_delete (tp_sub);
+  dds_delete (tp_pub);
+}
+
+static void do_write_scaling_series (bool async)
+{
+  struct test_domains doms;
+  create_test_domains (&doms, DDS_CONFIG_XMIT_POOL, NULL);
+
+  /* Ordering is checked at every step, but the contended case is the
+     interesting one, the others only matter for measuring the scaling */
+  const int nthreads_min = test_benchmarks_enabled () ? 1 : MAX_THREADS;
+  for (int nthreads = nthreads_min; nthreads <= MAX_THREADS; nthreads *= 2)
+    do_write_scaling (doms.pub_participant, doms.sub_participant, async, nthreads);
+
+  delete_test_domains (&doms);
+}
+
+CU_Test(ddsc_transmit, write_scaling_sync, .timeout = 120)
+{
+  do_write_scaling_series (false);
+}
+
+CU_Test(ddsc_transmit, write_scaling_async, .timeout = 120)
+{
+  do_write_scaling_series (true);
+}
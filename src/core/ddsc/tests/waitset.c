@@ -19,6 +19,7 @@
 #include "dds/ddsrt/threads.h"
 #include "dds/ddsrt/atomics.h"
 #include "dds/ddsrt/time.h"
+#include "dds/ddsi/ddsi_serdata.h"
 
 #include "test_common.h"
 
@@ -927,3 +928,140 @@ CU_Theory((bool use_nop_listener), ddsc_waitset_triggering, after_listener, .ini
   dds_set_listener (reader, NULL);
   dds_delete_listener (listener);
 }
+
+CU_Test(ddsc_waitset_takecdr, multiple_readers)
+{
+  dds_entity_t pp, ws, tp[3], rd[3], wr[3];
+  struct ddsi_serdata *buf[8];
+  dds_sample_info_t si[8];
+  dds_entity_t rds[8];
+  uint32_t count[3] = { 0, 0, 0 };
+  dds_return_t ret;
+  char name[100];
+
+  pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  ws = dds_create_waitset (pp);
+  CU_ASSERT_FATAL (ws > 0);
+  for (int i = 0; i < 3; i++)
+  {
+    tp[i] = dds_create_topic (pp, &Space_Type1_desc, create_unique_topic_name ("ddsc_waitset_takecdr", name, sizeof name), NULL, NULL);
+    CU_ASSERT_FATAL (tp[i] > 0);
+    rd[i] = dds_create_reader (pp, tp[i], NULL, NULL);
+    CU_ASSERT_FATAL (rd[i] > 0);
+    wr[i] = dds_create_writer (pp, tp[i], NULL, NULL);
+    CU_ASSERT_FATAL (wr[i] > 0);
+    ret = dds_set_status_mask (rd[i], DDS_DATA_AVAILABLE_STATUS);
+    CU_ASSERT_FATAL (ret == 0);
+    ret = dds_waitset_attach (ws, rd[i], i);
+    CU_ASSERT_FATAL (ret == 0);
+  }
+
+  ret = dds_waitset_takecdr (ws, buf, si, rds, 8, DDS_MSECS (10));
+  CU_ASSERT_FATAL (ret == 0);
+
+  /* more data than fits in the buffer: all of it must eventually be taken */
+  for (int i = 0; i < 3; i++)
+  {
+    for (int32_t k = 0; k < 5 * (i + 1); k++)
+    {
+      ret = dds_write (wr[i], &(Space_Type1){ k, i, 0 });
+      CU_ASSERT_FATAL (ret == 0);
+    }
+  }
+  while ((ret = dds_waitset_takecdr (ws, buf, si, rds, 8, DDS_MSECS (10))) > 0)
+  {
+    CU_ASSERT_FATAL (ret <= 8);
+    for (int32_t j = 0; j < ret; j++)
+    {
+      int i;
+      for (i = 0; i < 3 && rds[j] != rd[i]; i++)
+        ;
+      CU_ASSERT_FATAL (i < 3);
+      CU_ASSERT (si[j].valid_data);
+      count[i]++;
+      ddsi_serdata_unref (buf[j]);
+    }
+  }
+  CU_ASSERT_FATAL (ret == 0);
+  for (int i = 0; i < 3; i++)
+    CU_ASSERT (count[i] == 5 * (uint32_t) (i + 1));
+
+  ret = dds_waitset_takecdr (ws, buf, si, rds, 0, DDS_MSECS (10));
+  CU_ASSERT (ret == DDS_RETCODE_BAD_PARAMETER);
+  ret = dds_waitset_takecdr (rd[0], buf, si, rds, 8, DDS_MSECS (10));
+  CU_ASSERT (ret == DDS_RETCODE_ILLEGAL_OPERATION);
+  dds_delete (pp);
+}
+
+struct takecdr_arg {
+  dds_entity_t ws;
+  ddsrt_atomic_uint32_t stop;
+  ddsrt_atomic_uint32_t ntaken;
+};
+
+static uint32_t takecdr_thread (void *varg)
+{
+  struct takecdr_arg * const arg = varg;
+  struct ddsi_serdata *buf[8];
+  dds_sample_info_t si[8];
+  dds_entity_t rds[8];
+  while (!ddsrt_atomic_ld32 (&arg->stop))
+  {
+    const dds_return_t ret = dds_waitset_takecdr (arg->ws, buf, si, rds, 8, DDS_MSECS (1));
+    CU_ASSERT_FATAL (ret >= 0);
+    for (int32_t j = 0; j < ret; j++)
+      ddsi_serdata_unref (buf[j]);
+    ddsrt_atomic_add32 (&arg->ntaken, (uint32_t) ret);
+  }
+  return 0;
+}
+
+CU_Test(ddsc_waitset_takecdr, concurrent_delete)
+{
+  /* Readers being deleted while attached to the waitset must be skipped */
+  dds_entity_t pp, tp, wr;
+  struct takecdr_arg arg;
+  ddsrt_threadattr_t attr;
+  ddsrt_thread_t tid;
+  dds_return_t ret;
+  char name[100];
+
+  pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  arg.ws = dds_create_waitset (pp);
+  CU_ASSERT_FATAL (arg.ws > 0);
+  ddsrt_atomic_st32 (&arg.stop, 0);
+  ddsrt_atomic_st32 (&arg.ntaken, 0);
+  tp = dds_create_topic (pp, &Space_Type1_desc, create_unique_topic_name ("ddsc_waitset_takecdr", name, sizeof name), NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  wr = dds_create_writer (pp, tp, NULL, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+
+  ddsrt_threadattr_init (&attr);
+  ret = ddsrt_thread_create (&tid, "takecdr", &attr, takecdr_thread, &arg);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  for (int32_t i = 0; i < 200; i++)
+  {
+    const dds_entity_t rd = dds_create_reader (pp, tp, NULL, NULL);
+    CU_ASSERT_FATAL (rd > 0);
+    ret = dds_set_status_mask (rd, DDS_DATA_AVAILABLE_STATUS);
+    CU_ASSERT_FATAL (ret == 0);
+    ret = dds_waitset_attach (arg.ws, rd, rd);
+    CU_ASSERT_FATAL (ret == 0);
+    for (int32_t k = 0; k < 10; k++)
+    {
+      ret = dds_write (wr, &(Space_Type1){ k, i, 0 });
+      CU_ASSERT_FATAL (ret == 0);
+    }
+    /* vary the moment of deleting so that it sometimes happens while taking */
+    dds_sleepfor (DDS_USECS (50 * (i % 10)));
+    ret = dds_delete (rd);
+    CU_ASSERT_FATAL (ret == 0);
+  }
+  ddsrt_atomic_st32 (&arg.stop, 1);
+  ret = ddsrt_thread_join (tid, NULL);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  CU_ASSERT (ddsrt_atomic_ld32 (&arg.ntaken) > 0);
+  dds_delete (pp);
+}
@@ -19,7 +19,12 @@
 #include "dds/ddsi/ddsi_entity_index.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_whc.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_tkmap.h"
 #include "dds__entity.h"
+#include "dds__topic.h"
+#include "dds__whc.h"
+#include "dds__whc_ring.h"
 
 #include "test_common.h"
 
@@ -113,6 +118,15 @@ static void get_writer_whc_state (dds_entity_t writer, struct whc_state *whcst)
   dds_entity_unpin(wr_entity);
 }
 
+static bool writer_whc_is_ring (dds_entity_t writer)
+{
+  struct dds_entity *x;
+  const struct writer *wr = pin_ddsi_writer (writer, &x);
+  const bool is_ring = whc_is_ring (wr->whc);
+  unpin_ddsi_entity (x);
+  return is_ring;
+}
+
 static void check_intermediate_whc_state(dds_entity_t writer, seqno_t exp_min, seqno_t exp_max)
 {
   struct whc_state whcst;
@@ -297,3 +311,534 @@ CU_Test(ddsc_whc, check_end_state, .init=whc_init, .fini=whc_fini, .timeout=30)
 #undef BE
 #undef KA
 #undef KL
+
+#define RING_SAMPLE_COUNT 1000
+CU_Test(ddsc_whc, keyless_keep_all, .init=whc_init, .fini=whc_fini, .timeout=30)
+{
+  /* volatile KEEP_ALL writers of keyless topics use a ring instead of the default
+     WHC; write enough data to force it to grow while the remote reader acks */
+  char name[100];
+  dds_entity_t topic, remote_topic, writer, reader_remote;
+  dds_return_t ret;
+
+  dds_qset_durability (g_qos, DDS_DURABILITY_VOLATILE);
+  dds_qset_reliability (g_qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (g_qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_qset_deadline (g_qos, DDS_INFINITY);
+
+  create_unique_topic_name ("ddsc_whc_keyless_keep_all", name, sizeof name);
+  topic = dds_create_topic (g_participant, &Space_Type3_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (topic > 0);
+  remote_topic = dds_create_topic (g_remote_participant, &Space_Type3_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (remote_topic > 0);
+  writer = dds_create_writer (g_publisher, topic, g_qos, NULL);
+  CU_ASSERT_FATAL (writer > 0);
+  CU_ASSERT_FATAL (writer_whc_is_ring (writer));
+  ret = dds_set_status_mask (writer, DDS_PUBLICATION_MATCHED_STATUS);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  reader_remote = create_and_sync_reader (g_remote_subscriber, remote_topic, g_qos, writer);
+
+  for (int32_t s = 0; s < RING_SAMPLE_COUNT; s++)
+  {
+    ret = dds_write (writer, &(Space_Type3){ s, 0, 0 });
+    CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+    if (s % 100 == 99)
+      check_intermediate_whc_state (writer, 1, s + 1);
+  }
+  ret = dds_wait_for_acks (writer, DDS_SECS (10));
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  check_whc_state (writer, -1, -1);
+
+  /* everything must have arrived, in order */
+  int32_t next = 0;
+  while (next < RING_SAMPLE_COUNT)
+  {
+    Space_Type3 sample;
+    void *ptr = &sample;
+    dds_sample_info_t si;
+    ret = dds_take (reader_remote, &ptr, &si, 1, 1);
+    CU_ASSERT_FATAL (ret == 1);
+    CU_ASSERT_FATAL (si.valid_data);
+    CU_ASSERT_EQUAL_FATAL (sample.long_1, next);
+    next++;
+  }
+
+  dds_delete (writer);
+  dds_delete (remote_topic);
+  dds_delete (topic);
+}
+#undef RING_SAMPLE_COUNT
+
+CU_Test(ddsc_whc, ring_selection, .init=whc_init, .fini=whc_fini)
+{
+  /* anything that requires dropping samples other than in sequence number
+     order or looking them up by key needs the default WHC */
+  static const struct {
+    const dds_topic_descriptor_t *desc;
+    dds_durability_kind_t d;
+    dds_history_kind_t h;
+    dds_duration_t deadline;
+    bool ring;
+  } cases[] = {
+    { &Space_Type3_desc, DDS_DURABILITY_VOLATILE, DDS_HISTORY_KEEP_ALL, DDS_INFINITY, true },
+    { &Space_Type1_desc, DDS_DURABILITY_VOLATILE, DDS_HISTORY_KEEP_ALL, DDS_INFINITY, false },
+    { &Space_Type3_desc, DDS_DURABILITY_VOLATILE, DDS_HISTORY_KEEP_LAST, DDS_INFINITY, false },
+    { &Space_Type3_desc, DDS_DURABILITY_TRANSIENT_LOCAL, DDS_HISTORY_KEEP_ALL, DDS_INFINITY, false },
+#ifdef DDS_HAS_DEADLINE_MISSED
+    { &Space_Type3_desc, DDS_DURABILITY_VOLATILE, DDS_HISTORY_KEEP_ALL, DDS_SECS (1), false },
+#endif
+  };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+  {
+    char name[100];
+    create_unique_topic_name ("ddsc_whc_ring_selection", name, sizeof name);
+    dds_entity_t topic = dds_create_topic (g_participant, cases[i].desc, name, NULL, NULL);
+    CU_ASSERT_FATAL (topic > 0);
+    dds_qset_durability (g_qos, cases[i].d);
+    dds_qset_reliability (g_qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+    dds_qset_history (g_qos, cases[i].h, 1);
+    dds_qset_deadline (g_qos, cases[i].deadline);
+    dds_entity_t writer = dds_create_writer (g_publisher, topic, g_qos, NULL);
+    CU_ASSERT_FATAL (writer > 0);
+    CU_ASSERT_EQUAL_FATAL (writer_whc_is_ring (writer), cases[i].ring);
+    dds_delete (writer);
+    dds_delete (topic);
+  }
+}
+
+static void set_writer_ignore_acknack (dds_entity_t writer, bool ignore)
+{
+  struct dds_entity *x;
+  struct writer *wr = pin_ddsi_writer (writer, &x);
+  ddsrt_mutex_lock (&wr->e.lock);
+  wr->test_ignore_acknack = ignore;
+  ddsrt_mutex_unlock (&wr->e.lock);
+  unpin_ddsi_entity (x);
+}
+
+/* ACKs are ignored while writing, so this must stay below the initial WHC high-water mark */
+#define ACK_JUMP_SAMPLE_COUNT 200
+#define ACK_JUMP_BENCH_COUNT 100000
+CU_Test(ddsc_whc, ack_jump, .init=whc_init, .fini=whc_fini, .timeout=30)
+{
+  /* Large jumps in the acknowledged sequence number hand freeing the dropped samples to
+     the GC.  The first round checks that the samples do get released, the second deletes the writer immediately after it has been acked
+     to check that freeing them completes before the WHC itself is freed */
+  char name[100];
+  dds_entity_t topic, remote_topic, writer, reader_remote;
+  dds_return_t ret;
+
+  dds_qset_durability (g_qos, DDS_DURABILITY_VOLATILE);
+  dds_qset_reliability (g_qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (g_qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_qset_deadline (g_qos, DDS_INFINITY);
+  dds_qset_durability_service (g_qos, 0, DDS_HISTORY_KEEP_LAST, 1, DDS_LENGTH_UNLIMITED, DDS_LENGTH_UNLIMITED, DDS_LENGTH_UNLIMITED);
+
+  create_unique_topic_name ("ddsc_whc_ack_jump", name, sizeof name);
+  topic = dds_create_topic (g_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (topic > 0);
+  remote_topic = dds_create_topic (g_remote_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (remote_topic > 0);
+  writer = dds_create_writer (g_publisher, topic, g_qos, NULL);
+  CU_ASSERT_FATAL (writer > 0);
+  ret = dds_set_status_mask (writer, DDS_PUBLICATION_MATCHED_STATUS);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  reader_remote = create_and_sync_reader (g_remote_subscriber, remote_topic, g_qos, writer);
+  (void) reader_remote;
+
+  /* Writing serdata of which we hold a reference shows when the WHC has released them,
+     i.e., when the deferred free list has actually been freed */
+  struct dds_entity *tp_entity;
+  CU_ASSERT_EQUAL_FATAL (dds_entity_pin (topic, &tp_entity), 0);
+  struct ddsi_domaingv * const gv = &tp_entity->m_domain->gv;
+  const struct ddsi_sertype *type = ((struct dds_topic *) tp_entity)->m_stype;
+  struct ddsi_serdata *sds[ACK_JUMP_SAMPLE_COUNT];
+  set_writer_ignore_acknack (writer, true);
+  for (int32_t s = 0; s < ACK_JUMP_SAMPLE_COUNT; s++)
+  {
+    struct ddsi_serdata *sd = ddsi_serdata_from_sample (type, SDK_DATA, &(Space_Type1){ s % 10, s, 0 });
+    sds[s] = ddsi_serdata_ref (sd);
+    ret = dds_writecdr (writer, sd);
+    CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  }
+  check_intermediate_whc_state (writer, 1, ACK_JUMP_SAMPLE_COUNT);
+  for (int32_t s = 0; s < ACK_JUMP_SAMPLE_COUNT; s++)
+    CU_ASSERT_FATAL (ddsrt_atomic_ld32 (&sds[s]->refc) > 1);
+
+  /* The next ACKNACK acknowledges all samples in one go, and that is well above the
+     threshold for freeing them on the GC thread */
+  const dds_time_t tack = dds_time ();
+  set_writer_ignore_acknack (writer, false);
+  int32_t nreleased = 0;
+  while (nreleased < ACK_JUMP_SAMPLE_COUNT && dds_time () < tack + DDS_SECS (10))
+  {
+    if (ddsrt_atomic_ld32 (&sds[nreleased]->refc) == 1)
+      nreleased++;
+    else
+      dds_sleepfor (DDS_USECS (100));
+  }
+  CU_ASSERT_EQUAL_FATAL (nreleased, ACK_JUMP_SAMPLE_COUNT);
+  ret = dds_wait_for_acks (writer, DDS_SECS (10));
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  check_whc_state (writer, -1, -1);
+  for (int32_t s = 0; s < ACK_JUMP_SAMPLE_COUNT; s++)
+    ddsi_serdata_unref (sds[s]);
+
+  set_writer_ignore_acknack (writer, true);
+  for (int32_t s = 0; s < ACK_JUMP_SAMPLE_COUNT; s++)
+  {
+    ret = dds_write (writer, &(Space_Type1){ s % 10, s, 0 });
+    CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  }
+  check_intermediate_whc_state (writer, ACK_JUMP_SAMPLE_COUNT + 1, 2 * ACK_JUMP_SAMPLE_COUNT);
+  set_writer_ignore_acknack (writer, false);
+  ret = dds_wait_for_acks (writer, DDS_SECS (10));
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  check_whc_state (writer, -1, -1);
+  dds_delete (writer);
+
+  /* Not a pass/fail criterion, but for comparing the time spent on dropping acked samples
+     from the WHC, which remains on the thread handling the ACKNACK, and freeing them, which
+     is now done on the GC thread */
+  if (test_benchmarks_enabled ())
+  {
+    struct whc_writer_info *wrinfo = whc_make_wrinfo (NULL, g_qos);
+    struct whc *whc = whc_new (gv, wrinfo);
+    struct whc_node *deferred_free_list;
+    struct whc_state whcst;
+    thread_state_awake (lookup_thread_state (), gv);
+    for (int32_t s = 0; s < ACK_JUMP_BENCH_COUNT; s++)
+    {
+      struct ddsi_serdata *sd = ddsi_serdata_from_sample (type, SDK_DATA, &(Space_Type1){ s % 10, s, 0 });
+      struct ddsi_tkmap_instance *tk = ddsi_tkmap_lookup_instance_ref (gv->m_tkmap, sd);
+      CU_ASSERT_FATAL (whc_insert (whc, 0, s + 1, DDSRT_MTIME_NEVER, NULL, sd, tk) == 0);
+      ddsi_tkmap_instance_unref (gv->m_tkmap, tk);
+      ddsi_serdata_unref (sd);
+    }
+    const dds_time_t t0 = dds_time ();
+    uint32_t n = whc_remove_acked_messages (whc, ACK_JUMP_BENCH_COUNT, &whcst, &deferred_free_list);
+    const dds_time_t t1 = dds_time ();
+    whc_free_deferred_free_list (whc, deferred_free_list);
+    const dds_time_t t2 = dds_time ();
+    thread_state_asleep (lookup_thread_state ());
+    CU_ASSERT_EQUAL_FATAL (n, ACK_JUMP_BENCH_COUNT);
+    printf ("ack jump of %d samples: remove %.3fms, free %.3fms\n", ACK_JUMP_BENCH_COUNT,
+            (double) (t1 - t0) / 1e6, (double) (t2 - t1) / 1e6);
+    whc_free (whc);
+    whc_free_wrinfo (wrinfo);
+  }
+  dds_entity_unpin (tp_entity);
+
+  dds_delete (remote_topic);
+  dds_delete (topic);
+}
+#undef ACK_JUMP_BENCH_COUNT
+#undef ACK_JUMP_SAMPLE_COUNT
+
+static uint32_t get_writer_whc_high (dds_entity_t writer)
+{
+  struct dds_entity *x;
+  struct writer *wr = pin_ddsi_writer (writer, &x);
+  ddsrt_mutex_lock (&wr->e.lock);
+  const uint32_t whc_high = wr->whc_high;
+  ddsrt_mutex_unlock (&wr->e.lock);
+  unpin_ddsi_entity (x);
+  return whc_high;
+}
+
+/* Well above the initial WHC high-water mark */
+#define BATCH_THROTTLE_SAMPLE_COUNT 10000
+CU_Test(ddsc_whc, batch_throttle, .init=whc_init, .fini=whc_fini, .timeout=30)
+{
+  /* A batch that doesn't fit in the WHC must be throttled like a sequence of
+     writes, rather than pushing the WHC past the high-water mark in one go */
+  char name[100];
+  static Space_Type1 samples[BATCH_THROTTLE_SAMPLE_COUNT];
+  static const void *psamples[BATCH_THROTTLE_SAMPLE_COUNT];
+  struct whc_state whcst;
+  dds_return_t ret;
+
+  dds_qset_durability (g_qos, DDS_DURABILITY_VOLATILE);
+  dds_qset_reliability (g_qos, DDS_RELIABILITY_RELIABLE, DDS_MSECS (100));
+  dds_qset_history (g_qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_qset_deadline (g_qos, DDS_INFINITY);
+  create_unique_topic_name ("ddsc_whc_batch_throttle", name, sizeof name);
+  dds_entity_t topic = dds_create_topic (g_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (topic > 0);
+  dds_entity_t remote_topic = dds_create_topic (g_remote_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (remote_topic > 0);
+  dds_entity_t writer = dds_create_writer (g_publisher, topic, g_qos, NULL);
+  CU_ASSERT_FATAL (writer > 0);
+  ret = dds_set_status_mask (writer, DDS_PUBLICATION_MATCHED_STATUS);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  dds_entity_t reader_remote = create_and_sync_reader (g_remote_subscriber, remote_topic, g_qos, writer);
+  (void) reader_remote;
+
+  for (int32_t s = 0; s < BATCH_THROTTLE_SAMPLE_COUNT; s++)
+  {
+    samples[s] = (Space_Type1){ s % 10, s, 0 };
+    psamples[s] = &samples[s];
+  }
+  set_writer_ignore_acknack (writer, true);
+  ret = dds_write_batch (writer, psamples, NULL, BATCH_THROTTLE_SAMPLE_COUNT);
+  CU_ASSERT_EQUAL_FATAL (ret, DDS_RETCODE_TIMEOUT);
+  get_writer_whc_state (writer, &whcst);
+  /* the sample that went over the limit is still in there */
+  CU_ASSERT_FATAL (whcst.unacked_bytes < get_writer_whc_high (writer) + 100);
+  CU_ASSERT_FATAL (whcst.max_seq < BATCH_THROTTLE_SAMPLE_COUNT);
+
+  set_writer_ignore_acknack (writer, false);
+  ret = dds_wait_for_acks (writer, DDS_SECS (10));
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  dds_delete (writer);
+  dds_delete (remote_topic);
+  dds_delete (topic);
+}
+#undef BATCH_THROTTLE_SAMPLE_COUNT
+
+#define NONBLOCKING_MAX_SAMPLE_COUNT 1000000
+CU_Test(ddsc_whc, nonblocking_write, .init=whc_init, .fini=whc_fini, .timeout=30)
+{
+  /* With ACKs ignored the WHC fills up and a non-blocking write must then fail immediately;
+     once ACKs are processed again the writer must signal it is ready and writing succeeds */
+  char name[100];
+  dds_entity_t topic, remote_topic, writer, reader_remote, waitset;
+  dds_return_t ret;
+  uint32_t status;
+
+  dds_qset_durability (g_qos, DDS_DURABILITY_VOLATILE);
+  dds_qset_reliability (g_qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (g_qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_qset_deadline (g_qos, DDS_INFINITY);
+
+  create_unique_topic_name ("ddsc_whc_nonblocking_write", name, sizeof name);
+  topic = dds_create_topic (g_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (topic > 0);
+  remote_topic = dds_create_topic (g_remote_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (remote_topic > 0);
+  writer = dds_create_writer (g_publisher, topic, g_qos, NULL);
+  CU_ASSERT_FATAL (writer > 0);
+  ret = dds_set_status_mask (writer, DDS_PUBLICATION_MATCHED_STATUS);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  reader_remote = create_and_sync_reader (g_remote_subscriber, remote_topic, g_qos, writer);
+  (void) reader_remote;
+
+  set_writer_ignore_acknack (writer, true);
+  int32_t s = 0;
+  do {
+    ret = dds_write_nonblocking (writer, &(Space_Type1){ s % 10, s, 0 });
+  } while (ret == DDS_RETCODE_OK && ++s < NONBLOCKING_MAX_SAMPLE_COUNT);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_TRY_AGAIN);
+  ret = dds_read_status (writer, &status, DDS_WRITER_READY_STATUS);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  CU_ASSERT_FATAL (status == 0);
+
+  waitset = dds_create_waitset (g_participant);
+  CU_ASSERT_FATAL (waitset > 0);
+  ret = dds_set_status_mask (writer, DDS_WRITER_READY_STATUS);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  ret = dds_waitset_attach (waitset, writer, writer);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  ret = dds_waitset_wait (waitset, NULL, 0, DDS_MSECS (100));
+  CU_ASSERT_FATAL (ret == 0);
+
+  set_writer_ignore_acknack (writer, false);
+  ret = dds_waitset_wait (waitset, NULL, 0, DDS_SECS (10));
+  CU_ASSERT_FATAL (ret == 1);
+  ret = dds_take_status (writer, &status, DDS_WRITER_READY_STATUS);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  CU_ASSERT_FATAL (status == DDS_WRITER_READY_STATUS);
+  ret = dds_write_nonblocking (writer, &(Space_Type1){ s % 10, s, 0 });
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+
+  dds_delete (waitset);
+  dds_delete (writer);
+  dds_delete (remote_topic);
+  dds_delete (topic);
+}
+#undef NONBLOCKING_MAX_SAMPLE_COUNT
+
+#ifdef DDS_HAS_DURABLE_WHC
+static dds_entity_t create_durable_writer (dds_entity_t topic, dds_durability_kind_t d, dds_history_kind_t dh, int32_t dhd, const char *store, const char *sync_interval)
+{
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_durability (qos, d);
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_qset_durability_service (qos, 0, dh, dhd, DDS_LENGTH_UNLIMITED, DDS_LENGTH_UNLIMITED, DDS_LENGTH_UNLIMITED);
+  if (store)
+    dds_qset_prop (qos, DDS_WRITER_PROP_DURABLE_STORE, store);
+  if (sync_interval)
+    dds_qset_prop (qos, DDS_WRITER_PROP_DURABLE_STORE_SYNC_INTERVAL, sync_interval);
+  dds_entity_t writer = dds_create_writer (g_publisher, topic, qos, NULL);
+  CU_ASSERT_FATAL (writer > 0);
+  dds_delete_qos (qos);
+  return writer;
+}
+
+static void check_durable_history (dds_entity_t subscriber, dds_entity_t topic, dds_entity_t writer, dds_durability_kind_t d, int32_t ninst, int32_t first, int32_t last)
+{
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_durability (qos, d);
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  dds_return_t ret = dds_set_status_mask (writer, DDS_PUBLICATION_MATCHED_STATUS);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  dds_entity_t reader = create_and_sync_reader (subscriber, topic, qos, writer);
+  dds_delete_qos (qos);
+
+  /* expect samples first .. last for each instance, in order */
+  const int32_t exp_n = ninst * (last - first + 1);
+  int32_t n = 0, next[10];
+  CU_ASSERT_FATAL (ninst <= 10);
+  for (int32_t i = 0; i < ninst; i++)
+    next[i] = first;
+  dds_time_t tend = dds_time () + DDS_SECS (10);
+  while (n < exp_n && dds_time () < tend)
+  {
+    Space_Type1 sample;
+    void *ptr = &sample;
+    dds_sample_info_t si;
+    if ((ret = dds_take (reader, &ptr, &si, 1, 1)) == 0)
+    {
+      dds_sleepfor (DDS_MSECS (10));
+      continue;
+    }
+    CU_ASSERT_FATAL (ret == 1 && si.valid_data);
+    CU_ASSERT_FATAL (sample.long_1 >= 0 && sample.long_1 < ninst);
+    CU_ASSERT_EQUAL_FATAL (sample.long_2, next[sample.long_1]);
+    next[sample.long_1]++;
+    n++;
+  }
+  CU_ASSERT_EQUAL_FATAL (n, exp_n);
+  ret = dds_delete (reader);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  while (1)
+  {
+    dds_publication_matched_status_t st;
+    ret = dds_get_publication_matched_status (writer, &st);
+    CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+    if (st.current_count == 0)
+      break;
+    dds_sleepfor (DDS_MSECS (1));
+  }
+}
+
+CU_Test(ddsc_whc, durable_store, .init=whc_init, .fini=whc_fini, .timeout=30)
+{
+  char name[100], store[100];
+  dds_entity_t topic, remote_topic, writer;
+  dds_return_t ret;
+
+  create_unique_topic_name ("ddsc_whc_durable_store", name, sizeof name);
+  (void) snprintf (store, sizeof (store), "%s.whc", name);
+  topic = dds_create_topic (g_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (topic > 0);
+  remote_topic = dds_create_topic (g_remote_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (remote_topic > 0);
+
+  /* write 3 instances x 5 samples, keeping 2 per instance */
+  writer = create_durable_writer (topic, DDS_DURABILITY_PERSISTENT, DDS_HISTORY_KEEP_LAST, 2, store, "0");
+  for (int32_t s = 0; s < 5; s++)
+    for (int32_t i = 0; i < 3; i++)
+    {
+      ret = dds_write (writer, &(Space_Type1){ i, s, 0 });
+      CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+    }
+  check_durable_history (g_subscriber, topic, writer, DDS_DURABILITY_TRANSIENT, 3, 3, 4);
+  ret = dds_delete (writer);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+
+  /* a new writer takes over the history and serves it to late joiners, both
+     local and remote, and continues after it */
+  writer = create_durable_writer (topic, DDS_DURABILITY_PERSISTENT, DDS_HISTORY_KEEP_LAST, 2, store, NULL);
+  check_durable_history (g_subscriber, topic, writer, DDS_DURABILITY_TRANSIENT, 3, 3, 4);
+  check_durable_history (g_remote_subscriber, remote_topic, writer, DDS_DURABILITY_TRANSIENT_LOCAL, 3, 3, 4);
+  for (int32_t i = 0; i < 3; i++)
+  {
+    ret = dds_write (writer, &(Space_Type1){ i, 5, 0 });
+    CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  }
+  check_durable_history (g_remote_subscriber, remote_topic, writer, DDS_DURABILITY_TRANSIENT, 3, 4, 5);
+  ret = dds_delete (writer);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+
+  writer = create_durable_writer (topic, DDS_DURABILITY_PERSISTENT, DDS_HISTORY_KEEP_LAST, 2, store, NULL);
+  check_durable_history (g_subscriber, topic, writer, DDS_DURABILITY_TRANSIENT, 3, 4, 5);
+  dds_delete (writer);
+  dds_delete (remote_topic);
+  dds_delete (topic);
+  (void) remove (store);
+}
+
+CU_Test(ddsc_whc, durable_store_in_use, .init=whc_init, .fini=whc_fini, .timeout=30)
+{
+  /* a store has a single owner: a second writer configured with the same one
+     keeps its history in memory and doesn't touch what's in the file */
+  char name[100], store[100];
+  dds_entity_t topic, writer, writer2;
+  dds_return_t ret;
+
+  create_unique_topic_name ("ddsc_whc_durable_store_in_use", name, sizeof name);
+  (void) snprintf (store, sizeof (store), "%s.whc", name);
+  topic = dds_create_topic (g_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (topic > 0);
+
+  writer = create_durable_writer (topic, DDS_DURABILITY_PERSISTENT, DDS_HISTORY_KEEP_LAST, 1, store, "0");
+  writer2 = create_durable_writer (topic, DDS_DURABILITY_PERSISTENT, DDS_HISTORY_KEEP_LAST, 1, store, "0");
+  for (int32_t i = 0; i < 2; i++)
+  {
+    ret = dds_write (writer, &(Space_Type1){ i, 1, 0 });
+    CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+    ret = dds_write (writer2, &(Space_Type1){ i, 2, 0 });
+    CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  }
+  ret = dds_delete (writer2);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+  ret = dds_delete (writer);
+  CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+
+  /* only the history of the owner was stored, and the store is free again */
+  writer = create_durable_writer (topic, DDS_DURABILITY_PERSISTENT, DDS_HISTORY_KEEP_LAST, 1, store, NULL);
+  check_durable_history (g_subscriber, topic, writer, DDS_DURABILITY_TRANSIENT, 2, 1, 1);
+  dds_delete (writer);
+  dds_delete (topic);
+  (void) remove (store);
+}
+
+#define REPLAY_SAMPLE_COUNT 20000
+CU_Test(ddsc_whc, durable_replay_throughput, .init=whc_init, .fini=whc_fini, .timeout=60)
+{
+  /* not a pass/fail criterion, but for comparing the time it takes to deliver
+     the history to a late-joining reader with the in-memory history */
+  if (!test_benchmarks_enabled ())
+  {
+    CU_PASS ("benchmarks not enabled");
+    return;
+  }
+  char name[100], store[100];
+  create_unique_topic_name ("ddsc_whc_durable_replay", name, sizeof name);
+  (void) snprintf (store, sizeof (store), "%s.whc", name);
+  dds_entity_t topic = dds_create_topic (g_participant, &Space_Type1_desc, name, NULL, NULL);
+  CU_ASSERT_FATAL (topic > 0);
+  for (int k = 0; k < 2; k++)
+  {
+    const dds_durability_kind_t d = k ? DDS_DURABILITY_TRANSIENT : DDS_DURABILITY_TRANSIENT_LOCAL;
+    dds_entity_t writer = create_durable_writer (topic, d, DDS_HISTORY_KEEP_ALL, 0, k ? store : NULL, NULL);
+    for (int32_t s = 0; s < REPLAY_SAMPLE_COUNT; s++)
+    {
+      dds_return_t ret = dds_write (writer, &(Space_Type1){ 0, s, 0 });
+      CU_ASSERT_FATAL (ret == DDS_RETCODE_OK);
+    }
+    const dds_time_t t0 = dds_time ();
+    check_durable_history (g_subscriber, topic, writer, d, 1, 0, REPLAY_SAMPLE_COUNT - 1);
+    const dds_time_t t1 = dds_time ();
+    printf ("replay %s: %d samples in %.3fs (%.0f samples/s)\n", k ? "file" : "memory", REPLAY_SAMPLE_COUNT,
+            (double) (t1 - t0) / 1e9, REPLAY_SAMPLE_COUNT / ((double) (t1 - t0) / 1e9));
+    dds_delete (writer);
+  }
+  dds_delete (topic);
+  (void) remove (store);
+}
+#undef REPLAY_SAMPLE_COUNT
+#endif
@@ -126,6 +126,52 @@ CU_Test(ddsc_write_ts, bad_timestamp, .init = setup, .fini = teardown)
     CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
 }
 
+CU_Test(ddsc_write_batch, basic, .init = setup, .fini = teardown)
+{
+    dds_return_t status;
+    const void *samples[3] = { &data, &data, &data };
+    const dds_time_t timestamps[3] = { DDS_SECS(1), DDS_SECS(2), DDS_SECS(3) };
+    dds_entity_t reader;
+    dds_qos_t *qos;
+
+    qos = dds_create_qos();
+    dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+    reader = dds_create_reader(participant, topic, qos, NULL);
+    CU_ASSERT_FATAL(reader > 0);
+    dds_delete_qos(qos);
+
+    status = dds_write_batch(writer, samples, NULL, 3);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    status = dds_write_batch(writer, samples, timestamps, 3);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    status = dds_write_batch(writer, samples, NULL, 0);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+
+    void *rs[6] = { NULL };
+    dds_sample_info_t si[6];
+    status = dds_take(reader, rs, si, 6, 6);
+    CU_ASSERT_EQUAL_FATAL(status, 6);
+    for (int i = 3; i < 6; i++)
+        CU_ASSERT_EQUAL(si[i].source_timestamp, timestamps[i - 3]);
+    dds_return_loan(reader, rs, status);
+}
+
+CU_Test(ddsc_write_batch, bad_param, .init = setup, .fini = teardown)
+{
+    dds_return_t status;
+    const void *samples[2] = { &data, NULL };
+    const dds_time_t timestamps[2] = { -1, 0 };
+
+    status = dds_write_batch(writer, samples, NULL, 2);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+    status = dds_write_batch(writer, samples, timestamps, 1);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+    status = dds_write_batch(writer, NULL, NULL, 1);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+    status = dds_write_batch(0, samples, NULL, 1);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+}
+
 CU_Test(ddsc_write, simpletypes)
 {
     dds_return_t status;
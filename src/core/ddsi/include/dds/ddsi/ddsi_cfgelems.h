@@ -975,6 +975,18 @@ static struct cfgelem heartbeat_interval_attrs[] = {
     DESCRIPTION(
       "<p>This attribute sets the maximum interval for periodic heartbeats.</p>"),
     UNIT("duration_inf")),
+  BOOL("adaptive", NULL, 1, "false",
+    MEMBER(hb_intv_adaptive),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This attribute enables adapting the heartbeat timing to the "
+      "latency with which the matched readers respond to heartbeats, as "
+      "measured by the writer. With an estimate available, the base "
+      "interval becomes twice the latency of the slowest reader (bounded "
+      "by minsched and the configured interval), no new acknowledgement is "
+      "requested while one is still expected to be in flight, and "
+      "heartbeats piggybacked on data are spaced by a quarter of that "
+      "latency.</p>")),
   END_MARKER
 };
 
@@ -1022,6 +1034,19 @@ static struct cfgelem internal_cfgelems[] = {
       "expressed in samples. Once a delivery queue is full, incoming samples "
       "destined for that queue are dropped until space becomes available "
       "again.</p>")),
+  INT("DeliveryQueueWorkers", NULL, 1, "0",
+    MEMBER(delivery_queue_workers),
+    FUNCTIONS(0, uf_uint, 0, pf_uint),
+    DESCRIPTION(
+      "<p>This element sets the number of additional delivery queues, each "
+      "with its own thread, over which the proxy writers of application data "
+      "are distributed. All data from a single proxy writer goes through the "
+      "same queue, preserving the order, but the construction of the samples "
+      "(deserialisation and key lookup) for different proxy writers is done "
+      "in parallel and no longer on the receive thread. If set to 0, all "
+      "application data goes through a single delivery queue and proxy "
+      "writers may deliver synchronously on the receive thread (see "
+      "Internal/SynchronousDeliveryLatencyBound).</p>")),
   INT("PrimaryReorderMaxSamples", NULL, 1, "128",
     MEMBER(primary_reorder_maxsamples),
     FUNCTIONS(0, uf_uint, 0, pf_uint),
@@ -1039,6 +1064,31 @@ static struct cfgelem internal_cfgelems[] = {
       "<p>This element sets the maximum size in samples of a secondary "
       "re-order administration. The secondary re-order administration is per "
       "reader in need of historical data.</p>")),
+  INT("ReorderWindowSize", NULL, 1, "256",
+    MEMBER(reorder_window_size),
+    FUNCTIONS(0, uf_uint, 0, pf_uint),
+    DESCRIPTION(
+      "<p>This element sets the size in samples of the window used by the "
+      "re-order administrations for samples arriving shortly after a lost "
+      "one. Samples in this window are tracked in a bitmap rather than an "
+      "interval tree, making the common case of a few lost packets followed "
+      "by in-order data cheaper; the tree is only used if the window "
+      "overflows. The size is rounded up to a power of 2 (at least 32, at "
+      "most 65536), the number of samples stored remains limited by "
+      "Internal/PrimaryReorderMaxSamples and "
+      "Internal/SecondaryReorderMaxSamples, and 0 disables the window.</p>")),
+  BOOL("SharedSecondaryReorder", NULL, 1, "false",
+    MEMBER(shared_secondary_reorder),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element controls whether reliable readers in need of "
+      "historical data from a proxy writer each get a secondary re-order "
+      "administration of their own, or share a single one per proxy writer "
+      "in which each such reader merely tracks the next sequence number it "
+      "needs. Sharing it makes the cost of processing incoming data "
+      "independent of the number of readers catching up. The shared "
+      "administration is limited to Internal/SecondaryReorderMaxSamples "
+      "samples.</p>")),
   INT("DefragUnreliableMaxSamples", NULL, 1, "4",
     MEMBER(defrag_unreliable_maxsamples),
     FUNCTIONS(0, uf_uint, 0, pf_uint),
@@ -1079,6 +1129,17 @@ static struct cfgelem internal_cfgelems[] = {
       "and calculating round trip times. This is non-standard behaviour. The "
       "measured latencies are quite noisy and are currently not used "
       "anywhere.</p>")),
+  BOOL("MeasureReceiveLatency", NULL, 1, "false",
+    MEMBER(meas_receive_latency),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element enables measuring where the latency of received "
+      "application data comes from. Samples are timestamped by the kernel "
+      "(where supported), on entering the receive path, on being queued for "
+      "delivery, on being taken from the delivery queue and after storing "
+      "them in the reader history caches. The intervals are collected in "
+      "per-proxy writer histograms that are available as reader "
+      "statistics. When disabled, none of this is done.</p>")),
   BOOL("UnicastResponseToSPDPMessages", NULL, 1, "true",
     MEMBER(unicast_response_to_spdp_messages),
     FUNCTIONS(0, uf_boolean, 0, pf_boolean),
@@ -1149,6 +1210,17 @@ static struct cfgelem internal_cfgelems[] = {
       "<p>See also Internal/RetransmitMerging.</p>"),
     UNIT("duration"),
     RANGE("0;1s")),
+  STRING("HeartbeatAggregationWindow", NULL, 1, "1 ms",
+    MEMBER(hb_aggregation_window),
+    FUNCTIONS(0, uf_duration_us_1s, 0, pf_duration),
+    DESCRIPTION(
+      "<p>This setting controls how far ahead of schedule writer heartbeats "
+      "may be sent so they can be combined with those of other writers. "
+      "Heartbeats handled together are grouped by destination and packed "
+      "into as few RTPS messages as possible. A value of 0 limits this to "
+      "heartbeats that happen to be due at the same time.</p>"),
+    UNIT("duration"),
+    RANGE("0;1s")),
   STRING("HeartbeatInterval", heartbeat_interval_attrs, 1, "100 ms",
     MEMBER(const_hb_intv_sched),
     FUNCTIONS(0, uf_duration_inf, 0, pf_duration),
@@ -1173,6 +1245,38 @@ static struct cfgelem internal_cfgelems[] = {
       "<p>This settings limits the maximum number of samples queued for "
       "retransmission.</p>"
     )),
+  STRING("RexmitReaderBandwidthLimit", NULL, 1, "inf",
+    MEMBER(rexmit_reader_bandwidth_limit),
+    FUNCTIONS(0, uf_bandwidth, 0, pf_bandwidth),
+    DESCRIPTION(
+      "<p>This element specifies the maximum rate at which retransmits "
+      "are sent to any single reader. Retransmits are queued per reader "
+      "and the queues are serviced round-robin, each with its own token "
+      "bucket, so that a reader on a bad link cannot starve the others. "
+      "The default value \"inf\" means the rate is not limited, but the "
+      "queues are still serviced round-robin.</p>"),
+    UNIT("bandwidth")),
+  STRING("RexmitReaderBurstSize", NULL, 1, "64 kB",
+    MEMBER(rexmit_reader_burst_size),
+    FUNCTIONS(0, uf_memsize, 0, pf_memsize),
+    DESCRIPTION(
+      "<p>This element specifies the number of bytes that may be "
+      "retransmitted to a single reader in a burst when its rate is "
+      "limited by RexmitReaderBandwidthLimit.</p>"),
+    UNIT("memsize")),
+  INT("FECGroupSize", NULL, 1, "0",
+    MEMBER(fec_group_size),
+    FUNCTIONS(0, uf_natint_255, 0, pf_int),
+    DESCRIPTION(
+      "<p>This element enables forward error correction for data sent to "
+      "all readers of a writer at once, which is primarily intended for "
+      "reliable multicast to many readers over a lossy network. Each group "
+      "of this many new DATA/DATA_FRAG submessages is followed by a "
+      "vendor-specific submessage containing their XOR, allowing a reader to "
+      "reconstruct any one submessage lost from the group without requesting "
+      "a retransmit. Readers that do not support it ignore it. The default "
+      "value of 0 disables forward error correction.</p>"),
+    RANGE("0;255")),
   STRING("LeaseDuration", NULL, 1, "10 s",
     MEMBER(lease_duration),
     FUNCTIONS(0, uf_duration_ms_1hr, 0, pf_duration),
@@ -1210,6 +1314,63 @@ static struct cfgelem internal_cfgelems[] = {
       "operating system by default creates a larger buffer, it is left "
       "unchanged.</p>"),
     UNIT("memsize")),
+  STRING("RawEthernetRingSize", NULL, 1, "0 B",
+    MEMBER(raweth_ring_size),
+    FUNCTIONS(0, uf_memsize, 0, pf_memsize),
+    DESCRIPTION(
+      "<p>This setting controls the size of the memory-mapped receive and "
+      "transmit rings (PACKET_MMAP, TPACKET_V3) used by the raw ethernet "
+      "transport on Linux. Received frames are then handed over by the "
+      "kernel in blocks, rather than one system call per frame, and "
+      "transmitted frames are built directly in the ring. The size is "
+      "rounded down to a multiple of the block size (64 KiB) and applies to "
+      "each of the two rings. "
+      "The default of 0 disables the rings, as does a failure to set them "
+      "up.</p>"),
+    UNIT("memsize")),
+  BOOL("UseIoUring", NULL, 1, "false",
+    MEMBER(use_io_uring),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element enables the use of io_uring on Linux for the UDP "
+      "transport. Packets are then received through multishot receive "
+      "requests into buffers provided in advance, waking the receive threads "
+      "on completion rather than on readiness of the sockets, and the copies "
+      "of a message sent to multiple destinations are submitted with a "
+      "single system call. Sockets and addressing are those of the normal "
+      "UDP transport, so this is interoperable with it.</p>\n"
+      "<p>It forces ManySocketsMode to \"single\". If io_uring is not "
+      "available (or disabled in the kernel), it falls back to the normal "
+      "UDP transport with a warning.</p>")),
+  BOOL("SharedMemoryTransport", NULL, 1, "false",
+    MEMBER(shmem_transport),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element enables a built-in shared memory transport for "
+      "communicating with other processes on the same machine, in addition "
+      "to UDP. Each unicast port gets a ring of RTPS messages in /dev/shm "
+      "that the other processes write into directly, with a wakeup only when "
+      "the receiving thread is idle. It is advertised in discovery as an "
+      "additional locator and is preferred over UDP for readers that can "
+      "be reached with it; as it carries complete RTPS messages, discovery, "
+      "reliability and security work as usual, and no separate daemon is "
+      "needed.</p>\n"
+      "<p>It is only available on Linux with the UDP transport, forces "
+      "ManySocketsMode to \"single\" and can't be combined with "
+      "UseIoUring.</p>")),
+  INT("SharedMemoryTransportRingSize", NULL, 1, "256",
+    MEMBER(shmem_ring_size),
+    FUNCTIONS(0, uf_uint, 0, pf_uint),
+    DESCRIPTION(
+      "<p>This element sets the number of messages that fit in a receive "
+      "ring of the shared memory transport (Internal/SharedMemoryTransport), "
+      "rounded up to a power of two (at least 4, at most 65536). Each message "
+      "takes 64 kB, all of which is reserved in /dev/shm when the ring is "
+      "created, so that with the default a ring takes 16 MB (and there are "
+      "normally two). If that can't be reserved, the shared memory transport "
+      "is disabled with a warning. A message sent to a full ring is dropped, "
+      "just like a UDP datagram arriving at a socket with a full receive "
+      "buffer.</p>")),
   STRING("NackDelay", NULL, 1, "100 ms",
     MEMBER(nack_delay),
     FUNCTIONS(0, uf_duration_ms_1hr, 0, pf_duration),
@@ -1268,6 +1429,17 @@ static struct cfgelem internal_cfgelems[] = {
       "system and hardware will likely limit the maximum transmit rate.</p>"
     )),
 #endif
+  INT("TransmitSockets", NULL, 1, "1",
+    MEMBER(xmit_conn_pool_size),
+    FUNCTIONS(0, uf_uint, 0, pf_uint),
+    DESCRIPTION(
+      "<p>This element sets the number of UDP sockets per network interface "
+      "used for transmitting the data of application writers. Each writer is "
+      "assigned one of these based on its GUID, so that writers used from "
+      "different threads need not all contend for a single socket, while all "
+      "data of any one writer still goes out via the same socket. Discovery "
+      "and other protocol traffic always uses the first one. The values 0 "
+      "and 1 both mean a single transmit socket per interface.</p>")),
   INT("DDSI2DirectMaxThreads", NULL, 1, "1",
     MEMBER(ddsi2direct_max_threads),
     FUNCTIONS(0, uf_uint, 0, pf_uint),
@@ -1335,6 +1507,19 @@ static struct cfgelem internal_cfgelems[] = {
       "the application may have to use the dds_write_flush function to "
       "ensure that all samples are written.</p>"
     )),
+  BOOL("AdaptiveWriteBatch", NULL, 1, "false",
+    MEMBER(whc_batch_adaptive),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element enables adaptive batching of write operations for "
+      "writers with a non-zero latency budget. The data of such a writer "
+      "is then held back until either the packet is full or the latency "
+      "budget of the oldest sample in it expires, at which point it is "
+      "sent by the send queue thread. Batching is automatically suspended "
+      "while the writer writes so slowly that no more data would be added "
+      "before the budget expires. It has no effect when WriteBatch is "
+      "enabled.</p>"
+    )),
   BOOL("LivelinessMonitoring", liveliness_monitoring_attrs, 1, "false",
     MEMBER(liveliness_monitoring),
     FUNCTIONS(0, uf_boolean, 0, pf_boolean),
@@ -1457,6 +1642,23 @@ static struct cfgelem sizing_cfgelems[] = {
       "shrunk immediately after processing a message, or freed "
       "straightaway.</p>"),
     UNIT("memsize")),
+  INT("RecycledReceiveBuffers", NULL, 1, "0",
+    MEMBER(rbuf_max_free),
+    FUNCTIONS(0, uf_uint, 0, pf_uint),
+    DESCRIPTION(
+      "<p>This element sets the number of empty receive buffers each receive "
+      "thread keeps for reuse rather than freeing them. Under a sustained "
+      "high load, this avoids continuously allocating and freeing blocks of "
+      "Sizing/ReceiveBufferSize bytes. The default of 0 frees them "
+      "immediately.</p>")),
+  BOOL("ReceiveBufferHugePages", NULL, 1, "false",
+    MEMBER(rbuf_hugepages),
+    FUNCTIONS(0, uf_boolean, 0, pf_boolean),
+    DESCRIPTION(
+      "<p>This element causes the receive buffers to be backed by huge pages "
+      "to reduce TLB misses. Explicitly reserved huge pages are used if "
+      "available, else transparent huge pages are requested. It is ignored "
+      "on platforms that do not support huge pages.</p>")),
   END_MARKER
 };
 
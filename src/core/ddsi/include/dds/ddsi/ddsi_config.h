@@ -271,6 +271,8 @@ struct ddsi_config
   int64_t const_hb_intv_sched_min;
   int64_t const_hb_intv_sched_max;
   int64_t const_hb_intv_min;
+  int hb_intv_adaptive;
+  int64_t hb_aggregation_window;
   enum ddsi_retransmit_merging retransmit_merging;
   int64_t retransmit_merging_period;
   int squash_participants;
@@ -283,8 +285,12 @@ struct ddsi_config
 
   unsigned primary_reorder_maxsamples;
   unsigned secondary_reorder_maxsamples;
+  unsigned reorder_window_size;
+  int shared_secondary_reorder;
 
   unsigned delivery_queue_maxsamples;
+  unsigned delivery_queue_workers;
+  unsigned xmit_conn_pool_size;
 
   uint16_t fragment_size;
   uint32_t max_msg_size;
@@ -337,8 +343,11 @@ struct ddsi_config
   int xmit_lossiness;           /**<< fraction of packets to drop on xmit, in units of 1e-3 */
   uint32_t rmsg_chunk_size;          /**<< size of a chunk in the receive buffer */
   uint32_t rbuf_size;                /* << size of a single receiver buffer */
+  uint32_t rbuf_max_free;            /* << number of empty receive buffers kept for reuse */
+  int rbuf_hugepages;                /* << back receive buffers with huge pages */
   enum ddsi_besmode besmode;
   int meas_hb_to_ack_latency;
+  int meas_receive_latency;
   int unicast_response_to_spdp_messages;
   int synchronous_delivery_priority_threshold;
   int64_t synchronous_delivery_latency_bound;
@@ -346,6 +355,7 @@ struct ddsi_config
   /* Write cache */
 
   int whc_batch;
+  int whc_batch_adaptive;
   uint32_t whc_lowwater_mark;
   uint32_t whc_highwater_mark;
   struct ddsi_config_maybe_uint32 whc_init_highwater_mark;
@@ -360,6 +370,10 @@ struct ddsi_config
   int multicast_ttl;
   struct ddsi_config_maybe_uint32 socket_min_rcvbuf_size;
   uint32_t socket_min_sndbuf_size;
+  uint32_t raweth_ring_size;
+  int use_io_uring;
+  int shmem_transport;
+  uint32_t shmem_ring_size;
   int64_t ack_delay;
   int64_t nack_delay;
   int64_t preemptive_ack_delay;
@@ -371,6 +385,9 @@ struct ddsi_config
 #endif
   uint32_t max_queued_rexmit_bytes;
   unsigned max_queued_rexmit_msgs;
+  uint32_t rexmit_reader_bandwidth_limit; /* bytes/second, 0 = unlimited */
+  uint32_t rexmit_reader_burst_size;
+  int fec_group_size; /* 0 = no forward error correction */
   unsigned ddsi2direct_max_threads;
   int late_ack_mode;
   int retry_on_reject_besteffort;
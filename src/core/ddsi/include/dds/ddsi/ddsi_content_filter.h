@@ -0,0 +1,114 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_CONTENT_FILTER_H
+#define DDSI_CONTENT_FILTER_H
+
+#include "dds/export.h"
+#include "dds/dds.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/retcode.h"
+#include "dds/ddsi/ddsi_plist.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct ddsi_domaingv;
+struct ddsi_serdata;
+struct writer;
+struct proxy_reader;
+
+/* Registered filter class: the function is only ever called for samples
+   containing data, key samples (dispose/unregister) always pass */
+struct ddsi_content_filter_class {
+  struct ddsi_content_filter_class *next;
+  char *name;
+  dds_content_filter_class_fn accept;
+  void *arg;
+};
+
+/* Content filter of a reader or proxy reader: the property as advertised in
+   SEDP (for a local reader derived from the DDS_CONTENT_FILTER_... QoS
+   properties), plus the filter class once it has been resolved.  Filter
+   classes are never unregistered, so the resolved class remains valid for
+   the lifetime of the domain. */
+struct ddsi_content_filter {
+  nn_content_filter_property_t prop;
+  ddsrt_atomic_voidp_t fclass;
+};
+
+void ddsi_content_filter_classes_init (struct ddsi_domaingv *gv);
+void ddsi_content_filter_classes_fini (struct ddsi_domaingv *gv);
+
+/** @brief Registers a filter class with the domain
+ *
+ * @returns DDS_RETCODE_OK on success, DDS_RETCODE_PRECONDITION_NOT_MET if a
+ * class with the same name exists already.
+ */
+DDS_EXPORT dds_return_t ddsi_content_filter_class_register (struct ddsi_domaingv *gv, const char *name, dds_content_filter_class_fn accept, void *arg);
+
+struct ddsi_content_filter *ddsi_content_filter_new (const nn_content_filter_property_t *prop);
+struct ddsi_content_filter *ddsi_content_filter_new_from_qos (const dds_qos_t *xqos);
+void ddsi_content_filter_free (struct ddsi_content_filter *cf);
+
+/** @brief Whether two content filters are guaranteed to give the same result */
+bool ddsi_content_filter_equal (const struct ddsi_content_filter *a, const struct ddsi_content_filter *b);
+
+/** @brief Whether any filter class is registered in the domain */
+bool ddsi_content_filter_classes_registered (struct ddsi_domaingv *gv);
+
+/** @brief Whether the filter's class is known in this domain
+ *
+ * Filters with an unknown class accept everything, so there is no point in
+ * deserializing a sample only for evaluating those.
+ */
+bool ddsi_content_filter_resolved (struct ddsi_domaingv *gv, struct ddsi_content_filter *cf);
+
+/** @brief Evaluates the filter for a sample
+ *
+ * Samples always pass if the filter class is not known in this domain, the
+ * consequence being that the reader has to do the filtering.
+ */
+DDS_EXPORT bool ddsi_content_filter_accepts (struct ddsi_domaingv *gv, struct ddsi_content_filter *cf, const struct ddsi_serdata *serdata);
+
+/** @brief Evaluates the filter for a sample that has been deserialized already
+ *
+ * Same as ddsi_content_filter_accepts, for evaluating many filters on the
+ * same sample.  The sample must contain data.
+ */
+bool ddsi_content_filter_accepts_sample (struct ddsi_domaingv *gv, struct ddsi_content_filter *cf, const void *sample);
+
+/** @brief Whether a GAP for one of the proxy readers also affects the other
+ *
+ * Cyclone shares the proxy writer, and hence the reorder admin, between all
+ * readers in a domain, and so a GAP addressed to one of them drops the
+ * sample for all of them (and data addressed to one of them is delivered to
+ * all of them).  A rejected sample can therefore only be replaced by a GAP
+ * if all readers sharing the proxy writer reject it.  Participants in the
+ * same Cyclone domain have the first 4 bytes of the GUID prefix in common,
+ * which may occasionally also be true for unrelated ones, but that only means
+ * sending data where a GAP would have done.
+ */
+bool ddsi_content_filter_shared_receiver (const struct proxy_reader *a, const struct proxy_reader *b);
+
+/** @brief Writer-side filter for a proxy reader with a content filter (matches filter_fn_t)
+ *
+ * Also accepts the sample if another reader sharing the receiver accepts it,
+ * the writer lock must be held.
+ */
+int ddsi_content_filter_prd (struct writer *wr, struct proxy_reader *prd, struct ddsi_serdata *serdata);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_CONTENT_FILTER_H */
@@ -24,6 +24,7 @@
 
 #include "dds/ddsi/ddsi_plist.h"
 #include "dds/ddsi/ddsi_ownip.h"
+#include "dds/ddsi/ddsi_timing_wheel.h"
 #include "dds/ddsi/q_protocol.h"
 #include "dds/ddsi/q_sockwaitset.h"
 #include "dds/ddsi/q_config.h"
@@ -50,6 +51,7 @@ struct ddsi_tkmap;
 struct dds_security_context;
 struct dds_security_match_index;
 struct ddsi_hsadmin;
+struct ddsi_uring_rx;
 
 typedef struct config_in_addr_node {
    ddsi_locator_t loc;
@@ -73,6 +75,7 @@ struct recv_thread_arg {
   enum recv_thread_mode mode;
   struct nn_rbufpool *rbpool;
   struct ddsi_domaingv *gv;
+  struct ddsi_uring_rx *uring_rx; /* replaces the waitset/blocking reads if non-NULL */
   union {
     struct {
       const ddsi_locator_t *loc;
@@ -103,6 +106,10 @@ struct ddsi_domaingv {
   /* Timed events admin */
   struct xeventq *xevents;
 
+  /* Timing wheel driving the lifespan and deadline administrations of all
+     history caches in the domain */
+  struct ddsi_domain_twheel twheel;
+
   /* Queue for garbage collection requests */
   struct gcreq_queue *gcreq_queue;
 
@@ -124,6 +131,12 @@ struct ddsi_domaingv {
   struct ddsi_tran_conn * disc_conn_uc;
   struct ddsi_tran_conn * data_conn_uc;
 
+  /* Receive rings of the shared memory transport (Internal/SharedMemoryTransport)
+     for the unicast discovery and data ports, may alias each other like the
+     sockets; NULL if not in use */
+  struct ddsi_tran_conn * disc_conn_shmem;
+  struct ddsi_tran_conn * data_conn_shmem;
+
   /* Connection used for all output (for connectionless transports), this
      used to simply be data_conn_uc, but:
 
@@ -151,6 +164,12 @@ struct ddsi_domaingv {
   struct ddsi_tran_conn * xmit_conns[MAX_XMIT_CONNS];
   ddsi_xlocator_t intf_xlocators[MAX_XMIT_CONNS];
 
+  /* Additional transmit sockets for application writers (Internal/TransmitSockets),
+     TransmitSockets-1 per interface, entry [i*(TransmitSockets-1)+k-1] is the k-th
+     one of interface i (the 0-th being xmit_conns[i]); entries alias xmit_conns[i]
+     for interfaces that do not support it; NULL if there is just one socket */
+  struct ddsi_tran_conn **xmit_conn_pool;
+
   /* TCP listener */
   struct ddsi_tran_listener * listener;
 
@@ -277,6 +296,11 @@ struct ddsi_domaingv {
 
   /* Application data gets its own delivery queue */
   struct nn_dqueue *user_dqueue;
+
+  /* Optional pool of delivery queues over which application data proxy
+     writers get distributed (Internal/DeliveryQueueWorkers), so that
+     samples of different writers are constructed in parallel */
+  struct nn_dqueue **user_dqueue_workers;
 #endif
 
   /* Transmit side: pools for the serializer & transmit messages and a
@@ -301,11 +325,16 @@ struct ddsi_domaingv {
   struct ddsi_sertype *pgm_volatile_type; /* participant generic message */
 #endif
 
+  /* The send queue proper is a lock-free LIFO that the sendq thread empties
+     in one go and reverses, the lock only protects the list of deferred
+     xpacks and the wait/wake-up administration */
   ddsrt_mutex_t sendq_lock;
   ddsrt_cond_t sendq_cond;
-  unsigned sendq_length;
-  struct nn_xpack *sendq_head;
-  struct nn_xpack *sendq_tail;
+  ddsrt_atomic_uint32_t sendq_length;
+  ddsrt_atomic_voidp_t sendq_head;
+  ddsrt_atomic_uint32_t sendq_idle; /* sendq thread (about to start) waiting on sendq_cond */
+  uint32_t sendq_nblocked;         /* [sendq_lock] writers waiting for space in the queue */
+  struct nn_xpack *sendq_deferred; /* xpacks to be flushed when their latency budget expires */
   int sendq_stop;
   struct thread_state1 *sendq_ts;
   bool sendq_running;
@@ -336,6 +365,11 @@ struct ddsi_domaingv {
   ddsrt_cond_t new_topic_cond;
   uint32_t new_topic_version;
 
+  /* Content filter classes that can be evaluated by writers on behalf of
+     (proxy) readers, see ddsi_content_filter.h */
+  ddsrt_mutex_t content_filter_classes_lock;
+  struct ddsi_content_filter_class *content_filter_classes;
+
   /* security globals */
 #ifdef DDS_HAS_SECURITY
   struct dds_security_context *security_context;
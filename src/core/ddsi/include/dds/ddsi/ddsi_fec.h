@@ -0,0 +1,95 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_FEC_H
+#define DDSI_FEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "dds/ddsrt/iovec.h"
+#include "dds/ddsi/ddsi_time.h"
+#include "dds/ddsi/q_protocol.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* Forward error correction for data sent to all readers of a writer at once
+   (i.e., typically, multicast).  The writer computes the XOR of every group
+   of "group size" consecutive DATA/DATA_FRAG submessages it sends, each
+   padded with zeros to the length of the longest, and follows the group with
+   a FEC submessage containing that parity and the sequence numbers, fragment
+   numbers, lengths, timestamps and checksums of the members.
+
+   A reader caches a copy of the recent submessages of each proxy writer from
+   which it received a FEC submessage, and if exactly one member of a group
+   is missing, the parity and the other members suffice to reconstruct it.
+   The reconstructed submessage is then processed as if it had been received,
+   sparing the NACK and the retransmit. */
+
+#define DDSI_FEC_MAX_GROUP_SIZE 255u
+
+struct ddsi_fec_encoder;
+struct ddsi_fec_decoder;
+
+struct ddsi_fec_encoder *ddsi_fec_encoder_new (uint32_t group_size);
+void ddsi_fec_encoder_free (struct ddsi_fec_encoder *enc);
+
+/* Adds the DATA or DATA_FRAG submessage in iov (the submessage header
+   and possibly a referenced payload, all in native byte order) to the
+   current group; returns true if this completes the group.  The timestamp
+   is the one in the INFO_TS preceding the submessage, DDSI_TIME_INVALID if
+   none. */
+bool ddsi_fec_encoder_add (struct ddsi_fec_encoder *enc, const ddsrt_iovec_t *iov, uint32_t niov, ddsi_time_t timestamp);
+
+/* Size of the FEC submessage for the completed group */
+size_t ddsi_fec_encoder_parity_size (const struct ddsi_fec_encoder *enc);
+
+/* Fills in the group size, parity size, members and parity of the FEC
+   submessage "msg" (which must have room for ddsi_fec_encoder_parity_size
+   bytes) and resets the encoder for the next group. */
+void ddsi_fec_encoder_fill (struct ddsi_fec_encoder *enc, FecParity_t *msg);
+
+/* Discards the current group */
+void ddsi_fec_encoder_reset (struct ddsi_fec_encoder *enc);
+
+struct ddsi_fec_decoder *ddsi_fec_decoder_new (void);
+void ddsi_fec_decoder_free (struct ddsi_fec_decoder *dec);
+
+/* Caches a copy of a DATA/DATA_FRAG submessage as it was sent, given the
+   submessage after the receive path converted its fixed part to native byte
+   order */
+void ddsi_fec_decoder_note (struct ddsi_fec_decoder *dec, const unsigned char *submsg, uint32_t size);
+
+/* Returns the index of the member of the FEC submessage "msg" (already
+   validated and converted to native byte order) that is missing from the
+   cache if there is exactly one, or UINT32_MAX otherwise (counting the
+   group as unrecoverable if more than one is missing) */
+uint32_t ddsi_fec_decoder_missing (struct ddsi_fec_decoder *dec, const FecParity_t *msg);
+
+/* Reconstructs member "idx" of the group of "msg" into "dst", which must
+   have room for the member's length; returns false if the result doesn't
+   match the member's checksum. */
+bool ddsi_fec_decoder_recover (struct ddsi_fec_decoder *dec, const FecParity_t *msg, uint32_t idx, unsigned char *dst);
+
+struct ddsi_fec_decoder_stats {
+  uint64_t recovered;     /* number of submessages reconstructed */
+  uint64_t unrecoverable; /* number of groups with more than one member missing */
+  uint64_t failed;        /* number of reconstructions failing the checksum */
+};
+
+void ddsi_fec_decoder_get_stats (const struct ddsi_fec_decoder *dec, struct ddsi_fec_decoder_stats *st);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_FEC_H */
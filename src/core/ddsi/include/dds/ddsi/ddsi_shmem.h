@@ -0,0 +1,37 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_SHMEM_H
+#define DDSI_SHMEM_H
+
+#include "dds/ddsi/ddsi_tran.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* Initializes the shared-memory transport that runs alongside UDP between
+   processes on the same machine: a receive connection created for a port
+   maps a ring of whole RTPS messages that the transmit connections of all
+   other processes write into.  Sets @p loc to the (port-less) locator that
+   identifies the shared memory; returns -1 if not supported */
+int ddsi_shmem_init (struct ddsi_domaingv *gv, ddsi_locator_t *loc);
+
+/* Whether @p loc can be used in the address set of a writer: false for the
+   locator of a ring that has been found full for so long that its receiver
+   apparently doesn't read it anymore */
+bool ddsi_shmem_locator_usable (const ddsi_xlocator_t *loc);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
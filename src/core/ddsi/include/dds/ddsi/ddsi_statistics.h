@@ -13,6 +13,8 @@
 #define _DDSI_STATISTICS_H_
 
 #include <stdint.h>
+#include "dds/export.h"
+#include "dds/ddsrt/atomics.h"
 
 #if defined (__cplusplus)
 extern "C" {
@@ -20,9 +22,44 @@ extern "C" {
 
 struct reader;
 struct writer;
+struct proxy_writer;
+
+/* Stages in the receive path for which latency is measured if
+   Internal/MeasureReceiveLatency is set:
+   - KERNEL: kernel timestamp to start of processing the packet
+   - RECEIVE: start of processing to queueing the sample for delivery
+   - DQUEUE: time spent in the delivery queue (not counted for
+     synchronous delivery)
+   - RHC: taken from the delivery queue to stored in the reader
+     history caches, i.e., including deserialization */
+enum ddsi_latency_stage {
+  DDSI_LATENCY_KERNEL,
+  DDSI_LATENCY_RECEIVE,
+  DDSI_LATENCY_DQUEUE,
+  DDSI_LATENCY_RHC
+};
+#define DDSI_LATENCY_NSTAGES 4
+
+/* Bucket i < DDSI_LATENCY_NBUCKETS-1 counts latencies less than 4^i
+   microseconds (and not counted in a lower bucket), the last one
+   counts everything else */
+#define DDSI_LATENCY_NBUCKETS 8
+
+struct ddsi_latency_hist {
+  ddsrt_atomic_uint32_t count[DDSI_LATENCY_NSTAGES][DDSI_LATENCY_NBUCKETS];
+};
+
+void ddsi_latency_hist_add (struct ddsi_latency_hist *hist, enum ddsi_latency_stage stage, int64_t latency);
 
 void ddsi_get_writer_stats (struct writer *wr, uint64_t * __restrict rexmit_bytes, uint32_t * __restrict throttle_count, uint64_t * __restrict time_throttled, uint64_t * __restrict time_retransmit);
-void ddsi_get_reader_stats (struct reader *rd, uint64_t * __restrict discarded_bytes);
+/* Retransmit statistics of the readers matched with the writer, as maintained per
+   reader by the xevent queue: the number of bytes retransmitted to them, the sum and
+   the maximum of their recent retransmit rates in bytes/s, the number of queued
+   retransmits and the number dropped because the queue was full.  These cover the
+   retransmits by all writers to these readers. */
+void ddsi_get_writer_rexmit_reader_stats (struct writer *wr, uint64_t * __restrict bytes, uint32_t * __restrict rate_total, uint32_t * __restrict rate_max, uint32_t * __restrict queued, uint32_t * __restrict dropped);
+void ddsi_get_reader_stats (struct reader *rd, uint64_t * __restrict discarded_bytes, uint32_t latency_hist[DDSI_LATENCY_NSTAGES * DDSI_LATENCY_NBUCKETS]);
+DDS_EXPORT void ddsi_get_proxy_writer_latency_stats (const struct proxy_writer *pwr, uint32_t latency_hist[DDSI_LATENCY_NSTAGES * DDSI_LATENCY_NBUCKETS]);
 
 #if defined (__cplusplus)
 }
@@ -0,0 +1,124 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_TIMING_WHEEL_H
+#define DDSI_TIMING_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "dds/export.h"
+#include "dds/ddsrt/circlist.h"
+#include "dds/ddsrt/fibheap.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/time.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct ddsi_domaingv;
+struct xevent;
+
+/* Resolution of the timing wheels: expiry times are rounded up to a multiple
+   of this, so timers never fire early, but may fire up to one tick late */
+#define DDSI_TWHEEL_RESOLUTION DDS_MSECS (1)
+#define DDSI_TWHEEL_NSLOTS 1024u
+
+typedef ddsrt_mtime_t (*ddsi_twheel_expired_cb_t) (void *hc, ddsrt_mtime_t tnow);
+
+enum ddsi_twheel_state {
+  DDSI_TWHEEL_IDLE,        /* not scheduled in the domain wheel */
+  DDSI_TWHEEL_SCHEDULED,   /* in a slot of the domain wheel */
+  DDSI_TWHEEL_PENDING,     /* callback due or executing */
+  DDSI_TWHEEL_STOPPED      /* no longer to be scheduled */
+};
+
+struct ddsi_twheel_node {
+  union {
+    struct ddsrt_circlist_elem e;     /* in a slot */
+    ddsrt_fibheap_node_t heapnode;    /* in the overflow heap */
+  } u;
+  int64_t tick;
+  bool overflow;
+};
+
+/* Slots covering one revolution starting at the cursor, so that each slot
+   holds only nodes that are due at the same tick, plus a heap of the nodes
+   that are due beyond that revolution.  The latter are moved into the slots
+   as the cursor advances. */
+struct ddsi_twheel_wheel {
+  struct ddsrt_circlist *slots;
+  ddsrt_fibheap_t overflow;
+  int64_t cursor;             /* no node has a tick < cursor */
+};
+
+/* Hashed timing wheel of a single history cache, protected by the lock of
+   that cache.  Registering, renewing and unregistering a node are O(1),
+   unless it is due more than one revolution of the wheel ahead, in which
+   case it is O(log n) in the number of such nodes; the slot array is
+   allocated on first use.
+
+   The cache is itself scheduled in the domain wheel at the earliest tick
+   that may contain an expired node, and the callback is invoked (once per
+   tick at most) from the timed-event thread.  Rescheduling happens when
+   ddsi_twheel_next_expired_locked finds no more expired nodes, which is
+   how all existing callbacks terminate. */
+struct ddsi_twheel {
+  struct ddsi_twheel_wheel wheel;
+  uint32_t count;             /* number of nodes in the wheel */
+  int64_t sched_hint;         /* tick at which a callback is certain to happen, INT64_MAX if unknown */
+  struct ddsi_domain_twheel *dtw;
+  ddsi_twheel_expired_cb_t cb;
+  void *hc;
+
+  /* below protected by dtw->lock */
+  enum ddsi_twheel_state state;
+  struct ddsi_twheel_node sched_node; /* tick is the scheduled tick if SCHEDULED */
+};
+
+/* Per-domain wheel of history caches with expired or soon to expire nodes,
+   driven by a single timed event */
+struct ddsi_domain_twheel {
+  ddsrt_mutex_t lock;
+  ddsrt_cond_t cond;
+  struct xevent *evt;
+  struct ddsi_twheel_wheel wheel;
+  struct ddsrt_circlist pending;
+  const struct ddsi_twheel *executing;
+};
+
+void ddsi_domain_twheel_init (struct ddsi_domaingv *gv);
+void ddsi_domain_twheel_fini (struct ddsi_domaingv *gv);
+
+DDS_EXPORT void ddsi_twheel_init (struct ddsi_domaingv *gv, struct ddsi_twheel *tw, ddsi_twheel_expired_cb_t cb, void *hc);
+
+/** @brief Stops invoking the callback, waiting for a concurrent invocation to complete
+ *
+ * Must not be called while holding the lock of the history cache.
+ */
+DDS_EXPORT void ddsi_twheel_stop (struct ddsi_twheel *tw);
+DDS_EXPORT void ddsi_twheel_fini (struct ddsi_twheel *tw);
+DDS_EXPORT void ddsi_twheel_insert_locked (struct ddsi_twheel *tw, struct ddsi_twheel_node *node, ddsrt_mtime_t texp);
+DDS_EXPORT void ddsi_twheel_remove_locked (struct ddsi_twheel *tw, struct ddsi_twheel_node *node);
+
+/** @brief Returns the first node that expired at or before tnow
+ *
+ * The node remains in the wheel.  If no node expired, NULL is returned, the
+ * history cache is rescheduled and *tnext is set to the (approximate) time
+ * of the next expiry, or to DDSRT_MTIME_NEVER if the wheel is empty.
+ */
+DDS_EXPORT struct ddsi_twheel_node *ddsi_twheel_next_expired_locked (struct ddsi_twheel *tw, ddsrt_mtime_t tnow, ddsrt_mtime_t *tnext);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_TIMING_WHEEL_H */
@@ -16,6 +16,7 @@
 
 #include "dds/ddsrt/ifaddrs.h"
 #include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/time.h"
 #include "dds/ddsi/ddsi_locator.h"
 #include "dds/ddsi/ddsi_config.h"
 
@@ -125,6 +126,7 @@ struct ddsi_tran_conn
   bool m_stream;
   bool m_closed;
   ddsrt_atomic_uint32_t m_count;
+  ddsrt_wctime_t m_rx_timestamp; /* kernel receive time of last packet read, 0 if not available */
 
   /* Relationships */
 
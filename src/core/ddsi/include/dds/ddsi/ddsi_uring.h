@@ -0,0 +1,51 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_URING_H
+#define DDSI_URING_H
+
+#include "dds/ddsi/ddsi_tran.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct ddsi_uring_rx;
+
+/* Initializes the UDP transport using io_uring for sending and receiving;
+   returns -1 if io_uring (or a required feature of it) is not available, in
+   which case the caller can fall back to plain UDP */
+int ddsi_uring_init (struct ddsi_domaingv *gv);
+
+/* Completion-driven replacement for the socket waitset of a receive thread:
+   the thread adds its sockets, then alternates between waiting and calling
+   ddsi_uring_rx_next until it returns NULL, reading one packet from each
+   returned connection.  Adding a socket returns 1, or 0 if it had been added
+   already; there is no limit on the number of sockets. */
+struct ddsi_uring_rx *ddsi_uring_rx_new (struct ddsi_domaingv *gv);
+void ddsi_uring_rx_free (struct ddsi_uring_rx *rx);
+int ddsi_uring_rx_add (struct ddsi_uring_rx *rx, ddsi_tran_conn_t conn);
+void ddsi_uring_rx_trigger (struct ddsi_uring_rx *rx);
+int ddsi_uring_rx_wait (struct ddsi_uring_rx *rx);
+ddsi_tran_conn_t ddsi_uring_rx_next (struct ddsi_uring_rx *rx);
+
+/* Writes by the calling thread between begin and end are submitted in one
+   go at the end, instead of one system call per write; the data must remain
+   valid until end returns.  The writes themselves then can't report errors,
+   instead end returns the number of them that failed. */
+void ddsi_uring_tx_begin (void);
+uint32_t ddsi_uring_tx_end (void);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
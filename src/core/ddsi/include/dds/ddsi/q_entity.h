@@ -39,7 +39,10 @@ extern "C" {
 
 struct xevent;
 struct nn_reorder;
+struct nn_catchup;
+struct nn_catchup_cursor;
 struct nn_defrag;
+struct ddsi_latency_hist;
 struct nn_dqueue;
 struct nn_rsample_info;
 struct nn_rdata;
@@ -47,6 +50,9 @@ struct addrset;
 struct ddsi_sertype;
 struct whc;
 struct dds_qos;
+struct ddsi_content_filter;
+struct ddsi_fec_encoder;
+struct ddsi_fec_decoder;
 struct ddsi_plist;
 struct lease;
 struct participant_sec_attributes;
@@ -142,6 +148,10 @@ struct wr_prd_match {
   ddsrt_etime_t t_nackfrag_accepted; /* (local) time a nackfrag was last accepted */
   struct nn_lat_estim hb_to_ack_latency;
   ddsrt_wctime_t hb_to_ack_latency_tlastlog;
+  nn_count_t ackhb_answered; /* identifies most recent heartbeat requesting an ack that this reader answered */
+  struct nn_lat_estim ack_latency_estim; /* heartbeat-to-acknack latency for adaptive heartbeats */
+  int64_t ack_latency; /* current estimate in ns, 0 if unknown */
+  int64_t max_ack_latency; /* max ack_latency of reliable readers in subtree */
   uint32_t non_responsive_count;
   uint32_t rexmit_requests;
 #ifdef DDS_HAS_SECURITY
@@ -186,6 +196,7 @@ struct pwr_rd_match {
     struct {
       seqno_t end_of_tl_seq; /* when seq >= end_of_tl_seq, it's in sync, =0 when not tl */
       struct nn_reorder *reorder; /* can be done (mostly) per proxy writer, but that is harder; only when state=OUT_OF_SYNC */
+      struct nn_catchup_cursor *cursor; /* instead of reorder if the proxy writer has a shared one (pwr->catchup) */
     } not_in_sync;
   } u;
 #ifdef DDS_HAS_SECURITY
@@ -327,6 +338,7 @@ struct writer
   unsigned test_suppress_retransmit : 1; /* iff 1, the writer does not respond to retransmit requests */
   unsigned test_suppress_heartbeat : 1; /* iff 1, the writer suppresses all periodic heartbeats */
   unsigned test_drop_outgoing_data : 1; /* iff 1, the writer drops outgoing data, forcing the readers to request a retransmit */
+  unsigned would_block: 1; /* iff 1, a non-blocking write was refused because the WHC was full, readiness gets signalled when it drops below the low-water mark */
 #ifdef DDS_HAS_SSM
   unsigned supports_ssm: 1;
   struct addrset *ssm_as;
@@ -339,6 +351,8 @@ struct writer
   struct ldur_fhnode *lease_duration; /* fibheap node to keep lease duration for this writer, NULL in case of automatic liveliness with inifite duration  */
   struct whc *whc; /* WHC tracking history, T-L durability service history + samples by sequence number for retransmit */
   uint32_t whc_low, whc_high; /* watermarks for WHC in bytes (counting only unack'd data) */
+  ddsrt_atomic_uint32_t whc_reclaims_pending; /* number of deferred free lists handed to the GC for freeing */
+  struct ddsi_fec_encoder *fec; /* parity for new data sent to all readers (FECGroupSize), NULL if disabled */
   ddsrt_etime_t t_rexmit_start;
   ddsrt_etime_t t_rexmit_end; /* time of last 1->0 transition of "retransmitting" */
   ddsrt_etime_t t_whc_high_upd; /* time "whc_high" was last updated for controlled ramp-up of throughput */
@@ -347,6 +361,7 @@ struct writer
   uint32_t num_readers; /* total number of matching PROXY readers */
   uint32_t num_reliable_readers; /* number of matching reliable PROXY readers */
   uint32_t num_readers_requesting_keyhash; /* also +1 for protected keys and config override for generating keyhash */
+  ddsrt_atomic_uint32_t num_readers_content_filtered; /* number of matching PROXY readers with a content filter, also read without holding the lock */
   ddsrt_avl_tree_t readers; /* all matching PROXY readers, see struct wr_prd_match */
   ddsrt_avl_tree_t local_readers; /* all matching LOCAL readers, see struct wr_rd_match */
 #ifdef DDS_HAS_NETWORK_PARTITIONS
@@ -406,6 +421,7 @@ struct reader
   ddsrt_avl_tree_t local_writers; /* all matching LOCAL writers, see struct rd_wr_match */
   ddsi2direct_directread_cb_t ddsi2direct_cb;
   void *ddsi2direct_cbarg;
+  struct ddsi_content_filter *content_filter; /* advertised in discovery, also applied to incoming data; NULL if none */
 #ifdef DDS_HAS_SECURITY
   struct reader_sec_attributes *sec_attr;
 #endif
@@ -527,6 +543,9 @@ struct proxy_writer {
   uint32_t alive_vclock; /* virtual clock counting transitions between alive/not-alive */
   struct nn_defrag *defrag; /* defragmenter for this proxy writer; FIXME: perhaps shouldn't be for historical data */
   struct nn_reorder *reorder; /* message reordering for this proxy writer, out-of-sync readers can have their own, see pwr_rd_match */
+  struct nn_catchup *catchup; /* shared secondary reorder admin for out-of-sync readers or NULL, see pwr_rd_match */
+  struct ddsi_latency_hist *latency_hist; /* receive path latency histograms if Internal/MeasureReceiveLatency, else NULL */
+  struct ddsi_fec_decoder *fec; /* recent data for recovering lost data using FEC submessages, NULL until one is received */
   struct nn_dqueue *dqueue; /* delivery queue for asynchronous delivery (historical data is always delivered asynchronously) */
   struct xeventq *evq; /* timed event queue to be used for ACK generation */
   struct local_reader_ary rdary; /* LOCAL readers for fast-pathing; if not fast-pathed, fall back to scanning local_readers */
@@ -553,6 +572,7 @@ struct proxy_reader {
 #endif
   ddsrt_avl_tree_t writers; /* matching LOCAL writers */
   uint32_t receive_buffer_size; /* assumed receive buffer size inherited from proxypp */
+  struct ddsi_content_filter *content_filter; /* content filter advertised by the reader, NULL if none */
   filter_fn_t filter;
 };
 
@@ -737,10 +757,12 @@ void update_writer_qos (struct writer *wr, const struct dds_qos *xqos);
 struct whc_node;
 struct whc_state;
 unsigned remove_acked_messages (struct writer *wr, struct whc_state *whcst, struct whc_node **deferred_free_list);
+void writer_free_deferred_free_list (struct writer *wr, struct whc_node *deferred_free_list, uint32_t n);
 seqno_t writer_max_drop_seq (const struct writer *wr);
 int writer_must_have_hb_scheduled (const struct writer *wr, const struct whc_state *whcst);
 void writer_set_retransmitting (struct writer *wr);
 void writer_clear_retransmitting (struct writer *wr);
+void writer_set_would_block (struct writer *wr);
 dds_return_t writer_wait_for_acks (struct writer *wr, const ddsi_guid_t *rdguid, dds_time_t abstimeout);
 
 dds_return_t unblock_throttled_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *guid);
@@ -21,6 +21,7 @@ extern "C" {
 struct writer;
 struct whc_state;
 struct proxy_reader;
+struct wr_prd_match;
 
 struct hbcontrol {
   ddsrt_mtime_t t_of_last_write;
@@ -29,6 +30,7 @@ struct hbcontrol {
   ddsrt_mtime_t tsched;
   uint32_t hbs_since_last_write;
   uint32_t last_packetid;
+  nn_count_t ackhb; /* identifies most recent heartbeat requesting an ack, 0 if none */
 };
 
 void writer_hbcontrol_init (struct hbcontrol *hbc);
@@ -36,6 +38,7 @@ int64_t writer_hbcontrol_intv (const struct writer *wr, const struct whc_state *
 void writer_hbcontrol_note_asyncwrite (struct writer *wr, ddsrt_mtime_t tnow);
 int writer_hbcontrol_ack_required (const struct writer *wr, const struct whc_state *whcst, ddsrt_mtime_t tnow);
 struct nn_xmsg *writer_hbcontrol_piggyback (struct writer *wr, const struct whc_state *whcst, ddsrt_mtime_t tnow, uint32_t packetid, int *hbansreq);
+void writer_hbcontrol_note_acknack (struct writer *wr, struct wr_prd_match *rn, ddsrt_mtime_t tnow);
 int writer_hbcontrol_must_send (const struct writer *wr, const struct whc_state *whcst, ddsrt_mtime_t tnow);
 struct nn_xmsg *writer_hbcontrol_create_heartbeat (struct writer *wr, const struct whc_state *whcst, ddsrt_mtime_t tnow, int hbansreq, int issync);
 
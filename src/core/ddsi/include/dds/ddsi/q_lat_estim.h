@@ -26,10 +26,12 @@ struct nn_lat_estim {
   int index;
   float window[NN_LAT_ESTIM_MEDIAN_WINSZ];
   /* simple alpha filtering for smoothing */
+  float alpha;
   float smoothed;
 };
 
 void nn_lat_estim_init (struct nn_lat_estim *le);
+void nn_lat_estim_init_alpha (struct nn_lat_estim *le, float alpha);
 void nn_lat_estim_fini (struct nn_lat_estim *le);
 void nn_lat_estim_update (struct nn_lat_estim *le, int64_t est);
 double nn_lat_estim_current (const struct nn_lat_estim *le);
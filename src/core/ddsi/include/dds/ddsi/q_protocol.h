@@ -109,6 +109,7 @@ typedef uint32_t nn_count_t;
 #define NN_LOCATOR_KIND_TCPv6 8
 #define NN_LOCATOR_KIND_SHEM 16
 #define NN_LOCATOR_KIND_RAWETH 0x8000 /* proposed vendor-specific */
+#define NN_LOCATOR_KIND_SHMEM 0x8001 /* vendor-specific: native shared memory transport */
 #define NN_LOCATOR_KIND_UDPv4MCGEN 0x4fff0000
 #define NN_LOCATOR_PORT_INVALID 0
 
@@ -162,7 +163,8 @@ typedef enum SubmessageKind {
   SMID_SRTPS_POSTFIX = 0x34,
   /* vendor-specific sub messages (0x80 .. 0xff) */
   SMID_ADLINK_MSG_LEN = 0x81,
-  SMID_ADLINK_ENTITY_ID = 0x82
+  SMID_ADLINK_ENTITY_ID = 0x82,
+  SMID_ADLINK_FEC = 0x83
 } SubmessageKind_t;
 
 typedef struct InfoTimestamp {
@@ -301,6 +303,29 @@ DDSRT_WARNING_MSVC_ON(4200)
 #define NACKFRAG_SIZE(numbits) (offsetof (NackFrag_t, bits) + NN_FRAGMENT_NUMBER_SET_BITS_SIZE (numbits) + 4)
 #define NACKFRAG_SIZE_MAX NACKFRAG_SIZE (NN_FRAGMENT_NUMBER_SET_MAX_BITS)
 
+/* Forward error correction: parity over the listed DATA/DATA_FRAG
+   submessages of a writer, see ddsi_fec.h */
+typedef struct FecMember {
+  nn_sequence_number_t writerSN;
+  nn_fragment_number_t fragmentStartingNum; /* 0 for a DATA submessage */
+  uint32_t length; /* of the submessage, including the header */
+  uint32_t checksum;
+  ddsi_time_t timestamp; /* from the preceding INFO_TS, or invalid */
+} FecMember_t;
+
+DDSRT_WARNING_MSVC_OFF(4200)
+typedef struct FecParity {
+  SubmessageHeader_t smhdr;
+  ddsi_entityid_t writerId;
+  uint16_t groupSize;
+  uint16_t reserved;
+  uint32_t paritySize;
+  FecMember_t members[];
+  /* unsigned char parity[paritySize]; */
+} FecParity_t;
+DDSRT_WARNING_MSVC_ON(4200)
+#define FEC_PARITY_SIZE(groupsize, paritysize) (offsetof (FecParity_t, members) + (groupsize) * sizeof (FecMember_t) + (paritysize))
+
 typedef union Submessage {
   SubmessageHeader_t smhdr;
   AckNack_t acknack;
@@ -313,6 +338,7 @@ typedef union Submessage {
   HeartbeatFrag_t heartbeatfrag;
   Gap_t gap;
   NackFrag_t nackfrag;
+  FecParity_t fec;
 } Submessage_t;
 
 #define PARTICIPANT_MESSAGE_DATA_KIND_UNKNOWN 0x0u
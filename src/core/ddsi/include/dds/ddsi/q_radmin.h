@@ -34,6 +34,8 @@ struct nn_rsample_chain;
 struct nn_rsample_info;
 struct nn_defrag;
 struct nn_reorder;
+struct nn_catchup;
+struct nn_catchup_cursor;
 struct nn_dqueue;
 struct ddsi_guid;
 struct ddsi_tran_conn;
@@ -102,6 +104,10 @@ struct nn_rmsg {
   /* whether to log */
   bool trace;
 
+  /* kernel receive timestamp, 0 if not available (only set if
+     Internal/MeasureReceiveLatency is enabled) */
+  ddsrt_wctime_t timestamp;
+
   struct nn_rmsg_chunk chunk;
 };
 DDSRT_STATIC_ASSERT (sizeof (struct nn_rmsg) == offsetof (struct nn_rmsg, chunk) + sizeof (struct nn_rmsg_chunk));
@@ -136,6 +142,7 @@ struct nn_rsample_info {
   uint32_t fragsize;
   ddsrt_wctime_t timestamp;
   ddsrt_wctime_t reception_timestamp; /* OpenSplice extension -- but we get it essentially for free, so why not? */
+  ddsrt_wctime_t enqueue_timestamp; /* first time queued for delivery, 0 if not (yet) or not measuring latency */
   unsigned statusinfo: 2;       /* just the two defined bits from the status info */
   unsigned bswap: 1;            /* so we can extract well formatted writer info quicker */
   unsigned complex_qos: 1;      /* includes QoS other than keyhash, 2-bit statusinfo, PT writer info */
@@ -197,6 +204,9 @@ enum nn_reorder_mode {
   NN_REORDER_MODE_ALWAYS_DELIVER
 };
 
+/* Upper bound on the size of the window of a reorder admin */
+#define NN_REORDER_MAX_WINDOW_SIZE 65536u
+
 enum nn_defrag_drop_mode {
   NN_DEFRAG_DROP_OLDEST,        /* (believed to be) best for unreliable */
   NN_DEFRAG_DROP_LATEST         /* (...) best for reliable  */
@@ -212,28 +222,43 @@ typedef int32_t nn_reorder_result_t;
 
 typedef void (*nn_dqueue_callback_t) (void *arg);
 
+/* Called by the shared secondary reorder admin for each cursor that advanced,
+   with the (possibly empty) chain of samples to be delivered to the reader
+   owning it; rres is the number of elements in the chain as for a reorder */
+typedef void (*nn_catchup_deliver_t) (void *cursor_arg, struct nn_rsample_chain *sc, nn_reorder_result_t rres, void *arg);
+
 struct ddsrt_log_cfg;
 struct nn_fragment_number_set_header;
 struct nn_sequence_number_set_header;
 
-struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size);
+struct nn_rbufpool_stats {
+  uint64_t recycled; /* number of released rbufs kept for reuse */
+  uint64_t hits;     /* number of new rbufs taken from the recycled ones */
+  uint64_t misses;   /* number of new rbufs that had to be allocated */
+};
+
+/* max_free is the maximum number of empty rbufs kept for reuse, 0 to free
+   them immediately; hugepages requests the buffers to be backed by huge
+   pages where the platform supports it */
+DDS_EXPORT struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size, uint32_t max_free, bool hugepages);
 void nn_rbufpool_setowner (struct nn_rbufpool *rbp, ddsrt_thread_t tid);
-void nn_rbufpool_free (struct nn_rbufpool *rbp);
+DDS_EXPORT void nn_rbufpool_free (struct nn_rbufpool *rbp);
+DDS_EXPORT void nn_rbufpool_get_stats (const struct nn_rbufpool *rbp, struct nn_rbufpool_stats *st);
 
-struct nn_rmsg *nn_rmsg_new (struct nn_rbufpool *rbufpool);
-void nn_rmsg_setsize (struct nn_rmsg *rmsg, uint32_t size);
-void nn_rmsg_commit (struct nn_rmsg *rmsg);
+DDS_EXPORT struct nn_rmsg *nn_rmsg_new (struct nn_rbufpool *rbufpool);
+DDS_EXPORT void nn_rmsg_setsize (struct nn_rmsg *rmsg, uint32_t size);
+DDS_EXPORT void nn_rmsg_commit (struct nn_rmsg *rmsg);
 void nn_rmsg_free (struct nn_rmsg *rmsg);
 void *nn_rmsg_alloc (struct nn_rmsg *rmsg, uint32_t size);
 
-struct nn_rdata *nn_rdata_new (struct nn_rmsg *rmsg, uint32_t start, uint32_t endp1, uint32_t submsg_offset, uint32_t payload_offset, uint32_t keyhash_offset);
-struct nn_rdata *nn_rdata_newgap (struct nn_rmsg *rmsg);
-void nn_fragchain_adjust_refcount (struct nn_rdata *frag, int adjust);
-void nn_fragchain_unref (struct nn_rdata *frag);
+DDS_EXPORT struct nn_rdata *nn_rdata_new (struct nn_rmsg *rmsg, uint32_t start, uint32_t endp1, uint32_t submsg_offset, uint32_t payload_offset, uint32_t keyhash_offset);
+DDS_EXPORT struct nn_rdata *nn_rdata_newgap (struct nn_rmsg *rmsg);
+DDS_EXPORT void nn_fragchain_adjust_refcount (struct nn_rdata *frag, int adjust);
+DDS_EXPORT void nn_fragchain_unref (struct nn_rdata *frag);
 
-struct nn_defrag *nn_defrag_new (const struct ddsrt_log_cfg *logcfg, enum nn_defrag_drop_mode drop_mode, uint32_t max_samples);
-void nn_defrag_free (struct nn_defrag *defrag);
-struct nn_rsample *nn_defrag_rsample (struct nn_defrag *defrag, struct nn_rdata *rdata, const struct nn_rsample_info *sampleinfo);
+DDS_EXPORT struct nn_defrag *nn_defrag_new (const struct ddsrt_log_cfg *logcfg, enum nn_defrag_drop_mode drop_mode, uint32_t max_samples);
+DDS_EXPORT void nn_defrag_free (struct nn_defrag *defrag);
+DDS_EXPORT struct nn_rsample *nn_defrag_rsample (struct nn_defrag *defrag, struct nn_rdata *rdata, const struct nn_rsample_info *sampleinfo);
 void nn_defrag_notegap (struct nn_defrag *defrag, seqno_t min, seqno_t maxp1);
 
 enum nn_defrag_nackmap_result {
@@ -246,18 +271,32 @@ enum nn_defrag_nackmap_result nn_defrag_nackmap (struct nn_defrag *defrag, seqno
 
 void nn_defrag_prune (struct nn_defrag *defrag, ddsi_guid_prefix_t *dst, seqno_t min);
 
-struct nn_reorder *nn_reorder_new (const struct ddsrt_log_cfg *logcfg, enum nn_reorder_mode mode, uint32_t max_samples, bool late_ack_mode);
-void nn_reorder_free (struct nn_reorder *r);
-struct nn_rsample *nn_reorder_rsample_dup_first (struct nn_rmsg *rmsg, struct nn_rsample *rsampleiv);
-struct nn_rdata *nn_rsample_fragchain (struct nn_rsample *rsample);
-nn_reorder_result_t nn_reorder_rsample (struct nn_rsample_chain *sc, struct nn_reorder *reorder, struct nn_rsample *rsampleiv, int *refcount_adjust, int delivery_queue_full_p);
-nn_reorder_result_t nn_reorder_gap (struct nn_rsample_chain *sc, struct nn_reorder *reorder, struct nn_rdata *rdata, seqno_t min, seqno_t maxp1, int *refcount_adjust);
+DDS_EXPORT struct nn_reorder *nn_reorder_new (const struct ddsrt_log_cfg *logcfg, enum nn_reorder_mode mode, uint32_t max_samples, uint32_t window_size, bool late_ack_mode);
+DDS_EXPORT void nn_reorder_free (struct nn_reorder *r);
+DDS_EXPORT struct nn_rsample *nn_reorder_rsample_dup_first (struct nn_rmsg *rmsg, struct nn_rsample *rsampleiv);
+DDS_EXPORT struct nn_rdata *nn_rsample_fragchain (struct nn_rsample *rsample);
+DDS_EXPORT nn_reorder_result_t nn_reorder_rsample (struct nn_rsample_chain *sc, struct nn_reorder *reorder, struct nn_rsample *rsampleiv, int *refcount_adjust, int delivery_queue_full_p);
+DDS_EXPORT nn_reorder_result_t nn_reorder_gap (struct nn_rsample_chain *sc, struct nn_reorder *reorder, struct nn_rdata *rdata, seqno_t min, seqno_t maxp1, int *refcount_adjust);
 void nn_reorder_drop_upto (struct nn_reorder *reorder, seqno_t maxp1); // drops [1,maxp1); next_seq' = maxp1
-int nn_reorder_wantsample (const struct nn_reorder *reorder, seqno_t seq);
-unsigned nn_reorder_nackmap (const struct nn_reorder *reorder, seqno_t base, seqno_t maxseq, struct nn_sequence_number_set_header *map, uint32_t *mapbits, uint32_t maxsz, int notail);
-seqno_t nn_reorder_next_seq (const struct nn_reorder *reorder);
+DDS_EXPORT int nn_reorder_wantsample (const struct nn_reorder *reorder, seqno_t seq);
+DDS_EXPORT unsigned nn_reorder_nackmap (const struct nn_reorder *reorder, seqno_t base, seqno_t maxseq, struct nn_sequence_number_set_header *map, uint32_t *mapbits, uint32_t maxsz, int notail);
+DDS_EXPORT seqno_t nn_reorder_next_seq (const struct nn_reorder *reorder);
 void nn_reorder_set_next_seq (struct nn_reorder *reorder, seqno_t seq);
 
+DDS_EXPORT struct nn_catchup *nn_catchup_new (const struct ddsrt_log_cfg *logcfg, uint32_t max_samples);
+DDS_EXPORT void nn_catchup_free (struct nn_catchup *c);
+DDS_EXPORT struct nn_catchup_cursor *nn_catchup_add_cursor (struct nn_catchup *c, void *arg);
+DDS_EXPORT void nn_catchup_remove_cursor (struct nn_catchup *c, struct nn_catchup_cursor *cur);
+DDS_EXPORT seqno_t nn_catchup_cursor_next_seq (const struct nn_catchup_cursor *cur);
+DDS_EXPORT seqno_t nn_catchup_min_next_seq (const struct nn_catchup *c); // MAX_SEQ_NUMBER if no cursors
+DDS_EXPORT uint32_t nn_catchup_ncursors (const struct nn_catchup *c);
+DDS_EXPORT nn_reorder_result_t nn_catchup_rsample (struct nn_catchup *c, struct nn_rmsg *rmsg, struct nn_rsample *rsampleiv, int *refcount_adjust, int delivery_queue_full_p, nn_catchup_deliver_t deliver, void *deliver_arg);
+DDS_EXPORT uint32_t nn_catchup_gap (struct nn_catchup *c, struct nn_rdata *rdata, seqno_t min, seqno_t maxp1, int *refcount_adjust, nn_catchup_deliver_t deliver, void *deliver_arg);
+DDS_EXPORT nn_reorder_result_t nn_catchup_cursor_gap (struct nn_catchup *c, struct nn_catchup_cursor *cur, struct nn_rdata *rdata, seqno_t min, seqno_t maxp1, int *refcount_adjust, nn_catchup_deliver_t deliver, void *deliver_arg);
+DDS_EXPORT int nn_catchup_wantsample (const struct nn_catchup *c, const struct nn_catchup_cursor *cur, seqno_t seq);
+DDS_EXPORT unsigned nn_catchup_nackmap (const struct nn_catchup *c, const struct nn_catchup_cursor *cur, seqno_t maxseq, struct nn_sequence_number_set_header *map, uint32_t *mapbits, uint32_t maxsz, int notail);
+DDS_EXPORT void nn_catchup_stats (const struct nn_catchup *c, uint64_t *discarded_bytes);
+
 struct nn_dqueue *nn_dqueue_new (const char *name, const struct ddsi_domaingv *gv, uint32_t max_samples, nn_dqueue_handler_t handler, void *arg);
 void nn_dqueue_free (struct nn_dqueue *q);
 bool nn_dqueue_enqueue_deferred_wakeup (struct nn_dqueue *q, struct nn_rsample_chain *sc, nn_reorder_result_t rres);
@@ -269,7 +308,7 @@ int  nn_dqueue_is_full (struct nn_dqueue *q);
 void nn_dqueue_wait_until_empty_if_full (struct nn_dqueue *q);
 
 void nn_defrag_stats (struct nn_defrag *defrag, uint64_t *discarded_bytes);
-void nn_reorder_stats (struct nn_reorder *reorder, uint64_t *discarded_bytes);
+DDS_EXPORT void nn_reorder_stats (struct nn_reorder *reorder, uint64_t *discarded_bytes);
 
 #if defined (__cplusplus)
 }
@@ -33,8 +33,16 @@ struct thread_state1;
 
    "nogc": no GC may occur, so it may not block to throttle the writer if the high water mark of the WHC is reached, which implies true KEEP_LAST behaviour.  This is true for all the DDSI built-in writers.
    "gc": GC may occur, which means the writer history and watermarks can be anything.  This must be used for all application data.
+   "gc_nonblocking": as "gc", but returns DDS_RETCODE_TRY_AGAIN instead of throttling the writer when the high water mark of the WHC is reached.  The writer's status callback is then invoked with DDS_WRITER_READY_STATUS_ID once it drops below the low water mark.
  */
 int write_sample_gc (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk);
+int write_sample_gc_nonblocking (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk);
+
+/* Writes "n" samples as write_sample_gc would, but assigning the sequence numbers and
+   inserting them in the WHC while holding the writer lock only once, and following them
+   with at most one heartbeat.  All serdata are unref'd, the first "*nwritten" have been
+   written, even if an error is returned. */
+dds_return_t write_sample_batch_gc (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, uint32_t n, struct ddsi_serdata **serdata, struct ddsi_tkmap_instance **tk, uint32_t *nwritten);
 int write_sample_nogc (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk);
 int write_sample_gc_notk (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata);
 int write_sample_nogc_notk (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata);
@@ -78,6 +78,15 @@ typedef uint32_t (*whc_downgrade_to_volatile_t)(struct whc *whc, struct whc_stat
 typedef uint32_t (*whc_remove_acked_messages_t)(struct whc *whc, seqno_t max_drop_seq, struct whc_state *whcst, struct whc_node **deferred_free_list);
 typedef void (*whc_free_deferred_free_list_t)(struct whc *whc, struct whc_node *deferred_free_list);
 
+/* WHC implementations that don't hand out a list of whc_nodes from
+   remove_acked_messages, but still have work for free_deferred_free_list
+   to do outside the writer lock, return one of these as the deferred free
+   list: the first if the cost of that work is proportional to the number of
+   samples removed, the second if it is expensive regardless (e.g., I/O) and
+   must not be done by the thread handling the acknowledgement */
+extern struct whc_node whc_deferred_work_marker;
+extern struct whc_node whc_deferred_slow_work_marker;
+
 struct whc_ops {
   whc_insert_t insert;
   whc_remove_acked_messages_t remove_acked_messages;
@@ -12,6 +12,8 @@
 #ifndef NN_XEVENT_H
 #define NN_XEVENT_H
 
+#include <stdbool.h>
+
 #include "dds/ddsrt/retcode.h"
 #include "dds/ddsi/ddsi_guid.h"
 
@@ -51,8 +53,34 @@ DDS_EXPORT void qxev_prd_entityid (struct proxy_reader * prd, const ddsi_guid_t
 DDS_EXPORT void qxev_nt_callback (struct xeventq *evq, void (*cb) (void *arg), void *arg);
 
 /* Returns 1 if queued, 0 otherwise (no point in returning the
-   event, you can't do anything with it anyway) */
-DDS_EXPORT int qxev_msg_rexmit_wrlock_held (struct xeventq *evq, struct nn_xmsg *msg, int force);
+   event, you can't do anything with it anyway).  Retransmits are
+   paced per destination: prd is the proxy reader for which it is
+   intended, or NULL if it is addressed to all readers */
+DDS_EXPORT int qxev_msg_rexmit_wrlock_held (struct xeventq *evq, struct nn_xmsg *msg, int force, const struct proxy_reader *prd);
+
+struct xeventq_rexmit_stats {
+  uint64_t bytes; /* cum bytes retransmitted */
+  uint32_t msgs; /* cum messages retransmitted */
+  uint32_t dropped; /* cum messages dropped because the retransmit queue was full */
+  uint32_t queued; /* messages currently queued */
+  uint32_t rate; /* recent retransmit rate in bytes/s */
+};
+
+/* Retrieves retransmit statistics for destination dst (a proxy reader GUID, or the
+   all-zero GUID for retransmits to all readers), returns false if there are none */
+DDS_EXPORT bool xeventq_get_rexmit_stats (struct xeventq *evq, const ddsi_guid_t *dst, struct xeventq_rexmit_stats *st);
+
+/* Releases the retransmit administration for dst once no more retransmits are queued for it */
+DDS_EXPORT void xeventq_forget_rexmit_destination (struct xeventq *evq, const ddsi_guid_t *dst);
+
+struct xeventq_heartbeat_stats {
+  uint64_t heartbeats; /* cum heartbeats sent by heartbeat events */
+  uint64_t packets_saved; /* cum heartbeats that didn't need a packet of their own */
+};
+
+/* Heartbeats due at about the same time are grouped by destination to
+   minimise the number of packets */
+DDS_EXPORT void xeventq_get_heartbeat_stats (struct xeventq *evq, struct xeventq_heartbeat_stats *st);
 
 /* All of the following lock EVQ for the duration of the operation */
 DDS_EXPORT void delete_xevent (struct xevent *ev);
@@ -15,6 +15,7 @@
 #include <stddef.h>
 
 #include "dds/ddsrt/bswap.h"
+#include "dds/ddsrt/sync.h"
 #include "dds/ddsi/q_protocol.h" /* for, e.g., SubmessageKind_t */
 //#include "dds/ddsi/ddsi_xqos.h" /* for, e.g., octetseq, stringseq */
 #include "dds/ddsi/ddsi_tran.h"
@@ -129,11 +130,22 @@ void nn_xmsg_setwriterseq_fragid (struct nn_xmsg *msg, const ddsi_guid_t *wrguid
    guid, sequence number and fragment id */
 int nn_xmsg_compare_fragid (const struct nn_xmsg *a, const struct nn_xmsg *b);
 
+/* Returns true if a and b go to the same destination and could therefore
+   be packed into a single RTPS message; like addrset_eq_onesidederr it may
+   return false for messages that do */
+bool nn_xmsg_same_dst_onesidederr (const struct nn_xmsg *a, const struct nn_xmsg *b);
+
 void nn_xmsg_free (struct nn_xmsg *msg);
 size_t nn_xmsg_size (const struct nn_xmsg *m);
 void *nn_xmsg_payload (size_t *sz, struct nn_xmsg *m);
 void nn_xmsg_payload_to_plistsample (struct ddsi_plist_sample *dst, nn_parameterid_t keyparam, const struct nn_xmsg *m);
 enum nn_xmsg_kind nn_xmsg_kind (const struct nn_xmsg *m);
+
+/* Locates the (first) DATA or DATA_FRAG submessage in m, returning it as one
+   or two pieces (the header part and the referenced payload), together with
+   the timestamp of the INFO_TS preceding it (DDSI_TIME_INVALID if none).
+   Returns false if m doesn't contain such a submessage. */
+bool nn_xmsg_data_submsg (const struct nn_xmsg *m, ddsrt_iovec_t iov[2], uint32_t *niov, ddsi_time_t *timestamp);
 void nn_xmsg_guid_seq_fragid (const struct nn_xmsg *m, ddsi_guid_t *wrguid, seqno_t *wrseq, nn_fragment_number_t *wrfragid);
 
 void *nn_xmsg_submsg_from_marker (struct nn_xmsg *msg, struct nn_xmsg_marker marker);
@@ -167,6 +179,20 @@ int nn_xpack_addmsg (struct nn_xpack *xp, struct nn_xmsg *m, const uint32_t flag
 int64_t nn_xpack_maxdelay (const struct nn_xpack *xp);
 unsigned nn_xpack_packetid (const struct nn_xpack *xp);
 
+/* Selects the transmit socket from the pool (Internal/TransmitSockets) based
+   on the GUID, for sending all data of a writer via the same socket */
+void nn_xpack_select_xmit_conn (struct nn_xpack *xp, const ddsi_guid_t *guid);
+
+/* Adaptive batching for an xpack in async mode that is protected by
+   "owner_lock": nn_xpack_send_or_defer (called with owner_lock held after
+   adding data) lets the data linger for at most the smallest latency budget
+   of the messages in it, relying on the sendq thread to flush it, unless
+   the rate at which it is called is too low for batching to be of any use.
+   nn_xpack_disable_adaptive must be called before freeing the xpack. */
+void nn_xpack_enable_adaptive (struct nn_xpack *xp, ddsrt_mutex_t *owner_lock);
+void nn_xpack_disable_adaptive (struct nn_xpack *xp);
+void nn_xpack_send_or_defer (struct nn_xpack *xp);
+
 /* SENDQ */
 void nn_xpack_sendq_init (struct ddsi_domaingv *gv);
 void nn_xpack_sendq_start (struct ddsi_domaingv *gv);
@@ -118,14 +118,22 @@ struct add_AckNack_info {
 
 static bool add_AckNack_makebitmaps (const struct proxy_writer *pwr, const struct pwr_rd_match *rwn, struct add_AckNack_info *info)
 {
-  struct nn_reorder *reorder;
-  seqno_t bitmap_base;
-  int notail; /* notail = false: all known missing ones are nack'd */
-  add_AckNack_getsource (pwr, rwn, &reorder, &bitmap_base, &notail);
-
   /* Make bitmap; note that we've made sure to have room for the maximum bitmap size. */
   const seqno_t last_seq = rwn->filtered ? rwn->last_seq : pwr->last_seq;
-  const uint32_t numbits = nn_reorder_nackmap (reorder, bitmap_base, last_seq, &info->acknack.set, info->acknack.bits, NN_SEQUENCE_NUMBER_SET_MAX_BITS, notail);
+  uint32_t numbits;
+  if (rwn->in_sync == PRMSS_OUT_OF_SYNC && rwn->u.not_in_sync.cursor)
+  {
+    /* out-of-sync reader served from the proxy writer's shared admin */
+    numbits = nn_catchup_nackmap (pwr->catchup, rwn->u.not_in_sync.cursor, last_seq, &info->acknack.set, info->acknack.bits, NN_SEQUENCE_NUMBER_SET_MAX_BITS, 0);
+  }
+  else
+  {
+    struct nn_reorder *reorder;
+    seqno_t bitmap_base;
+    int notail; /* notail = false: all known missing ones are nack'd */
+    add_AckNack_getsource (pwr, rwn, &reorder, &bitmap_base, &notail);
+    numbits = nn_reorder_nackmap (reorder, bitmap_base, last_seq, &info->acknack.set, info->acknack.bits, NN_SEQUENCE_NUMBER_SET_MAX_BITS, notail);
+  }
   if (numbits == 0)
   {
     info->nackfrag.seq = 0;
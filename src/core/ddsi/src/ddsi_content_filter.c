@@ -0,0 +1,253 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsi/ddsi_content_filter.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_sertype.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/ddsi_entity_index.h"
+#include "dds/ddsi/q_misc.h"
+#include "dds/ddsi/sysdeps.h"
+
+void ddsi_content_filter_classes_init (struct ddsi_domaingv *gv)
+{
+  ddsrt_mutex_init (&gv->content_filter_classes_lock);
+  gv->content_filter_classes = NULL;
+}
+
+void ddsi_content_filter_classes_fini (struct ddsi_domaingv *gv)
+{
+  struct ddsi_content_filter_class *fc;
+  while ((fc = gv->content_filter_classes) != NULL)
+  {
+    gv->content_filter_classes = fc->next;
+    ddsrt_free (fc->name);
+    ddsrt_free (fc);
+  }
+  ddsrt_mutex_destroy (&gv->content_filter_classes_lock);
+}
+
+static struct ddsi_content_filter_class *lookup_class_locked (const struct ddsi_domaingv *gv, const char *name)
+{
+  struct ddsi_content_filter_class *fc;
+  for (fc = gv->content_filter_classes; fc; fc = fc->next)
+    if (strcmp (fc->name, name) == 0)
+      break;
+  return fc;
+}
+
+dds_return_t ddsi_content_filter_class_register (struct ddsi_domaingv *gv, const char *name, dds_content_filter_class_fn accept, void *arg)
+{
+  dds_return_t ret = DDS_RETCODE_OK;
+  if (name == NULL || *name == 0 || accept == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+  ddsrt_mutex_lock (&gv->content_filter_classes_lock);
+  if (lookup_class_locked (gv, name) != NULL)
+    ret = DDS_RETCODE_PRECONDITION_NOT_MET;
+  else
+  {
+    struct ddsi_content_filter_class *fc = ddsrt_malloc (sizeof (*fc));
+    fc->name = ddsrt_strdup (name);
+    fc->accept = accept;
+    fc->arg = arg;
+    fc->next = gv->content_filter_classes;
+    gv->content_filter_classes = fc;
+  }
+  ddsrt_mutex_unlock (&gv->content_filter_classes_lock);
+  return ret;
+}
+
+static char *strdup_or_empty (const char *s)
+{
+  return ddsrt_strdup (s ? s : "");
+}
+
+struct ddsi_content_filter *ddsi_content_filter_new (const nn_content_filter_property_t *prop)
+{
+  struct ddsi_content_filter *cf = ddsrt_malloc (sizeof (*cf));
+  cf->prop.content_filtered_topic_name = strdup_or_empty (prop->content_filtered_topic_name);
+  cf->prop.related_topic_name = strdup_or_empty (prop->related_topic_name);
+  cf->prop.filter_class_name = strdup_or_empty (prop->filter_class_name);
+  cf->prop.filter_expression = strdup_or_empty (prop->filter_expression);
+  cf->prop.expression_parameters.n = prop->expression_parameters.n;
+  cf->prop.expression_parameters.strs = NULL;
+  if (prop->expression_parameters.n > 0)
+  {
+    cf->prop.expression_parameters.strs = ddsrt_malloc (prop->expression_parameters.n * sizeof (*cf->prop.expression_parameters.strs));
+    for (uint32_t i = 0; i < prop->expression_parameters.n; i++)
+      cf->prop.expression_parameters.strs[i] = strdup_or_empty (prop->expression_parameters.strs[i]);
+  }
+  ddsrt_atomic_stvoidp (&cf->fclass, NULL);
+  return cf;
+}
+
+static const char *lookup_property (const dds_qos_t *xqos, const char *name)
+{
+  if (!(xqos->present & QP_PROPERTY_LIST))
+    return NULL;
+  for (uint32_t i = 0; i < xqos->property.value.n; i++)
+    if (strcmp (xqos->property.value.props[i].name, name) == 0)
+      return xqos->property.value.props[i].value;
+  return NULL;
+}
+
+struct ddsi_content_filter *ddsi_content_filter_new_from_qos (const dds_qos_t *xqos)
+{
+  const char *fclass, *expr;
+  if ((fclass = lookup_property (xqos, DDS_CONTENT_FILTER_CLASS_PROPERTY)) == NULL || *fclass == 0)
+    return NULL;
+  if ((expr = lookup_property (xqos, DDS_CONTENT_FILTER_EXPRESSION_PROPERTY)) == NULL)
+    return NULL;
+  /* parameters are numbered from 0 and end at the first one missing; there
+     are at most 100 of them in the SQL filter grammar */
+  const char *params[100];
+  uint32_t nparams = 0;
+  while (nparams < sizeof (params) / sizeof (params[0]))
+  {
+    char name[sizeof (DDS_CONTENT_FILTER_PARAMETER_PROPERTY_PREFIX) + 3];
+    (void) snprintf (name, sizeof (name), "%s%"PRIu32, DDS_CONTENT_FILTER_PARAMETER_PROPERTY_PREFIX, nparams);
+    if ((params[nparams] = lookup_property (xqos, name)) == NULL)
+      break;
+    nparams++;
+  }
+  const char *topic_name = (xqos->present & QP_TOPIC_NAME) ? xqos->topic_name : "";
+  nn_content_filter_property_t prop = {
+    .content_filtered_topic_name = (char *) topic_name,
+    .related_topic_name = (char *) topic_name,
+    .filter_class_name = (char *) fclass,
+    .filter_expression = (char *) expr,
+    .expression_parameters = { .n = nparams, .strs = (char **) params }
+  };
+  return ddsi_content_filter_new (&prop);
+}
+
+void ddsi_content_filter_free (struct ddsi_content_filter *cf)
+{
+  if (cf == NULL)
+    return;
+  ddsrt_free (cf->prop.content_filtered_topic_name);
+  ddsrt_free (cf->prop.related_topic_name);
+  ddsrt_free (cf->prop.filter_class_name);
+  ddsrt_free (cf->prop.filter_expression);
+  for (uint32_t i = 0; i < cf->prop.expression_parameters.n; i++)
+    ddsrt_free (cf->prop.expression_parameters.strs[i]);
+  ddsrt_free (cf->prop.expression_parameters.strs);
+  ddsrt_free (cf);
+}
+
+bool ddsi_content_filter_equal (const struct ddsi_content_filter *a, const struct ddsi_content_filter *b)
+{
+  if (a == b)
+    return true;
+  if (strcmp (a->prop.related_topic_name, b->prop.related_topic_name) != 0 ||
+      strcmp (a->prop.filter_class_name, b->prop.filter_class_name) != 0 ||
+      strcmp (a->prop.filter_expression, b->prop.filter_expression) != 0 ||
+      a->prop.expression_parameters.n != b->prop.expression_parameters.n)
+    return false;
+  for (uint32_t i = 0; i < a->prop.expression_parameters.n; i++)
+    if (strcmp (a->prop.expression_parameters.strs[i], b->prop.expression_parameters.strs[i]) != 0)
+      return false;
+  return true;
+}
+
+static const struct ddsi_content_filter_class *resolve_class (struct ddsi_domaingv *gv, struct ddsi_content_filter *cf)
+{
+  const struct ddsi_content_filter_class *fc;
+  if ((fc = ddsrt_atomic_ldvoidp (&cf->fclass)) == NULL)
+  {
+    /* Classes may be registered after discovery of the reader, so keep
+       trying until it is found; the list is short and this only happens
+       while the filter is unresolved */
+    ddsrt_mutex_lock (&gv->content_filter_classes_lock);
+    fc = lookup_class_locked (gv, cf->prop.filter_class_name);
+    ddsrt_mutex_unlock (&gv->content_filter_classes_lock);
+    if (fc != NULL)
+      ddsrt_atomic_stvoidp (&cf->fclass, (void *) fc);
+  }
+  return fc;
+}
+
+bool ddsi_content_filter_classes_registered (struct ddsi_domaingv *gv)
+{
+  ddsrt_mutex_lock (&gv->content_filter_classes_lock);
+  const bool ret = (gv->content_filter_classes != NULL);
+  ddsrt_mutex_unlock (&gv->content_filter_classes_lock);
+  return ret;
+}
+
+bool ddsi_content_filter_resolved (struct ddsi_domaingv *gv, struct ddsi_content_filter *cf)
+{
+  return resolve_class (gv, cf) != NULL;
+}
+
+bool ddsi_content_filter_accepts_sample (struct ddsi_domaingv *gv, struct ddsi_content_filter *cf, const void *sample)
+{
+  const struct ddsi_content_filter_class *fc;
+  if ((fc = resolve_class (gv, cf)) == NULL)
+    return true;
+  return fc->accept (sample, cf->prop.filter_expression, cf->prop.expression_parameters.n, (const char * const *) cf->prop.expression_parameters.strs, fc->arg);
+}
+
+bool ddsi_content_filter_accepts (struct ddsi_domaingv *gv, struct ddsi_content_filter *cf, const struct ddsi_serdata *serdata)
+{
+  if (serdata->kind != SDK_DATA)
+    return true;
+  if (resolve_class (gv, cf) == NULL)
+    return true;
+  void *sample = ddsi_sertype_alloc_sample (serdata->type);
+  bool ret = true;
+  if (ddsi_serdata_to_sample (serdata, sample, NULL, NULL))
+    ret = ddsi_content_filter_accepts_sample (gv, cf, sample);
+  ddsi_sertype_free_sample (serdata->type, sample, DDS_FREE_ALL);
+  return ret;
+}
+
+bool ddsi_content_filter_shared_receiver (const struct proxy_reader *a, const struct proxy_reader *b)
+{
+  return vendor_is_eclipse (a->c.vendor) && vendor_is_eclipse (b->c.vendor) && a->e.guid.prefix.u[0] == b->e.guid.prefix.u[0];
+}
+
+int ddsi_content_filter_prd (struct writer *wr, struct proxy_reader *prd, struct ddsi_serdata *serdata)
+{
+  struct ddsi_domaingv * const gv = wr->e.gv;
+  assert (prd->content_filter != NULL);
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  if (serdata->kind != SDK_DATA || resolve_class (gv, prd->content_filter) == NULL)
+    return 1;
+  void *sample = ddsi_sertype_alloc_sample (serdata->type);
+  int ret = 1;
+  if (ddsi_serdata_to_sample (serdata, sample, NULL, NULL) && !ddsi_content_filter_accepts_sample (gv, prd->content_filter, sample))
+  {
+    ddsrt_avl_iter_t it;
+    ret = 0;
+    for (struct wr_prd_match *m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->readers, &it); m && ret == 0; m = ddsrt_avl_iter_next (&it))
+    {
+      struct proxy_reader *prd1;
+      if (guid_eq (&m->prd_guid, &prd->e.guid) ||
+          (prd1 = entidx_lookup_proxy_reader_guid (gv->entity_index, &m->prd_guid)) == NULL ||
+          !ddsi_content_filter_shared_receiver (prd, prd1))
+        continue;
+      if (prd1->content_filter == NULL || ddsi_content_filter_accepts_sample (gv, prd1->content_filter, sample))
+        ret = 1;
+    }
+  }
+  ddsi_sertype_free_sample (serdata->type, sample, DDS_FREE_ALL);
+  return ret;
+}
@@ -0,0 +1,305 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/endian.h"
+#include "dds/ddsi/ddsi_fec.h"
+#include "dds/ddsi/q_bswap.h"
+#include "dds/ddsi/q_misc.h"
+
+/* Initial number of submessages cached per proxy writer, grows to twice the
+   largest group size seen so all members of a group are still present when
+   the parity arrives, even if another group has started in the meantime */
+#define FEC_INITIAL_CACHE_SIZE 16u
+
+struct ddsi_fec_encoder {
+  uint32_t group_size;
+  uint32_t n;             /* number of members in current group */
+  uint32_t parity_size;   /* length of longest member in current group */
+  uint32_t parity_alloc;  /* allocated size of parity, beyond parity_size it is all 0 */
+  unsigned char *parity;
+  FecMember_t *members;
+};
+
+struct ddsi_fec_cached {
+  seqno_t seq;
+  nn_fragment_number_t fragnum;
+  uint32_t size;
+  uint32_t alloc;
+  unsigned char *data;
+};
+
+struct ddsi_fec_decoder {
+  uint32_t ncache;
+  uint32_t next;
+  struct ddsi_fec_cached *cache;
+  struct ddsi_fec_decoder_stats stats;
+};
+
+static uint32_t fec_checksum (uint32_t h, const unsigned char *p, size_t n)
+{
+  /* Only meant for catching a reconstruction from the wrong inputs, it
+     needn't be strong, but it must be cheap and sensitive to position */
+  size_t i;
+  for (i = 0; i + 4 <= n; i += 4)
+  {
+    uint32_t w;
+    memcpy (&w, p + i, sizeof (w));
+    h = ((h << 5) | (h >> 27)) ^ w;
+    h *= 0x9e3779b1u;
+  }
+  if (i < n)
+  {
+    uint32_t w = 0;
+    memcpy (&w, p + i, n - i);
+    h = ((h << 5) | (h >> 27)) ^ w;
+    h *= 0x9e3779b1u;
+  }
+  return h;
+}
+
+static void fec_xor (unsigned char * __restrict dst, const unsigned char * __restrict src, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    dst[i] ^= src[i];
+}
+
+struct ddsi_fec_encoder *ddsi_fec_encoder_new (uint32_t group_size)
+{
+  struct ddsi_fec_encoder *enc = ddsrt_malloc (sizeof (*enc));
+  assert (group_size > 0 && group_size <= DDSI_FEC_MAX_GROUP_SIZE);
+  enc->group_size = group_size;
+  enc->n = 0;
+  enc->parity_size = 0;
+  enc->parity_alloc = 0;
+  enc->parity = NULL;
+  enc->members = ddsrt_malloc (group_size * sizeof (*enc->members));
+  return enc;
+}
+
+void ddsi_fec_encoder_free (struct ddsi_fec_encoder *enc)
+{
+  ddsrt_free (enc->parity);
+  ddsrt_free (enc->members);
+  ddsrt_free (enc);
+}
+
+bool ddsi_fec_encoder_add (struct ddsi_fec_encoder *enc, const ddsrt_iovec_t *iov, uint32_t niov, ddsi_time_t timestamp)
+{
+  FecMember_t * const m = &enc->members[enc->n];
+  Data_DataFrag_common_t hdr;
+  uint32_t size = 0, off = 0, checksum = 0;
+
+  assert (enc->n < enc->group_size);
+  assert (niov > 0 && iov[0].iov_len >= sizeof (Data_t));
+  for (uint32_t i = 0; i < niov; i++)
+    size += (uint32_t) iov[i].iov_len;
+  if (size > enc->parity_alloc)
+  {
+    enc->parity = ddsrt_realloc (enc->parity, size);
+    memset (enc->parity + enc->parity_alloc, 0, size - enc->parity_alloc);
+    enc->parity_alloc = size;
+  }
+  for (uint32_t i = 0; i < niov; i++)
+  {
+    /* pieces are all multiples of 4 bytes, except perhaps the last,
+       so checksumming them one by one is the same as doing the whole */
+    assert (i + 1 == niov || (iov[i].iov_len % 4) == 0);
+    fec_xor (enc->parity + off, iov[i].iov_base, iov[i].iov_len);
+    checksum = fec_checksum (checksum, iov[i].iov_base, iov[i].iov_len);
+    off += (uint32_t) iov[i].iov_len;
+  }
+  if (size > enc->parity_size)
+    enc->parity_size = size;
+
+  memcpy (&hdr, iov[0].iov_base, sizeof (hdr));
+  m->writerSN = hdr.writerSN;
+  if (hdr.smhdr.submessageId != SMID_DATA_FRAG)
+    m->fragmentStartingNum = 0;
+  else
+  {
+    DataFrag_t frag;
+    assert (iov[0].iov_len >= sizeof (frag));
+    memcpy (&frag, iov[0].iov_base, sizeof (frag));
+    m->fragmentStartingNum = frag.fragmentStartingNum;
+  }
+  m->length = size;
+  m->checksum = checksum;
+  m->timestamp = timestamp;
+  return ++enc->n == enc->group_size;
+}
+
+size_t ddsi_fec_encoder_parity_size (const struct ddsi_fec_encoder *enc)
+{
+  return FEC_PARITY_SIZE (enc->n, (enc->parity_size + 3) & ~3u);
+}
+
+void ddsi_fec_encoder_fill (struct ddsi_fec_encoder *enc, FecParity_t *msg)
+{
+  const uint32_t parity_size = (enc->parity_size + 3) & ~3u;
+  unsigned char *parity = (unsigned char *) &msg->members[enc->n];
+  msg->groupSize = (uint16_t) enc->n;
+  msg->reserved = 0;
+  msg->paritySize = parity_size;
+  memcpy (msg->members, enc->members, enc->n * sizeof (*enc->members));
+  memcpy (parity, enc->parity, enc->parity_size);
+  memset (parity + enc->parity_size, 0, parity_size - enc->parity_size);
+  ddsi_fec_encoder_reset (enc);
+}
+
+void ddsi_fec_encoder_reset (struct ddsi_fec_encoder *enc)
+{
+  memset (enc->parity, 0, enc->parity_size);
+  enc->n = 0;
+  enc->parity_size = 0;
+}
+
+struct ddsi_fec_decoder *ddsi_fec_decoder_new (void)
+{
+  struct ddsi_fec_decoder *dec = ddsrt_malloc (sizeof (*dec));
+  dec->ncache = FEC_INITIAL_CACHE_SIZE;
+  dec->next = 0;
+  dec->cache = ddsrt_calloc (dec->ncache, sizeof (*dec->cache));
+  memset (&dec->stats, 0, sizeof (dec->stats));
+  return dec;
+}
+
+void ddsi_fec_decoder_free (struct ddsi_fec_decoder *dec)
+{
+  for (uint32_t i = 0; i < dec->ncache; i++)
+    ddsrt_free (dec->cache[i].data);
+  ddsrt_free (dec->cache);
+  ddsrt_free (dec);
+}
+
+void ddsi_fec_decoder_note (struct ddsi_fec_decoder *dec, const unsigned char *submsg, uint32_t size)
+{
+  struct ddsi_fec_cached * const c = &dec->cache[dec->next];
+  union { Data_DataFrag_common_t x; DataFrag_t frag; } h;
+  bool bswap, isfrag;
+
+  assert (size >= sizeof (Data_t));
+  memcpy (&h.x, submsg, sizeof (h.x));
+  isfrag = (h.x.smhdr.submessageId == SMID_DATA_FRAG && size >= sizeof (DataFrag_t));
+  if (isfrag)
+    memcpy (&h.frag, submsg, sizeof (h.frag));
+  DDSRT_WARNING_MSVC_OFF(6326)
+  bswap = (h.x.smhdr.flags & SMFLAG_ENDIANNESS) ? (DDSRT_ENDIAN != DDSRT_LITTLE_ENDIAN) : (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN);
+  DDSRT_WARNING_MSVC_ON(6326)
+  c->seq = fromSN (h.x.writerSN);
+  c->fragnum = isfrag ? h.frag.fragmentStartingNum : 0;
+
+  if (size > c->alloc)
+  {
+    c->data = ddsrt_realloc (c->data, size);
+    c->alloc = size;
+  }
+  memcpy (c->data, submsg, size);
+  c->size = size;
+
+  /* The receive path converts the fixed part of the submessage to native
+     byte order in place, so what we got isn't quite what was sent, but it
+     is easily restored */
+  h.x.smhdr.octetsToNextHeader = (uint16_t) (size - RTPS_SUBMESSAGE_HEADER_SIZE);
+  h.x.readerId = nn_hton_entityid (h.x.readerId);
+  h.x.writerId = nn_hton_entityid (h.x.writerId);
+  if (bswap)
+  {
+    h.x.smhdr.octetsToNextHeader = ddsrt_bswap2u (h.x.smhdr.octetsToNextHeader);
+    h.x.extraFlags = ddsrt_bswap2u (h.x.extraFlags);
+    h.x.octetsToInlineQos = ddsrt_bswap2u (h.x.octetsToInlineQos);
+    bswapSN (&h.x.writerSN);
+    if (isfrag)
+    {
+      h.frag.fragmentStartingNum = ddsrt_bswap4u (h.frag.fragmentStartingNum);
+      h.frag.fragmentsInSubmessage = ddsrt_bswap2u (h.frag.fragmentsInSubmessage);
+      h.frag.fragmentSize = ddsrt_bswap2u (h.frag.fragmentSize);
+      h.frag.sampleSize = ddsrt_bswap4u (h.frag.sampleSize);
+    }
+  }
+  memcpy (c->data, &h, isfrag ? sizeof (h.frag) : sizeof (h.x));
+  dec->next = (dec->next + 1) % dec->ncache;
+}
+
+static const struct ddsi_fec_cached *lookup_cached (const struct ddsi_fec_decoder *dec, const FecMember_t *m)
+{
+  const seqno_t seq = fromSN (m->writerSN);
+  for (uint32_t i = 0; i < dec->ncache; i++)
+  {
+    const struct ddsi_fec_cached *c = &dec->cache[i];
+    if (c->seq == seq && c->fragnum == m->fragmentStartingNum && c->size == m->length && c->data != NULL)
+      return c;
+  }
+  return NULL;
+}
+
+static void grow_cache (struct ddsi_fec_decoder *dec, uint32_t ncache)
+{
+  dec->cache = ddsrt_realloc (dec->cache, ncache * sizeof (*dec->cache));
+  memset (dec->cache + dec->ncache, 0, (ncache - dec->ncache) * sizeof (*dec->cache));
+  /* continue overwriting at the oldest entry: what used to be the end of
+     the ring now has free space following it */
+  dec->next = dec->ncache;
+  dec->ncache = ncache;
+}
+
+uint32_t ddsi_fec_decoder_missing (struct ddsi_fec_decoder *dec, const FecParity_t *msg)
+{
+  uint32_t idx = UINT32_MAX, nmissing = 0;
+  if (2u * msg->groupSize > dec->ncache)
+    grow_cache (dec, 2u * msg->groupSize);
+  for (uint32_t i = 0; i < msg->groupSize && nmissing <= 1; i++)
+  {
+    if (lookup_cached (dec, &msg->members[i]) == NULL)
+    {
+      idx = i;
+      nmissing++;
+    }
+  }
+  if (nmissing == 1)
+    return idx;
+  if (nmissing > 1)
+    dec->stats.unrecoverable++;
+  return UINT32_MAX;
+}
+
+bool ddsi_fec_decoder_recover (struct ddsi_fec_decoder *dec, const FecParity_t *msg, uint32_t idx, unsigned char *dst)
+{
+  const unsigned char *parity = (const unsigned char *) &msg->members[msg->groupSize];
+  const uint32_t length = msg->members[idx].length;
+  assert (idx < msg->groupSize);
+  assert (length <= msg->paritySize);
+  memcpy (dst, parity, length);
+  for (uint32_t i = 0; i < msg->groupSize; i++)
+  {
+    const struct ddsi_fec_cached *c;
+    if (i == idx)
+      continue;
+    if ((c = lookup_cached (dec, &msg->members[i])) == NULL)
+      return false;
+    fec_xor (dst, c->data, (c->size < length) ? c->size : length);
+  }
+  if (fec_checksum (0, dst, length) != msg->members[idx].checksum)
+  {
+    dec->stats.failed++;
+    return false;
+  }
+  dec->stats.recovered++;
+  return true;
+}
+
+void ddsi_fec_decoder_get_stats (const struct ddsi_fec_decoder *dec, struct ddsi_fec_decoder_stats *st)
+{
+  *st = dec->stats;
+}
@@ -21,20 +21,45 @@
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/log.h"
 #include "dds/ddsrt/sockets.h"
+#include "dds/ddsrt/sync.h"
 
 #if defined(__linux) && !LWIP_SOCKET
 #include <linux/if_packet.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <poll.h>
 #include <ifaddrs.h>
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <errno.h>
 
+/* PACKET_MMAP rings (Internal/RawEthernetRingSize): a frame must fit an
+   ethernet MTU plus the frame header, blocks hold 32 frames.  Received
+   frames are handed over a block at a time, so a block that is not full
+   is retired by the kernel after a timeout, bounding the added latency. */
+#define RAWETH_RING_BLOCK_SIZE (1u << 16)
+#define RAWETH_RING_FRAME_SIZE (1u << 11)
+#define RAWETH_RING_BLOCK_TIMEOUT_MS 1
+#define RAWETH_RING_FRAME_DATA_OFFSET ((sizeof (struct tpacket3_hdr) + TPACKET_ALIGNMENT - 1) & ~(size_t) (TPACKET_ALIGNMENT - 1))
+
+struct ddsi_raweth_ring {
+  unsigned char *base;        /* NULL if not in use */
+  uint32_t n;                 /* number of blocks (RX) or frames (TX) */
+  uint32_t idx;               /* current block (RX) or next frame (TX) */
+  struct tpacket3_hdr *frame; /* RX: next frame in current block, NULL if none */
+  uint32_t nleft;             /* RX: number of frames left in current block */
+};
+
 typedef struct ddsi_raweth_conn {
   struct ddsi_tran_conn m_base;
   ddsrt_socket_t m_sock;
   int m_ifindex;
+  unsigned char *m_rings;            /* mmap'd RX and TX rings, NULL if not in use */
+  size_t m_rings_size;
+  struct ddsi_raweth_ring m_rx_ring;
+  struct ddsi_raweth_ring m_tx_ring;
+  ddsrt_mutex_t m_tx_lock;           /* serializes filling and flushing the TX ring */
 } *ddsi_raweth_conn_t;
 
 static char *ddsi_raweth_to_string (char *dst, size_t sizeof_dst, const ddsi_locator_t *loc, ddsi_tran_conn_t conn, int with_port)
@@ -51,6 +76,79 @@ static char *ddsi_raweth_to_string (char *dst, size_t sizeof_dst, const ddsi_loc
   return dst;
 }
 
+static void ddsi_raweth_set_srcloc (ddsi_locator_t *srcloc, const struct sockaddr_ll *src)
+{
+  srcloc->kind = NN_LOCATOR_KIND_RAWETH;
+  srcloc->port = ntohs (src->sll_protocol);
+  memset(srcloc->address, 0, 10);
+  memcpy(srcloc->address + 10, src->sll_addr, 6);
+}
+
+static void ddsi_raweth_warn_truncated (ddsi_tran_conn_t conn, const struct sockaddr_ll *src, size_t size, size_t len)
+{
+  char addrbuf[DDSI_LOCSTRLEN];
+  (void) snprintf(addrbuf, sizeof(addrbuf), "[%02x:%02x:%02x:%02x:%02x:%02x]:%u",
+                  src->sll_addr[0], src->sll_addr[1], src->sll_addr[2],
+                  src->sll_addr[3], src->sll_addr[4], src->sll_addr[5], ntohs(src->sll_protocol));
+  DDS_CWARNING(&conn->m_base.gv->logconfig, "%s => %d truncated to %d\n", addrbuf, (int)size, (int)len);
+}
+
+static ssize_t ddsi_raweth_conn_read_ring (ddsi_raweth_conn_t uc, unsigned char * buf, size_t len, ddsi_locator_t *srcloc)
+{
+  struct ddsi_raweth_ring * const ring = &uc->m_rx_ring;
+  struct tpacket_block_desc *blk = (struct tpacket_block_desc *) (ring->base + (size_t) ring->idx * RAWETH_RING_BLOCK_SIZE);
+  while (ring->frame == NULL)
+  {
+    if (!(((volatile struct tpacket_block_desc *) blk)->hdr.bh1.block_status & TP_STATUS_USER))
+    {
+      /* Only gets here without a block available when there is only a
+         single receive thread for this connection, which blocks in read */
+      struct pollfd pfd = { .fd = uc->m_sock, .events = POLLIN | POLLERR, .revents = 0 };
+      if (poll (&pfd, 1, -1) < 0 && errno != EINTR)
+      {
+        DDS_CERROR (&uc->m_base.m_base.gv->logconfig, "ddsi_raweth_conn_read sock %d: poll failed (%d)\n", (int) uc->m_sock, errno);
+        return -1;
+      }
+      continue;
+    }
+    ddsrt_atomic_fence_acq ();
+    if ((ring->nleft = blk->hdr.bh1.num_pkts) > 0)
+      ring->frame = (struct tpacket3_hdr *) ((unsigned char *) blk + blk->hdr.bh1.offset_to_first_pkt);
+    else
+    {
+      ddsrt_atomic_fence_rel ();
+      blk->hdr.bh1.block_status = TP_STATUS_KERNEL;
+      ring->idx = (ring->idx + 1) % ring->n;
+      blk = (struct tpacket_block_desc *) (ring->base + (size_t) ring->idx * RAWETH_RING_BLOCK_SIZE);
+    }
+  }
+
+  /* The data can't be used in place because a received message must live
+     on in the receive buffer after the block has been returned to the kernel;
+     what is saved is the system call per frame */
+  struct tpacket3_hdr * const ppd = ring->frame;
+  const struct sockaddr_ll *src = (const struct sockaddr_ll *) ((unsigned char *) ppd + RAWETH_RING_FRAME_DATA_OFFSET);
+  const size_t n = (ppd->tp_snaplen < len) ? ppd->tp_snaplen : len;
+  memcpy (buf, (unsigned char *) ppd + ppd->tp_mac, n);
+  if (srcloc)
+    ddsi_raweth_set_srcloc (srcloc, src);
+  if (ppd->tp_len > n)
+    ddsi_raweth_warn_truncated (&uc->m_base, src, ppd->tp_len, n);
+  if (uc->m_base.m_base.gv->config.meas_receive_latency)
+    uc->m_base.m_rx_timestamp.v = (int64_t) ppd->tp_sec * DDS_NSECS_IN_SEC + ppd->tp_nsec;
+
+  if (--ring->nleft > 0)
+    ring->frame = (struct tpacket3_hdr *) ((unsigned char *) ppd + ppd->tp_next_offset);
+  else
+  {
+    ddsrt_atomic_fence_rel ();
+    blk->hdr.bh1.block_status = TP_STATUS_KERNEL;
+    ring->idx = (ring->idx + 1) % ring->n;
+    ring->frame = NULL;
+  }
+  return (ssize_t) n;
+}
+
 static ssize_t ddsi_raweth_conn_read (ddsi_tran_conn_t conn, unsigned char * buf, size_t len, bool allow_spurious, ddsi_locator_t *srcloc)
 {
   dds_return_t rc;
@@ -61,6 +159,9 @@ static ssize_t ddsi_raweth_conn_read (ddsi_tran_conn_t conn, unsigned char * buf
   socklen_t srclen = (socklen_t) sizeof (src);
   (void) allow_spurious;
 
+  if (((ddsi_raweth_conn_t) conn)->m_rx_ring.base)
+    return ddsi_raweth_conn_read_ring ((ddsi_raweth_conn_t) conn, buf, len, srcloc);
+
   msg_iov.iov_base = (void*) buf;
   msg_iov.iov_len = len;
 
@@ -78,12 +179,7 @@ static ssize_t ddsi_raweth_conn_read (ddsi_tran_conn_t conn, unsigned char * buf
   if (ret > 0)
   {
     if (srcloc)
-    {
-      srcloc->kind = NN_LOCATOR_KIND_RAWETH;
-      srcloc->port = ntohs (src.sll_protocol);
-      memset(srcloc->address, 0, 10);
-      memcpy(srcloc->address + 10, src.sll_addr, 6);
-    }
+      ddsi_raweth_set_srcloc (srcloc, &src);
 
     /* Check for udp packet truncation */
     if ((((size_t) ret) > len)
@@ -92,11 +188,7 @@ static ssize_t ddsi_raweth_conn_read (ddsi_tran_conn_t conn, unsigned char * buf
 #endif
         )
     {
-      char addrbuf[DDSI_LOCSTRLEN];
-      (void) snprintf(addrbuf, sizeof(addrbuf), "[%02x:%02x:%02x:%02x:%02x:%02x]:%u",
-                      src.sll_addr[0], src.sll_addr[1], src.sll_addr[2],
-                      src.sll_addr[3], src.sll_addr[4], src.sll_addr[5], ntohs(src.sll_protocol));
-      DDS_CWARNING(&conn->m_base.gv->logconfig, "%s => %d truncated to %d\n", addrbuf, (int)ret, (int)len);
+      ddsi_raweth_warn_truncated (conn, &src, (size_t) ret, len);
     }
   }
   else if (rc != DDS_RETCODE_OK &&
@@ -108,6 +200,61 @@ static ssize_t ddsi_raweth_conn_read (ddsi_tran_conn_t conn, unsigned char * buf
   return ret;
 }
 
+static bool ddsi_raweth_conn_write_ring (ddsi_raweth_conn_t uc, struct msghdr *msg, int sendflags, ssize_t *ret)
+{
+  /* Builds the frame directly in the TX ring and has the kernel send it.
+     The destination address is passed when flushing the ring and applies
+     to all pending frames, hence the lock covers flushing as well.
+     Returns false if the message needs to be sent the ordinary way. */
+  struct ddsi_raweth_ring * const ring = &uc->m_tx_ring;
+  const size_t niov = (size_t) msg->msg_iovlen;
+  size_t len = 0;
+  for (size_t i = 0; i < niov; i++)
+    len += msg->msg_iov[i].iov_len;
+  if (len > RAWETH_RING_FRAME_SIZE - RAWETH_RING_FRAME_DATA_OFFSET)
+    return false;
+
+  ddsrt_mutex_lock (&uc->m_tx_lock);
+  struct tpacket3_hdr * const ppd = (struct tpacket3_hdr *) (ring->base + (size_t) ring->idx * RAWETH_RING_FRAME_SIZE);
+  if (((volatile struct tpacket3_hdr *) ppd)->tp_status != TP_STATUS_AVAILABLE)
+  {
+    ddsrt_mutex_unlock (&uc->m_tx_lock);
+    return false;
+  }
+  unsigned char *data = (unsigned char *) ppd + RAWETH_RING_FRAME_DATA_OFFSET;
+  for (size_t i = 0; i < niov; i++)
+  {
+    memcpy (data, msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+    data += msg->msg_iov[i].iov_len;
+  }
+  ppd->tp_len = (uint32_t) len;
+  ppd->tp_next_offset = 0;
+  ddsrt_atomic_fence_rel ();
+  ppd->tp_status = TP_STATUS_SEND_REQUEST;
+  ring->idx = (ring->idx + 1) % ring->n;
+
+  struct msghdr kick = *msg;
+  kick.msg_iov = NULL;
+  kick.msg_iovlen = 0;
+  dds_return_t rc;
+  do {
+    rc = ddsrt_sendmsg (uc->m_sock, &kick, sendflags, ret);
+  } while (rc == DDS_RETCODE_INTERRUPTED);
+  /* Without MSG_DONTWAIT the kernel is done with the frame by now */
+  if (rc != DDS_RETCODE_OK || ((volatile struct tpacket3_hdr *) ppd)->tp_status == TP_STATUS_WRONG_FORMAT)
+  {
+    DDS_CERROR (&uc->m_base.m_base.gv->logconfig, "ddsi_raweth_conn_write failed on TX ring with retcode %d", rc);
+    ppd->tp_status = TP_STATUS_AVAILABLE;
+    *ret = -1;
+  }
+  else
+  {
+    *ret = (ssize_t) len;
+  }
+  ddsrt_mutex_unlock (&uc->m_tx_lock);
+  return true;
+}
+
 static ssize_t ddsi_raweth_conn_write (ddsi_tran_conn_t conn, const ddsi_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags)
 {
   ddsi_raweth_conn_t uc = (ddsi_raweth_conn_t) conn;
@@ -133,6 +280,8 @@ static ssize_t ddsi_raweth_conn_write (ddsi_tran_conn_t conn, const ddsi_locator
 #ifdef MSG_NOSIGNAL
   sendflags |= MSG_NOSIGNAL;
 #endif
+  if (uc->m_tx_ring.base && ddsi_raweth_conn_write_ring (uc, &msg, sendflags, &ret))
+    return ret;
   do {
     rc = ddsrt_sendmsg (uc->m_sock, &msg, sendflags, &ret);
   } while ((rc == DDS_RETCODE_INTERRUPTED) ||
@@ -174,6 +323,59 @@ static int ddsi_raweth_conn_locator (ddsi_tran_factory_t fact, ddsi_tran_base_t
   return ret;
 }
 
+static void ddsi_raweth_setup_rings (const struct ddsi_domaingv *gv, ddsi_raweth_conn_t uc)
+{
+  /* Both rings on every socket: with many sockets mode forced to "none",
+     the same sockets are used for receiving and transmitting */
+  const uint32_t nblocks = gv->config.raweth_ring_size / RAWETH_RING_BLOCK_SIZE;
+  const int version = TPACKET_V3;
+  struct tpacket_req3 req;
+  dds_return_t rc;
+  if (nblocks == 0)
+    return;
+  memset (&req, 0, sizeof (req));
+  req.tp_block_size = RAWETH_RING_BLOCK_SIZE;
+  req.tp_block_nr = nblocks;
+  req.tp_frame_size = RAWETH_RING_FRAME_SIZE;
+  req.tp_frame_nr = nblocks * (RAWETH_RING_BLOCK_SIZE / RAWETH_RING_FRAME_SIZE);
+  req.tp_retire_blk_tov = RAWETH_RING_BLOCK_TIMEOUT_MS;
+  if ((rc = ddsrt_setsockopt (uc->m_sock, SOL_PACKET, PACKET_VERSION, &version, sizeof (version))) != DDS_RETCODE_OK ||
+      (rc = ddsrt_setsockopt (uc->m_sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof (req))) != DDS_RETCODE_OK)
+  {
+    GVWARNING ("ddsi_raweth_create_conn: failed to set up TPACKET_V3 rings (retcode %d), continuing without\n", rc);
+    return;
+  }
+  req.tp_retire_blk_tov = 0;
+  if ((rc = ddsrt_setsockopt (uc->m_sock, SOL_PACKET, PACKET_TX_RING, &req, sizeof (req))) != DDS_RETCODE_OK)
+  {
+    GVWARNING ("ddsi_raweth_create_conn: failed to set up TPACKET_V3 rings (retcode %d), continuing without\n", rc);
+    goto err_tx_ring;
+  }
+  /* RX and TX ring are mapped together, in that order */
+  const size_t ringsize = (size_t) nblocks * RAWETH_RING_BLOCK_SIZE;
+  void *base = mmap (NULL, 2 * ringsize, PROT_READ | PROT_WRITE, MAP_SHARED, uc->m_sock, 0);
+  if (base == MAP_FAILED)
+  {
+    GVWARNING ("ddsi_raweth_create_conn: failed to map TPACKET_V3 rings (%d), continuing without\n", errno);
+    goto err_mmap;
+  }
+  uc->m_rings = base;
+  uc->m_rings_size = 2 * ringsize;
+  uc->m_rx_ring.base = uc->m_rings;
+  uc->m_rx_ring.n = req.tp_block_nr;
+  uc->m_tx_ring.base = uc->m_rings + ringsize;
+  uc->m_tx_ring.n = req.tp_frame_nr;
+  return;
+
+  /* a ring without blocks is how one gets rid of it again */
+err_mmap:
+  memset (&req, 0, sizeof (req));
+  (void) ddsrt_setsockopt (uc->m_sock, SOL_PACKET, PACKET_TX_RING, &req, sizeof (req));
+err_tx_ring:
+  memset (&req, 0, sizeof (req));
+  (void) ddsrt_setsockopt (uc->m_sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof (req));
+}
+
 static dds_return_t ddsi_raweth_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_factory_t fact, uint32_t port, const struct ddsi_tran_qos *qos)
 {
   ddsrt_socket_t sock;
@@ -221,6 +423,8 @@ static dds_return_t ddsi_raweth_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tr
   memset (uc, 0, sizeof (*uc));
   uc->m_sock = sock;
   uc->m_ifindex = addr.sll_ifindex;
+  ddsi_raweth_setup_rings (gv, uc);
+  ddsrt_mutex_init (&uc->m_tx_lock);
   ddsi_factory_conn_init (fact, intf, &uc->m_base);
   uc->m_base.m_base.m_port = port;
   uc->m_base.m_base.m_trantype = DDSI_TRAN_CONN;
@@ -289,6 +493,9 @@ static void ddsi_raweth_release_conn (ddsi_tran_conn_t conn)
               conn->m_base.m_multicast ? "multicast" : "unicast",
               uc->m_sock,
               uc->m_base.m_base.m_port);
+  if (uc->m_rings)
+    (void) munmap (uc->m_rings, uc->m_rings_size);
+  ddsrt_mutex_destroy (&uc->m_tx_lock);
   ddsrt_close (uc->m_sock);
   ddsrt_free (conn);
 }
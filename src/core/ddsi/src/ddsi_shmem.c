@@ -0,0 +1,876 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include "dds/ddsi/ddsi_tran.h"
+#include "dds/ddsi/ddsi_shmem.h"
+#include "dds/ddsi/q_config.h"
+#include "dds/ddsi/q_log.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_gc.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/hopscotch.h"
+#include "dds/ddsrt/log.h"
+#include "dds/ddsrt/mh3.h"
+#include "dds/ddsrt/static_assert.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/time.h"
+
+#if defined(__linux) && !LWIP_SOCKET
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+
+/* A receive ring is a file in /dev/shm named after the user, the network
+   namespace and the port of the UDP unicast socket it accompanies.  That port
+   is bound exclusively by the owner, so the name is unique, and anything that
+   already exists under that name is a leftover of a process that is gone.
+
+   Senders map the file and copy messages into its slots following Vyukov's
+   bounded queue: claim a slot by advancing the tail, fill it, then publish it
+   by updating its sequence number.  Any number of processes can so write
+   without locking, the receive thread owning the ring is the only reader.
+
+   A sender dying half-way through filling a slot would stall the ring, so
+   a sender records its process id in the slot and marks it as being filled
+   before touching the contents.  If the reader finds the next slot claimed
+   but not published for SHMEM_STALL_TIMEOUT, it skips it when it was never
+   marked, or when the process that marked it no longer exists.  Both the
+   marking and the publishing are CAS operations, so a sender that was only
+   very slow finds the slot taken away and drops its message.  Conversely,
+   a sender that finds a ring full for SHMEM_FULL_TIMEOUT assumes that the
+   receiver isn't reading it anymore, and writers stop choosing its locator
+   over the UDP ones until the ring has space again.
+
+   A FIFO next to it serves as the doorbell for the socket waitset of the
+   receive thread (an eventfd can't be opened by an unrelated process).  The
+   reader "arms" the ring only when it finds it empty, and senders only write
+   to the FIFO if it is armed, so no system calls are made while the reader
+   is keeping up with a busy ring. */
+#define SHMEM_DIR "/dev/shm"
+#define SHMEM_MAGIC 0x4344534du /* "CDSM" */
+#define SHMEM_VERSION 2u
+#define SHMEM_CACHELINE 64
+#define SHMEM_MAX_MSG_SIZE 65536u
+#define SHMEM_MIN_SLOTS 4u
+#define SHMEM_MAX_SLOTS (1u << 16)
+#define SHMEM_SEQ_FILLING 2u
+#define SHMEM_STALL_TIMEOUT DDS_SECS (1)
+#define SHMEM_FULL_TIMEOUT (2 * SHMEM_STALL_TIMEOUT) /* give the reader a chance to skip a stalled slot first */
+
+struct ddsi_shmem_slot {
+  ddsrt_atomic_uint32_t seq; /* pos + FILLING while being filled for position pos, pos + 1 once filled, pos + nslots once consumed */
+  uint32_t len;
+  uint32_t srcport;
+  ddsrt_atomic_uint32_t owner; /* pid of the sender that (last) marked it as being filled */
+  int64_t tstamp;            /* wallclock time at which the sender published it */
+  unsigned char pad1[SHMEM_CACHELINE - 24];
+  unsigned char data[SHMEM_MAX_MSG_SIZE];
+};
+
+struct ddsi_shmem_ring {
+  ddsrt_atomic_uint32_t magic; /* set last when creating the ring */
+  uint32_t version;
+  uint32_t nslots;             /* power of 2 */
+  uint32_t pad;
+  ddsrt_atomic_uint32_t closed;
+  ddsrt_atomic_uint32_t armed;
+  unsigned char pad0[SHMEM_CACHELINE - 24];
+  ddsrt_atomic_uint32_t tail;
+  unsigned char pad1[SHMEM_CACHELINE - 4];
+  struct ddsi_shmem_slot slots[];
+};
+
+DDSRT_STATIC_ASSERT (sizeof (struct ddsi_shmem_slot) % SHMEM_CACHELINE == 0);
+DDSRT_STATIC_ASSERT (sizeof (struct ddsi_shmem_ring) == 2 * SHMEM_CACHELINE);
+
+struct ddsi_shmem_peer_key {
+  uint32_t netns;
+  uint32_t port;
+};
+
+/* Mapped receive ring of another process (or of another domain instance in
+   this one), refc counts the reference from the table of peers */
+struct ddsi_shmem_peer {
+  struct ddsi_shmem_peer_key key;
+  ddsrt_atomic_uint32_t refc;
+  struct ddsi_shmem_ring *ring;
+  size_t size;
+  uint32_t nslots;
+  int fifo;
+  ddsrt_atomic_uint32_t stuck;      /* full for SHMEM_FULL_TIMEOUT, not used for new address sets */
+  ddsrt_atomic_uint64_t full_since; /* monotonic time of first failure to put, 0 if last put succeeded */
+};
+
+typedef struct ddsi_shmem_conn {
+  struct ddsi_tran_conn m_base;
+  struct ddsi_shmem_ring *m_ring;  /* receive ring, NULL for a transmit connection */
+  size_t m_size;
+  uint32_t m_nslots;
+  uint32_t m_head;                 /* position of next slot to read */
+  uint32_t m_stall_head;           /* m_head when a stalled slot was first seen */
+  ddsrt_mtime_t m_stall_since;     /* when it was first seen, NEVER if not stalled */
+  int m_fifo;
+} *ddsi_shmem_conn_t;
+
+typedef struct ddsi_shmem_tran_factory {
+  struct ddsi_tran_factory m_base;
+  ddsi_locator_t m_loc;            /* port-less locator identifying /dev/shm and the user */
+  uint32_t m_pid;                  /* recorded in the slots being filled */
+  ddsrt_mutex_t m_lock;            /* protects m_peers */
+  struct ddsrt_hh *m_peers;
+} *ddsi_shmem_tran_factory_t;
+
+static void ddsi_shmem_address_set (ddsi_locator_t *loc, uint64_t dev, uint32_t uid, uint32_t netns)
+{
+  loc->kind = NN_LOCATOR_KIND_SHMEM;
+  loc->port = NN_LOCATOR_PORT_INVALID;
+  for (int i = 0; i < 8; i++)
+    loc->address[i] = (unsigned char) (dev >> (56 - 8 * i));
+  for (int i = 0; i < 4; i++)
+  {
+    loc->address[8 + i] = (unsigned char) (uid >> (24 - 8 * i));
+    loc->address[12 + i] = (unsigned char) (netns >> (24 - 8 * i));
+  }
+}
+
+static void ddsi_shmem_address_get (const ddsi_locator_t *loc, uint64_t *dev, uint32_t *uid, uint32_t *netns)
+{
+  *dev = 0;
+  *uid = *netns = 0;
+  for (int i = 0; i < 8; i++)
+    *dev = (*dev << 8) | loc->address[i];
+  for (int i = 0; i < 4; i++)
+  {
+    *uid = (*uid << 8) | loc->address[8 + i];
+    *netns = (*netns << 8) | loc->address[12 + i];
+  }
+}
+
+static void ddsi_shmem_path (char *dst, size_t sizeof_dst, const ddsi_locator_t *loc, const char *suffix)
+{
+  uint64_t dev;
+  uint32_t uid, netns;
+  ddsi_shmem_address_get (loc, &dev, &uid, &netns);
+  (void) snprintf (dst, sizeof_dst, SHMEM_DIR "/cyclonedds-%"PRIu32"-%"PRIu32"-%"PRIu32"%s", uid, netns, loc->port, suffix);
+}
+
+static size_t ddsi_shmem_ring_size (uint32_t nslots)
+{
+  return sizeof (struct ddsi_shmem_ring) + nslots * sizeof (struct ddsi_shmem_slot);
+}
+
+static char *ddsi_shmem_to_string (char *dst, size_t sizeof_dst, const ddsi_locator_t *loc, ddsi_tran_conn_t conn, int with_port)
+{
+  uint64_t dev;
+  uint32_t uid, netns;
+  (void) conn;
+  ddsi_shmem_address_get (loc, &dev, &uid, &netns);
+  if (with_port)
+    (void) snprintf (dst, sizeof_dst, "[%"PRIx64".%"PRIu32".%"PRIu32"]:%"PRIu32, dev, uid, netns, loc->port);
+  else
+    (void) snprintf (dst, sizeof_dst, "[%"PRIx64".%"PRIu32".%"PRIu32"]", dev, uid, netns);
+  return dst;
+}
+
+static void ddsi_shmem_doorbell (int fifo)
+{
+  /* if the FIFO is full, the reader is going to wake up anyway */
+  const char c = 0;
+  ssize_t r = write (fifo, &c, 1);
+  (void) r;
+}
+
+static bool ddsi_shmem_slot_filled (const struct ddsi_shmem_slot *slot, uint32_t pos)
+{
+  if (ddsrt_atomic_ld32 (&slot->seq) != pos + 1)
+    return false;
+  ddsrt_atomic_fence_acq ();
+  return true;
+}
+
+static void ddsi_shmem_rearm (ddsi_shmem_conn_t conn)
+{
+  struct ddsi_shmem_ring * const ring = conn->m_ring;
+  char buf[16];
+  while (read (conn->m_fifo, buf, sizeof (buf)) > 0)
+    ;
+  ddsrt_atomic_st32 (&ring->armed, 1);
+  /* Pairs with the fence in ddsi_shmem_ring_put: either this sees the slot
+     filled, or the sender sees the ring armed */
+  ddsrt_atomic_fence ();
+  if (ddsi_shmem_slot_filled (&ring->slots[conn->m_head & (conn->m_nslots - 1)], conn->m_head) &&
+      ddsrt_atomic_cas32 (&ring->armed, 1, 0))
+    ddsi_shmem_doorbell (conn->m_fifo);
+}
+
+static bool ddsi_shmem_skip_stalled (ddsi_shmem_conn_t conn, struct ddsi_shmem_slot *slot)
+{
+  /* claimed by a sender but not yet published: that's normally a matter of
+     microseconds, so only consider skipping it if it has been like this for
+     quite some time, and even then only if the sender can't come back */
+  const ddsrt_mtime_t tnow = ddsrt_time_monotonic ();
+  if (conn->m_stall_since.v == DDS_NEVER || conn->m_stall_head != conn->m_head)
+  {
+    conn->m_stall_head = conn->m_head;
+    conn->m_stall_since = tnow;
+    return false;
+  }
+  else if (tnow.v - conn->m_stall_since.v < SHMEM_STALL_TIMEOUT)
+  {
+    return false;
+  }
+  else
+  {
+    const uint32_t pos = conn->m_head, consumed = pos + conn->m_nslots;
+    uint32_t owner = 0;
+    bool skip;
+    if (ddsrt_atomic_cas32 (&slot->seq, pos, consumed))
+      skip = true;
+    else if (ddsrt_atomic_ld32 (&slot->seq) != pos + SHMEM_SEQ_FILLING)
+      skip = false; /* published after all */
+    else
+    {
+      ddsrt_atomic_fence_acq ();
+      owner = ddsrt_atomic_ld32 (&slot->owner);
+      skip = (kill ((pid_t) owner, 0) < 0 && errno == ESRCH && ddsrt_atomic_cas32 (&slot->seq, pos + SHMEM_SEQ_FILLING, consumed));
+    }
+    if (skip)
+      DDS_CWARNING (&conn->m_base.m_base.gv->logconfig, "shmem: port %"PRIu32" skipping message of stalled sender %"PRIu32"\n", conn->m_base.m_base.m_port, owner);
+    return skip;
+  }
+}
+
+static ssize_t ddsi_shmem_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char * buf, size_t len, bool allow_spurious, ddsi_locator_t *srcloc)
+{
+  ddsi_shmem_conn_t conn = (ddsi_shmem_conn_t) conn_cmn;
+  const struct ddsi_shmem_tran_factory * const fact = (const struct ddsi_shmem_tran_factory *) conn_cmn->m_factory;
+  struct ddsi_shmem_ring * const ring = conn->m_ring;
+  ssize_t ret = 0;
+  (void) allow_spurious;
+  if (ring == NULL)
+    return -1;
+
+  struct ddsi_shmem_slot *slot = &ring->slots[conn->m_head & (conn->m_nslots - 1)];
+  if (ddsi_shmem_slot_filled (slot, conn->m_head))
+  {
+    const size_t size = (slot->len < SHMEM_MAX_MSG_SIZE) ? slot->len : SHMEM_MAX_MSG_SIZE;
+    const size_t n = (size < len) ? size : len;
+    memcpy (buf, slot->data, n);
+    if (srcloc)
+    {
+      *srcloc = fact->m_loc;
+      srcloc->port = slot->srcport;
+    }
+    if (conn_cmn->m_base.gv->config.meas_receive_latency)
+      conn_cmn->m_rx_timestamp.v = slot->tstamp;
+    if (n < size)
+    {
+      char addrbuf[DDSI_LOCSTRLEN];
+      ddsi_locator_t loc = fact->m_loc;
+      loc.port = slot->srcport;
+      ddsi_locator_to_string (addrbuf, sizeof (addrbuf), &loc);
+      DDS_CWARNING (&conn_cmn->m_base.gv->logconfig, "%s => %d truncated to %d\n", addrbuf, (int) size, (int) n);
+    }
+    /* done with the contents before handing the slot back to the senders */
+    ddsrt_atomic_fence_rel ();
+    ddsrt_atomic_st32 (&slot->seq, conn->m_head + conn->m_nslots);
+    conn->m_head++;
+    conn->m_stall_since = DDSRT_MTIME_NEVER;
+    ret = (ssize_t) n;
+  }
+  else if (ddsrt_atomic_ld32 (&ring->tail) != conn->m_head && ddsi_shmem_skip_stalled (conn, slot))
+  {
+    /* nothing to return this time, but the next slot may well be filled */
+    conn->m_head++;
+    conn->m_stall_since = DDSRT_MTIME_NEVER;
+  }
+
+  if (!ddsi_shmem_slot_filled (&ring->slots[conn->m_head & (conn->m_nslots - 1)], conn->m_head))
+    ddsi_shmem_rearm (conn);
+  return ret;
+}
+
+enum ddsi_shmem_put_result {
+  SPR_OK,
+  SPR_FULL,
+  SPR_SKIPPED
+};
+
+static enum ddsi_shmem_put_result ddsi_shmem_ring_put (const struct ddsi_shmem_peer *peer, uint32_t pid, uint32_t srcport, size_t niov, const ddsrt_iovec_t *iov, size_t len)
+{
+  struct ddsi_shmem_ring * const ring = peer->ring;
+  const uint32_t mask = peer->nslots - 1;
+  struct ddsi_shmem_slot *slot;
+  uint32_t pos = ddsrt_atomic_ld32 (&ring->tail);
+  for (;;)
+  {
+    slot = &ring->slots[pos & mask];
+    const int32_t dif = (int32_t) (ddsrt_atomic_ld32 (&slot->seq) - pos);
+    if (dif == 0 && ddsrt_atomic_cas32 (&ring->tail, pos, pos + 1))
+      break;
+    else if (dif < 0)
+    {
+      /* drop it like a socket would, but make sure a reader waiting for a
+         stalled slot gets to look at it again */
+      if (ddsrt_atomic_ld32 (&ring->armed) && ddsrt_atomic_cas32 (&ring->armed, 1, 0))
+        ddsi_shmem_doorbell (peer->fifo);
+      return SPR_FULL;
+    }
+    pos = ddsrt_atomic_ld32 (&ring->tail);
+  }
+  /* the reader is done with the slot's previous contents; if it gave up on
+     us before we got here, the slot is no longer ours */
+  ddsrt_atomic_fence_acq ();
+  ddsrt_atomic_st32 (&slot->owner, pid);
+  if (!ddsrt_atomic_cas32 (&slot->seq, pos, pos + SHMEM_SEQ_FILLING))
+    return SPR_SKIPPED;
+
+  size_t off = 0;
+  for (size_t i = 0; i < niov; i++)
+  {
+    memcpy (slot->data + off, iov[i].iov_base, iov[i].iov_len);
+    off += iov[i].iov_len;
+  }
+  slot->len = (uint32_t) len;
+  slot->srcport = srcport;
+  slot->tstamp = ddsrt_time_wallclock ().v;
+  ddsrt_atomic_fence_rel ();
+  if (!ddsrt_atomic_cas32 (&slot->seq, pos + SHMEM_SEQ_FILLING, pos + 1))
+    return SPR_SKIPPED;
+
+  ddsrt_atomic_fence ();
+  if (ddsrt_atomic_ld32 (&ring->armed) && ddsrt_atomic_cas32 (&ring->armed, 1, 0))
+    ddsi_shmem_doorbell (peer->fifo);
+  return SPR_OK;
+}
+
+static bool ddsi_shmem_ring_has_space (const struct ddsi_shmem_peer *peer)
+{
+  const uint32_t pos = ddsrt_atomic_ld32 (&peer->ring->tail);
+  const struct ddsi_shmem_slot *slot = &peer->ring->slots[pos & (peer->nslots - 1)];
+  return (int32_t) (ddsrt_atomic_ld32 (&slot->seq) - pos) >= 0;
+}
+
+static void ddsi_shmem_rebuild_addrsets (struct gcreq *gcreq)
+{
+  rebuild_or_clear_writer_addrsets (gcreq->arg, 1);
+  gcreq_free (gcreq);
+}
+
+static void ddsi_shmem_note_full (struct ddsi_domaingv *gv, struct ddsi_shmem_peer *peer)
+{
+  /* a ring that stays full is one that isn't read anymore: stop preferring
+     it over UDP by recomputing the writers' address sets (that takes the
+     writer locks, which can't be done from somewhere in the transmit path) */
+  const uint64_t tnow = (uint64_t) ddsrt_time_monotonic ().v;
+  const uint64_t t0 = ddsrt_atomic_ld64 (&peer->full_since);
+  if (t0 == 0)
+    (void) ddsrt_atomic_cas64 (&peer->full_since, 0, tnow);
+  else if (tnow - t0 >= (uint64_t) SHMEM_FULL_TIMEOUT && ddsrt_atomic_cas32 (&peer->stuck, 0, 1))
+  {
+    GVWARNING ("shmem: ring for port %"PRIu32" has been full for too long, preferring other locators\n", peer->key.port);
+    struct gcreq *gcreq = gcreq_new (gv->gcreq_queue, ddsi_shmem_rebuild_addrsets);
+    gcreq->arg = gv;
+    gcreq_enqueue (gcreq);
+  }
+}
+
+static uint32_t ddsi_shmem_peer_hash (const void *va)
+{
+  const struct ddsi_shmem_peer *a = va;
+  return ddsrt_mh3 (&a->key, sizeof (a->key), 0);
+}
+
+static int ddsi_shmem_peer_equal (const void *va, const void *vb)
+{
+  const struct ddsi_shmem_peer *a = va;
+  const struct ddsi_shmem_peer *b = vb;
+  return a->key.netns == b->key.netns && a->key.port == b->key.port;
+}
+
+static struct ddsi_shmem_peer *ddsi_shmem_peer_open (const ddsi_locator_t *loc)
+{
+  char path[64], fifopath[64];
+  struct stat st;
+  int fd;
+  ddsi_shmem_path (path, sizeof (path), loc, "");
+  ddsi_shmem_path (fifopath, sizeof (fifopath), loc, ".fifo");
+  if ((fd = open (path, O_RDWR | O_CLOEXEC)) < 0)
+    return NULL;
+  /* the name contains our uid, but anyone can create a file in /dev/shm */
+  if (fstat (fd, &st) < 0 || st.st_uid != geteuid () || (size_t) st.st_size < sizeof (struct ddsi_shmem_ring))
+  {
+    close (fd);
+    return NULL;
+  }
+  const size_t size = (size_t) st.st_size;
+  void *base = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  struct ddsi_shmem_ring * const ring = base;
+  int fifo;
+  if (ddsrt_atomic_ld32 (&ring->magic) != SHMEM_MAGIC)
+    goto err;
+  ddsrt_atomic_fence_acq ();
+  const uint32_t nslots = ring->nslots;
+  if (ring->version != SHMEM_VERSION || nslots < SHMEM_MIN_SLOTS || nslots > SHMEM_MAX_SLOTS || (nslots & (nslots - 1)) != 0 || size != ddsi_shmem_ring_size (nslots))
+    goto err;
+  if ((fifo = open (fifopath, O_WRONLY | O_NONBLOCK | O_CLOEXEC)) < 0)
+    goto err;
+
+  struct ddsi_shmem_peer *peer = ddsrt_malloc (sizeof (*peer));
+  uint64_t dev;
+  uint32_t uid;
+  ddsi_shmem_address_get (loc, &dev, &uid, &peer->key.netns);
+  peer->key.port = loc->port;
+  ddsrt_atomic_st32 (&peer->refc, 1);
+  peer->ring = ring;
+  peer->size = size;
+  peer->nslots = nslots;
+  peer->fifo = fifo;
+  ddsrt_atomic_st32 (&peer->stuck, 0);
+  ddsrt_atomic_st64 (&peer->full_since, 0);
+  return peer;
+
+err:
+  (void) munmap (base, size);
+  return NULL;
+}
+
+static void ddsi_shmem_peer_unref (struct ddsi_shmem_peer *peer)
+{
+  if (ddsrt_atomic_dec32_nv (&peer->refc) == 0)
+  {
+    (void) munmap (peer->ring, peer->size);
+    close (peer->fifo);
+    ddsrt_free (peer);
+  }
+}
+
+static struct ddsi_shmem_peer *ddsi_shmem_peer_ref (struct ddsi_shmem_tran_factory *fact, const ddsi_locator_t *loc)
+{
+  struct ddsi_shmem_peer template, *peer;
+  uint64_t dev;
+  uint32_t uid;
+  ddsi_shmem_address_get (loc, &dev, &uid, &template.key.netns);
+  template.key.port = loc->port;
+  ddsrt_mutex_lock (&fact->m_lock);
+  if ((peer = ddsrt_hh_lookup (fact->m_peers, &template)) == NULL)
+  {
+    if ((peer = ddsi_shmem_peer_open (loc)) != NULL)
+      ddsrt_hh_add (fact->m_peers, peer);
+  }
+  if (peer)
+    ddsrt_atomic_inc32 (&peer->refc);
+  ddsrt_mutex_unlock (&fact->m_lock);
+  return peer;
+}
+
+static void ddsi_shmem_peer_retire (struct ddsi_shmem_tran_factory *fact, struct ddsi_shmem_peer *peer)
+{
+  bool removed = false;
+  ddsrt_mutex_lock (&fact->m_lock);
+  if (ddsrt_hh_lookup (fact->m_peers, peer) == peer)
+  {
+    ddsrt_hh_remove (fact->m_peers, peer);
+    removed = true;
+  }
+  ddsrt_mutex_unlock (&fact->m_lock);
+  if (removed)
+    ddsi_shmem_peer_unref (peer);
+}
+
+static ssize_t ddsi_shmem_conn_write (ddsi_tran_conn_t conn, const ddsi_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags)
+{
+  struct ddsi_shmem_tran_factory * const fact = (struct ddsi_shmem_tran_factory *) conn->m_factory;
+  struct ddsi_domaingv * const gv = conn->m_base.gv;
+  size_t len = 0;
+  (void) flags;
+  for (size_t i = 0; i < niov; i++)
+    len += iov[i].iov_len;
+  if (len > SHMEM_MAX_MSG_SIZE)
+    return -1;
+
+  /* a ring marked closed is a leftover, retry once in case it has been
+     replaced by a new one for the same port */
+  for (int attempt = 0; attempt < 2; attempt++)
+  {
+    struct ddsi_shmem_peer *peer;
+    if ((peer = ddsi_shmem_peer_ref (fact, dst)) == NULL)
+      return -1;
+    if (!ddsrt_atomic_ld32 (&peer->ring->closed))
+    {
+      const enum ddsi_shmem_put_result res = ddsi_shmem_ring_put (peer, fact->m_pid, gv->loc_default_uc.port, niov, iov, len);
+      if (res == SPR_OK)
+        ddsrt_atomic_st64 (&peer->full_since, 0);
+      else if (res == SPR_FULL)
+        ddsi_shmem_note_full (gv, peer);
+      ddsi_shmem_peer_unref (peer);
+      return (res == SPR_OK) ? (ssize_t) len : -1;
+    }
+    ddsi_shmem_peer_retire (fact, peer);
+    ddsi_shmem_peer_unref (peer);
+  }
+  return -1;
+}
+
+bool ddsi_shmem_locator_usable (const ddsi_xlocator_t *loc)
+{
+  if (loc->conn == NULL || loc->c.kind != NN_LOCATOR_KIND_SHMEM)
+    return true;
+  struct ddsi_shmem_tran_factory * const fact = (struct ddsi_shmem_tran_factory *) loc->conn->m_factory;
+  struct ddsi_shmem_peer template, *peer;
+  uint64_t dev;
+  uint32_t uid;
+  bool usable = true;
+  ddsi_shmem_address_get (&loc->c, &dev, &uid, &template.key.netns);
+  template.key.port = loc->c.port;
+  ddsrt_mutex_lock (&fact->m_lock);
+  if ((peer = ddsrt_hh_lookup (fact->m_peers, &template)) != NULL && ddsrt_atomic_ld32 (&peer->stuck))
+  {
+    /* a replaced ring gets retired on the next write */
+    if (ddsrt_atomic_ld32 (&peer->ring->closed) || ddsi_shmem_ring_has_space (peer))
+    {
+      ddsrt_atomic_st64 (&peer->full_since, 0);
+      ddsrt_atomic_st32 (&peer->stuck, 0);
+    }
+    else
+    {
+      usable = false;
+    }
+  }
+  ddsrt_mutex_unlock (&fact->m_lock);
+  return usable;
+}
+
+static ddsrt_socket_t ddsi_shmem_conn_handle (ddsi_tran_base_t base)
+{
+  const struct ddsi_shmem_conn *conn = (const struct ddsi_shmem_conn *) base;
+  return conn->m_ring ? conn->m_fifo : DDSRT_INVALID_SOCKET;
+}
+
+static bool ddsi_shmem_supports (const struct ddsi_tran_factory *fact, int32_t kind)
+{
+  (void) fact;
+  return (kind == NN_LOCATOR_KIND_SHMEM);
+}
+
+static int ddsi_shmem_conn_locator (ddsi_tran_factory_t fact, ddsi_tran_base_t base, ddsi_locator_t *loc)
+{
+  *loc = ((const struct ddsi_shmem_tran_factory *) fact)->m_loc;
+  loc->port = base->m_port;
+  return 0;
+}
+
+static void ddsi_shmem_remove_stale (const char *path, const char *fifopath)
+{
+  /* tell senders still having it mapped that it is gone, then remove it */
+  int fd;
+  if ((fd = open (path, O_RDWR | O_CLOEXEC)) >= 0)
+  {
+    struct stat st;
+    if (fstat (fd, &st) == 0 && st.st_uid == geteuid () && (size_t) st.st_size >= sizeof (struct ddsi_shmem_ring))
+    {
+      void *base = mmap (NULL, sizeof (struct ddsi_shmem_ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (base != MAP_FAILED)
+      {
+        ddsrt_atomic_st32 (&((struct ddsi_shmem_ring *) base)->closed, 1);
+        (void) munmap (base, sizeof (struct ddsi_shmem_ring));
+      }
+    }
+    close (fd);
+    (void) unlink (path);
+  }
+  (void) unlink (fifopath);
+}
+
+static int ddsi_shmem_create_ring (const struct ddsi_shmem_tran_factory *fact, ddsi_shmem_conn_t conn, uint32_t port)
+{
+  const struct ddsi_domaingv * const gv = fact->m_base.gv;
+  ddsi_locator_t loc = fact->m_loc;
+  char path[64], fifopath[64];
+  uint32_t nslots = SHMEM_MIN_SLOTS;
+  while (nslots < gv->config.shmem_ring_size && nslots < SHMEM_MAX_SLOTS)
+    nslots *= 2;
+  const size_t size = ddsi_shmem_ring_size (nslots);
+  loc.port = port;
+  ddsi_shmem_path (path, sizeof (path), &loc, "");
+  ddsi_shmem_path (fifopath, sizeof (fifopath), &loc, ".fifo");
+  ddsi_shmem_remove_stale (path, fifopath);
+
+  int fd, rc;
+  void *base;
+  if ((fd = open (path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600)) < 0)
+  {
+    GVWARNING ("ddsi_shmem_create_conn: can't create %s (%d)\n", path, errno);
+    return -1;
+  }
+  /* allocate the memory up front: a sparse file means a SIGBUS in whichever
+     process happens to write into a page that /dev/shm has no room for */
+  if ((rc = posix_fallocate (fd, 0, (off_t) size)) != 0)
+  {
+    GVWARNING ("ddsi_shmem_create_conn: can't allocate %"PRIuSIZE" bytes for %s (%d)\n", size, path, rc);
+    goto err_map;
+  }
+  if ((base = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+  {
+    GVWARNING ("ddsi_shmem_create_conn: can't map %s (%d)\n", path, errno);
+    goto err_map;
+  }
+  close (fd);
+  if (mkfifo (fifopath, 0600) < 0 || (conn->m_fifo = open (fifopath, O_RDWR | O_NONBLOCK | O_CLOEXEC)) < 0)
+  {
+    GVWARNING ("ddsi_shmem_create_conn: can't create %s (%d)\n", fifopath, errno);
+    (void) unlink (fifopath);
+    (void) munmap (base, size);
+    (void) unlink (path);
+    return -1;
+  }
+
+  /* posix_fallocate zero-fills, and magic must be set last because senders take
+     the ring as valid once it is */
+  struct ddsi_shmem_ring * const ring = base;
+  ring->version = SHMEM_VERSION;
+  ring->nslots = nslots;
+  ddsrt_atomic_st32 (&ring->armed, 1);
+  for (uint32_t i = 0; i < nslots; i++)
+    ddsrt_atomic_st32 (&ring->slots[i].seq, i);
+  ddsrt_atomic_fence_rel ();
+  ddsrt_atomic_st32 (&ring->magic, SHMEM_MAGIC);
+
+  conn->m_ring = ring;
+  conn->m_size = size;
+  conn->m_nslots = nslots;
+  conn->m_head = 0;
+  conn->m_stall_since = DDSRT_MTIME_NEVER;
+  GVLOG (DDS_LC_CONFIG, "shmem: receive ring %s with %"PRIu32" slots\n", path, nslots);
+  return 0;
+
+err_map:
+  close (fd);
+  (void) unlink (path);
+  return -1;
+}
+
+static dds_return_t ddsi_shmem_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_factory_t fact_cmn, uint32_t port, const struct ddsi_tran_qos *qos)
+{
+  struct ddsi_shmem_tran_factory * const fact = (struct ddsi_shmem_tran_factory *) fact_cmn;
+  ddsi_shmem_conn_t conn;
+
+  /* a receive ring is tied to a UDP unicast port, transmitting needs none */
+  if (qos->m_purpose == DDSI_TRAN_QOS_RECV_MC || (qos->m_purpose == DDSI_TRAN_QOS_RECV_UC && port == 0))
+    return DDS_RETCODE_BAD_PARAMETER;
+
+  conn = ddsrt_malloc (sizeof (*conn));
+  memset (conn, 0, sizeof (*conn));
+  conn->m_fifo = -1;
+  if (qos->m_purpose == DDSI_TRAN_QOS_RECV_UC && ddsi_shmem_create_ring (fact, conn, port) < 0)
+  {
+    ddsrt_free (conn);
+    return DDS_RETCODE_ERROR;
+  }
+
+  ddsi_factory_conn_init (&fact->m_base, qos->m_interface, &conn->m_base);
+  conn->m_base.m_base.m_port = port;
+  conn->m_base.m_base.m_trantype = DDSI_TRAN_CONN;
+  conn->m_base.m_base.m_multicast = false;
+  conn->m_base.m_base.m_handle_fn = ddsi_shmem_conn_handle;
+  conn->m_base.m_locator_fn = ddsi_shmem_conn_locator;
+  conn->m_base.m_read_fn = ddsi_shmem_conn_read;
+  conn->m_base.m_write_fn = ddsi_shmem_conn_write;
+  conn->m_base.m_disable_multiplexing_fn = 0;
+  DDS_CTRACE (&fact->m_base.gv->logconfig, "ddsi_shmem_create_conn %s port %"PRIu32"\n", conn->m_ring ? "receive" : "transmit", port);
+  *conn_out = &conn->m_base;
+  return DDS_RETCODE_OK;
+}
+
+static void ddsi_shmem_release_conn (ddsi_tran_conn_t conn_cmn)
+{
+  ddsi_shmem_conn_t conn = (ddsi_shmem_conn_t) conn_cmn;
+  DDS_CTRACE (&conn_cmn->m_base.gv->logconfig, "ddsi_shmem_release_conn port %"PRIu32"\n", conn_cmn->m_base.m_port);
+  if (conn->m_ring)
+  {
+    char path[64], fifopath[64];
+    ddsi_locator_t loc;
+    (void) ddsi_shmem_conn_locator (conn_cmn->m_factory, &conn_cmn->m_base, &loc);
+    ddsi_shmem_path (path, sizeof (path), &loc, "");
+    ddsi_shmem_path (fifopath, sizeof (fifopath), &loc, ".fifo");
+    ddsrt_atomic_st32 (&conn->m_ring->closed, 1);
+    (void) munmap (conn->m_ring, conn->m_size);
+    close (conn->m_fifo);
+    (void) unlink (path);
+    (void) unlink (fifopath);
+  }
+  ddsrt_free (conn);
+}
+
+static int ddsi_shmem_join_mc (ddsi_tran_conn_t conn, const ddsi_locator_t *srcloc, const ddsi_locator_t *mcloc, const struct nn_interface *interf)
+{
+  (void) conn; (void) srcloc; (void) mcloc; (void) interf;
+  return -1;
+}
+
+static int ddsi_shmem_leave_mc (ddsi_tran_conn_t conn, const ddsi_locator_t *srcloc, const ddsi_locator_t *mcloc, const struct nn_interface *interf)
+{
+  (void) conn; (void) srcloc; (void) mcloc; (void) interf;
+  return -1;
+}
+
+static int ddsi_shmem_is_loopbackaddr (const struct ddsi_tran_factory *tran, const ddsi_locator_t *loc)
+{
+  (void) tran;
+  (void) loc;
+  return 0;
+}
+
+static int ddsi_shmem_is_mcaddr (const struct ddsi_tran_factory *tran, const ddsi_locator_t *loc)
+{
+  (void) tran;
+  (void) loc;
+  return 0;
+}
+
+static int ddsi_shmem_is_ssm_mcaddr (const struct ddsi_tran_factory *tran, const ddsi_locator_t *loc)
+{
+  (void) tran;
+  (void) loc;
+  return 0;
+}
+
+static enum ddsi_nearby_address_result ddsi_shmem_is_nearby_address (const ddsi_locator_t *loc, size_t ninterf, const struct nn_interface interf[], size_t *interf_idx)
+{
+  /* same /dev/shm and same user; the network namespace only serves to keep
+     the names of the rings apart */
+  for (size_t i = 0; i < ninterf; i++)
+  {
+    if (interf[i].loc.kind == loc->kind && memcmp (interf[i].loc.address, loc->address, 12) == 0)
+    {
+      if (interf_idx)
+        *interf_idx = i;
+      return DNAR_LOCAL;
+    }
+  }
+  return DNAR_DISTANT;
+}
+
+static enum ddsi_locator_from_string_result ddsi_shmem_address_from_string (const struct ddsi_tran_factory *tran, ddsi_locator_t *loc, const char *str)
+{
+  uint64_t dev;
+  uint32_t uid, netns;
+  int pos = 0;
+  (void) tran;
+  if (sscanf (str, "[%"SCNx64".%"SCNu32".%"SCNu32"]%n", &dev, &uid, &netns, &pos) != 3 || str[pos] != 0)
+    return AFSR_INVALID;
+  ddsi_shmem_address_set (loc, dev, uid, netns);
+  return AFSR_OK;
+}
+
+static void ddsi_shmem_peer_free (void *vpeer, void *varg)
+{
+  (void) varg;
+  ddsi_shmem_peer_unref (vpeer);
+}
+
+static void ddsi_shmem_deinit (ddsi_tran_factory_t fact_cmn)
+{
+  struct ddsi_shmem_tran_factory * const fact = (struct ddsi_shmem_tran_factory *) fact_cmn;
+  DDS_CLOG (DDS_LC_CONFIG, &fact_cmn->gv->logconfig, "shmem de-initialized\n");
+  ddsrt_hh_enum (fact->m_peers, ddsi_shmem_peer_free, NULL);
+  ddsrt_hh_free (fact->m_peers);
+  ddsrt_mutex_destroy (&fact->m_lock);
+  ddsrt_free (fact);
+}
+
+static int ddsi_shmem_enumerate_interfaces (ddsi_tran_factory_t fact, enum ddsi_transport_selector transport_selector, ddsrt_ifaddrs_t **ifs)
+{
+  (void) fact; (void) transport_selector;
+  *ifs = NULL;
+  return 0;
+}
+
+static int ddsi_shmem_is_valid_port (const struct ddsi_tran_factory *fact, uint32_t port)
+{
+  (void) fact;
+  return (port <= 65535);
+}
+
+static uint32_t ddsi_shmem_receive_buffer_size (const struct ddsi_tran_factory *fact)
+{
+  (void) fact;
+  return 0;
+}
+
+static int ddsi_shmem_locator_from_sockaddr (const struct ddsi_tran_factory *tran, ddsi_locator_t *loc, const struct sockaddr *sockaddr)
+{
+  (void) tran; (void) loc; (void) sockaddr;
+  return -1;
+}
+
+int ddsi_shmem_init (struct ddsi_domaingv *gv, ddsi_locator_t *loc)
+{
+  struct stat st, stns;
+  if (stat (SHMEM_DIR, &st) < 0 || !S_ISDIR (st.st_mode))
+  {
+    GVLOG (DDS_LC_CONFIG, "shmem: %s not available\n", SHMEM_DIR);
+    return -1;
+  }
+  const uint32_t netns = (stat ("/proc/self/ns/net", &stns) == 0) ? (uint32_t) stns.st_ino : 0;
+
+  struct ddsi_shmem_tran_factory *fact = ddsrt_malloc (sizeof (*fact));
+  memset (fact, 0, sizeof (*fact));
+  ddsi_shmem_address_set (&fact->m_loc, (uint64_t) st.st_dev, (uint32_t) geteuid (), netns);
+  fact->m_pid = (uint32_t) getpid ();
+  ddsrt_mutex_init (&fact->m_lock);
+  fact->m_peers = ddsrt_hh_new (1, ddsi_shmem_peer_hash, ddsi_shmem_peer_equal);
+  fact->m_base.gv = gv;
+  fact->m_base.m_free_fn = ddsi_shmem_deinit;
+  fact->m_base.m_typename = "shmem";
+  fact->m_base.m_default_spdp_address = NULL;
+  fact->m_base.m_connless = 1;
+  fact->m_base.m_enable_spdp = 1;
+  fact->m_base.m_supports_fn = ddsi_shmem_supports;
+  fact->m_base.m_create_conn_fn = ddsi_shmem_create_conn;
+  fact->m_base.m_release_conn_fn = ddsi_shmem_release_conn;
+  fact->m_base.m_join_mc_fn = ddsi_shmem_join_mc;
+  fact->m_base.m_leave_mc_fn = ddsi_shmem_leave_mc;
+  fact->m_base.m_is_loopbackaddr_fn = ddsi_shmem_is_loopbackaddr;
+  fact->m_base.m_is_mcaddr_fn = ddsi_shmem_is_mcaddr;
+  fact->m_base.m_is_ssm_mcaddr_fn = ddsi_shmem_is_ssm_mcaddr;
+  fact->m_base.m_is_nearby_address_fn = ddsi_shmem_is_nearby_address;
+  fact->m_base.m_locator_from_string_fn = ddsi_shmem_address_from_string;
+  fact->m_base.m_locator_to_string_fn = ddsi_shmem_to_string;
+  fact->m_base.m_enumerate_interfaces_fn = ddsi_shmem_enumerate_interfaces;
+  fact->m_base.m_is_valid_port_fn = ddsi_shmem_is_valid_port;
+  fact->m_base.m_receive_buffer_size_fn = ddsi_shmem_receive_buffer_size;
+  fact->m_base.m_locator_from_sockaddr_fn = ddsi_shmem_locator_from_sockaddr;
+  ddsi_factory_add (gv, &fact->m_base);
+  *loc = fact->m_loc;
+  GVLOG (DDS_LC_CONFIG, "shmem initialized\n");
+  return 0;
+}
+
+#else
+
+int ddsi_shmem_init (struct ddsi_domaingv *gv, ddsi_locator_t *loc) { (void) gv; (void) loc; return -1; }
+bool ddsi_shmem_locator_usable (const ddsi_xlocator_t *loc) { (void) loc; return true; }
+
+#endif /* defined __linux */
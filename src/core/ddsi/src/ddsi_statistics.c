@@ -11,11 +11,13 @@
  */
 #include <string.h>
 #include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/time.h"
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/ddsi_entity_index.h"
 #include "dds/ddsi/ddsi_statistics.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_radmin.h"
+#include "dds/ddsi/q_xevent.h"
 
 void ddsi_get_writer_stats (struct writer *wr, uint64_t * __restrict rexmit_bytes, uint32_t * __restrict throttle_count, uint64_t * __restrict time_throttled, uint64_t * __restrict time_retransmit)
 {
@@ -27,7 +29,55 @@ void ddsi_get_writer_stats (struct writer *wr, uint64_t * __restrict rexmit_byte
   ddsrt_mutex_unlock (&wr->e.lock);
 }
 
-void ddsi_get_reader_stats (struct reader *rd, uint64_t * __restrict discarded_bytes)
+void ddsi_get_writer_rexmit_reader_stats (struct writer *wr, uint64_t * __restrict bytes, uint32_t * __restrict rate_total, uint32_t * __restrict rate_max, uint32_t * __restrict queued, uint32_t * __restrict dropped)
+{
+  ddsrt_avl_iter_t it;
+  *bytes = 0;
+  *rate_total = *rate_max = *queued = *dropped = 0;
+  ddsrt_mutex_lock (&wr->e.lock);
+  for (const struct wr_prd_match *m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->readers, &it); m; m = ddsrt_avl_iter_next (&it))
+  {
+    struct xeventq_rexmit_stats st;
+    if (!xeventq_get_rexmit_stats (wr->evq, &m->prd_guid, &st))
+      continue;
+    *bytes += st.bytes;
+    *rate_total = (st.rate > UINT32_MAX - *rate_total) ? UINT32_MAX : *rate_total + st.rate;
+    if (st.rate > *rate_max)
+      *rate_max = st.rate;
+    *queued += st.queued;
+    *dropped += st.dropped;
+  }
+  ddsrt_mutex_unlock (&wr->e.lock);
+}
+
+void ddsi_latency_hist_add (struct ddsi_latency_hist *hist, enum ddsi_latency_stage stage, int64_t latency)
+{
+  uint32_t b = 0;
+  int64_t limit = DDS_USECS (1);
+  while (b < DDSI_LATENCY_NBUCKETS - 1 && latency >= limit)
+  {
+    b++;
+    limit *= 4;
+  }
+  ddsrt_atomic_inc32 (&hist->count[stage][b]);
+}
+
+static void add_proxy_writer_latency_stats (const struct proxy_writer *pwr, uint32_t latency_hist[DDSI_LATENCY_NSTAGES * DDSI_LATENCY_NBUCKETS])
+{
+  if (pwr->latency_hist == NULL)
+    return;
+  for (int s = 0; s < DDSI_LATENCY_NSTAGES; s++)
+    for (int b = 0; b < DDSI_LATENCY_NBUCKETS; b++)
+      latency_hist[s * DDSI_LATENCY_NBUCKETS + b] += ddsrt_atomic_ld32 (&pwr->latency_hist->count[s][b]);
+}
+
+void ddsi_get_proxy_writer_latency_stats (const struct proxy_writer *pwr, uint32_t latency_hist[DDSI_LATENCY_NSTAGES * DDSI_LATENCY_NBUCKETS])
+{
+  memset (latency_hist, 0, DDSI_LATENCY_NSTAGES * DDSI_LATENCY_NBUCKETS * sizeof (*latency_hist));
+  add_proxy_writer_latency_stats (pwr, latency_hist);
+}
+
+void ddsi_get_reader_stats (struct reader *rd, uint64_t * __restrict discarded_bytes, uint32_t latency_hist[DDSI_LATENCY_NSTAGES * DDSI_LATENCY_NBUCKETS])
 {
   struct rd_pwr_match *m;
   ddsi_guid_t pwrguid;
@@ -35,6 +85,7 @@ void ddsi_get_reader_stats (struct reader *rd, uint64_t * __restrict discarded_b
   assert (thread_is_awake ());
 
   *discarded_bytes = 0;
+  memset (latency_hist, 0, DDSI_LATENCY_NSTAGES * DDSI_LATENCY_NBUCKETS * sizeof (*latency_hist));
 
   // collect for all matched proxy writers
   ddsrt_mutex_lock (&rd->e.lock);
@@ -53,9 +104,12 @@ void ddsi_get_reader_stats (struct reader *rd, uint64_t * __restrict discarded_b
         nn_defrag_stats (pwr->defrag, &disc_frags);
         if (x->in_sync != PRMSS_OUT_OF_SYNC && !x->filtered)
           nn_reorder_stats (pwr->reorder, &disc_samples);
+        else if (x->u.not_in_sync.cursor)
+          nn_catchup_stats (pwr->catchup, &disc_samples);
         else
           nn_reorder_stats (x->u.not_in_sync.reorder, &disc_samples);
         *discarded_bytes += disc_frags + disc_samples;
+        add_proxy_writer_latency_stats (pwr, latency_hist);
       }
       ddsrt_mutex_unlock (&pwr->e.lock);
     }
@@ -0,0 +1,334 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <stddef.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsi/ddsi_timing_wheel.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/q_xevent.h"
+
+static int compare_node_tick (const void *va, const void *vb);
+
+static const ddsrt_fibheap_def_t overflow_fhdef = DDSRT_FIBHEAPDEF_INITIALIZER (offsetof (struct ddsi_twheel_node, u.heapnode), compare_node_tick);
+
+static int compare_node_tick (const void *va, const void *vb)
+{
+  const struct ddsi_twheel_node *a = va, *b = vb;
+  return (a->tick == b->tick) ? 0 : (a->tick < b->tick) ? -1 : 1;
+}
+
+static int64_t tick_floor (ddsrt_mtime_t t)
+{
+  if (t.v == DDS_NEVER)
+    return INT64_MAX;
+  return (t.v <= 0) ? 0 : t.v / DDSI_TWHEEL_RESOLUTION;
+}
+
+static int64_t tick_ceil (ddsrt_mtime_t t)
+{
+  if (t.v == DDS_NEVER)
+    return INT64_MAX;
+  return (t.v <= 0) ? 0 : (t.v - 1) / DDSI_TWHEEL_RESOLUTION + 1;
+}
+
+static ddsrt_mtime_t tick_to_time (int64_t tick)
+{
+  if (tick >= INT64_MAX / DDSI_TWHEEL_RESOLUTION)
+    return DDSRT_MTIME_NEVER;
+  return (ddsrt_mtime_t) { tick * DDSI_TWHEEL_RESOLUTION };
+}
+
+static uint32_t slot_index (int64_t tick)
+{
+  return (uint32_t) ((uint64_t) tick % DDSI_TWHEEL_NSLOTS);
+}
+
+static void wheel_init (struct ddsi_twheel_wheel *w, int64_t cursor)
+{
+  w->slots = NULL;
+  ddsrt_fibheap_init (&overflow_fhdef, &w->overflow);
+  w->cursor = cursor;
+}
+
+static void wheel_alloc_slots (struct ddsi_twheel_wheel *w)
+{
+  w->slots = ddsrt_malloc (DDSI_TWHEEL_NSLOTS * sizeof (*w->slots));
+  for (uint32_t i = 0; i < DDSI_TWHEEL_NSLOTS; i++)
+    ddsrt_circlist_init (&w->slots[i]);
+}
+
+static void wheel_fini (struct ddsi_twheel_wheel *w)
+{
+#ifndef NDEBUG
+  assert (ddsrt_fibheap_min (&overflow_fhdef, &w->overflow) == NULL);
+  if (w->slots)
+  {
+    for (uint32_t i = 0; i < DDSI_TWHEEL_NSLOTS; i++)
+      assert (ddsrt_circlist_isempty (&w->slots[i]));
+  }
+#endif
+  ddsrt_free (w->slots);
+}
+
+static void wheel_insert (struct ddsi_twheel_wheel *w, struct ddsi_twheel_node *node, int64_t tick)
+{
+  assert (tick >= w->cursor);
+  node->tick = tick;
+  node->overflow = (tick - w->cursor >= (int64_t) DDSI_TWHEEL_NSLOTS);
+  if (node->overflow)
+    ddsrt_fibheap_insert (&overflow_fhdef, &w->overflow, node);
+  else
+    ddsrt_circlist_append (&w->slots[slot_index (tick)], &node->u.e);
+}
+
+static void wheel_remove (struct ddsi_twheel_wheel *w, struct ddsi_twheel_node *node)
+{
+  if (node->overflow)
+    ddsrt_fibheap_delete (&overflow_fhdef, &w->overflow, node);
+  else
+    ddsrt_circlist_remove (&w->slots[slot_index (node->tick)], &node->u.e);
+}
+
+/* Moves the nodes from the overflow heap that are due within a revolution
+   of the cursor into the slots, which must be done before visiting the
+   slots after the cursor has advanced */
+static void wheel_cascade (struct ddsi_twheel_wheel *w)
+{
+  struct ddsi_twheel_node *node;
+  while ((node = ddsrt_fibheap_min (&overflow_fhdef, &w->overflow)) != NULL && node->tick - w->cursor < (int64_t) DDSI_TWHEEL_NSLOTS)
+  {
+    (void) ddsrt_fibheap_extract_min (&overflow_fhdef, &w->overflow);
+    node->overflow = false;
+    ddsrt_circlist_append (&w->slots[slot_index (node->tick)], &node->u.e);
+  }
+}
+
+/* Advances the cursor to the first non-empty slot at or before tick, and
+   returns that slot, or returns NULL and advances the cursor to tick + 1 if
+   nothing is due.  All nodes in the returned slot are due at the cursor. */
+static struct ddsrt_circlist *wheel_advance (struct ddsi_twheel_wheel *w, int64_t tick)
+{
+  while (w->cursor <= tick)
+  {
+    /* slots beyond the cursor may be visited only once the overflow heap
+       has been cascaded, but as the overflow nodes are all due later than
+       one revolution after the cursor, once is enough for a revolution */
+    wheel_cascade (w);
+    for (uint32_t n = 0; w->cursor <= tick && n < DDSI_TWHEEL_NSLOTS; n++, w->cursor++)
+    {
+      struct ddsrt_circlist * const slot = &w->slots[slot_index (w->cursor)];
+      if (!ddsrt_circlist_isempty (slot))
+        return slot;
+    }
+    if (w->cursor <= tick)
+    {
+      /* all slots are empty: skip to the first node in the overflow heap */
+      const struct ddsi_twheel_node *node = ddsrt_fibheap_min (&overflow_fhdef, &w->overflow);
+      w->cursor = (node != NULL && node->tick <= tick) ? node->tick : tick + 1;
+    }
+  }
+  return NULL;
+}
+
+/* Returns the first tick >= cursor at which a node is due, or INT64_MAX if
+   the wheel is empty.  Scanning the slots is bounded by the size of the
+   wheel, a node that is far away is found in the overflow heap in constant
+   time. */
+static int64_t wheel_next_due_tick (struct ddsi_twheel_wheel *w)
+{
+  wheel_cascade (w);
+  for (uint32_t i = 0; i < DDSI_TWHEEL_NSLOTS; i++)
+  {
+    if (!ddsrt_circlist_isempty (&w->slots[slot_index (w->cursor + i)]))
+      return w->cursor + i;
+  }
+  const struct ddsi_twheel_node *node = ddsrt_fibheap_min (&overflow_fhdef, &w->overflow);
+  return (node == NULL) ? INT64_MAX : node->tick;
+}
+
+static void domain_twheel_tick (struct xevent *xev, void *varg, ddsrt_mtime_t tnow)
+{
+  struct ddsi_domain_twheel * const dtw = varg;
+  const int64_t tick = tick_floor (tnow);
+  struct ddsrt_circlist *slot;
+  ddsrt_mutex_lock (&dtw->lock);
+  while ((slot = wheel_advance (&dtw->wheel, tick)) != NULL)
+  {
+    do {
+      struct ddsrt_circlist_elem * const e = ddsrt_circlist_oldest (slot);
+      struct ddsi_twheel * const tw = DDSRT_FROM_CIRCLIST (struct ddsi_twheel, sched_node.u.e, e);
+      ddsrt_circlist_remove (slot, e);
+      ddsrt_circlist_append (&dtw->pending, e);
+      tw->state = DDSI_TWHEEL_PENDING;
+    } while (!ddsrt_circlist_isempty (slot));
+  }
+
+  /* one callback per history cache, with the same time for all of them, so
+     all nodes that expired since the previous tick are handled in one go */
+  while (!ddsrt_circlist_isempty (&dtw->pending))
+  {
+    struct ddsrt_circlist_elem * const e = ddsrt_circlist_oldest (&dtw->pending);
+    struct ddsi_twheel * const tw = DDSRT_FROM_CIRCLIST (struct ddsi_twheel, sched_node.u.e, e);
+    ddsrt_circlist_remove (&dtw->pending, e);
+    tw->state = DDSI_TWHEEL_IDLE;
+    dtw->executing = tw;
+    ddsrt_mutex_unlock (&dtw->lock);
+    (void) tw->cb (tw->hc, tnow);
+    ddsrt_mutex_lock (&dtw->lock);
+    dtw->executing = NULL;
+    ddsrt_cond_broadcast (&dtw->cond);
+  }
+  (void) resched_xevent_if_earlier (xev, tick_to_time (wheel_next_due_tick (&dtw->wheel)));
+  ddsrt_mutex_unlock (&dtw->lock);
+}
+
+void ddsi_domain_twheel_init (struct ddsi_domaingv *gv)
+{
+  struct ddsi_domain_twheel * const dtw = &gv->twheel;
+  ddsrt_mutex_init (&dtw->lock);
+  ddsrt_cond_init (&dtw->cond);
+  wheel_init (&dtw->wheel, tick_floor (ddsrt_time_monotonic ()));
+  wheel_alloc_slots (&dtw->wheel);
+  ddsrt_circlist_init (&dtw->pending);
+  dtw->executing = NULL;
+  dtw->evt = qxev_callback (gv->xevents, DDSRT_MTIME_NEVER, domain_twheel_tick, dtw);
+}
+
+void ddsi_domain_twheel_fini (struct ddsi_domaingv *gv)
+{
+  struct ddsi_domain_twheel * const dtw = &gv->twheel;
+  delete_xevent_callback (dtw->evt);
+  assert (ddsrt_circlist_isempty (&dtw->pending));
+  wheel_fini (&dtw->wheel);
+  ddsrt_cond_destroy (&dtw->cond);
+  ddsrt_mutex_destroy (&dtw->lock);
+}
+
+static void twheel_schedule (struct ddsi_twheel *tw, int64_t tick)
+{
+  struct ddsi_domain_twheel * const dtw = tw->dtw;
+  ddsrt_mutex_lock (&dtw->lock);
+  if (tick < dtw->wheel.cursor)
+    tick = dtw->wheel.cursor;
+  switch (tw->state)
+  {
+    case DDSI_TWHEEL_STOPPED:
+      tw->sched_hint = INT64_MIN;
+      break;
+    case DDSI_TWHEEL_PENDING:
+      /* callback will be invoked and that will reschedule it */
+      tw->sched_hint = tick;
+      break;
+    case DDSI_TWHEEL_SCHEDULED:
+      if (tick >= tw->sched_node.tick)
+      {
+        tw->sched_hint = tw->sched_node.tick;
+        break;
+      }
+      wheel_remove (&dtw->wheel, &tw->sched_node);
+      /* fall through */
+    case DDSI_TWHEEL_IDLE:
+      tw->state = DDSI_TWHEEL_SCHEDULED;
+      tw->sched_hint = tick;
+      wheel_insert (&dtw->wheel, &tw->sched_node, tick);
+      (void) resched_xevent_if_earlier (dtw->evt, tick_to_time (tick));
+      break;
+  }
+  ddsrt_mutex_unlock (&dtw->lock);
+}
+
+void ddsi_twheel_init (struct ddsi_domaingv *gv, struct ddsi_twheel *tw, ddsi_twheel_expired_cb_t cb, void *hc)
+{
+  wheel_init (&tw->wheel, tick_floor (ddsrt_time_monotonic ()));
+  tw->count = 0;
+  tw->sched_hint = INT64_MAX;
+  tw->dtw = &gv->twheel;
+  tw->cb = cb;
+  tw->hc = hc;
+  tw->state = DDSI_TWHEEL_IDLE;
+  tw->sched_node.tick = INT64_MAX;
+}
+
+void ddsi_twheel_stop (struct ddsi_twheel *tw)
+{
+  struct ddsi_domain_twheel * const dtw = tw->dtw;
+  ddsrt_mutex_lock (&dtw->lock);
+  switch (tw->state)
+  {
+    case DDSI_TWHEEL_SCHEDULED:
+      wheel_remove (&dtw->wheel, &tw->sched_node);
+      break;
+    case DDSI_TWHEEL_PENDING:
+      ddsrt_circlist_remove (&dtw->pending, &tw->sched_node.u.e);
+      break;
+    case DDSI_TWHEEL_IDLE:
+    case DDSI_TWHEEL_STOPPED:
+      break;
+  }
+  tw->state = DDSI_TWHEEL_STOPPED;
+  while (dtw->executing == tw)
+    ddsrt_cond_wait (&dtw->cond, &dtw->lock);
+  ddsrt_mutex_unlock (&dtw->lock);
+}
+
+void ddsi_twheel_fini (struct ddsi_twheel *tw)
+{
+  assert (tw->state == DDSI_TWHEEL_STOPPED);
+  assert (tw->count == 0);
+  wheel_fini (&tw->wheel);
+}
+
+void ddsi_twheel_insert_locked (struct ddsi_twheel *tw, struct ddsi_twheel_node *node, ddsrt_mtime_t texp)
+{
+  int64_t tick = tick_ceil (texp);
+  if (tw->wheel.slots == NULL)
+    wheel_alloc_slots (&tw->wheel);
+  if (tick < tw->wheel.cursor)
+    tick = tw->wheel.cursor;
+  wheel_insert (&tw->wheel, node, tick);
+  tw->count++;
+  if (tick < tw->sched_hint)
+    twheel_schedule (tw, tick);
+}
+
+void ddsi_twheel_remove_locked (struct ddsi_twheel *tw, struct ddsi_twheel_node *node)
+{
+  /* no need to reschedule: an early callback is harmless */
+  assert (tw->count > 0);
+  wheel_remove (&tw->wheel, node);
+  tw->count--;
+}
+
+struct ddsi_twheel_node *ddsi_twheel_next_expired_locked (struct ddsi_twheel *tw, ddsrt_mtime_t tnow, ddsrt_mtime_t *tnext)
+{
+  if (tw->count == 0)
+  {
+    tw->sched_hint = INT64_MAX;
+    *tnext = DDSRT_MTIME_NEVER;
+    return NULL;
+  }
+
+  const int64_t tick = tick_floor (tnow);
+  const struct ddsrt_circlist *slot;
+  if ((slot = wheel_advance (&tw->wheel, tick)) != NULL)
+    return DDSRT_FROM_CIRCLIST (struct ddsi_twheel_node, u.e, ddsrt_circlist_oldest (slot));
+
+  /* nothing has a tick <= the current tick, and as the wheel isn't empty,
+     tnow can't be "never" */
+  assert (tick != INT64_MAX);
+  const int64_t next_tick = wheel_next_due_tick (&tw->wheel);
+  assert (next_tick != INT64_MAX);
+  twheel_schedule (tw, next_tick);
+  *tnext = tick_to_time (next_tick);
+  return NULL;
+}
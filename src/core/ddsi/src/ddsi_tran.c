@@ -140,7 +140,9 @@ void ddsi_conn_free (ddsi_tran_conn_t conn)
             switch (conn->m_base.gv->recv_threads[i].arg.mode)
             {
               case RTM_MANY:
-                os_sockWaitsetRemove (conn->m_base.gv->recv_threads[i].arg.u.many.ws, conn);
+                /* with io_uring, sockets are only closed once the receive threads have stopped */
+                if (conn->m_base.gv->recv_threads[i].arg.u.many.ws)
+                  os_sockWaitsetRemove (conn->m_base.gv->recv_threads[i].arg.u.many.ws, conn);
                 break;
               case RTM_SINGLE:
                 if (conn->m_base.gv->recv_threads[i].arg.u.single.conn == conn)
@@ -174,6 +176,7 @@ void ddsi_factory_conn_init (const struct ddsi_tran_factory *factory, const stru
   conn->m_stream = factory->m_stream;
   conn->m_factory = (struct ddsi_tran_factory *) factory;
   conn->m_interf = interf;
+  conn->m_rx_timestamp.v = 0;
   conn->m_base.gv = factory->gv;
 }
 
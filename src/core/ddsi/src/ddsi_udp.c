@@ -19,6 +19,7 @@
 #include "dds/ddsrt/string.h"
 #include "dds/ddsrt/static_assert.h"
 #include "ddsi_eth.h"
+#include "ddsi_udp_impl.h"
 #include "dds/ddsi/ddsi_tran.h"
 #include "dds/ddsi/ddsi_udp.h"
 #include "dds/ddsi/ddsi_ipaddr.h"
@@ -37,24 +38,6 @@ union addr {
 #endif
 };
 
-typedef struct ddsi_udp_conn {
-  struct ddsi_tran_conn m_base;
-  ddsrt_socket_t m_sock;
-#if defined _WIN32
-  WSAEVENT m_sockEvent;
-#endif
-  int m_diffserv;
-} *ddsi_udp_conn_t;
-
-typedef struct ddsi_udp_tran_factory {
-  struct ddsi_tran_factory fact;
-  int32_t m_kind;
-
-  // actual minimum receive buffer size in use
-  // atomically loaded/stored so we don't have to lie about constness
-  ddsrt_atomic_uint32_t receive_buf_size;
-} *ddsi_udp_tran_factory_t;
-
 static void addr_to_loc (const struct ddsi_tran_factory *tran, ddsi_locator_t *dst, const union addr *src)
 {
   (void) tran;
@@ -71,6 +54,12 @@ static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char * bu
   union addr src;
   ddsrt_iovec_t msg_iov;
   socklen_t srclen = (socklen_t) sizeof (src);
+#ifdef SO_TIMESTAMPNS
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE (sizeof (struct timespec))];
+  } ctrl;
+#endif
   (void) allow_spurious;
 
   msg_iov.iov_base = (void *) buf;
@@ -87,6 +76,13 @@ static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char * bu
   msghdr.msg_control = NULL;
   msghdr.msg_controllen = 0;
 #endif
+#ifdef SO_TIMESTAMPNS
+  if (conn->m_rx_timestamps)
+  {
+    msghdr.msg_control = ctrl.buf;
+    msghdr.msg_controllen = sizeof (ctrl.buf);
+  }
+#endif
 
   do {
     rc = ddsrt_recvmsg (conn->m_sock, &msghdr, 0, &ret);
@@ -97,6 +93,22 @@ static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char * bu
     if (srcloc)
       addr_to_loc (conn->m_base.m_factory, srcloc, &src);
 
+#ifdef SO_TIMESTAMPNS
+    if (conn->m_rx_timestamps)
+    {
+      conn->m_base.m_rx_timestamp.v = 0;
+      for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (&msghdr); cmsg; cmsg = CMSG_NXTHDR (&msghdr, cmsg))
+      {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+          struct timespec ts;
+          memcpy (&ts, CMSG_DATA (cmsg), sizeof (ts));
+          conn->m_base.m_rx_timestamp.v = (int64_t) ts.tv_sec * DDS_NSECS_IN_SEC + ts.tv_nsec;
+        }
+      }
+    }
+#endif
+
     if (gv->pcap_fp)
     {
       union addr dest;
@@ -568,11 +580,23 @@ static dds_return_t ddsi_udp_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_
   }
 #endif
 
-  ddsi_udp_conn_t conn = ddsrt_malloc (sizeof (*conn));
-  memset (conn, 0, sizeof (*conn));
+  bool rx_timestamps = false;
+#ifdef SO_TIMESTAMPNS
+  if (gv->config.meas_receive_latency && qos->m_purpose != DDSI_TRAN_QOS_XMIT)
+  {
+    if ((rc = ddsrt_setsockopt (sock, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof (one))) == DDS_RETCODE_OK)
+      rx_timestamps = true;
+    else
+      GVWARNING ("ddsi_udp_create_conn: failed to enable receive timestamps: %s\n", dds_strretcode (rc));
+  }
+#endif
+
+  ddsi_udp_conn_t conn = ddsrt_malloc (fact->m_conn_size);
+  memset (conn, 0, fact->m_conn_size);
 
   conn->m_sock = sock;
   conn->m_diffserv = qos->m_diffserv;
+  conn->m_rx_timestamps = rx_timestamps;
 #if defined _WIN32 && !defined WINCE
   conn->m_sockEvent = WSACreateEvent ();
   WSAEventSelect (conn->m_sock, conn->m_sockEvent, FD_WRITE);
@@ -903,11 +927,11 @@ static int ddsi_udp_locator_from_sockaddr (const struct ddsi_tran_factory *tran_
   return 0;
 }
 
-int ddsi_udp_init (struct ddsi_domaingv*gv)
+void ddsi_udp_factory_init (struct ddsi_udp_tran_factory *fact, struct ddsi_domaingv *gv)
 {
-  struct ddsi_udp_tran_factory *fact = ddsrt_malloc (sizeof (*fact));
   memset (fact, 0, sizeof (*fact));
   fact->m_kind = NN_LOCATOR_KIND_UDPv4;
+  fact->m_conn_size = sizeof (struct ddsi_udp_conn);
   fact->fact.gv = gv;
   fact->fact.m_free_fn = ddsi_udp_fini;
   fact->fact.m_typename = "udp";
@@ -940,7 +964,12 @@ int ddsi_udp_init (struct ddsi_domaingv*gv)
   }
 #endif
   ddsrt_atomic_st32 (&fact->receive_buf_size, UINT32_MAX);
+}
 
+int ddsi_udp_init (struct ddsi_domaingv *gv)
+{
+  struct ddsi_udp_tran_factory *fact = ddsrt_malloc (sizeof (*fact));
+  ddsi_udp_factory_init (fact, gv);
   ddsi_factory_add (gv, &fact->fact);
   GVLOG (DDS_LC_CONFIG, "udp initialized\n");
   return 0;
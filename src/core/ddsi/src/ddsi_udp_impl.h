@@ -0,0 +1,55 @@
+/*
+ * Copyright(c) 2006 to 2018 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_UDP_IMPL_H
+#define DDSI_UDP_IMPL_H
+
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsi/ddsi_tran.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* The UDP connection and factory types are shared with transports that are
+   built on top of the UDP one (io_uring), which extend them by embedding */
+
+typedef struct ddsi_udp_conn {
+  struct ddsi_tran_conn m_base;
+  ddsrt_socket_t m_sock;
+#if defined _WIN32
+  WSAEVENT m_sockEvent;
+#endif
+  int m_diffserv;
+  bool m_rx_timestamps;
+} *ddsi_udp_conn_t;
+
+typedef struct ddsi_udp_tran_factory {
+  struct ddsi_tran_factory fact;
+  int32_t m_kind;
+
+  // size of the connection objects to allocate, at least sizeof (struct ddsi_udp_conn)
+  size_t m_conn_size;
+
+  // actual minimum receive buffer size in use
+  // atomically loaded/stored so we don't have to lie about constness
+  ddsrt_atomic_uint32_t receive_buf_size;
+} *ddsi_udp_tran_factory_t;
+
+/* Initializes a UDP factory without adding it to the set of factories */
+void ddsi_udp_factory_init (struct ddsi_udp_tran_factory *fact, struct ddsi_domaingv *gv);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_UDP_IMPL_H */
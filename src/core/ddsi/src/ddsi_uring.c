@@ -0,0 +1,772 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <string.h>
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/log.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsrt/static_assert.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/threads.h"
+#include "dds/ddsi/ddsi_tran.h"
+#include "dds/ddsi/ddsi_udp.h"
+#include "dds/ddsi/ddsi_uring.h"
+#include "dds/ddsi/ddsi_ipaddr.h"
+#include "dds/ddsi/q_config.h"
+#include "dds/ddsi/q_log.h"
+#include "dds/ddsi/q_pcap.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "ddsi_udp_impl.h"
+
+#if defined(__linux) && !LWIP_SOCKET
+#include <linux/io_uring.h>
+#endif
+
+#if defined(__linux) && !LWIP_SOCKET && defined(IORING_RECV_MULTISHOT)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+
+/* Transmit rings: all sends of an RTPS message (one per destination) are
+   submitted with a single system call.  The ring is drained before the
+   batch ends, because the data is owned by the caller, and so a batch of
+   at most this many sends fits in the ring. */
+#define URING_TX_ENTRIES 64u
+#define URING_TX_BATCH_MAX_CONNS 8u
+
+/* Receive rings: one multishot recvmsg per socket, plus a read on an
+   eventfd for waking up the receive thread.  Datagrams are received in a
+   ring of provided buffers, each large enough to hold a datagram of the
+   maximum size do_packet accepts, preceded by the recvmsg header, source
+   address and control data. */
+#define URING_RX_ENTRIES 64u
+#define URING_RX_NBUFS 16u
+#define URING_RX_BGID 0
+#define URING_RX_CONNS_DELTA 8u
+#define URING_RX_UD_EVENTFD UINT64_MAX
+#define URING_RX_NAMELEN ((uint32_t) sizeof (struct sockaddr_storage))
+#define URING_RX_CONTROLLEN ((uint32_t) CMSG_SPACE (sizeof (struct timespec)))
+#define URING_RX_HDRLEN ((uint32_t) sizeof (struct io_uring_recvmsg_out) + URING_RX_NAMELEN + URING_RX_CONTROLLEN)
+
+union addr {
+  struct sockaddr_storage x;
+  struct sockaddr a;
+  struct sockaddr_in a4;
+#if DDSRT_HAVE_IPV6
+  struct sockaddr_in6 a6;
+#endif
+};
+
+struct uring {
+  int fd;
+  unsigned char *sq_map, *cq_map;
+  size_t sq_map_size, cq_map_size;
+  struct io_uring_sqe *sqes;
+  size_t sqes_size;
+  volatile uint32_t *sq_head, *sq_tail, *cq_head, *cq_tail;
+  uint32_t *sq_array;
+  uint32_t sq_mask, cq_mask, sq_entries;
+  struct io_uring_cqe *cqes;
+  uint32_t tail; /* local SQ tail, includes SQEs not yet published */
+};
+
+struct ddsi_uring_tx {
+  ddsrt_mutex_t lock;
+  struct uring ring;
+  uint32_t ninflight;
+  struct {
+    struct msghdr msg;
+    union addr dst;
+  } slots[URING_TX_ENTRIES];
+};
+
+struct ddsi_uring_rxmsg {
+  uint32_t connidx;
+  uint16_t bid;
+  uint32_t len; /* number of bytes of the buffer filled */
+};
+
+struct ddsi_uring_conn {
+  struct ddsi_udp_conn m_udp;
+  ddsi_tran_read_fn_t m_udp_read_fn;
+  ddsi_tran_write_fn_t m_udp_write_fn;
+  struct ddsi_uring_tx *m_tx;                /* NULL: plain UDP sends */
+  const unsigned char *m_staged;             /* datagram to be read, NULL if none */
+  uint32_t m_staged_len;
+};
+
+struct ddsi_uring_tran_factory {
+  struct ddsi_udp_tran_factory m_udp;
+  ddsi_tran_create_conn_fn_t m_udp_create_conn_fn;
+  ddsi_tran_release_conn_fn_t m_udp_release_conn_fn;
+};
+
+struct ddsi_uring_rxconn {
+  struct ddsi_uring_conn *conn;
+  bool armed;                                /* multishot receive outstanding */
+};
+
+struct ddsi_uring_rx {
+  struct ddsi_domaingv *gv;
+  struct uring ring;
+  int evfd;
+  uint64_t evbuf;
+  bool evarmed;
+  struct msghdr msg; /* only the name and control lengths are used */
+  uint32_t bufsize;
+  unsigned char *bufs;
+  struct io_uring_buf_ring *br;
+  size_t br_size;
+  uint16_t br_tail;
+  uint32_t nconns, conns_sz;
+  struct ddsi_uring_rxconn *conns;
+  uint32_t nready, next;
+  struct ddsi_uring_rxmsg ready[URING_RX_NBUFS];
+  struct ddsi_uring_rxmsg *staged;
+};
+
+static ddsrt_thread_local struct {
+  bool active;
+  uint32_t nfailed;
+  uint32_t nconns;
+  struct ddsi_uring_conn *conns[URING_TX_BATCH_MAX_CONNS];
+} uring_tx_batch;
+
+static int uring_enter (const struct uring *r, uint32_t to_submit, uint32_t min_complete)
+{
+  return (int) syscall (__NR_io_uring_enter, r->fd, to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+static int uring_register (const struct uring *r, unsigned opcode, void *arg, unsigned nargs)
+{
+  return (int) syscall (__NR_io_uring_register, r->fd, opcode, arg, nargs);
+}
+
+static void uring_fini (struct uring *r)
+{
+  if (r->sqes)
+    munmap (r->sqes, r->sqes_size);
+  if (r->cq_map && r->cq_map != r->sq_map)
+    munmap (r->cq_map, r->cq_map_size);
+  if (r->sq_map)
+    munmap (r->sq_map, r->sq_map_size);
+  close (r->fd);
+}
+
+static int uring_init (struct uring *r, uint32_t entries)
+{
+  struct io_uring_params p;
+  memset (r, 0, sizeof (*r));
+  memset (&p, 0, sizeof (p));
+  if ((r->fd = (int) syscall (__NR_io_uring_setup, entries, &p)) < 0)
+    return -1;
+  r->sq_map_size = p.sq_off.array + p.sq_entries * sizeof (uint32_t);
+  r->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (r->cq_map_size > r->sq_map_size)
+      r->sq_map_size = r->cq_map_size;
+    r->cq_map_size = r->sq_map_size;
+  }
+  if ((r->sq_map = mmap (NULL, r->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING)) == MAP_FAILED)
+  {
+    r->sq_map = NULL;
+    goto fail;
+  }
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    r->cq_map = r->sq_map;
+  else if ((r->cq_map = mmap (NULL, r->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING)) == MAP_FAILED)
+  {
+    r->cq_map = NULL;
+    goto fail;
+  }
+  r->sqes_size = p.sq_entries * sizeof (struct io_uring_sqe);
+  if ((r->sqes = mmap (NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES)) == MAP_FAILED)
+  {
+    r->sqes = NULL;
+    goto fail;
+  }
+  r->sq_head = (volatile uint32_t *) (r->sq_map + p.sq_off.head);
+  r->sq_tail = (volatile uint32_t *) (r->sq_map + p.sq_off.tail);
+  r->sq_mask = *(uint32_t *) (r->sq_map + p.sq_off.ring_mask);
+  r->sq_array = (uint32_t *) (r->sq_map + p.sq_off.array);
+  r->sq_entries = p.sq_entries;
+  r->cq_head = (volatile uint32_t *) (r->cq_map + p.cq_off.head);
+  r->cq_tail = (volatile uint32_t *) (r->cq_map + p.cq_off.tail);
+  r->cq_mask = *(uint32_t *) (r->cq_map + p.cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe *) (r->cq_map + p.cq_off.cqes);
+  return 0;
+
+fail:
+  uring_fini (r);
+  return -1;
+}
+
+/* Number of SQEs queued but not yet consumed by the kernel */
+static uint32_t uring_pending (const struct uring *r)
+{
+  return r->tail - *r->sq_head;
+}
+
+/* Returns a zeroed SQE for the caller to fill in, the caller must not queue
+   more than sq_entries SQEs before submitting them */
+static struct io_uring_sqe *uring_get_sqe (struct uring *r)
+{
+  assert (uring_pending (r) < r->sq_entries);
+  const uint32_t idx = r->tail++ & r->sq_mask;
+  struct io_uring_sqe *sqe = &r->sqes[idx];
+  memset (sqe, 0, sizeof (*sqe));
+  r->sq_array[idx] = idx;
+  return sqe;
+}
+
+static void uring_publish (struct uring *r)
+{
+  ddsrt_atomic_fence_rel ();
+  *r->sq_tail = r->tail;
+}
+
+static struct io_uring_cqe *uring_peek_cqe (struct uring *r)
+{
+  const uint32_t head = *r->cq_head;
+  if (head == *r->cq_tail)
+    return NULL;
+  ddsrt_atomic_fence_acq ();
+  return &r->cqes[head & r->cq_mask];
+}
+
+static void uring_cqe_seen (struct uring *r)
+{
+  ddsrt_atomic_fence_rel ();
+  *r->cq_head = *r->cq_head + 1;
+}
+
+static bool uring_supported (struct ddsi_domaingv *gv)
+{
+  struct uring r;
+  bool ok = false;
+  if (uring_init (&r, 2) < 0)
+  {
+    GVLOG (DDS_LC_CONFIG, "io_uring: setup failed: %s\n", strerror (errno));
+    return false;
+  }
+
+  /* Multishot receives date from the same kernel release as zero-copy
+     sends; the former can't be probed for, the latter can */
+  const size_t probe_size = sizeof (struct io_uring_probe) + 256 * sizeof (struct io_uring_probe_op);
+  struct io_uring_probe *probe = ddsrt_malloc (probe_size);
+  memset (probe, 0, probe_size);
+  if (uring_register (&r, IORING_REGISTER_PROBE, probe, 256) < 0)
+    GVLOG (DDS_LC_CONFIG, "io_uring: probe failed: %s\n", strerror (errno));
+  else
+  {
+    static const uint8_t ops[] = { IORING_OP_RECVMSG, IORING_OP_SENDMSG, IORING_OP_READ, IORING_OP_SEND_ZC };
+    ok = true;
+    for (size_t i = 0; i < sizeof (ops) / sizeof (ops[0]); i++)
+    {
+      if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+      {
+        GVLOG (DDS_LC_CONFIG, "io_uring: operation %u not supported\n", (unsigned) ops[i]);
+        ok = false;
+      }
+    }
+  }
+  ddsrt_free (probe);
+  uring_fini (&r);
+  return ok;
+}
+
+/* TRANSMIT */
+
+static struct ddsi_uring_tx *uring_tx_new (void)
+{
+  struct ddsi_uring_tx *tx = ddsrt_malloc (sizeof (*tx));
+  memset (tx, 0, sizeof (*tx));
+  if (uring_init (&tx->ring, URING_TX_ENTRIES) < 0)
+  {
+    ddsrt_free (tx);
+    return NULL;
+  }
+  assert (tx->ring.sq_entries == URING_TX_ENTRIES);
+  ddsrt_mutex_init (&tx->lock);
+  return tx;
+}
+
+static void uring_tx_free (struct ddsi_uring_tx *tx)
+{
+  assert (uring_pending (&tx->ring) == 0 && tx->ninflight == 0);
+  ddsrt_mutex_destroy (&tx->lock);
+  uring_fini (&tx->ring);
+  ddsrt_free (tx);
+}
+
+/* Submits all queued sends and waits for all of them to complete, so that
+   the caller's data and all slots are free again; returns the number of them
+   that failed */
+static uint32_t uring_tx_flush_locked (struct ddsi_uring_conn *conn)
+{
+  struct ddsi_domaingv * const gv = conn->m_udp.m_base.m_base.gv;
+  struct ddsi_uring_tx * const tx = conn->m_tx;
+  struct uring * const r = &tx->ring;
+  uint32_t nfailed = 0;
+  uint32_t npending;
+  while ((npending = uring_pending (r)) > 0 || tx->ninflight > 0)
+  {
+    const int n = uring_enter (r, npending, npending + tx->ninflight);
+    if (n >= 0)
+      tx->ninflight += (uint32_t) n;
+    else if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+    {
+      /* The kernel didn't consume them, so retracting them is safe */
+      GVERROR ("ddsi_uring_conn_write: io_uring_enter failed: %s\n", strerror (errno));
+      nfailed += npending;
+      r->tail = *r->sq_head;
+      uring_publish (r);
+    }
+    struct io_uring_cqe *cqe;
+    while ((cqe = uring_peek_cqe (r)) != NULL)
+    {
+      const int res = cqe->res;
+      if (res < 0)
+      {
+        nfailed++;
+        if (res != -EPERM && res != -EACCES && res != -ECONNRESET && res != -EHOSTUNREACH && res != -EHOSTDOWN)
+        {
+          char locbuf[DDSI_LOCSTRLEN];
+          ddsi_locator_t dst;
+          const union addr *dstaddr = &tx->slots[cqe->user_data].dst;
+          ddsi_ipaddr_to_loc (&dst, &dstaddr->a, (dstaddr->a.sa_family == AF_INET) ? NN_LOCATOR_KIND_UDPv4 : NN_LOCATOR_KIND_UDPv6);
+          GVERROR ("ddsi_uring_conn_write to %s failed: %s\n", ddsi_locator_to_string (locbuf, sizeof (locbuf), &dst), strerror (-res));
+        }
+      }
+      assert (tx->ninflight > 0);
+      tx->ninflight--;
+      uring_cqe_seen (r);
+    }
+  }
+  return nfailed;
+}
+
+static ssize_t ddsi_uring_conn_write (ddsi_tran_conn_t conn_cmn, const ddsi_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags)
+{
+  struct ddsi_uring_conn * const conn = (struct ddsi_uring_conn *) conn_cmn;
+  struct ddsi_domaingv * const gv = conn->m_udp.m_base.m_base.gv;
+  struct ddsi_uring_tx * const tx = conn->m_tx;
+  if (tx == NULL || gv->pcap_fp)
+    return conn->m_udp_write_fn (conn_cmn, dst, niov, iov, flags);
+
+  size_t len = 0;
+  for (size_t i = 0; i < niov; i++)
+    len += iov[i].iov_len;
+
+  /* failures of earlier sends that get flushed here are accounted to the
+     batch, if any, otherwise they have been reported already */
+  uint32_t nfailed = 0;
+  ddsrt_mutex_lock (&tx->lock);
+  if (uring_pending (&tx->ring) == URING_TX_ENTRIES)
+    nfailed += uring_tx_flush_locked (conn);
+  const uint32_t slot = tx->ring.tail & tx->ring.sq_mask;
+  struct msghdr * const msg = &tx->slots[slot].msg;
+  ddsi_ipaddr_from_loc (&tx->slots[slot].dst.x, dst);
+  memset (msg, 0, sizeof (*msg));
+  msg->msg_name = &tx->slots[slot].dst.x;
+  msg->msg_namelen = (socklen_t) ddsrt_sockaddr_get_size (&tx->slots[slot].dst.a);
+  msg->msg_iov = (struct iovec *) iov;
+  msg->msg_iovlen = niov;
+  struct io_uring_sqe * const sqe = uring_get_sqe (&tx->ring);
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = conn->m_udp.m_sock;
+  sqe->addr = (uint64_t) (uintptr_t) msg;
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL | flags;
+  sqe->user_data = slot;
+  uring_publish (&tx->ring);
+
+  if (!uring_tx_batch.active)
+  {
+    /* only the outcome of this send matters, and it is the last one */
+    nfailed = uring_tx_flush_locked (conn);
+    ddsrt_mutex_unlock (&tx->lock);
+    return (nfailed > 0) ? -1 : (ssize_t) len;
+  }
+
+  uint32_t i;
+  for (i = 0; i < uring_tx_batch.nconns && uring_tx_batch.conns[i] != conn; i++)
+    ;
+  if (i < uring_tx_batch.nconns)
+    ; /* already part of this batch */
+  else if (i < URING_TX_BATCH_MAX_CONNS)
+    uring_tx_batch.conns[uring_tx_batch.nconns++] = conn;
+  else
+    nfailed += uring_tx_flush_locked (conn);
+  ddsrt_mutex_unlock (&tx->lock);
+  /* the outcome is known only at the end of the batch */
+  uring_tx_batch.nfailed += nfailed;
+  return (ssize_t) len;
+}
+
+void ddsi_uring_tx_begin (void)
+{
+  assert (!uring_tx_batch.active);
+  uring_tx_batch.active = true;
+  uring_tx_batch.nfailed = 0;
+  uring_tx_batch.nconns = 0;
+}
+
+uint32_t ddsi_uring_tx_end (void)
+{
+  assert (uring_tx_batch.active);
+  for (uint32_t i = 0; i < uring_tx_batch.nconns; i++)
+  {
+    struct ddsi_uring_conn * const conn = uring_tx_batch.conns[i];
+    ddsrt_mutex_lock (&conn->m_tx->lock);
+    uring_tx_batch.nfailed += uring_tx_flush_locked (conn);
+    ddsrt_mutex_unlock (&conn->m_tx->lock);
+  }
+  uring_tx_batch.active = false;
+  return uring_tx_batch.nfailed;
+}
+
+/* RECEIVE */
+
+static void uring_rx_recycle (struct ddsi_uring_rx *rx, uint16_t bid)
+{
+  struct io_uring_buf *b = &rx->br->bufs[rx->br_tail & (URING_RX_NBUFS - 1)];
+  b->addr = (uint64_t) (uintptr_t) (rx->bufs + (size_t) bid * rx->bufsize);
+  b->len = rx->bufsize;
+  b->bid = bid;
+  rx->br_tail++;
+  ddsrt_atomic_fence_rel ();
+  ((volatile struct io_uring_buf_ring *) rx->br)->tail = rx->br_tail;
+}
+
+struct ddsi_uring_rx *ddsi_uring_rx_new (struct ddsi_domaingv *gv)
+{
+  DDSRT_STATIC_ASSERT ((URING_RX_NBUFS & (URING_RX_NBUFS - 1)) == 0);
+  struct ddsi_uring_rx *rx = ddsrt_malloc (sizeof (*rx));
+  memset (rx, 0, sizeof (*rx));
+  rx->gv = gv;
+  rx->evfd = -1;
+  if (uring_init (&rx->ring, URING_RX_ENTRIES) < 0)
+  {
+    GVERROR ("ddsi_uring_rx_new: io_uring setup failed: %s\n", strerror (errno));
+    goto fail_ring;
+  }
+  if ((rx->evfd = eventfd (0, EFD_CLOEXEC)) < 0)
+  {
+    GVERROR ("ddsi_uring_rx_new: eventfd failed: %s\n", strerror (errno));
+    goto fail_evfd;
+  }
+
+  /* Buffer size matches the maximum do_packet reads */
+  const uint32_t maxsz = gv->config.rmsg_chunk_size < 65536 ? gv->config.rmsg_chunk_size : 65536;
+  rx->bufsize = URING_RX_HDRLEN + maxsz;
+  rx->bufs = ddsrt_malloc ((size_t) URING_RX_NBUFS * rx->bufsize);
+  rx->br_size = URING_RX_NBUFS * sizeof (struct io_uring_buf);
+  if ((rx->br = mmap (NULL, rx->br_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+  {
+    GVERROR ("ddsi_uring_rx_new: mmap failed: %s\n", strerror (errno));
+    goto fail_br;
+  }
+  struct io_uring_buf_reg reg;
+  memset (&reg, 0, sizeof (reg));
+  reg.ring_addr = (uint64_t) (uintptr_t) rx->br;
+  reg.ring_entries = URING_RX_NBUFS;
+  reg.bgid = URING_RX_BGID;
+  if (uring_register (&rx->ring, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+  {
+    GVERROR ("ddsi_uring_rx_new: registering buffer ring failed: %s\n", strerror (errno));
+    goto fail_reg;
+  }
+  for (uint16_t i = 0; i < URING_RX_NBUFS; i++)
+    uring_rx_recycle (rx, i);
+  rx->msg.msg_namelen = URING_RX_NAMELEN;
+  rx->msg.msg_controllen = URING_RX_CONTROLLEN;
+  return rx;
+
+fail_reg:
+  munmap (rx->br, rx->br_size);
+fail_br:
+  ddsrt_free (rx->bufs);
+  close (rx->evfd);
+fail_evfd:
+  uring_fini (&rx->ring);
+fail_ring:
+  ddsrt_free (rx);
+  return NULL;
+}
+
+void ddsi_uring_rx_free (struct ddsi_uring_rx *rx)
+{
+  /* Closing the ring cancels the outstanding requests */
+  for (uint32_t i = 0; i < rx->nconns; i++)
+    rx->conns[i].conn->m_staged = NULL;
+  uring_fini (&rx->ring);
+  munmap (rx->br, rx->br_size);
+  ddsrt_free (rx->bufs);
+  close (rx->evfd);
+  ddsrt_free (rx->conns);
+  ddsrt_free (rx);
+}
+
+int ddsi_uring_rx_add (struct ddsi_uring_rx *rx, ddsi_tran_conn_t conn_cmn)
+{
+  struct ddsi_uring_conn * const conn = (struct ddsi_uring_conn *) conn_cmn;
+  for (uint32_t i = 0; i < rx->nconns; i++)
+    if (rx->conns[i].conn == conn)
+      return 0;
+  if (rx->nconns == rx->conns_sz)
+  {
+    rx->conns_sz += URING_RX_CONNS_DELTA;
+    rx->conns = ddsrt_realloc (rx->conns, rx->conns_sz * sizeof (*rx->conns));
+  }
+  rx->conns[rx->nconns++] = (struct ddsi_uring_rxconn) { .conn = conn, .armed = false };
+  return 1;
+}
+
+void ddsi_uring_rx_trigger (struct ddsi_uring_rx *rx)
+{
+  const uint64_t one = 1;
+  (void) !write (rx->evfd, &one, sizeof (one));
+}
+
+int ddsi_uring_rx_wait (struct ddsi_uring_rx *rx)
+{
+  struct ddsi_domaingv * const gv = rx->gv;
+  struct uring * const r = &rx->ring;
+  assert (rx->staged == NULL && rx->next == rx->nready);
+  rx->nready = rx->next = 0;
+
+  /* (Re-)arm receives on sockets for which the kernel terminated it, which
+     mostly happens when running out of buffers, at this point all buffers
+     have been returned */
+  for (uint32_t i = 0; i < rx->nconns; i++)
+  {
+    if (rx->conns[i].armed)
+      continue;
+    if (uring_pending (r) + 1 >= r->sq_entries)
+    {
+      /* more sockets than fit in the submission queue, leaving room for
+         the eventfd read */
+      uring_publish (r);
+      if (uring_enter (r, uring_pending (r), 0) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+      {
+        GVERROR ("ddsi_uring_rx_wait: io_uring_enter failed: %s\n", strerror (errno));
+        return -1;
+      }
+      if (uring_pending (r) + 1 >= r->sq_entries)
+        break;
+    }
+    struct io_uring_sqe *sqe = uring_get_sqe (r);
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = rx->conns[i].conn->m_udp.m_sock;
+    sqe->addr = (uint64_t) (uintptr_t) &rx->msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_RX_BGID;
+    sqe->user_data = i;
+    rx->conns[i].armed = true;
+  }
+  if (!rx->evarmed)
+  {
+    struct io_uring_sqe *sqe = uring_get_sqe (r);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = rx->evfd;
+    sqe->addr = (uint64_t) (uintptr_t) &rx->evbuf;
+    sqe->len = sizeof (rx->evbuf);
+    sqe->user_data = URING_RX_UD_EVENTFD;
+    rx->evarmed = true;
+  }
+  uring_publish (r);
+  if (uring_enter (r, uring_pending (r), 1) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+  {
+    GVERROR ("ddsi_uring_rx_wait: io_uring_enter failed: %s\n", strerror (errno));
+    return -1;
+  }
+
+  struct io_uring_cqe *cqe;
+  while ((cqe = uring_peek_cqe (r)) != NULL)
+  {
+    if (cqe->user_data == URING_RX_UD_EVENTFD)
+      rx->evarmed = false;
+    else
+    {
+      const uint32_t idx = (uint32_t) cqe->user_data;
+      assert (idx < rx->nconns);
+      if (!(cqe->flags & IORING_CQE_F_MORE))
+        rx->conns[idx].armed = false;
+      if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED)
+        GVERROR ("ddsi_uring_rx_wait: receive on socket %d failed: %s\n", (int) rx->conns[idx].conn->m_udp.m_sock, strerror (-cqe->res));
+      if (cqe->flags & IORING_CQE_F_BUFFER)
+      {
+        const uint16_t bid = (uint16_t) (cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        if (cqe->res < (int) URING_RX_HDRLEN)
+          uring_rx_recycle (rx, bid);
+        else
+        {
+          assert (rx->nready < URING_RX_NBUFS);
+          rx->ready[rx->nready++] = (struct ddsi_uring_rxmsg) { .connidx = idx, .bid = bid, .len = (uint32_t) cqe->res };
+        }
+      }
+    }
+    uring_cqe_seen (r);
+  }
+  return 0;
+}
+
+ddsi_tran_conn_t ddsi_uring_rx_next (struct ddsi_uring_rx *rx)
+{
+  if (rx->staged)
+  {
+    rx->conns[rx->staged->connidx].conn->m_staged = NULL;
+    uring_rx_recycle (rx, rx->staged->bid);
+    rx->staged = NULL;
+  }
+  if (rx->next == rx->nready)
+    return NULL;
+  rx->staged = &rx->ready[rx->next++];
+  struct ddsi_uring_conn * const conn = rx->conns[rx->staged->connidx].conn;
+  conn->m_staged = rx->bufs + (size_t) rx->staged->bid * rx->bufsize;
+  conn->m_staged_len = rx->staged->len;
+  return &conn->m_udp.m_base;
+}
+
+/* The rmsg a datagram is read into outlives the receive buffer, so this
+   copies it; the gain is in the number of system calls, not copies */
+static ssize_t ddsi_uring_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char *buf, size_t len, bool allow_spurious, ddsi_locator_t *srcloc)
+{
+  struct ddsi_uring_conn * const conn = (struct ddsi_uring_conn *) conn_cmn;
+  struct ddsi_domaingv * const gv = conn->m_udp.m_base.m_base.gv;
+  const unsigned char * const staged = conn->m_staged;
+  if (staged == NULL)
+    return conn->m_udp_read_fn (conn_cmn, buf, len, allow_spurious, srcloc);
+  conn->m_staged = NULL;
+
+  struct io_uring_recvmsg_out out;
+  union addr src;
+  memcpy (&out, staged, sizeof (out));
+  memset (&src, 0, sizeof (src));
+  memcpy (&src, staged + sizeof (out), out.namelen < URING_RX_NAMELEN ? out.namelen : URING_RX_NAMELEN);
+  const unsigned char *control = staged + sizeof (out) + URING_RX_NAMELEN;
+  const unsigned char *payload = control + URING_RX_CONTROLLEN;
+  size_t sz = conn->m_staged_len - URING_RX_HDRLEN;
+  if (sz > out.payloadlen)
+    sz = out.payloadlen;
+  const bool trunc_flag = (out.flags & MSG_TRUNC) || sz > len;
+  if (sz > len)
+    sz = len;
+  memcpy (buf, payload, sz);
+
+  if (srcloc)
+    ddsi_ipaddr_to_loc (srcloc, &src.a, (src.a.sa_family == AF_INET) ? NN_LOCATOR_KIND_UDPv4 : NN_LOCATOR_KIND_UDPv6);
+
+#ifdef SO_TIMESTAMPNS
+  if (conn->m_udp.m_rx_timestamps)
+  {
+    struct msghdr msghdr;
+    memset (&msghdr, 0, sizeof (msghdr));
+    msghdr.msg_control = (void *) control;
+    msghdr.msg_controllen = out.controllen < URING_RX_CONTROLLEN ? out.controllen : URING_RX_CONTROLLEN;
+    conn->m_udp.m_base.m_rx_timestamp.v = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (&msghdr); cmsg; cmsg = CMSG_NXTHDR (&msghdr, cmsg))
+    {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+      {
+        struct timespec ts;
+        memcpy (&ts, CMSG_DATA (cmsg), sizeof (ts));
+        conn->m_udp.m_base.m_rx_timestamp.v = (int64_t) ts.tv_sec * DDS_NSECS_IN_SEC + ts.tv_nsec;
+      }
+    }
+  }
+#endif
+
+  if (gv->pcap_fp)
+  {
+    union addr dest;
+    socklen_t dest_len = sizeof (dest);
+    if (ddsrt_getsockname (conn->m_udp.m_sock, &dest.a, &dest_len) != DDS_RETCODE_OK)
+      memset (&dest, 0, sizeof (dest));
+    write_pcap_received (gv, ddsrt_time_wallclock (), &src.x, &dest.x, buf, sz);
+  }
+
+  if (trunc_flag)
+  {
+    char addrbuf[DDSI_LOCSTRLEN];
+    ddsi_locator_t tmp;
+    ddsi_ipaddr_to_loc (&tmp, &src.a, (src.a.sa_family == AF_INET) ? NN_LOCATOR_KIND_UDPv4 : NN_LOCATOR_KIND_UDPv6);
+    ddsi_locator_to_string (addrbuf, sizeof (addrbuf), &tmp);
+    GVWARNING ("%s => %d truncated to %d\n", addrbuf, (int) out.payloadlen, (int) sz);
+  }
+  return (ssize_t) sz;
+}
+
+/* FACTORY */
+
+static dds_return_t ddsi_uring_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_factory_t fact_cmn, uint32_t port, const ddsi_tran_qos_t *qos)
+{
+  struct ddsi_uring_tran_factory * const fact = (struct ddsi_uring_tran_factory *) fact_cmn;
+  struct ddsi_domaingv * const gv = fact_cmn->gv;
+  dds_return_t rc;
+  if ((rc = fact->m_udp_create_conn_fn (conn_out, fact_cmn, port, qos)) != DDS_RETCODE_OK)
+    return rc;
+  struct ddsi_uring_conn * const conn = (struct ddsi_uring_conn *) *conn_out;
+  conn->m_udp_read_fn = conn->m_udp.m_base.m_read_fn;
+  conn->m_udp_write_fn = conn->m_udp.m_base.m_write_fn;
+  conn->m_udp.m_base.m_read_fn = ddsi_uring_conn_read;
+  conn->m_udp.m_base.m_write_fn = ddsi_uring_conn_write;
+  if (qos->m_purpose == DDSI_TRAN_QOS_XMIT && (conn->m_tx = uring_tx_new ()) == NULL)
+    GVWARNING ("ddsi_uring_create_conn: io_uring setup failed (%s), using plain sends\n", strerror (errno));
+  return DDS_RETCODE_OK;
+}
+
+static void ddsi_uring_release_conn (ddsi_tran_conn_t conn_cmn)
+{
+  struct ddsi_uring_conn * const conn = (struct ddsi_uring_conn *) conn_cmn;
+  struct ddsi_uring_tran_factory * const fact = (struct ddsi_uring_tran_factory *) conn_cmn->m_factory;
+  if (conn->m_tx)
+    uring_tx_free (conn->m_tx);
+  fact->m_udp_release_conn_fn (conn_cmn);
+}
+
+int ddsi_uring_init (struct ddsi_domaingv *gv)
+{
+  if (!uring_supported (gv))
+    return -1;
+  struct ddsi_uring_tran_factory *fact = ddsrt_malloc (sizeof (*fact));
+  ddsi_udp_factory_init (&fact->m_udp, gv);
+  fact->m_udp.m_conn_size = sizeof (struct ddsi_uring_conn);
+  fact->m_udp_create_conn_fn = fact->m_udp.fact.m_create_conn_fn;
+  fact->m_udp_release_conn_fn = fact->m_udp.fact.m_release_conn_fn;
+  fact->m_udp.fact.m_create_conn_fn = ddsi_uring_create_conn;
+  fact->m_udp.fact.m_release_conn_fn = ddsi_uring_release_conn;
+  ddsi_factory_add (gv, &fact->m_udp.fact);
+  GVLOG (DDS_LC_CONFIG, "udp initialized (io_uring)\n");
+  return 0;
+}
+
+#else
+
+int ddsi_uring_init (struct ddsi_domaingv *gv) { (void) gv; return -1; }
+struct ddsi_uring_rx *ddsi_uring_rx_new (struct ddsi_domaingv *gv) { (void) gv; return NULL; }
+void ddsi_uring_rx_free (struct ddsi_uring_rx *rx) { (void) rx; }
+int ddsi_uring_rx_add (struct ddsi_uring_rx *rx, ddsi_tran_conn_t conn) { (void) rx; (void) conn; return -1; }
+void ddsi_uring_rx_trigger (struct ddsi_uring_rx *rx) { (void) rx; }
+int ddsi_uring_rx_wait (struct ddsi_uring_rx *rx) { (void) rx; return -1; }
+ddsi_tran_conn_t ddsi_uring_rx_next (struct ddsi_uring_rx *rx) { (void) rx; return NULL; }
+void ddsi_uring_tx_begin (void) { }
+uint32_t ddsi_uring_tx_end (void) { return 0; }
+
+#endif /* defined __linux */
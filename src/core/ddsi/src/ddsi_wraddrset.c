@@ -22,6 +22,7 @@
 #include "dds/ddsi/ddsi_entity_index.h"
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/ddsi_wraddrset.h"
+#include "dds/ddsi/ddsi_shmem.h"
 
 #include "dds/ddsi/ddsi_udp.h" /* nn_mc4gen_address_t */
 
@@ -312,6 +313,11 @@ static const int32_t cost_redundant_iceoryx = 1000000;
 // several readers can be addressed simultaneously)
 static const int32_t cost_delivered = -1;
 
+// Bonus for the native shared memory transport: a reader reachable that way
+// is in a process on the same machine, and copying into its receive ring is
+// cheaper than sending it over the loopback interface
+static const int32_t cost_shmem = -1;
+
 #define CI_ICEORYX        0xfc // FIXME: this is a hack
 
 static cost_t sat_cost_add (cost_t x, int32_t a)
@@ -323,7 +329,7 @@ static cost_t sat_cost_add (cost_t x, int32_t a)
     return (x < INT32_MIN - a) ? INT32_MIN : x + a;
 }
 
-static readercount_cost_t calc_locator_cost (const struct cover *c, int lidx, bool prefer_multicast, dds_locator_mask_t ignore)
+static readercount_cost_t calc_locator_cost (const struct locset *locs, const struct cover *c, int lidx, bool prefer_multicast, dds_locator_mask_t ignore)
 {
   const int32_t cost_uc  = prefer_multicast ? 1000000 : 2;
   const int32_t cost_mc  = prefer_multicast ? 1 : 3;
@@ -354,6 +360,12 @@ static readercount_cost_t calc_locator_cost (const struct cover *c, int lidx, bo
     else
       goto no_readers;
   }
+  else if (locs->locs[lidx].c.kind == NN_LOCATOR_KIND_SHMEM)
+  {
+    if (!ddsi_shmem_locator_usable (&locs->locs[lidx]))
+      goto no_readers;
+    x.cost += cost_uc + cost_shmem;
+  }
   else if ((ci & CI_MULTICAST_MASK) == 0)
     x.cost += cost_uc;
   else if (((ci & CI_MULTICAST_MASK) >> CI_MULTICAST_SHIFT) == CI_MULTICAST_SSM)
@@ -599,12 +611,12 @@ addrset_changed:
   return false;
 }
 
-static struct costmap *wras_calc_costmap (const struct cover *covered, bool prefer_multicast, dds_locator_mask_t ignore)
+static struct costmap *wras_calc_costmap (const struct locset *locs, const struct cover *covered, bool prefer_multicast, dds_locator_mask_t ignore)
 {
   const int nlocs = cover_get_nlocs (covered);
   struct costmap *wm = costmap_new (nlocs);
   for (int i = 0; i < nlocs; i++)
-    costmap_set (wm, i, calc_locator_cost (covered, i, prefer_multicast, ignore));
+    costmap_set (wm, i, calc_locator_cost (locs, covered, i, prefer_multicast, ignore));
   return wm;
 }
 
@@ -795,7 +807,7 @@ struct addrset *compute_writer_addrset (const struct writer *wr)
   else
   {
     assert(wr->xqos->present & QP_LOCATOR_MASK);
-    struct costmap *wm = wras_calc_costmap (covered, prefer_multicast, wr->xqos->ignore_locator_type);
+    struct costmap *wm = wras_calc_costmap (locs, covered, prefer_multicast, wr->xqos->ignore_locator_type);
     int best;
     newas = new_addrset ();
     while ((best = wras_choose_locator (locs, wm)) >= 0)
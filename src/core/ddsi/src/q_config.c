@@ -177,9 +177,7 @@ DUPF(retransmit_merging);
 DUPF(sched_class);
 DUPF(maybe_memsize);
 DUPF(maybe_int32);
-#ifdef DDS_HAS_BANDWIDTH_LIMITING
 DUPF(bandwidth);
-#endif
 DUPF(domainId);
 DUPF(transport_selector);
 DUPF(many_sockets_mode);
@@ -321,7 +319,6 @@ static const struct unit unittab_memsize[] = {
   { NULL, 0 }
 };
 
-#ifdef DDS_HAS_BANDWIDTH_LIMITING
 static const struct unit unittab_bandwidth_bps[] = {
   { "b/s", 1 },{ "bps", 1 },
   { "Kib/s", 1024 },{ "Kibps", 1024 },
@@ -350,7 +347,6 @@ static const struct unit unittab_bandwidth_Bps[] = {
   { "GB/s", 1000000000 },{ "GBps", 1000000000 },
   { NULL, 0 }
 };
-#endif
 
 static void free_configured_elements (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem);
 static void free_configured_element (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem);
@@ -1089,7 +1085,6 @@ static void pf_string (struct cfgst *cfgst, void *parent, struct cfgelem const *
   cfg_logelem (cfgst, sources, "%s", *p ? *p : "(null)");
 }
 
-#ifdef DDS_HAS_BANDWIDTH_LIMITING
 static enum update_result uf_bandwidth (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG (int first), const char *value)
 {
   int64_t bandwidth_bps = 0;
@@ -1097,11 +1092,11 @@ static enum update_result uf_bandwidth (struct cfgst *cfgst, void *parent, struc
     /* special case: inf needs no unit */
     uint32_t * const elem = cfg_address (cfgst, parent, cfgelem);
     if (strspn (value + 3, " ") != strlen (value + 3) &&
-        lo.up_multiplier (cfgst, unittab_bandwidth_bps, value, 3, 1, 8, 1) == 0)
+        lookup_multiplier (cfgst, unittab_bandwidth_bps, value, 3, 1, 8, 1) == 0)
       return URES_ERROR;
     *elem = 0;
     return URES_SUCCESS;
-  } else if (uf_natint64_unit (cfgst, &bandwidth_bps, value, unittab_bandwidth_bps, 8, INT64_MAX) != URES_SUCCESS) {
+  } else if (uf_natint64_unit (cfgst, &bandwidth_bps, value, unittab_bandwidth_bps, 8, 0, INT64_MAX) != URES_SUCCESS) {
     return URES_ERROR;
   } else if (bandwidth_bps / 8 > INT_MAX) {
     return cfg_error (cfgst, "%s: value out of range", value);
@@ -1120,7 +1115,6 @@ static void pf_bandwidth(struct cfgst *cfgst, void *parent, struct cfgelem const
   else
     pf_int64_unit (cfgst, *elem, sources, unittab_bandwidth_Bps, "B/s");
 }
-#endif
 
 static enum update_result uf_memsize (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG (int first), const char *value)
 {
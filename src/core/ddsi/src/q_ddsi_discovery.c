@@ -19,6 +19,7 @@
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/log.h"
 #include "dds/ddsrt/md5.h"
+#include "dds/ddsrt/mh3.h"
 #include "dds/ddsrt/sync.h"
 #include "dds/ddsrt/avl.h"
 #include "dds/ddsrt/string.h"
@@ -46,6 +47,7 @@
 #include "dds/ddsi/q_feature_check.h"
 #include "dds/ddsi/ddsi_security_omg.h"
 #include "dds/ddsi/ddsi_pmd.h"
+#include "dds/ddsi/ddsi_content_filter.h"
 #ifdef DDS_HAS_SECURITY
 #include "dds/ddsi/ddsi_security_exchange.h"
 #endif
@@ -426,7 +428,7 @@ void get_participant_builtin_topic_data (const struct participant *pp, ddsi_plis
 #endif
         data_port = meta_port = pp->m_locator.port;
       }
-      assert (kind == pp->e.gv->interfaces[i].extloc.kind);
+      assert (kind == pp->e.gv->interfaces[i].extloc.kind || pp->e.gv->interfaces[i].extloc.kind == NN_LOCATOR_KIND_SHMEM);
       locators_add_one (&def_uni, &pp->e.gv->interfaces[i].extloc, data_port);
       locators_add_one (&meta_uni, &pp->e.gv->interfaces[i].extloc, meta_port);
     }
@@ -1158,6 +1160,15 @@ static int sedp_write_endpoint_impl
         ps.present |= PP_CYCLONE_REQUESTS_KEYHASH;
         ps.cyclone_requests_keyhash = 1u;
       }
+      if (rd->content_filter)
+      {
+        /* can't simply alias it: fini frees the parameter sequence even if aliased */
+        ddsi_plist_t cfps;
+        ddsi_plist_init_empty (&cfps);
+        cfps.present = cfps.aliased = PP_CONTENT_FILTER_PROPERTY;
+        cfps.content_filter_property = rd->content_filter->prop;
+        ddsi_plist_mergein_missing (&ps, &cfps, PP_CONTENT_FILTER_PROPERTY, 0);
+      }
     }
 
 #ifdef DDS_HAS_SSM
@@ -1535,6 +1546,26 @@ static void addrset_from_locatorlists_collect_interfaces (const ddsi_xlocator_t
   }
 }
 
+#ifndef DDS_HAS_NETWORK_CHANNELS
+/** @brief Select the delivery queue for a new application data proxy writer
+ *
+ * Without Internal/DeliveryQueueWorkers that is always the "user" queue, else the
+ * proxy writers are spread over the workers based on their GUIDs. All data of one
+ * proxy writer always goes through the same queue and so remains in order.
+ *
+ * @param[in] gv domain
+ * @param[in] guid proxy writer GUID
+ * @return delivery queue to use for the proxy writer
+ */
+static struct nn_dqueue *user_dqueue_for_proxy_writer (const struct ddsi_domaingv *gv, const ddsi_guid_t *guid)
+{
+  if (gv->user_dqueue_workers == NULL)
+    return gv->user_dqueue;
+  const uint32_t h = ddsrt_mh3 (guid, sizeof (*guid), 0);
+  return gv->user_dqueue_workers[h % gv->config.delivery_queue_workers];
+}
+#endif
+
 static void handle_sedp_alive_endpoint (const struct receiver_state *rst, seqno_t seq, ddsi_plist_t *datap /* note: potentially modifies datap */, ddsi_sedp_kind_t sedp_kind, const ddsi_guid_prefix_t *src_guid_prefix, nn_vendorid_t vendorid, ddsrt_wctime_t timestamp)
 {
 #define E(msg, lbl) do { GVLOGDISC (msg); goto lbl; } while (0)
@@ -1700,7 +1731,7 @@ static void handle_sedp_alive_endpoint (const struct receiver_state *rst, seqno_
           new_proxy_writer (gv, &ppguid, &datap->endpoint_guid, as, datap, channel->dqueue, channel->evq ? channel->evq : gv->xevents, timestamp, seq);
         }
 #else
-        new_proxy_writer (gv, &ppguid, &datap->endpoint_guid, as, datap, gv->user_dqueue, gv->xevents, timestamp, seq);
+        new_proxy_writer (gv, &ppguid, &datap->endpoint_guid, as, datap, user_dqueue_for_proxy_writer (gv, &datap->endpoint_guid), gv->xevents, timestamp, seq);
 #endif
       }
     }
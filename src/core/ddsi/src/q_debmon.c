@@ -33,6 +33,7 @@
 #include "dds/ddsi/q_protocol.h" /* NN_ENTITYID_... */
 #include "dds/ddsi/q_unused.h"
 #include "dds/ddsi/q_debmon.h"
+#include "dds/ddsi/q_xevent.h"
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_tran.h"
 #include "dds/ddsi/ddsi_tcp.h"
@@ -260,8 +261,12 @@ static int print_proxy_participants (struct thread_state1 * const ts1, struct dd
         struct prd_wr_match *m;
         if (r->c.proxypp != p)
           continue;
+        struct xeventq_rexmit_stats rst;
         ddsrt_mutex_lock (&r->e.lock);
         print_proxy_endpoint_common (conn, "prd", &r->e, &r->c);
+        if (xeventq_get_rexmit_stats (gv->xevents, &r->e.guid, &rst))
+          x += cpf (conn, "    rexmit %"PRIu64" bytes %"PRIu32" msgs (%"PRIu32" B/s) #queued %"PRIu32" #dropped %"PRIu32"\n",
+                    rst.bytes, rst.msgs, rst.rate, rst.queued, rst.dropped);
         for (m = ddsrt_avl_iter_first (&rd_writers_treedef, &r->writers, &writ); m; m = ddsrt_avl_iter_next (&writ))
           x += cpf (conn, "    wr "PGUIDFMT"\n", PGUID (m->wr_guid));
         ddsrt_mutex_unlock (&r->e.lock);
@@ -55,6 +55,9 @@
 #include "dds/ddsi/ddsi_typelookup.h"
 #include "dds/ddsi/ddsi_list_tmpl.h"
 #include "dds/ddsi/ddsi_builtin_topic_if.h"
+#include "dds/ddsi/ddsi_content_filter.h"
+#include "dds/ddsi/ddsi_fec.h"
+#include "dds/ddsi/ddsi_statistics.h"
 
 #ifdef DDS_HAS_SECURITY
 #include "dds/ddsi/ddsi_security_msg.h"
@@ -1652,6 +1655,10 @@ void rebuild_or_clear_writer_addrsets (struct ddsi_domaingv *gv, int rebuild)
   entidx_enum_writer_init (&est, gv->entity_index);
   while ((wr = entidx_enum_writer_next (&est)) != NULL)
   {
+    /* the local orphan writers of the built-in topics have the entity ids of
+       the discovery writers, but mustn't ever send anything */
+    if (is_local_orphan_endpoint (&wr->e))
+      continue;
     ddsrt_mutex_lock (&wr->e.lock);
     if (wr->e.guid.entityid.u != NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_WRITER)
     {
@@ -1689,6 +1696,7 @@ static void free_wr_prd_match (const struct ddsi_domaingv *gv, const ddsi_guid_t
     (void) wr_guid;
 #endif
     nn_lat_estim_fini (&m->hb_to_ack_latency);
+    nn_lat_estim_fini (&m->ack_latency_estim);
     ddsrt_free (m);
   }
 }
@@ -1724,7 +1732,9 @@ static void free_pwr_rd_match (struct pwr_rd_match *m)
   {
     if (m->acknack_xevent)
       delete_xevent (m->acknack_xevent);
-    nn_reorder_free (m->u.not_in_sync.reorder);
+    /* a cursor in pwr->catchup is removed by the caller */
+    if (m->u.not_in_sync.reorder)
+      nn_reorder_free (m->u.not_in_sync.reorder);
     ddsrt_free (m);
   }
 }
@@ -1776,6 +1786,7 @@ static void writer_drop_connection (const struct ddsi_guid *wr_guid, const struc
   if ((wr = entidx_lookup_writer_guid (prd->e.gv->entity_index, wr_guid)) != NULL)
   {
     struct whc_node *deferred_free_list = NULL;
+    uint32_t n_dropped = 0;
     struct wr_prd_match *m;
     ddsrt_mutex_lock (&wr->e.lock);
     if ((m = ddsrt_avl_lookup (&wr_readers_treedef, &wr->readers, &prd->e.guid)) != NULL)
@@ -1785,8 +1796,10 @@ static void writer_drop_connection (const struct ddsi_guid *wr_guid, const struc
       wr->num_readers--;
       wr->num_reliable_readers -= m->is_reliable;
       wr->num_readers_requesting_keyhash -= prd->requests_keyhash ? 1 : 0;
+      if (prd->content_filter)
+        ddsrt_atomic_dec32 (&wr->num_readers_content_filtered);
       rebuild_writer_addrset (wr);
-      remove_acked_messages (wr, &whcst, &deferred_free_list);
+      n_dropped = remove_acked_messages (wr, &whcst, &deferred_free_list);
     }
 
     ddsrt_mutex_unlock (&wr->e.lock);
@@ -1798,7 +1811,7 @@ static void writer_drop_connection (const struct ddsi_guid *wr_guid, const struc
       data.handle = prd->e.iid;
       (wr->status_cb) (wr->status_cb_entity, &data);
     }
-    whc_free_deferred_free_list (wr->whc, deferred_free_list);
+    writer_free_deferred_free_list (wr, deferred_free_list, n_dropped);
     free_wr_prd_match (wr->e.gv, &wr->e.guid, m);
   }
 }
@@ -2042,6 +2055,8 @@ static void proxy_writer_drop_connection (const struct ddsi_guid *pwr_guid, stru
     if ((m = ddsrt_avl_lookup (&pwr_readers_treedef, &pwr->readers, &rd->e.guid)) != NULL)
     {
       ddsrt_avl_delete (&pwr_readers_treedef, &pwr->readers, m);
+      if (m->u.not_in_sync.cursor)
+        nn_catchup_remove_cursor (pwr->catchup, m->u.not_in_sync.cursor);
       if (m->in_sync != PRMSS_SYNC)
       {
         if (--pwr->n_readers_out_of_sync == 0)
@@ -2136,6 +2151,9 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd,
   m->prev_nackfrag = 0;
   nn_lat_estim_init (&m->hb_to_ack_latency);
   m->hb_to_ack_latency_tlastlog = ddsrt_time_wallclock ();
+  m->ackhb_answered = 0;
+  nn_lat_estim_init_alpha (&m->ack_latency_estim, 0.125f);
+  m->ack_latency = 0;
   m->t_acknack_accepted.v = 0;
   m->t_nackfrag_accepted.v = 0;
 
@@ -2155,6 +2173,7 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd,
               PGUID (wr->e.guid), PGUID (prd->e.guid));
     ddsrt_mutex_unlock (&wr->e.lock);
     nn_lat_estim_fini (&m->hb_to_ack_latency);
+    nn_lat_estim_fini (&m->ack_latency_estim);
     ddsrt_free (m);
   }
   else
@@ -2165,6 +2184,8 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd,
     wr->num_readers++;
     wr->num_reliable_readers += m->is_reliable;
     wr->num_readers_requesting_keyhash += prd->requests_keyhash ? 1 : 0;
+    if (prd->content_filter)
+      ddsrt_atomic_inc32 (&wr->num_readers_content_filtered);
     rebuild_writer_addrset (wr);
     ddsrt_mutex_unlock (&wr->e.lock);
 
@@ -2525,15 +2546,27 @@ static void proxy_writer_add_connection (struct proxy_writer *pwr, struct reader
 
     const ddsrt_mtime_t tsched = use_iceoryx ? DDSRT_MTIME_NEVER : ddsrt_mtime_add_duration (tnow, pwr->e.gv->config.preemptive_ack_delay);
     m->acknack_xevent = qxev_acknack (pwr->evq, tsched, &pwr->e.guid, &rd->e.guid);
-    m->u.not_in_sync.reorder =
-      nn_reorder_new (&pwr->e.gv->logconfig, NN_REORDER_MODE_NORMAL, secondary_reorder_maxsamples, pwr->e.gv->config.late_ack_mode);
+    if (pwr->catchup && !m->filtered)
+    {
+      /* catching up on historical data is done by the proxy writer's shared admin,
+         the reader only needs a position in it, and only while it is catching up */
+      m->u.not_in_sync.reorder = NULL;
+      m->u.not_in_sync.cursor = (m->in_sync != PRMSS_SYNC) ? nn_catchup_add_cursor (pwr->catchup, m) : NULL;
+    }
+    else
+    {
+      m->u.not_in_sync.reorder =
+        nn_reorder_new (&pwr->e.gv->logconfig, NN_REORDER_MODE_NORMAL, secondary_reorder_maxsamples, pwr->e.gv->config.reorder_window_size, pwr->e.gv->config.late_ack_mode);
+      m->u.not_in_sync.cursor = NULL;
+    }
     pwr->n_reliable_readers++;
   }
   else
   {
     m->acknack_xevent = NULL;
     m->u.not_in_sync.reorder =
-      nn_reorder_new (&pwr->e.gv->logconfig, NN_REORDER_MODE_MONOTONICALLY_INCREASING, pwr->e.gv->config.secondary_reorder_maxsamples, pwr->e.gv->config.late_ack_mode);
+      nn_reorder_new (&pwr->e.gv->logconfig, NN_REORDER_MODE_MONOTONICALLY_INCREASING, pwr->e.gv->config.secondary_reorder_maxsamples, 0, pwr->e.gv->config.late_ack_mode);
+    m->u.not_in_sync.cursor = NULL;
   }
 
   ddsrt_avl_insert_ipath (&pwr_readers_treedef, &pwr->readers, m, &path);
@@ -3416,6 +3449,7 @@ static void augment_wr_prd_match (void *vnode, const void *vleft, const void *vr
   const struct wr_prd_match *left = vleft;
   const struct wr_prd_match *right = vright;
   seqno_t min_seq, max_seq;
+  int64_t max_ack_latency;
   int have_replied = n->has_replied_to_hb;
 
   /* note: this means min <= seq, but not min <= max nor seq <= max!
@@ -3425,8 +3459,9 @@ static void augment_wr_prd_match (void *vnode, const void *vleft, const void *vr
      one */
   min_seq = n->seq;
   max_seq = (n->seq < MAX_SEQ_NUMBER) ? n->seq : 0;
+  max_ack_latency = n->is_reliable ? n->ack_latency : 0;
 
-  /* 1. Compute {min,max} & have_replied. */
+  /* 1. Compute {min,max}, have_replied & max_ack_latency. */
   if (left)
   {
     if (left->min_seq < min_seq)
@@ -3434,6 +3469,8 @@ static void augment_wr_prd_match (void *vnode, const void *vleft, const void *vr
     if (left->max_seq > max_seq)
       max_seq = left->max_seq;
     have_replied = have_replied && left->all_have_replied_to_hb;
+    if (left->max_ack_latency > max_ack_latency)
+      max_ack_latency = left->max_ack_latency;
   }
   if (right)
   {
@@ -3442,10 +3479,13 @@ static void augment_wr_prd_match (void *vnode, const void *vleft, const void *vr
     if (right->max_seq > max_seq)
       max_seq = right->max_seq;
     have_replied = have_replied && right->all_have_replied_to_hb;
+    if (right->max_ack_latency > max_ack_latency)
+      max_ack_latency = right->max_ack_latency;
   }
   n->min_seq = min_seq;
   n->max_seq = max_seq;
   n->all_have_replied_to_hb = have_replied ? 1 : 0;
+  n->max_ack_latency = max_ack_latency;
 
   /* 2. Compute num_reliable_readers_where_seq_equals_max */
   if (max_seq == 0)
@@ -3564,6 +3604,33 @@ void writer_clear_retransmitting (struct writer *wr)
   ddsrt_cond_broadcast (&wr->throttle_cond);
 }
 
+static void writer_signal_ready (struct writer *wr, bool ready)
+{
+  /* Called with wr->e.lock held, unlike the other status callbacks: there is no
+     listener for this status and so the callback never blocks, and it is the
+     only way to guarantee the transitions are signalled in the right order */
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  if (wr->status_cb)
+  {
+    status_cb_data_t data;
+    data.raw_status_id = (int) DDS_WRITER_READY_STATUS_ID;
+    data.add = ready;
+    data.handle = 0;
+    data.extra = 0;
+    (wr->status_cb) (wr->status_cb_entity, &data);
+  }
+}
+
+void writer_set_would_block (struct writer *wr)
+{
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  if (!wr->would_block)
+  {
+    wr->would_block = 1;
+    writer_signal_ready (wr, false);
+  }
+}
+
 unsigned remove_acked_messages (struct writer *wr, struct whc_state *whcst, struct whc_node **deferred_free_list)
 {
   unsigned n;
@@ -3574,6 +3641,11 @@ unsigned remove_acked_messages (struct writer *wr, struct whc_state *whcst, stru
   ddsrt_cond_broadcast (&wr->throttle_cond);
   if (wr->retransmitting && whcst->unacked_bytes == 0)
     writer_clear_retransmitting (wr);
+  if (wr->would_block && whcst->unacked_bytes <= wr->whc_low && !wr->retransmitting)
+  {
+    wr->would_block = 0;
+    writer_signal_ready (wr, true);
+  }
   if (wr->state == WRST_LINGERING && whcst->unacked_bytes == 0)
   {
     ELOGDISC (wr, "remove_acked_messages: deleting lingering writer "PGUIDFMT"\n", PGUID (wr->e.guid));
@@ -3582,6 +3654,47 @@ unsigned remove_acked_messages (struct writer *wr, struct whc_state *whcst, stru
   return n;
 }
 
+struct gc_whc_reclaim {
+  struct writer *wr;
+  struct whc_node *deferred_free_list;
+};
+
+static void gc_whc_reclaim (struct gcreq *gcreq)
+{
+  struct gc_whc_reclaim * const arg = gcreq->arg;
+  struct writer * const wr = arg->wr;
+  gcreq_free (gcreq);
+  whc_free_deferred_free_list (wr->whc, arg->deferred_free_list);
+  ddsrt_free (arg);
+  ddsrt_atomic_dec32 (&wr->whc_reclaims_pending);
+}
+
+/* Freeing the samples dropped from the WHC means dropping the references to the serdata
+   and plists, which for a large jump in the acknowledged sequence number can take a long
+   time.  Below the threshold, it is done in-line; beyond it, or if the WHC indicates the
+   work is expensive regardless of the number of samples, it is handed off to the GC
+   thread so the (receive) thread handling the ACKNACK can continue with the next message.
+   Must be called without holding wr->e.lock, while awake. */
+#define WHC_ASYNC_RECLAIM_THRESHOLD 32
+
+void writer_free_deferred_free_list (struct writer *wr, struct whc_node *deferred_free_list, uint32_t n)
+{
+  if (deferred_free_list == NULL)
+    return;
+  if (n < WHC_ASYNC_RECLAIM_THRESHOLD && deferred_free_list != &whc_deferred_slow_work_marker)
+    whc_free_deferred_free_list (wr->whc, deferred_free_list);
+  else
+  {
+    struct gcreq *gcreq = gcreq_new (wr->e.gv->gcreq_queue, gc_whc_reclaim);
+    struct gc_whc_reclaim *arg = ddsrt_malloc (sizeof (*arg));
+    arg->wr = wr;
+    arg->deferred_free_list = deferred_free_list;
+    gcreq->arg = arg;
+    ddsrt_atomic_inc32 (&wr->whc_reclaims_pending);
+    gcreq_enqueue (gcreq);
+  }
+}
+
 static void writer_notify_liveliness_change_may_unlock (struct writer *wr)
 {
   struct alive_state alive_state;
@@ -3670,14 +3783,25 @@ int writer_set_notalive (struct writer *wr, bool notify)
 static void new_writer_guid_common_init (struct writer *wr, const char *topic_name, const struct ddsi_sertype *type, const struct dds_qos *xqos, struct whc *whc, status_cb_t status_cb, void * status_entity)
 {
   ddsrt_cond_init (&wr->throttle_cond);
-  wr->seq = 0;
+  /* a WHC may start out with history (e.g., one kept in a file), in which case
+     that history has to be treated as already written and transmitted */
+  {
+    struct whc_state whcst;
+    whc_get_state (whc, &whcst);
+    wr->seq = (whcst.max_seq > 0) ? whcst.max_seq : 0;
+  }
   wr->cs_seq = 0;
-  ddsrt_atomic_st64 (&wr->seq_xmit, (uint64_t) 0);
+  ddsrt_atomic_st64 (&wr->seq_xmit, (uint64_t) wr->seq);
   wr->hbcount = 1;
   wr->state = WRST_OPERATIONAL;
   wr->hbfragcount = 1;
   writer_hbcontrol_init (&wr->hbcontrol);
   wr->throttling = 0;
+  ddsrt_atomic_st32 (&wr->whc_reclaims_pending, 0);
+  if (wr->e.gv->config.fec_group_size > 0 && !is_builtin_entityid (wr->e.guid.entityid, NN_VENDORID_ECLIPSE))
+    wr->fec = ddsi_fec_encoder_new ((uint32_t) wr->e.gv->config.fec_group_size);
+  else
+    wr->fec = NULL;
   wr->retransmitting = 0;
   wr->t_rexmit_end.v = 0;
   wr->t_rexmit_start.v = 0;
@@ -3685,6 +3809,7 @@ static void new_writer_guid_common_init (struct writer *wr, const char *topic_na
   wr->num_readers = 0;
   wr->num_reliable_readers = 0;
   wr->num_readers_requesting_keyhash = 0;
+  ddsrt_atomic_st32 (&wr->num_readers_content_filtered, 0);
   wr->num_acks_received = 0;
   wr->num_nacks_received = 0;
   wr->throttle_count = 0;
@@ -3700,6 +3825,7 @@ static void new_writer_guid_common_init (struct writer *wr, const char *topic_na
   wr->test_suppress_retransmit = 0;
   wr->test_suppress_heartbeat = 0;
   wr->test_drop_outgoing_data = 0;
+  wr->would_block = 0;
   wr->alive_vclock = 0;
   wr->init_burst_size_limit = UINT32_MAX - UINT16_MAX;
   wr->rexmit_burst_size_limit = UINT32_MAX - UINT16_MAX;
@@ -3739,7 +3865,11 @@ static void new_writer_guid_common_init (struct writer *wr, const char *topic_na
     assert ((wr->xqos->durability.kind == DDS_DURABILITY_TRANSIENT_LOCAL) ||
             (wr->e.guid.entityid.u == NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_STATELESS_MESSAGE_WRITER));
   }
-  wr->handle_as_transient_local = (wr->xqos->durability.kind == DDS_DURABILITY_TRANSIENT_LOCAL);
+  /* a transient or persistent writer with a durable store serves the history
+     in the store from its WHC just like transient-local data */
+  wr->handle_as_transient_local = (wr->xqos->durability.kind == DDS_DURABILITY_TRANSIENT_LOCAL) ||
+                                  (wr->xqos->durability.kind >= DDS_DURABILITY_TRANSIENT &&
+                                   ddsi_xqos_find_prop (wr->xqos, DDS_WRITER_PROP_DURABLE_STORE, NULL));
   wr->num_readers_requesting_keyhash +=
     wr->e.gv->config.generate_keyhash &&
     ((wr->e.guid.entityid.u & NN_ENTITYID_KIND_MASK) == NN_ENTITYID_KIND_WRITER_WITH_KEY);
@@ -4009,6 +4139,16 @@ static void gc_delete_writer (struct gcreq *gcreq)
 {
   struct writer *wr = gcreq->arg;
   ELOGDISC (wr, "gc_delete_writer(%p, "PGUIDFMT")\n", (void *) gcreq, PGUID (wr->e.guid));
+
+  /* Deferred free lists handed to the GC by writer_free_deferred_free_list must be freed
+     before the WHC is.  Any thread that can still be doing so has completed by the time
+     this request is handled, so the outstanding ones are queued already and requeueing
+     this request puts it behind them. */
+  if (ddsrt_atomic_ld32 (&wr->whc_reclaims_pending) > 0)
+  {
+    gcreq_requeue (gcreq, gc_delete_writer);
+    return;
+  }
   gcreq_free (gcreq);
 
   /* We now allow GC while blocked on a full WHC, but we still don't allow deleting a writer while blocked on it. The writer's state must be DELETING by the time we get here, and that means the transmit path is no longer blocked. It doesn't imply that the write thread is no longer in throttle_writer(), just that if it is, it will soon return from there. Therefore, block until it isn't throttling anymore. We can safely lock the writer, as we're on the separate GC thread. */
@@ -4051,6 +4191,8 @@ static void gc_delete_writer (struct gcreq *gcreq)
   if (!is_builtin_entityid (wr->e.guid.entityid, NN_VENDORID_ECLIPSE))
     sedp_dispose_unregister_writer (wr);
   whc_free (wr->whc);
+  if (wr->fec)
+    ddsi_fec_encoder_free (wr->fec);
   if (wr->status_cb)
     (wr->status_cb) (wr->status_cb_entity, NULL);
 
@@ -4377,6 +4519,7 @@ static dds_return_t new_reader_guid
                                   (rd->e.guid.entityid.u == NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_VOLATILE_SECURE_READER);
   rd->type = ddsi_sertype_ref (type);
   rd->request_keyhash = rd->type->request_keyhash;
+  rd->content_filter = ddsi_content_filter_new_from_qos (rd->xqos);
   rd->ddsi2direct_cb = 0;
   rd->ddsi2direct_cbarg = 0;
   rd->init_acknack_count = 1;
@@ -4538,6 +4681,7 @@ static void gc_delete_reader (struct gcreq *gcreq)
     (rd->status_cb) (rd->status_cb_entity, NULL);
   }
   ddsi_sertype_unref ((struct ddsi_sertype *) rd->type);
+  ddsi_content_filter_free (rd->content_filter);
 
   ddsi_xqos_fini (rd->xqos);
   ddsrt_free (rd->xqos);
@@ -6073,6 +6217,11 @@ int new_proxy_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid,
     /* The DDSI built-in proxy writers always deliver
        asynchronously */
     pwr->deliver_synchronously = 0;
+  } else if (gv->config.delivery_queue_workers > 0) {
+    /* Constructing samples is done by the delivery queue workers
+       whenever those are configured, so that the receive thread
+       only needs to sort the data into the right queues */
+    pwr->deliver_synchronously = 0;
   } else if (pwr->c.xqos->latency_budget.duration <= gv->config.synchronous_delivery_latency_bound &&
              pwr->c.xqos->transport_priority.value >= gv->config.synchronous_delivery_priority_threshold) {
     /* Regular proxy-writers with a sufficiently low latency_budget
@@ -6127,7 +6276,8 @@ int new_proxy_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid,
     pwr->defrag = nn_defrag_new (&gv->logconfig, NN_DEFRAG_DROP_OLDEST, gv->config.defrag_unreliable_maxsamples);
   }
   reorder_mode = get_proxy_writer_reorder_mode(pwr->e.guid.entityid, isreliable);
-  pwr->reorder = nn_reorder_new (&gv->logconfig, reorder_mode, gv->config.primary_reorder_maxsamples, gv->config.late_ack_mode);
+  pwr->reorder = nn_reorder_new (&gv->logconfig, reorder_mode, gv->config.primary_reorder_maxsamples, gv->config.reorder_window_size, gv->config.late_ack_mode);
+  pwr->fec = NULL;
 
   if (pwr->e.guid.entityid.u == NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_VOLATILE_SECURE_WRITER)
   {
@@ -6140,6 +6290,20 @@ int new_proxy_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid,
     nn_reorder_set_next_seq(pwr->reorder, MAX_SEQ_NUMBER);
     pwr->filtered = 1;
   }
+  if (isreliable && !pwr->filtered && gv->config.shared_secondary_reorder)
+    pwr->catchup = nn_catchup_new (&gv->logconfig, gv->config.secondary_reorder_maxsamples);
+  else
+    pwr->catchup = NULL;
+
+  if (gv->config.meas_receive_latency && !is_builtin_entityid (pwr->e.guid.entityid, pwr->c.vendor))
+  {
+    pwr->latency_hist = ddsrt_malloc (sizeof (*pwr->latency_hist));
+    memset (pwr->latency_hist, 0, sizeof (*pwr->latency_hist));
+  }
+  else
+  {
+    pwr->latency_hist = NULL;
+  }
 
   pwr->dqueue = dqueue;
   pwr->evq = evq;
@@ -6280,6 +6444,11 @@ static void gc_delete_proxy_writer (struct gcreq *gcreq)
   proxy_endpoint_common_fini (&pwr->e, &pwr->c);
   nn_defrag_free (pwr->defrag);
   nn_reorder_free (pwr->reorder);
+  if (pwr->catchup)
+    nn_catchup_free (pwr->catchup);
+  ddsrt_free (pwr->latency_hist);
+  if (pwr->fec)
+    ddsi_fec_decoder_free (pwr->fec);
   ddsrt_free (pwr);
 }
 
@@ -6445,13 +6614,19 @@ int new_proxy_reader (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid,
 
   ddsrt_avl_init (&prd_writers_treedef, &prd->writers);
 
+  /* Writer-side content filtering is only done for application readers, the
+     retransmit path then turns filtered-out samples into GAPs, too */
+  prd->content_filter = NULL;
+  if ((plist->present & PP_CONTENT_FILTER_PROPERTY) && !is_builtin_entityid (prd->e.guid.entityid, prd->c.vendor))
+    prd->content_filter = ddsi_content_filter_new (&plist->content_filter_property);
+
 #ifdef DDS_HAS_SECURITY
   if (prd->e.guid.entityid.u == NN_ENTITYID_P2P_BUILTIN_PARTICIPANT_VOLATILE_SECURE_READER)
     prd->filter = volatile_secure_data_filter;
   else
-    prd->filter = NULL;
+    prd->filter = prd->content_filter ? ddsi_content_filter_prd : NULL;
 #else
-  prd->filter = NULL;
+  prd->filter = prd->content_filter ? ddsi_content_filter_prd : NULL;
 #endif
 
   /* locking the entity prevents matching while the built-in topic hasn't been published yet */
@@ -6492,6 +6667,7 @@ static void proxy_reader_set_delete_and_ack_all_messages (struct proxy_reader *p
     if ((wr = entidx_lookup_writer_guid (prd->e.gv->entity_index, &wrguid)) != NULL)
     {
       struct whc_node *deferred_free_list = NULL;
+      uint32_t n_dropped = 0;
       struct wr_prd_match *m_wr;
       ddsrt_mutex_lock (&wr->e.lock);
       if ((m_wr = ddsrt_avl_lookup (&wr_readers_treedef, &wr->readers, &prd->e.guid)) != NULL)
@@ -6499,11 +6675,11 @@ static void proxy_reader_set_delete_and_ack_all_messages (struct proxy_reader *p
         struct whc_state whcst;
         m_wr->seq = MAX_SEQ_NUMBER;
         ddsrt_avl_augment_update (&wr_readers_treedef, m_wr);
-        (void)remove_acked_messages (wr, &whcst, &deferred_free_list);
+        n_dropped = remove_acked_messages (wr, &whcst, &deferred_free_list);
         writer_clear_retransmitting (wr);
       }
       ddsrt_mutex_unlock (&wr->e.lock);
-      whc_free_deferred_free_list (wr->whc, deferred_free_list);
+      writer_free_deferred_free_list (wr, deferred_free_list, n_dropped);
     }
 
     wrguid = wrguid_next;
@@ -6525,9 +6701,16 @@ static void gc_delete_proxy_reader (struct gcreq *gcreq)
     writer_drop_connection (&m->wr_guid, prd);
     free_prd_wr_match (m);
   }
+  xeventq_forget_rexmit_destination (prd->e.gv->xevents, &prd->e.guid);
+#ifdef DDS_HAS_NETWORK_CHANNELS
+  for (struct ddsi_config_channel_listelem *chptr = prd->e.gv->config.channels; chptr; chptr = chptr->next)
+    if (chptr->evq)
+      xeventq_forget_rexmit_destination (chptr->evq, &prd->e.guid);
+#endif
 #ifdef DDS_HAS_SECURITY
   q_omg_security_deregister_remote_reader(prd);
 #endif
+  ddsi_content_filter_free (prd->content_filter);
   proxy_endpoint_common_fini (&prd->e, &prd->c);
   ddsrt_free (prd);
 }
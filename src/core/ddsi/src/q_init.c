@@ -51,9 +51,13 @@
 #include "dds/ddsi/ddsi_threadmon.h"
 #include "dds/ddsi/ddsi_pmd.h"
 #include "dds/ddsi/ddsi_typelookup.h"
+#include "dds/ddsi/ddsi_content_filter.h"
+#include "dds/ddsi/ddsi_timing_wheel.h"
 
 #include "dds/ddsi/ddsi_tran.h"
 #include "dds/ddsi/ddsi_udp.h"
+#include "dds/ddsi/ddsi_uring.h"
+#include "dds/ddsi/ddsi_shmem.h"
 #include "dds/ddsi/ddsi_tcp.h"
 #include "dds/ddsi/ddsi_raweth.h"
 #include "dds/ddsi/ddsi_vnet.h"
@@ -964,6 +968,7 @@ static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
     gv->recv_threads[i].arg.mode = RTM_SINGLE;
     gv->recv_threads[i].arg.rbpool = NULL;
     gv->recv_threads[i].arg.gv = gv;
+    gv->recv_threads[i].arg.uring_rx = NULL;
     gv->recv_threads[i].arg.u.single.loc = NULL;
     gv->recv_threads[i].arg.u.single.conn = NULL;
   }
@@ -1003,12 +1008,20 @@ static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
     /* We create the rbufpool for the receive thread, and so we'll
        become the initial owner thread. The receive thread will change
        it before it does anything with it. */
-    if ((gv->recv_threads[i].arg.rbpool = nn_rbufpool_new (&gv->logconfig, gv->config.rbuf_size, gv->config.rmsg_chunk_size)) == NULL)
+    if ((gv->recv_threads[i].arg.rbpool = nn_rbufpool_new (&gv->logconfig, gv->config.rbuf_size, gv->config.rmsg_chunk_size, gv->config.rbuf_max_free, gv->config.rbuf_hugepages)) == NULL)
     {
       GVERROR ("rtps_init: can't allocate receive buffer pool for thread %s\n", gv->recv_threads[i].name);
       goto fail;
     }
-    if (gv->recv_threads[i].arg.mode == RTM_MANY)
+    if (gv->config.use_io_uring)
+    {
+      if ((gv->recv_threads[i].arg.uring_rx = ddsi_uring_rx_new (gv)) == NULL)
+      {
+        GVERROR ("rtps_init: can't allocate io_uring receive state for thread %s\n", gv->recv_threads[i].name);
+        goto fail;
+      }
+    }
+    else if (gv->recv_threads[i].arg.mode == RTM_MANY)
     {
       if ((gv->recv_threads[i].arg.u.many.ws = os_sockWaitsetNew ()) == NULL)
       {
@@ -1032,6 +1045,8 @@ fail:
   {
     if (gv->recv_threads[i].arg.mode == RTM_MANY && gv->recv_threads[i].arg.u.many.ws)
       os_sockWaitsetFree (gv->recv_threads[i].arg.u.many.ws);
+    if (gv->recv_threads[i].arg.uring_rx)
+      ddsi_uring_rx_free (gv->recv_threads[i].arg.uring_rx);
     if (gv->recv_threads[i].arg.rbpool)
       nn_rbufpool_free (gv->recv_threads[i].arg.rbpool);
   }
@@ -1095,11 +1110,24 @@ void ddsi_set_deafmute (struct ddsi_domaingv *gv, bool deaf, bool mute, int64_t
 
 static void free_conns (struct ddsi_domaingv *gv)
 {
+  if (gv->xmit_conn_pool)
+  {
+    const uint32_t n = (uint32_t) gv->n_interfaces * (gv->config.xmit_conn_pool_size - 1);
+    for (uint32_t i = 0; i < n; i++)
+    {
+      const uint32_t intf = i / (gv->config.xmit_conn_pool_size - 1);
+      if (gv->xmit_conn_pool[i] != NULL && gv->xmit_conn_pool[i] != gv->xmit_conns[intf])
+        ddsi_conn_free (gv->xmit_conn_pool[i]);
+    }
+    ddsrt_free (gv->xmit_conn_pool);
+    gv->xmit_conn_pool = NULL;
+  }
+
   // Depending on settings, various "conn"s can alias others, this makes sure we free each one only once
   // FIXME: perhaps store them in a table instead?
-  ddsi_tran_conn_t cs[4 + MAX_XMIT_CONNS] = { gv->disc_conn_mc, gv->data_conn_mc, gv->disc_conn_uc, gv->data_conn_uc };
+  ddsi_tran_conn_t cs[6 + MAX_XMIT_CONNS] = { gv->disc_conn_mc, gv->data_conn_mc, gv->disc_conn_uc, gv->data_conn_uc, gv->disc_conn_shmem, gv->data_conn_shmem };
   for (size_t i = 0; i < MAX_XMIT_CONNS; i++)
-    cs[4 + i] = gv->xmit_conns[i];
+    cs[6 + i] = gv->xmit_conns[i];
   for (size_t i = 0; i < sizeof (cs) / sizeof (cs[0]); i++)
   {
     if (cs[i] == NULL)
@@ -1208,6 +1236,89 @@ static int iceoryx_init (struct ddsi_domaingv *gv)
 }
 #endif
 
+static void shmem_transport_init (struct ddsi_domaingv *gv)
+{
+  /* the receive rings accompany the UDP unicast sockets, and the receive
+     threads need a fixed set of them to wait on */
+  const char *reason = NULL;
+  ddsi_locator_t loc;
+  if (gv->config.transport_selector != DDSI_TRANS_UDP && gv->config.transport_selector != DDSI_TRANS_UDP6)
+    reason = "requires UDP";
+  else if (gv->config.use_io_uring)
+    reason = "can't be combined with io_uring";
+  else if (gv->config.many_sockets_mode == DDSI_MSM_NO_UNICAST)
+    reason = "requires unicast sockets";
+  else if (gv->extmask.kind != NN_LOCATOR_KIND_INVALID)
+    reason = "can't be combined with an external network mask";
+  else if (gv->n_interfaces == MAX_XMIT_CONNS)
+    reason = "requires an interface but the maximum number has been reached";
+  else if (ddsi_shmem_init (gv, &loc) < 0)
+    reason = "is not available";
+  if (reason)
+  {
+    GVWARNING ("shared memory transport %s: disabling it\n", reason);
+    gv->config.shmem_transport = 0;
+    return;
+  }
+
+  ddsi_factory_find (gv, "shmem")->m_enable = true;
+  if (gv->config.many_sockets_mode == DDSI_MSM_MANY_UNICAST)
+  {
+    GVLOG (DDS_LC_CONFIG, "shmem: using ManySocketsMode single\n");
+    gv->config.many_sockets_mode = DDSI_MSM_SINGLE_UNICAST;
+  }
+
+  struct nn_interface *intf = &gv->interfaces[gv->n_interfaces];
+  // Same trick as for iceoryx: an otherwise unused interface index
+  intf->if_index = 1000;
+  for (int i = 0; i < gv->n_interfaces; i++)
+    if (gv->interfaces[i].if_index >= intf->if_index)
+      intf->if_index = gv->interfaces[i].if_index + 1;
+  intf->link_local = false;
+  intf->loc = loc;
+  intf->extloc = intf->loc;
+  intf->loopback = true; // Never to be used for reaching other machines
+  intf->mc_capable = false;
+  intf->mc_flaky = false;
+  intf->name = ddsrt_strdup ("shmem");
+  intf->point_to_point = false;
+  intf->netmask.kind = NN_LOCATOR_KIND_INVALID;
+  intf->netmask.port = NN_LOCATOR_PORT_INVALID;
+  memset (intf->netmask.address, 0, sizeof (intf->netmask.address));
+  gv->n_interfaces++;
+}
+
+static void shmem_transport_create_rings (struct ddsi_domaingv *gv)
+{
+  /* receive rings for the unicast ports, which are what the locators of the
+     shared memory interface get advertised with; failing to create them (a
+     full /dev/shm, a file of another user in the way) is no reason not to
+     communicate over UDP instead */
+  const ddsi_tran_qos_t qos = { .m_purpose = DDSI_TRAN_QOS_RECV_UC, .m_diffserv = 0, .m_interface = NULL };
+  ddsi_tran_factory_t fact = ddsi_factory_find (gv, "shmem");
+  if (ddsi_factory_create_conn (&gv->disc_conn_shmem, fact, ddsi_conn_port (gv->disc_conn_uc), &qos) != DDS_RETCODE_OK)
+    gv->disc_conn_shmem = NULL;
+  else if (ddsi_conn_port (gv->data_conn_uc) == ddsi_conn_port (gv->disc_conn_uc))
+    gv->data_conn_shmem = gv->disc_conn_shmem;
+  else if (ddsi_factory_create_conn (&gv->data_conn_shmem, fact, ddsi_conn_port (gv->data_conn_uc), &qos) != DDS_RETCODE_OK)
+  {
+    ddsi_conn_free (gv->disc_conn_shmem);
+    gv->disc_conn_shmem = gv->data_conn_shmem = NULL;
+  }
+  if (gv->disc_conn_shmem != NULL)
+    return;
+
+  /* the shared memory interface is the last one added and no transmit
+     connections exist yet, so it can simply be dropped again */
+  GVWARNING ("shared memory transport: can't create receive rings: disabling it\n");
+  assert (gv->n_interfaces > 0 && strcmp (gv->interfaces[gv->n_interfaces - 1].name, "shmem") == 0);
+  gv->n_interfaces--;
+  ddsrt_free (gv->interfaces[gv->n_interfaces].name);
+  gv->interfaces[gv->n_interfaces].name = NULL;
+  fact->m_enable = false;
+  gv->config.shmem_transport = 0;
+}
+
 static void free_config_networkpartition_addresses (struct ddsi_config_networkpartition_listelem *np)
 {
   struct networkpartition_address **ps[] = {
@@ -1328,8 +1439,11 @@ int rtps_init (struct ddsi_domaingv *gv)
   gv->data_conn_uc = NULL;
   gv->disc_conn_mc = NULL;
   gv->data_conn_mc = NULL;
+  gv->disc_conn_shmem = NULL;
+  gv->data_conn_shmem = NULL;
   for (size_t i = 0; i < MAX_XMIT_CONNS; i++)
     gv->xmit_conns[i] = NULL;
+  gv->xmit_conn_pool = NULL;
   gv->listener = NULL;
   gv->debmon = NULL;
 
@@ -1360,7 +1474,21 @@ int rtps_init (struct ddsi_domaingv *gv)
     case DDSI_TRANS_UDP6:
       gv->config.publish_uc_locators = 1;
       gv->config.enable_uc_locators = 1;
-      if (ddsi_udp_init (gv) < 0)
+      if (gv->config.use_io_uring && ddsi_uring_init (gv) < 0)
+      {
+        GVWARNING ("io_uring not available, using plain UDP\n");
+        gv->config.use_io_uring = 0;
+      }
+      if (gv->config.use_io_uring)
+      {
+        /* the receive threads handle a fixed set of sockets */
+        if (gv->config.many_sockets_mode == DDSI_MSM_MANY_UNICAST)
+        {
+          GVLOG (DDS_LC_CONFIG, "io_uring: using ManySocketsMode single\n");
+          gv->config.many_sockets_mode = DDSI_MSM_SINGLE_UNICAST;
+        }
+      }
+      else if (ddsi_udp_init (gv) < 0)
         goto err_udp_tcp_init;
       gv->m_factory = ddsi_factory_find (gv, gv->config.transport_selector == DDSI_TRANS_UDP ? "udp" : "udp6");
       break;
@@ -1443,6 +1571,8 @@ int rtps_init (struct ddsi_domaingv *gv)
     goto err_set_ext_address;
   if (set_ext_address_and_mask (gv) < 0)
     goto err_set_ext_address;
+  if (gv->config.shmem_transport)
+    shmem_transport_init (gv);
 
   {
     char buf[DDSI_LOCSTRLEN], buf2[DDSI_LOCSTRLEN];
@@ -1506,6 +1636,7 @@ int rtps_init (struct ddsi_domaingv *gv)
   ddsrt_mutex_init (&gv->new_topic_lock);
   ddsrt_cond_init (&gv->new_topic_cond);
   gv->new_topic_version = 0;
+  ddsi_content_filter_classes_init (gv);
 #ifdef DDS_HAS_TOPIC_DISCOVERY
   ddsrt_mutex_init (&gv->topic_defs_lock);
   gv->topic_defs = ddsrt_hh_new (1, topic_definition_hash_wrap, topic_definition_equal_wrap);
@@ -1559,7 +1690,7 @@ int rtps_init (struct ddsi_domaingv *gv)
   ddsrt_mutex_init (&gv->lock);
   ddsrt_mutex_init (&gv->spdp_lock);
   gv->spdp_defrag = nn_defrag_new (&gv->logconfig, NN_DEFRAG_DROP_OLDEST, gv->config.defrag_unreliable_maxsamples);
-  gv->spdp_reorder = nn_reorder_new (&gv->logconfig, NN_REORDER_MODE_ALWAYS_DELIVER, gv->config.primary_reorder_maxsamples, false);
+  gv->spdp_reorder = nn_reorder_new (&gv->logconfig, NN_REORDER_MODE_ALWAYS_DELIVER, gv->config.primary_reorder_maxsamples, 0, false);
 
   gv->m_tkmap = ddsi_tkmap_new (gv);
 
@@ -1623,6 +1754,9 @@ int rtps_init (struct ddsi_domaingv *gv)
   }
   GVLOG (DDS_LC_CONFIG, "rtps_init: domainid %"PRIu32" participantid %d\n", gv->config.domainId, gv->config.participantIndex);
 
+  if (gv->config.shmem_transport)
+    shmem_transport_create_rings (gv);
+
   if (gv->config.pcap_file && *gv->config.pcap_file)
   {
     gv->pcap_fp = new_pcap_file (gv, gv->config.pcap_file);
@@ -1658,6 +1792,28 @@ int rtps_init (struct ddsi_domaingv *gv)
       gv->intf_xlocators[i].conn = gv->xmit_conns[i];
       gv->intf_xlocators[i].c = gv->interfaces[i].loc;
     }
+
+    if (gv->config.xmit_conn_pool_size > 1)
+    {
+      const uint32_t nextra = gv->config.xmit_conn_pool_size - 1;
+      gv->xmit_conn_pool = ddsrt_calloc ((size_t) gv->n_interfaces * nextra, sizeof (*gv->xmit_conn_pool));
+      for (int i = 0; i < gv->n_interfaces; i++)
+      {
+        const ddsi_tran_qos_t qos = { .m_purpose = DDSI_TRAN_QOS_XMIT, .m_diffserv = 0, .m_interface = &gv->interfaces[i] };
+        ddsi_tran_factory_t fact = ddsi_factory_find_supported_kind (gv, gv->interfaces[i].loc.kind);
+        const bool is_udp = (gv->interfaces[i].loc.kind == NN_LOCATOR_KIND_UDPv4 || gv->interfaces[i].loc.kind == NN_LOCATOR_KIND_UDPv6);
+        for (uint32_t k = 0; k < nextra; k++)
+        {
+          struct ddsi_tran_conn **conn = &gv->xmit_conn_pool[(uint32_t) i * nextra + k];
+          if (!is_udp)
+            *conn = gv->xmit_conns[i];
+          else if ((rc = ddsi_factory_create_conn (conn, fact, 0, &qos)) != DDS_RETCODE_OK)
+            goto err_mc_conn;
+          else
+            GVLOG (DDS_LC_CONFIG, "interface %s: additional transmit port %d\n", gv->interfaces[i].name, (int) ddsi_conn_port (*conn));
+        }
+      }
+    }
   }
 
 #ifdef DDS_HAS_NETWORK_PARTITIONS
@@ -1681,6 +1837,15 @@ int rtps_init (struct ddsi_domaingv *gv)
       {
         gv->data_conn_uc = gv->data_conn_mc;
         gv->disc_conn_uc = gv->disc_conn_mc;
+        ddsi_conn_locator (gv->disc_conn_uc, &gv->loc_meta_uc);
+        ddsi_conn_locator (gv->data_conn_uc, &gv->loc_default_uc);
+        /* the transmit connection was set to the then still non-existent data_conn_uc */
+        if (gv->xmit_conns[0] == NULL)
+        {
+          gv->xmit_conns[0] = gv->data_conn_uc;
+          gv->intf_xlocators[0].conn = gv->xmit_conns[0];
+          gv->intf_xlocators[0].c = gv->interfaces[0].loc;
+        }
       }
 
       /* Set multicast locators */
@@ -1795,6 +1960,7 @@ int rtps_init (struct ddsi_domaingv *gv)
     0
 #endif
   );
+  ddsi_domain_twheel_init (gv);
 
 #ifdef DDS_HAS_SECURITY
   q_omg_security_init(gv);
@@ -1808,7 +1974,8 @@ int rtps_init (struct ddsi_domaingv *gv)
      automatically. */
   for (int i = 0; i < gv->n_interfaces; i++)
   {
-    if (!gv->interfaces[i].mc_capable && gv->config.peers == NULL)
+    // the shared memory pseudo-interface has no address the transport could send to
+    if (!gv->interfaces[i].mc_capable && gv->config.peers == NULL && ddsi_factory_supports (gv->m_factory, gv->interfaces[i].loc.kind))
     {
       struct ddsi_config_peer_listelem peer_local;
       char local_addr[DDSI_LOCSTRLEN];
@@ -1846,6 +2013,18 @@ int rtps_init (struct ddsi_domaingv *gv)
     chptr->dqueue = nn_dqueue_new (chptr->name, &gv->config, gv->config.delivery_queue_maxsamples, user_dqueue_handler, NULL);
 #else
   gv->user_dqueue = nn_dqueue_new ("user", gv, gv->config.delivery_queue_maxsamples, user_dqueue_handler, NULL);
+  if (gv->config.delivery_queue_workers == 0)
+    gv->user_dqueue_workers = NULL;
+  else
+  {
+    gv->user_dqueue_workers = ddsrt_malloc (gv->config.delivery_queue_workers * sizeof (*gv->user_dqueue_workers));
+    for (uint32_t i = 0; i < gv->config.delivery_queue_workers; i++)
+    {
+      char name[16];
+      (void) snprintf (name, sizeof (name), "user.%"PRIu32, i);
+      gv->user_dqueue_workers[i] = nn_dqueue_new (name, gv, gv->config.delivery_queue_maxsamples, user_dqueue_handler, NULL);
+    }
+  }
 #endif
 
   if (reset_deaf_mute_time.v < DDS_NEVER)
@@ -1900,6 +2079,7 @@ err_unicast_sockets:
 #endif
   ddsrt_mutex_destroy (&gv->new_topic_lock);
   ddsrt_cond_destroy (&gv->new_topic_cond);
+  ddsi_content_filter_classes_fini (gv);
 #ifdef DDS_HAS_TYPE_DISCOVERY
   ddsrt_hh_free (gv->tl_admin);
   ddsrt_mutex_destroy (&gv->tl_admin_lock);
@@ -2181,12 +2361,19 @@ void rtps_fini (struct ddsi_domaingv *gv)
   }
 #else
   nn_dqueue_free (gv->user_dqueue);
+  if (gv->user_dqueue_workers)
+  {
+    for (uint32_t i = 0; i < gv->config.delivery_queue_workers; i++)
+      nn_dqueue_free (gv->user_dqueue_workers[i]);
+    ddsrt_free (gv->user_dqueue_workers);
+  }
 #endif
 
 #ifdef DDS_HAS_SECURITY
   q_omg_security_deinit (gv->security_context);
 #endif
 
+  ddsi_domain_twheel_fini (gv);
   xeventq_free (gv->xevents);
 
   // if sendq thread is started
@@ -2240,8 +2427,17 @@ void rtps_fini (struct ddsi_domaingv *gv)
      queues been drained.  I.e., until very late in the game. */
   for (uint32_t i = 0; i < gv->n_recv_threads; i++)
   {
-    if (gv->recv_threads[i].arg.mode == RTM_MANY)
+    if (gv->recv_threads[i].arg.mode == RTM_MANY && gv->recv_threads[i].arg.u.many.ws)
       os_sockWaitsetFree (gv->recv_threads[i].arg.u.many.ws);
+    if (gv->recv_threads[i].arg.uring_rx)
+      ddsi_uring_rx_free (gv->recv_threads[i].arg.uring_rx);
+    if (gv->config.rbuf_max_free > 0)
+    {
+      struct nn_rbufpool_stats st;
+      nn_rbufpool_get_stats (gv->recv_threads[i].arg.rbpool, &st);
+      GVLOG (DDS_LC_INFO, "%s: receive buffers recycled %"PRIu64" hits %"PRIu64" misses %"PRIu64"\n",
+             gv->recv_threads[i].name, st.recycled, st.hits, st.misses);
+    }
     nn_rbufpool_free (gv->recv_threads[i].arg.rbpool);
   }
 
@@ -2272,6 +2468,7 @@ void rtps_fini (struct ddsi_domaingv *gv)
 #endif
   ddsrt_hh_free (gv->sertypes);
   ddsrt_mutex_destroy (&gv->sertypes_lock);
+  ddsi_content_filter_classes_fini (gv);
 #ifdef DDS_HAS_TYPE_DISCOVERY
 #ifndef NDEBUG
   {
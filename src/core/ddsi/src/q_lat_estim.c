@@ -9,6 +9,7 @@
  *
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
+#include <assert.h>
 #include <ctype.h>
 #include <stddef.h>
 
@@ -19,11 +20,18 @@
 #include <string.h>
 
 void nn_lat_estim_init (struct nn_lat_estim *le)
+{
+  nn_lat_estim_init_alpha (le, 0.01f);
+}
+
+void nn_lat_estim_init_alpha (struct nn_lat_estim *le, float alpha)
 {
   int i;
+  assert (alpha > 0.0f && alpha <= 1.0f);
   le->index = 0;
   for (i = 0; i < NN_LAT_ESTIM_MEDIAN_WINSZ; i++)
     le->window[i] = 0;
+  le->alpha = alpha;
   le->smoothed = 0;
 }
 
@@ -38,7 +46,7 @@ static int cmpfloat (const float *a, const float *b)
 
 void nn_lat_estim_update (struct nn_lat_estim *le, int64_t est)
 {
-  const float alpha = 0.01f;
+  const float alpha = le->alpha;
   float fest, med;
   float tmp[NN_LAT_ESTIM_MEDIAN_WINSZ];
   if (est <= 0)
@@ -77,8 +85,8 @@ int nn_lat_estim_log (uint32_t logcat, const struct ddsrt_log_cfg *logcfg, const
   }
 }
 
-#if 0 /* not implemented yet */
 double nn_lat_estim_current (const struct nn_lat_estim *le)
 {
+  /* in microseconds, 0 until the median filter window has been filled */
+  return le->smoothed;
 }
-#endif
@@ -22,6 +22,11 @@
 #define USE_VALGRIND 0
 #endif
 
+#if defined (__linux__)
+#include <sys/mman.h>
+#endif
+
+#include "dds/ddsrt/atomics.h"
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/threads.h"
 #include "dds/ddsrt/sync.h"
@@ -279,13 +284,31 @@ struct nn_rbufpool {
 
      Could trivially be done lockless, except that it requires
      compare-and-swap, and we don't have that. But it hardly ever
-     happens anyway. */
+     happens anyway.
+
+     Optionally, up to max_free released rbufs are kept for reuse on a
+     stack instead of being freed, so that a busy receive thread doesn't
+     continuously malloc and free rbuf_size bytes.  Any thread may push
+     onto it, only the owner pops from it. */
   ddsrt_mutex_t lock;
   struct nn_rbuf *current;
   uint32_t rbuf_size;
   uint32_t max_rmsg_size;
   const struct ddsrt_log_cfg *logcfg;
   bool trace;
+  bool hugepages;
+  uint32_t max_free;
+  ddsrt_atomic_uint32_t nfree;
+#if DDSRT_HAVE_ATOMIC_LIFO
+  ddsrt_atomic_lifo_t freelist;
+#else
+  /* separate lock: rbufs get released while holding "lock" */
+  ddsrt_mutex_t freelist_lock;
+  struct nn_rbuf *freelist; /* [freelist_lock] */
+#endif
+  ddsrt_atomic_uint32_t recycled;
+  uint64_t hits;   /* [owner] */
+  uint64_t misses; /* [owner] */
 #ifndef NDEBUG
   /* Thread that owns this pool, so we can check that no other thread
      is calling functions only the owner may use. */
@@ -295,6 +318,8 @@ struct nn_rbufpool {
 
 static struct nn_rbuf *nn_rbuf_alloc_new (struct nn_rbufpool *rbp);
 static void nn_rbuf_release (struct nn_rbuf *rbuf);
+static struct nn_rbuf *nn_rbufpool_pop_free (struct nn_rbufpool *rbp);
+static void nn_rbuf_mem_free (struct nn_rbuf *rbuf);
 
 #define TRACE_CFG(obj, logcfg, ...) ((obj)->trace ? (void) DDS_CLOG (DDS_LC_RADMIN, (logcfg), __VA_ARGS__) : (void) 0)
 #define TRACE(obj, ...)             TRACE_CFG ((obj), (obj)->logcfg, __VA_ARGS__)
@@ -336,7 +361,7 @@ static uint32_t max_rmsg_size_w_hdr (uint32_t max_rmsg_size)
     + max_rmsg_size;
 }
 
-struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size)
+struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size, uint32_t max_free, bool hugepages)
 {
   struct nn_rbufpool *rbp;
 
@@ -361,6 +386,18 @@ struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_
   rbp->max_rmsg_size = max_rmsg_size;
   rbp->logcfg = logcfg;
   rbp->trace = (logcfg->c.mask & DDS_LC_RADMIN) != 0;
+  rbp->hugepages = hugepages;
+  rbp->max_free = max_free;
+  ddsrt_atomic_st32 (&rbp->nfree, 0);
+#if DDSRT_HAVE_ATOMIC_LIFO
+  ddsrt_atomic_lifo_init (&rbp->freelist);
+#else
+  ddsrt_mutex_init (&rbp->freelist_lock);
+  rbp->freelist = NULL;
+#endif
+  ddsrt_atomic_st32 (&rbp->recycled, 0);
+  rbp->hits = 0;
+  rbp->misses = 0;
 
 #if USE_VALGRIND
   VALGRIND_CREATE_MEMPOOL (rbp, 0, 0);
@@ -373,6 +410,9 @@ struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_
  fail_rbuf:
 #if USE_VALGRIND
   VALGRIND_DESTROY_MEMPOOL (rbp);
+#endif
+#if ! DDSRT_HAVE_ATOMIC_LIFO
+  ddsrt_mutex_destroy (&rbp->freelist_lock);
 #endif
   ddsrt_mutex_destroy (&rbp->lock);
   ddsrt_free (rbp);
@@ -396,14 +436,29 @@ void nn_rbufpool_free (struct nn_rbufpool *rbp)
      reference counts are all 0, as they should be. */
   ASSERT_RBUFPOOL_OWNER (rbp);
 #endif
+  struct nn_rbuf *rb;
   nn_rbuf_release (rbp->current);
+  while ((rb = nn_rbufpool_pop_free (rbp)) != NULL)
+    nn_rbuf_mem_free (rb);
 #if USE_VALGRIND
   VALGRIND_DESTROY_MEMPOOL (rbp);
+#endif
+#if ! DDSRT_HAVE_ATOMIC_LIFO
+  ddsrt_mutex_destroy (&rbp->freelist_lock);
 #endif
   ddsrt_mutex_destroy (&rbp->lock);
   ddsrt_free (rbp);
 }
 
+void nn_rbufpool_get_stats (const struct nn_rbufpool *rbp, struct nn_rbufpool_stats *st)
+{
+  /* hits and misses are only updated by the owner, they may be a bit out of
+     date when read by another thread but that's ok for statistics */
+  st->recycled = ddsrt_atomic_ld32 (&rbp->recycled);
+  st->hits = rbp->hits;
+  st->misses = rbp->misses;
+}
+
 /* RBUF ---------------------------------------------------------------- */
 
 struct nn_rbuf {
@@ -413,6 +468,10 @@ struct nn_rbuf {
   struct nn_rbufpool *rbufpool;
   bool trace;
 
+  /* Size of the mapping if the memory was obtained with mmap, 0 if malloc'd */
+  size_t mapsize;
+  struct nn_rbuf *freelist_next;
+
   /* Allocating sequentially, releasing in random order, not bothering
      to reuse memory as soon as it becomes available again. I think
      this will have to change eventually, but this is the easiest
@@ -430,12 +489,118 @@ struct nn_rbuf {
   unsigned char raw[];
 };
 
+#if defined (__linux__)
+#define RBUF_HUGEPAGE_SIZE ((size_t) 2 << 20)
+
+static struct nn_rbuf *nn_rbuf_mem_alloc_huge (size_t size)
+{
+  /* Explicit huge pages if the system has some reserved, else transparent
+     huge pages if the buffer is large enough for them to be of any use */
+  const size_t mapsize = (size + RBUF_HUGEPAGE_SIZE - 1) & ~(RBUF_HUGEPAGE_SIZE - 1);
+  void *p;
+#ifdef MAP_HUGETLB
+  if ((p = mmap (NULL, mapsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0)) != MAP_FAILED)
+  {
+    ((struct nn_rbuf *) p)->mapsize = mapsize;
+    return p;
+  }
+#endif
+  /* Transparent huge pages require alignment, so map a bit more than
+     needed and trim it */
+  unsigned char *q;
+  if ((q = mmap (NULL, mapsize + RBUF_HUGEPAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+    return NULL;
+  const size_t head = (RBUF_HUGEPAGE_SIZE - ((uintptr_t) q & (RBUF_HUGEPAGE_SIZE - 1))) & (RBUF_HUGEPAGE_SIZE - 1);
+  if (head > 0)
+    (void) munmap (q, head);
+  (void) munmap (q + head + mapsize, RBUF_HUGEPAGE_SIZE - head);
+  p = q + head;
+#ifdef MADV_HUGEPAGE
+  (void) madvise (p, mapsize, MADV_HUGEPAGE);
+#endif
+  ((struct nn_rbuf *) p)->mapsize = mapsize;
+  return p;
+}
+#endif
+
+static struct nn_rbuf *nn_rbuf_mem_alloc (struct nn_rbufpool *rbp)
+{
+  const size_t size = sizeof (struct nn_rbuf) + rbp->rbuf_size;
+  struct nn_rbuf *rb;
+#if defined (__linux__)
+  if (rbp->hugepages)
+    return nn_rbuf_mem_alloc_huge (size);
+#endif
+  if ((rb = ddsrt_malloc (size)) != NULL)
+    rb->mapsize = 0;
+  return rb;
+}
+
+static void nn_rbuf_mem_free (struct nn_rbuf *rbuf)
+{
+#if defined (__linux__)
+  if (rbuf->mapsize > 0)
+  {
+    (void) munmap (rbuf, rbuf->mapsize);
+    return;
+  }
+#endif
+  assert (rbuf->mapsize == 0);
+  ddsrt_free (rbuf);
+}
+
+static struct nn_rbuf *nn_rbufpool_pop_free (struct nn_rbufpool *rbp)
+{
+  struct nn_rbuf *rb;
+#if DDSRT_HAVE_ATOMIC_LIFO
+  rb = ddsrt_atomic_lifo_pop (&rbp->freelist, offsetof (struct nn_rbuf, freelist_next));
+#else
+  ddsrt_mutex_lock (&rbp->freelist_lock);
+  if ((rb = rbp->freelist) != NULL)
+    rbp->freelist = rb->freelist_next;
+  ddsrt_mutex_unlock (&rbp->freelist_lock);
+#endif
+  if (rb != NULL)
+    ddsrt_atomic_dec32 (&rbp->nfree);
+  return rb;
+}
+
+static bool nn_rbufpool_push_free (struct nn_rbufpool *rbp, struct nn_rbuf *rbuf)
+{
+  /* The bound is approximate if multiple threads push and pop concurrently,
+     but never exceeded: a slot is reserved before pushing */
+  if (ddsrt_atomic_inc32_ov (&rbp->nfree) >= rbp->max_free)
+  {
+    ddsrt_atomic_dec32 (&rbp->nfree);
+    return false;
+  }
+#if DDSRT_HAVE_ATOMIC_LIFO
+  ddsrt_atomic_lifo_push (&rbp->freelist, rbuf, offsetof (struct nn_rbuf, freelist_next));
+#else
+  ddsrt_mutex_lock (&rbp->freelist_lock);
+  rbuf->freelist_next = rbp->freelist;
+  rbp->freelist = rbuf;
+  ddsrt_mutex_unlock (&rbp->freelist_lock);
+#endif
+  ddsrt_atomic_inc32 (&rbp->recycled);
+  return true;
+}
+
 static struct nn_rbuf *nn_rbuf_alloc_new (struct nn_rbufpool *rbp)
 {
   struct nn_rbuf *rb;
   ASSERT_RBUFPOOL_OWNER (rbp);
 
-  if ((rb = ddsrt_malloc (sizeof (struct nn_rbuf) + rbp->rbuf_size)) == NULL)
+  if (rbp->max_free == 0)
+    rb = nn_rbuf_mem_alloc (rbp);
+  else if ((rb = nn_rbufpool_pop_free (rbp)) != NULL)
+    rbp->hits++;
+  else
+  {
+    rbp->misses++;
+    rb = nn_rbuf_mem_alloc (rbp);
+  }
+  if (rb == NULL)
     return NULL;
 #if USE_VALGRIND
   VALGRIND_MAKE_MEM_NOACCESS (rb->raw, rbp->rbuf_size);
@@ -472,8 +637,13 @@ static void nn_rbuf_release (struct nn_rbuf *rbuf)
   RBPTRACE ("rbuf_release(%p) pool %p current %p\n", (void *) rbuf, (void *) rbp, (void *) rbp->current);
   if (ddsrt_atomic_dec32_ov (&rbuf->n_live_rmsg_chunks) == 1)
   {
-    RBPTRACE ("rbuf_release(%p) free\n", (void *) rbuf);
-    ddsrt_free (rbuf);
+    if (rbp->max_free > 0 && nn_rbufpool_push_free (rbp, rbuf))
+      RBPTRACE ("rbuf_release(%p) recycle\n", (void *) rbuf);
+    else
+    {
+      RBPTRACE ("rbuf_release(%p) free\n", (void *) rbuf);
+      nn_rbuf_mem_free (rbuf);
+    }
   }
 }
 
@@ -546,6 +716,7 @@ struct nn_rmsg *nn_rmsg_new (struct nn_rbufpool *rbp)
   /* Initial chunk */
   init_rmsg_chunk (&rmsg->chunk, rbp->current);
   rmsg->trace = rbp->trace;
+  rmsg->timestamp.v = 0;
   rmsg->lastchunk = &rmsg->chunk;
   /* Incrementing freeptr happens in commit(), so that discarding the
      message is really simple. */
@@ -825,6 +996,19 @@ static void nn_rdata_unref (struct nn_rdata *rdata)
    fragmented message will have at least one interval allocated to it
    and thus have sufficient space for the chain node.
 
+   Large samples received out of order (e.g., over multiple paths, or
+   after losing a few packets) need many tree operations per sample.
+   For samples of at least DEFRAG_FRAGMAP_MIN_FRAGS and at most
+   DEFRAG_FRAGMAP_MAX_FRAGS fragments whose fragments are aligned on
+   the fragment size (which the spec requires), the defragmenter
+   instead tracks the received fragment numbers in a bitmap
+   ("fragmap"), with an interval for each received
+   rdata indexed by its first fragment number.  The fragment chain is
+   then only built once the sample is complete.  If a fragment doesn't
+   fit the fragmap (a different fragment size, or not aligned), the
+   sample is converted to the interval tree representation and
+   continues from there.
+
    FIXME: These AVL trees are overkill.  Either switch to parent-less
    red-black trees (they have better performance anyway and only need
    a single bit of state) or to splay trees (must have a parent
@@ -839,12 +1023,30 @@ struct nn_defrag_iv {
   struct nn_rdata *last;
 };
 
+#define DEFRAG_FRAGMAP_MIN_FRAGS 32
+/* The sample and fragment sizes come from the peer, so the size of the
+   fragmap must be bounded independently of MaxSampleSize; samples with
+   more fragments use the interval tree, which only grows with the data
+   actually received */
+#define DEFRAG_FRAGMAP_MAX_FRAGS 65536
+
+struct nn_defrag_fragmap {
+  uint32_t nfrags; /* number of fragments in the sample */
+  uint32_t nmissing; /* number of fragments not yet received */
+  uint32_t fragsize, size; /* fragment and sample size of the sample */
+  uint32_t maxp1; /* 1 + highest fragment number received */
+  struct nn_defrag_iv *sentinel; /* [0,0) interval for conversion to a tree, if first fragment was missing */
+  uint32_t *bits; /* received fragments, nfrags bits */
+  struct nn_defrag_iv **frags; /* interval of rdatas starting at each fragment, or NULL */
+};
+
 struct nn_rsample {
   union {
     struct nn_rsample_defrag {
       ddsrt_avl_node_t avlnode; /* for nn_defrag::sampletree */
-      ddsrt_avl_tree_t fragtree;
+      ddsrt_avl_tree_t fragtree; /* empty if fragmap != NULL */
       struct nn_defrag_iv *lastfrag;
+      struct nn_defrag_fragmap *fragmap; /* fragment bitmap, or NULL if using fragtree */
       struct nn_rsample_info *sampleinfo;
       seqno_t seq;
     } defrag;
@@ -937,10 +1139,22 @@ static void defrag_rsample_drop (struct nn_defrag *defrag, struct nn_rsample *rs
      inorder treewalk does provide. */
   ddsrt_avl_iter_t iter;
   struct nn_defrag_iv *iv;
+  struct nn_defrag_fragmap * const fragmap = rsample->u.defrag.fragmap;
   TRACE (defrag, "  defrag_rsample_drop (%p, %p)\n", (void *) defrag, (void *) rsample);
   ddsrt_avl_delete (&defrag_sampletree_treedef, &defrag->sampletree, rsample);
   assert (defrag->n_samples > 0);
   defrag->n_samples--;
+  if (fragmap)
+  {
+    /* each interval is stored in the rmsg of the first rdata in its
+       chain, so it can't be referenced after freeing the chain */
+    uint32_t i;
+    for (i = 0; i < fragmap->nfrags; i++)
+      if (fragmap->frags[i])
+        nn_fragchain_rmbias (fragmap->frags[i]->first);
+    ddsrt_free (fragmap);
+    return;
+  }
   for (iv = ddsrt_avl_iter_first (&rsample_defrag_fragtree_treedef, &rsample->u.defrag.fragtree, &iter); iv; iv = ddsrt_avl_iter_next (&iter))
   {
     if (iv->first)
@@ -1014,11 +1228,13 @@ static int defrag_try_merge_with_succ (const struct nn_defrag *defrag, struct nn
 
     node->last->nextfrag = succ->first;
     node->last = succ->last;
-    node->maxp1 = succ_maxp1;
 
     /* if the new fragment contains data beyond succ it may even
        allow merging with succ-succ */
-    return node->maxp1 > succ_maxp1;
+    if (node->maxp1 > succ_maxp1)
+      return 1;
+    node->maxp1 = succ_maxp1;
+    return 0;
   }
 }
 
@@ -1037,15 +1253,193 @@ static void defrag_rsample_addiv (struct nn_rsample_defrag *sample, struct nn_rd
     sample->lastfrag = newiv;
 }
 
+static struct nn_defrag_fragmap *defrag_fragmap_new (const struct nn_rsample_info *sampleinfo)
+{
+  struct nn_defrag_fragmap *m;
+  uint32_t fragsize = sampleinfo->fragsize, nfrags, nwords;
+  if (fragsize == 0)
+    return NULL;
+  nfrags = (uint32_t) (((uint64_t) sampleinfo->size + fragsize - 1) / fragsize);
+  if (nfrags < DEFRAG_FRAGMAP_MIN_FRAGS || nfrags > DEFRAG_FRAGMAP_MAX_FRAGS)
+    return NULL;
+  nwords = (nfrags + 31) / 32;
+  m = ddsrt_malloc (sizeof (*m) + nfrags * sizeof (*m->frags) + nwords * sizeof (*m->bits));
+  m->nfrags = m->nmissing = nfrags;
+  m->fragsize = fragsize;
+  m->size = sampleinfo->size;
+  m->maxp1 = 0;
+  m->sentinel = NULL;
+  m->frags = (struct nn_defrag_iv **) (m + 1);
+  m->bits = (uint32_t *) (m->frags + nfrags);
+  memset (m->frags, 0, nfrags * sizeof (*m->frags));
+  nn_bitset_zero (nfrags, m->bits);
+  return m;
+}
+
+static bool defrag_fragmap_range (const struct nn_defrag_fragmap *m, const struct nn_rdata *rdata, const struct nn_rsample_info *sampleinfo, uint32_t *f0, uint32_t *f1)
+{
+  /* Sets [f0,f1) to the fragment numbers covered by rdata, returns
+     false if rdata can't be represented in the fragmap */
+  if (sampleinfo->fragsize != m->fragsize || sampleinfo->size != m->size)
+    return false;
+  if (rdata->min % m->fragsize != 0 || (rdata->maxp1 % m->fragsize != 0 && rdata->maxp1 != m->size))
+    return false;
+  *f0 = rdata->min / m->fragsize;
+  *f1 = (rdata->maxp1 + m->fragsize - 1) / m->fragsize;
+  return true;
+}
+
+static uint32_t defrag_fragmap_next_missing (const struct nn_defrag_fragmap *m, uint32_t i)
+{
+  /* Returns the lowest missing fragment number >= i, or nfrags if none */
+  while (i < m->nfrags)
+  {
+    if ((i % 32) == 0 && m->bits[i / 32] == ~UINT32_C(0))
+      i += 32;
+    else if (!nn_bitset_isset (m->nfrags, m->bits, i))
+      return i;
+    else
+      i++;
+  }
+  return m->nfrags;
+}
+
+static uint32_t defrag_fragmap_prev_missing (const struct nn_defrag_fragmap *m, uint32_t i)
+{
+  /* Returns the highest missing fragment number <= i, which must exist */
+  for (;;)
+  {
+    if ((i % 32) == 31 && m->bits[i / 32] == ~UINT32_C(0))
+      i -= 32;
+    else if (!nn_bitset_isset (m->nfrags, m->bits, i))
+      return i;
+    else
+      i--;
+  }
+}
+
+static void defrag_fragmap_to_tree (const struct nn_defrag *defrag, struct nn_rsample_defrag *sample)
+{
+  /* Converts the sample to the interval tree representation, merging
+     the intervals of consecutive fragments like add_fragment does */
+  struct nn_defrag_fragmap * const m = sample->fragmap;
+  struct nn_defrag_iv *cur = NULL;
+  uint32_t i;
+  TRACE (defrag, "  defrag_fragmap_to_tree(%p)\n", (void *) sample);
+  assert (ddsrt_avl_is_empty (&sample->fragtree));
+  if (m->frags[0] == NULL)
+  {
+    assert (m->sentinel != NULL);
+    ddsrt_avl_insert (&rsample_defrag_fragtree_treedef, &sample->fragtree, m->sentinel);
+    cur = m->sentinel;
+  }
+  for (i = 0; i < m->nfrags; i++)
+  {
+    struct nn_defrag_iv * const iv = m->frags[i];
+    if (iv == NULL)
+      continue;
+    if (cur != NULL && iv->min <= cur->maxp1)
+    {
+      cur->last->nextfrag = iv->first;
+      cur->last = iv->last;
+      if (iv->maxp1 > cur->maxp1)
+        cur->maxp1 = iv->maxp1;
+    }
+    else
+    {
+      ddsrt_avl_insert (&rsample_defrag_fragtree_treedef, &sample->fragtree, iv);
+      cur = iv;
+    }
+  }
+  sample->lastfrag = cur;
+  sample->fragmap = NULL;
+  ddsrt_free (m);
+}
+
+static int defrag_fragmap_add (struct nn_defrag *defrag, struct nn_rsample_defrag *sample, struct nn_rdata *rdata, const struct nn_rsample_info *sampleinfo, uint32_t f0, uint32_t f1)
+{
+  /* Adds rdata covering fragments [f0,f1) to the fragmap, returns 1 if
+     this completed the sample, in which case the sample is converted
+     to a single interval containing the full fragment chain */
+  struct nn_defrag_fragmap * const m = sample->fragmap;
+  struct nn_defrag_iv *iv;
+  uint32_t i, nnew = 0;
+  assert (f0 < f1 && f1 <= m->nfrags);
+  for (i = f0; i < f1; i++)
+    if (!nn_bitset_isset (m->nfrags, m->bits, i))
+      nnew++;
+  if (nnew == 0)
+  {
+    TRACE (defrag, "  fragments %"PRIu32"..%"PRIu32" already known\n", f0, f1 - 1);
+    defrag->discarded_bytes += rdata->maxp1 - rdata->min;
+    return 0;
+  }
+  if ((iv = m->frags[f0]) != NULL)
+  {
+    /* overlaps with an rdata starting at the same fragment, but adds
+       data: chain it behind that one, the deserializer skips anything
+       that doesn't add data */
+    TRACE (defrag, "  fragments %"PRIu32"..%"PRIu32" extend %p\n", f0, f1 - 1, (void *) iv);
+    assert (rdata->maxp1 > iv->maxp1);
+    iv->last->nextfrag = rdata;
+    iv->last = rdata;
+    iv->maxp1 = rdata->maxp1;
+  }
+  else
+  {
+    TRACE (defrag, "  fragments %"PRIu32"..%"PRIu32" new\n", f0, f1 - 1);
+    if ((iv = nn_rmsg_alloc (rdata->rmsg, sizeof (*iv))) == NULL)
+      return 0;
+    iv->first = iv->last = rdata;
+    iv->min = rdata->min;
+    iv->maxp1 = rdata->maxp1;
+    m->frags[f0] = iv;
+    /* always use the sample info contributed by the first fragment */
+    if (f0 == 0)
+      *sample->sampleinfo = *sampleinfo;
+  }
+  nn_rdata_addbias (rdata);
+  rdata->nextfrag = NULL;
+  for (i = f0; i < f1; i++)
+    nn_bitset_set (m->nfrags, m->bits, i);
+  m->nmissing -= nnew;
+  if (f1 > m->maxp1)
+    m->maxp1 = f1;
+  if (m->nmissing > 0)
+    return 0;
+
+  /* complete: chain everything together in the interval of the first
+     fragment, which becomes the only interval in the tree */
+  TRACE (defrag, "  fragmap complete\n");
+  iv = m->frags[0];
+  assert (iv != NULL);
+  for (i = 1; i < m->nfrags; i++)
+  {
+    if (m->frags[i])
+    {
+      iv->last->nextfrag = m->frags[i]->first;
+      iv->last = m->frags[i]->last;
+      if (m->frags[i]->maxp1 > iv->maxp1)
+        iv->maxp1 = m->frags[i]->maxp1;
+    }
+  }
+  ddsrt_avl_insert (&rsample_defrag_fragtree_treedef, &sample->fragtree, iv);
+  sample->lastfrag = iv;
+  sample->fragmap = NULL;
+  ddsrt_free (m);
+  return 1;
+}
+
 static void rsample_init_common (UNUSED_ARG (struct nn_rsample *rsample), UNUSED_ARG (struct nn_rdata *rdata), UNUSED_ARG (const struct nn_rsample_info *sampleinfo))
 {
 }
 
-static struct nn_rsample *defrag_rsample_new (struct nn_rdata *rdata, const struct nn_rsample_info *sampleinfo)
+static struct nn_rsample *defrag_rsample_new (struct nn_defrag *defrag, struct nn_rdata *rdata, const struct nn_rsample_info *sampleinfo)
 {
   struct nn_rsample *rsample;
   struct nn_rsample_defrag *dfsample;
   ddsrt_avl_ipath_t ivpath;
+  uint32_t f0 = 0, f1 = 0;
 
   if ((rsample = nn_rmsg_alloc (rdata->rmsg, sizeof (*rsample))) == NULL)
     return NULL;
@@ -1059,16 +1453,48 @@ static struct nn_rsample *defrag_rsample_new (struct nn_rdata *rdata, const stru
 
   ddsrt_avl_init (&rsample_defrag_fragtree_treedef, &dfsample->fragtree);
 
-  /* add sentinel if rdata is not the first fragment of the message */
+  /* use a fragmap if the sample is large enough and the first fragment
+     fits, there is no point in trying to use it otherwise */
+  if ((dfsample->fragmap = defrag_fragmap_new (sampleinfo)) != NULL &&
+      !defrag_fragmap_range (dfsample->fragmap, rdata, sampleinfo, &f0, &f1))
+  {
+    ddsrt_free (dfsample->fragmap);
+    dfsample->fragmap = NULL;
+  }
+
+  /* add sentinel if rdata is not the first fragment of the message;
+     with a fragmap, it is only needed if it gets converted to a tree */
   if (rdata->min > 0)
   {
     struct nn_defrag_iv *sentinel;
     if ((sentinel = nn_rmsg_alloc (rdata->rmsg, sizeof (*sentinel))) == NULL)
+    {
+      ddsrt_free (dfsample->fragmap);
       return NULL;
+    }
     sentinel->first = sentinel->last = NULL;
     sentinel->min = sentinel->maxp1 = 0;
-    ddsrt_avl_lookup_ipath (&rsample_defrag_fragtree_treedef, &dfsample->fragtree, &sentinel->min, &ivpath);
-    ddsrt_avl_insert_ipath (&rsample_defrag_fragtree_treedef, &dfsample->fragtree, sentinel, &ivpath);
+    if (dfsample->fragmap)
+      dfsample->fragmap->sentinel = sentinel;
+    else
+    {
+      ddsrt_avl_lookup_ipath (&rsample_defrag_fragtree_treedef, &dfsample->fragtree, &sentinel->min, &ivpath);
+      ddsrt_avl_insert_ipath (&rsample_defrag_fragtree_treedef, &dfsample->fragtree, sentinel, &ivpath);
+    }
+  }
+
+  if (dfsample->fragmap)
+  {
+    /* a single fragment can't complete a sample */
+    if (defrag_fragmap_add (defrag, dfsample, rdata, sampleinfo, f0, f1))
+      assert (0);
+    if (dfsample->fragmap->nmissing == dfsample->fragmap->nfrags)
+    {
+      /* out of memory for the interval */
+      ddsrt_free (dfsample->fragmap);
+      return NULL;
+    }
+    return rsample;
   }
 
   /* add an interval for the first received fragment */
@@ -1177,6 +1603,16 @@ static struct nn_rsample *defrag_add_fragment (struct nn_defrag *defrag, struct
   /* and it must concern this message */
   assert (dfsample);
   assert (dfsample->seq == sampleinfo->seq);
+
+  if (dfsample->fragmap)
+  {
+    uint32_t f0, f1;
+    if (defrag_fragmap_range (dfsample->fragmap, rdata, sampleinfo, &f0, &f1))
+      return defrag_fragmap_add (defrag, dfsample, rdata, sampleinfo, f0, f1) ? sample : NULL;
+    TRACE (defrag, "  fragment doesn't fit fragmap\n");
+    defrag_fragmap_to_tree (defrag, dfsample);
+  }
+
   /* there must be a last fragment */
   assert (dfsample->lastfrag);
   /* relatively expensive test: lastfrag, tree must be consistent */
@@ -1390,7 +1826,7 @@ struct nn_rsample *nn_defrag_rsample (struct nn_defrag *defrag, struct nn_rdata
     /* FIXME: MERGE THIS ONE WITH THE NEXT */
     TRACE (defrag, "  new max sample\n");
     ddsrt_avl_lookup_ipath (&defrag_sampletree_treedef, &defrag->sampletree, &sampleinfo->seq, &path);
-    if ((sample = defrag_rsample_new (rdata, sampleinfo)) == NULL)
+    if ((sample = defrag_rsample_new (defrag, rdata, sampleinfo)) == NULL)
       return NULL;
     ddsrt_avl_insert_ipath (&defrag_sampletree_treedef, &defrag->sampletree, sample, &path);
     defrag->max_sample = sample;
@@ -1402,7 +1838,7 @@ struct nn_rsample *nn_defrag_rsample (struct nn_defrag *defrag, struct nn_rdata
     /* a new sequence number, but smaller than the maximum */
     TRACE (defrag, "  new sample less than max\n");
     assert (sampleinfo->seq < max_seq);
-    if ((sample = defrag_rsample_new (rdata, sampleinfo)) == NULL)
+    if ((sample = defrag_rsample_new (defrag, rdata, sampleinfo)) == NULL)
       return NULL;
     ddsrt_avl_insert_ipath (&defrag_sampletree_treedef, &defrag->sampletree, sample, &path);
     defrag->n_samples++;
@@ -1489,6 +1925,28 @@ enum nn_defrag_nackmap_result nn_defrag_nackmap (struct nn_defrag *defrag, seqno
   if (maxfragnum >= nfrags)
     maxfragnum = nfrags - 1;
 
+  if (s->u.defrag.fragmap)
+  {
+    /* Missing fragments are known to exist up to maxfragnum and up to
+       the highest one received; the bitmap runs from the first to the
+       last missing one in that range */
+    const struct nn_defrag_fragmap *m = s->u.defrag.fragmap;
+    const uint32_t limit = (m->maxp1 - 1 > maxfragnum) ? m->maxp1 - 1 : maxfragnum;
+    nn_fragment_number_t map_end;
+    assert (m->nfrags == nfrags && m->maxp1 > 0);
+    if ((map->bitmap_base = defrag_fragmap_next_missing (m, 0)) > limit)
+      return DEFRAG_NACKMAP_ALL_ADVERTISED_FRAGMENTS_KNOWN;
+    map_end = defrag_fragmap_prev_missing (m, limit);
+    map->numbits = map_end - map->bitmap_base + 1;
+    if (map->numbits > maxsz)
+      map->numbits = maxsz;
+    nn_bitset_zero (map->numbits, mapbits);
+    for (i = 0; i < map->numbits; i++)
+      if (!nn_bitset_isset (m->nfrags, m->bits, map->bitmap_base + i))
+        nn_bitset_set (map->numbits, mapbits, i);
+    return DEFRAG_NACKMAP_FRAGMENTS_MISSING;
+  }
+
   /* Determine bitmap start & size */
   {
     /* We always have an interval starting at 0, which is empty if we
@@ -1654,11 +2112,28 @@ void nn_defrag_prune (struct nn_defrag *defrag, ddsi_guid_prefix_t *dst, seqno_t
    admins that accepted it, less BIAS for the initial reference.  We
    can't use the original sample because of [CASE I], so we adjust
    based on the fragment chain instead of the sample.  Example code is
-   in the overview comment at the top of this file. */
+   in the overview comment at the top of this file.
+
+   The common case of out-of-order arrival is a few lost packets
+   followed by samples arriving in order until the retransmits come
+   in.  Storing those in the interval tree means tree operations for
+   every sample that arrives while waiting for the retransmits, so
+   while the interval tree is empty, samples within "window_size" of
+   next_seq are instead stored in a sliding window: an array of
+   singleton samples indexed by sequence number modulo the window size
+   and a bitmap of the occupied slots.  Anything the window can't
+   represent (a sample beyond the window, a gap) first moves the
+   contents of the window into the tree as intervals, and the tree is
+   then used until it becomes empty again. */
 
 struct nn_reorder {
   ddsrt_avl_tree_t sampleivtree;
   struct nn_rsample *max_sampleiv; /* = max(sampleivtree) */
+  struct nn_rsample **window; /* window_size entries, allocated on first use */
+  uint32_t *window_bits; /* occupied slots in window */
+  uint32_t window_size; /* power of 2 or 0 if disabled */
+  uint32_t window_n; /* number of samples in window, > 0 => tree empty */
+  seqno_t window_maxp1; /* 1 + highest sequence number in window if window_n > 0 */
   seqno_t next_seq;
   enum nn_reorder_mode mode;
   uint32_t max_samples;
@@ -1672,13 +2147,28 @@ struct nn_reorder {
 static const ddsrt_avl_treedef_t reorder_sampleivtree_treedef =
   DDSRT_AVL_TREEDEF_INITIALIZER (offsetof (struct nn_rsample, u.reorder.avlnode), offsetof (struct nn_rsample, u.reorder.min), compare_seqno, 0);
 
-struct nn_reorder *nn_reorder_new (const struct ddsrt_log_cfg *logcfg, enum nn_reorder_mode mode, uint32_t max_samples, bool late_ack_mode)
+struct nn_reorder *nn_reorder_new (const struct ddsrt_log_cfg *logcfg, enum nn_reorder_mode mode, uint32_t max_samples, uint32_t window_size, bool late_ack_mode)
 {
   struct nn_reorder *r;
   if ((r = ddsrt_malloc (sizeof (*r))) == NULL)
     return NULL;
   ddsrt_avl_init (&reorder_sampleivtree_treedef, &r->sampleivtree);
   r->max_sampleiv = NULL;
+  r->window = NULL;
+  r->window_bits = NULL;
+  if (window_size == 0 || max_samples == 0 || mode != NN_REORDER_MODE_NORMAL)
+    r->window_size = 0;
+  else
+  {
+    /* power of 2 for cheap indexing, multiple of 32 for the bitmap */
+    if (window_size > NN_REORDER_MAX_WINDOW_SIZE)
+      window_size = NN_REORDER_MAX_WINDOW_SIZE;
+    r->window_size = 32;
+    while (r->window_size < window_size)
+      r->window_size *= 2;
+  }
+  r->window_n = 0;
+  r->window_maxp1 = 0;
   r->next_seq = 1;
   r->mode = mode;
   r->max_samples = max_samples;
@@ -1706,10 +2196,74 @@ void nn_fragchain_unref (struct nn_rdata *frag)
   }
 }
 
+static uint32_t reorder_window_idx (const struct nn_reorder *reorder, seqno_t seq)
+{
+  return (uint32_t) seq & (reorder->window_size - 1);
+}
+
+static bool reorder_window_isset (const struct nn_reorder *reorder, seqno_t seq)
+{
+  return nn_bitset_isset (reorder->window_size, reorder->window_bits, reorder_window_idx (reorder, seq));
+}
+
+static seqno_t reorder_window_next (const struct nn_reorder *reorder, seqno_t seq, seqno_t limit)
+{
+  /* Returns the lowest sequence number in [seq,limit) present in the
+     window, or limit if none */
+  while (seq < limit)
+  {
+    const uint32_t idx = reorder_window_idx (reorder, seq);
+    if ((idx % 32) == 0 && reorder->window_bits[idx / 32] == 0)
+      seq += 32;
+    else if (nn_bitset_isset (reorder->window_size, reorder->window_bits, idx))
+      return seq;
+    else
+      seq++;
+  }
+  return limit;
+}
+
+static seqno_t reorder_window_prev (const struct nn_reorder *reorder, seqno_t seq, seqno_t lower)
+{
+  /* Returns the highest sequence number in [lower,seq) present in the
+     window, or lower-1 if none */
+  while (seq > lower)
+  {
+    const uint32_t idx = reorder_window_idx (reorder, seq - 1);
+    if ((idx % 32) == 31 && reorder->window_bits[idx / 32] == 0)
+      seq -= 32;
+    else if (nn_bitset_isset (reorder->window_size, reorder->window_bits, idx))
+      return seq - 1;
+    else
+      seq--;
+  }
+  return lower - 1;
+}
+
+static struct nn_rsample *reorder_window_take (struct nn_reorder *reorder, seqno_t seq)
+{
+  const uint32_t idx = reorder_window_idx (reorder, seq);
+  assert (reorder->window_n > 0);
+  assert (nn_bitset_isset (reorder->window_size, reorder->window_bits, idx));
+  nn_bitset_clear (reorder->window_size, reorder->window_bits, idx);
+  reorder->window_n--;
+  return reorder->window[idx];
+}
+
 void nn_reorder_free (struct nn_reorder *r)
 {
   struct nn_rsample *iv;
   struct nn_rsample_chain_elem *sce;
+  if (r->window_n > 0)
+  {
+    seqno_t seq = r->next_seq;
+    while ((seq = reorder_window_next (r, seq, r->window_maxp1)) < r->window_maxp1)
+    {
+      iv = reorder_window_take (r, seq++);
+      nn_fragchain_unref (iv->u.reorder.sc.first->fragchain);
+    }
+  }
+  ddsrt_free (r->window);
   /* FXIME: instead of findmin/delete, a treewalk can be used. */
   iv = ddsrt_avl_find_min (&reorder_sampleivtree_treedef, &r->sampleivtree);
   while (iv)
@@ -1896,6 +2450,123 @@ static void delete_last_sample (struct nn_reorder *reorder)
   nn_fragchain_unref (fragchain);
 }
 
+static void reorder_window_to_tree (struct nn_reorder *reorder)
+{
+  /* Moves the contents of the window into the interval tree, one
+     interval for each run of consecutive sequence numbers */
+  seqno_t seq = reorder->next_seq;
+  TRACE (reorder, "  moving %"PRIu32" samples in window to tree\n", reorder->window_n);
+  assert (reorder->max_sampleiv == NULL);
+  assert (reorder->n_samples == reorder->window_n);
+  while ((seq = reorder_window_next (reorder, seq, reorder->window_maxp1)) < reorder->window_maxp1)
+  {
+    struct nn_rsample *iv = reorder_window_take (reorder, seq++);
+    while (seq < reorder->window_maxp1 && reorder_window_isset (reorder, seq))
+      append_rsample_interval (iv, reorder_window_take (reorder, seq++));
+    reorder_add_rsampleiv (reorder, iv);
+    reorder->max_sampleiv = iv;
+  }
+  assert (reorder->window_n == 0);
+}
+
+static bool reorder_window_usable (struct nn_reorder *reorder, seqno_t seq)
+{
+  /* The window can only be used while the tree is empty and for
+     sequence numbers in [next_seq, next_seq + window_size); if seq is
+     beyond it the contents of the window must be moved into the tree */
+  assert (seq > reorder->next_seq);
+  if (reorder->window_size == 0 || reorder->max_sampleiv != NULL)
+    return false;
+  else if (seq - reorder->next_seq >= (seqno_t) reorder->window_size)
+  {
+    if (reorder->window_n > 0)
+      reorder_window_to_tree (reorder);
+    return false;
+  }
+  else if (reorder->window == NULL)
+  {
+    /* lazily allocated: nothing is ever out of order on many
+       connections, and the bitmap follows the array */
+    const size_t wsz = reorder->window_size * sizeof (*reorder->window);
+    if ((reorder->window = ddsrt_malloc (wsz + reorder->window_size / 8)) == NULL)
+    {
+      reorder->window_size = 0;
+      return false;
+    }
+    reorder->window_bits = (uint32_t *) ((char *) reorder->window + wsz);
+    nn_bitset_zero (reorder->window_size, reorder->window_bits);
+  }
+  return true;
+}
+
+static void reorder_window_append_run (struct nn_reorder *reorder, struct nn_rsample *rsampleiv)
+{
+  /* Appends the samples in the window immediately following rsampleiv */
+  const seqno_t min = rsampleiv->u.reorder.maxp1;
+  seqno_t seq = min;
+  while (reorder->window_n > 0 && reorder_window_isset (reorder, seq))
+    append_rsample_interval (rsampleiv, reorder_window_take (reorder, seq++));
+  if (seq > min)
+    TRACE (reorder, "  appended [%"PRId64",%"PRId64") from window\n", min, seq);
+}
+
+static void reorder_window_delete_last (struct nn_reorder *reorder)
+{
+  struct nn_rsample *last;
+  struct nn_rdata *fragchain;
+  /* not supposed to be called on a window with only one sample */
+  assert (reorder->window_n > 1);
+  last = reorder_window_take (reorder, reorder->window_maxp1 - 1);
+  fragchain = last->u.reorder.sc.first->fragchain;
+  TRACE (reorder, "  delete_last_sample: %"PRId64" in window\n", reorder->window_maxp1 - 1);
+  reorder->discarded_bytes += last->u.reorder.sc.first->sampleinfo->size;
+  reorder->window_maxp1 = reorder_window_prev (reorder, reorder->window_maxp1 - 1, reorder->next_seq + 1) + 1;
+  nn_fragchain_unref (fragchain);
+}
+
+static nn_reorder_result_t reorder_window_rsample (struct nn_reorder *reorder, struct nn_rsample *rsampleiv, int *refcount_adjust, int delivery_queue_full_p)
+{
+  /* Same policy as for the tree: at the end means it is subject to the
+     max_samples limit and rejected if the delivery queue is full;
+     before the end it is accepted at the expense of the last one
+     (unless in late-ack mode and the delivery queue is full) */
+  struct nn_rsample_reorder *s = &rsampleiv->u.reorder;
+  const uint32_t idx = reorder_window_idx (reorder, s->min);
+  const bool at_end = (reorder->window_n == 0 || s->min >= reorder->window_maxp1);
+  assert (reorder->n_samples == reorder->window_n);
+  if (nn_bitset_isset (reorder->window_size, reorder->window_bits, idx))
+  {
+    TRACE (reorder, "  discard: present in window\n");
+    reorder->discarded_bytes += s->sc.first->sampleinfo->size;
+    return NN_REORDER_REJECT;
+  }
+  else if (delivery_queue_full_p && (at_end || reorder->late_ack_mode))
+  {
+    TRACE (reorder, "  discarding sample: delivery queue full\n");
+    reorder->discarded_bytes += s->sc.first->sampleinfo->size;
+    return NN_REORDER_REJECT;
+  }
+  else if (at_end && reorder->n_samples >= reorder->max_samples)
+  {
+    TRACE (reorder, "  discarding sample: max_samples reached and sample at end\n");
+    reorder->discarded_bytes += s->sc.first->sampleinfo->size;
+    return NN_REORDER_REJECT;
+  }
+
+  TRACE (reorder, "  storing in window\n");
+  reorder->window[idx] = rsampleiv;
+  nn_bitset_set (reorder->window_size, reorder->window_bits, idx);
+  reorder->window_n++;
+  if (at_end)
+    reorder->window_maxp1 = s->maxp1;
+  if (reorder->n_samples < reorder->max_samples)
+    reorder->n_samples++;
+  else
+    reorder_window_delete_last (reorder);
+  (*refcount_adjust)++;
+  return NN_REORDER_ACCEPT;
+}
+
 nn_reorder_result_t nn_reorder_rsample (struct nn_rsample_chain *sc, struct nn_reorder *reorder, struct nn_rsample *rsampleiv, int *refcount_adjust, int delivery_queue_full_p)
 {
   /* Adds an rsample (represented as an interval) to the reorder admin
@@ -1961,6 +2632,10 @@ nn_reorder_result_t nn_reorder_rsample (struct nn_rsample_chain *sc, struct nn_r
       if (reorder_try_append_and_discard (reorder, rsampleiv, min))
         reorder->max_sampleiv = NULL;
     }
+    else if (reorder->window_n > 0)
+    {
+      reorder_window_append_run (reorder, rsampleiv);
+    }
     reorder->next_seq = s->maxp1;
     *sc = rsampleiv->u.reorder.sc;
     (*refcount_adjust)++;
@@ -1982,6 +2657,10 @@ nn_reorder_result_t nn_reorder_rsample (struct nn_rsample_chain *sc, struct nn_r
     reorder->discarded_bytes += s->sc.first->sampleinfo->size;
     return NN_REORDER_TOO_OLD; /* don't want refcount increment */
   }
+  else if (reorder_window_usable (reorder, s->min))
+  {
+    return reorder_window_rsample (reorder, rsampleiv, refcount_adjust, delivery_queue_full_p);
+  }
   else if (ddsrt_avl_is_empty (&reorder->sampleivtree))
   {
     /* else, if nothing's stored simply add this one, max_samples = 0
@@ -2269,6 +2948,8 @@ nn_reorder_result_t nn_reorder_gap (struct nn_rsample_chain *sc, struct nn_reord
     TRACE (reorder, "  special mode => don't care\n");
     return NN_REORDER_REJECT;
   }
+  if (reorder->window_n > 0)
+    reorder_window_to_tree (reorder);
 
   /* Coalesce all intervals [m,n) with n >= min or m <= maxp1 */
   if ((coalesced = coalesce_intervals_touching_range (reorder, min, maxp1, &valuable)) == NULL)
@@ -2374,6 +3055,11 @@ int nn_reorder_wantsample (const struct nn_reorder *reorder, seqno_t seq)
   if (seq < reorder->next_seq)
     /* trivially not interesting */
     return 0;
+  if (reorder->window_n > 0)
+  {
+    /* tree is empty when the window is in use */
+    return (seq - reorder->next_seq >= (seqno_t) reorder->window_size || !reorder_window_isset (reorder, seq));
+  }
   /* Find interval that contains seq, if we know seq.  We are
      interested if seq is outside this interval (if any). */
   s = ddsrt_avl_lookup_pred_eq (&reorder_sampleivtree_treedef, &reorder->sampleivtree, &seq);
@@ -2419,9 +3105,26 @@ unsigned nn_reorder_nackmap (const struct nn_reorder *reorder, seqno_t base, seq
     map->numbits = (uint32_t) (maxseq + 1 - base);
   nn_bitset_zero (map->numbits, mapbits);
 
-  if ((iv = ddsrt_avl_find_min (&reorder_sampleivtree_treedef, &reorder->sampleivtree)) != NULL)
+  if (reorder->window_n > 0)
+  {
+    /* the window covers [next_seq, window_maxp1) and next_seq is never
+       in it; anything beyond it is the tail */
+    for (i = base; i < base + map->numbits && i < reorder->window_maxp1; i++)
+    {
+      if (i <= reorder->next_seq || !reorder_window_isset (reorder, i))
+        nn_bitset_set (map->numbits, mapbits, (unsigned) (i - base));
+    }
+    iv = NULL;
+  }
+  else if ((iv = ddsrt_avl_find_min (&reorder_sampleivtree_treedef, &reorder->sampleivtree)) != NULL)
+  {
     assert (iv->u.reorder.min > base);
-  i = base;
+    i = base;
+  }
+  else
+  {
+    i = base;
+  }
   while (iv && i < base + map->numbits)
   {
     for (; i < base + map->numbits && i < iv->u.reorder.min; i++)
@@ -2452,9 +3155,403 @@ seqno_t nn_reorder_next_seq (const struct nn_reorder *reorder)
 
 void nn_reorder_set_next_seq (struct nn_reorder *reorder, seqno_t seq)
 {
+  if (reorder->window_n > 0)
+    reorder_window_to_tree (reorder);
   reorder->next_seq = seq;
 }
 
+/* CATCHUP -------------------------------------------------------------
+
+   A shared alternative to the per-reader secondary reorder admins: one
+   instance per proxy writer storing the samples that are of interest
+   to at least one reader that is catching up, with each such reader
+   represented by a cursor holding the next sequence number it needs.
+   Accepting a sample then costs a lookup in the sample index and a
+   lookup in the cursor index, rather than an insert in every reader's
+   own reorder admin.
+
+   The samples are stored as singleton rsamples (duplicated using
+   nn_reorder_rsample_dup_first, exactly like for a secondary reorder
+   admin), each holding a single reference to its fragment chain.
+   Nothing is stored for gaps: a gap advances the cursors it covers
+   and is otherwise forgotten.  A gap addressed to a single reader
+   that doesn't cover that reader's cursor therefore gets dropped,
+   the reader will simply NACK the range again once it gets there.
+
+   Invariant: a cursor's next_seq is never the sequence number of a
+   stored sample, and all stored samples are >= the lowest cursor.
+   When the cursor at sequence number S advances, the samples S, S+1,
+   ... present in the index are appended to a chain for that cursor,
+   each element taking an additional reference to the fragment chain
+   so that the sample can also be delivered to the other cursors.
+   Because the chain elements are allocated from the rmsg currently
+   being processed, but the fragment chains may all be in other
+   rmsgs, each chain is terminated by a gap element referencing the
+   current rmsg to keep it alive until the chain has been processed.
+
+   Delivery is done by the caller, via a callback invoked for every
+   cursor that advanced once the admin is in a consistent state.  The
+   callback may remove the cursor it is invoked for (but no other).  */
+
+struct nn_catchup_cursor {
+  ddsrt_avl_node_t avlnode;
+  seqno_t next_seq;
+  void *arg;
+  struct nn_catchup_cursor *ready_next;
+  struct nn_rsample_chain sc;
+  nn_reorder_result_t rres;
+};
+
+struct nn_catchup {
+  ddsrt_avl_tree_t samples; /* singleton rsamples indexed on u.reorder.min */
+  ddsrt_avl_tree_t cursors;
+  uint32_t ncursors;
+  uint32_t max_samples;
+  uint32_t n_samples;
+  uint64_t discarded_bytes;
+  const struct ddsrt_log_cfg *logcfg;
+  bool trace;
+};
+
+struct catchup_run {
+  struct nn_rmsg *rmsg;
+  struct nn_rdata *keepalive; /* gap rdata terminating the chains */
+  int keepalive_refs;
+  struct nn_catchup_cursor *ready, **ready_tail;
+};
+
+static const ddsrt_avl_treedef_t catchup_cursors_treedef =
+  DDSRT_AVL_TREEDEF_INITIALIZER_ALLOWDUPS (offsetof (struct nn_catchup_cursor, avlnode), offsetof (struct nn_catchup_cursor, next_seq), compare_seqno, 0);
+
+struct nn_catchup *nn_catchup_new (const struct ddsrt_log_cfg *logcfg, uint32_t max_samples)
+{
+  struct nn_catchup *c;
+  if ((c = ddsrt_malloc (sizeof (*c))) == NULL)
+    return NULL;
+  ddsrt_avl_init (&reorder_sampleivtree_treedef, &c->samples);
+  ddsrt_avl_init (&catchup_cursors_treedef, &c->cursors);
+  c->ncursors = 0;
+  c->max_samples = max_samples;
+  c->n_samples = 0;
+  c->discarded_bytes = 0;
+  c->logcfg = logcfg;
+  c->trace = (logcfg->c.mask & DDS_LC_RADMIN) != 0;
+  return c;
+}
+
+static void catchup_delete_sample (struct nn_catchup *c, struct nn_rsample *s)
+{
+  ddsrt_avl_delete (&reorder_sampleivtree_treedef, &c->samples, s);
+  assert (c->n_samples > 0);
+  c->n_samples--;
+  nn_fragchain_unref (s->u.reorder.sc.first->fragchain);
+}
+
+void nn_catchup_free (struct nn_catchup *c)
+{
+  struct nn_rsample *s;
+  while ((s = ddsrt_avl_find_min (&reorder_sampleivtree_treedef, &c->samples)) != NULL)
+    catchup_delete_sample (c, s);
+  ddsrt_avl_free (&catchup_cursors_treedef, &c->cursors, ddsrt_free);
+  ddsrt_free (c);
+}
+
+static void catchup_trim (struct nn_catchup *c)
+{
+  /* samples below the lowest cursor will never be delivered, and if
+     there are too many, the highest ones are the least useful */
+  const struct nn_catchup_cursor *mincur = ddsrt_avl_find_min (&catchup_cursors_treedef, &c->cursors);
+  const seqno_t limit = mincur ? mincur->next_seq : MAX_SEQ_NUMBER;
+  struct nn_rsample *s;
+  while ((s = ddsrt_avl_find_min (&reorder_sampleivtree_treedef, &c->samples)) != NULL && s->u.reorder.min < limit)
+    catchup_delete_sample (c, s);
+  while (c->n_samples > c->max_samples)
+  {
+    s = ddsrt_avl_find_max (&reorder_sampleivtree_treedef, &c->samples);
+    TRACE (c, "  catchup: dropping #%"PRId64" to make room\n", s->u.reorder.min);
+    c->discarded_bytes += s->u.reorder.sc.first->sampleinfo->size;
+    catchup_delete_sample (c, s);
+  }
+}
+
+struct nn_catchup_cursor *nn_catchup_add_cursor (struct nn_catchup *c, void *arg)
+{
+  struct nn_catchup_cursor *cur;
+  if ((cur = ddsrt_malloc (sizeof (*cur))) == NULL)
+    return NULL;
+  /* like a fresh reorder admin; as nothing is stored below the lowest
+     cursor, nothing is stored at 1 either */
+  cur->next_seq = 1;
+  cur->arg = arg;
+  cur->ready_next = NULL;
+  cur->sc.first = cur->sc.last = NULL;
+  cur->rres = 0;
+  ddsrt_avl_insert (&catchup_cursors_treedef, &c->cursors, cur);
+  c->ncursors++;
+  return cur;
+}
+
+void nn_catchup_remove_cursor (struct nn_catchup *c, struct nn_catchup_cursor *cur)
+{
+  ddsrt_avl_delete (&catchup_cursors_treedef, &c->cursors, cur);
+  assert (c->ncursors > 0);
+  c->ncursors--;
+  ddsrt_free (cur);
+  catchup_trim (c);
+}
+
+seqno_t nn_catchup_cursor_next_seq (const struct nn_catchup_cursor *cur)
+{
+  return cur->next_seq;
+}
+
+seqno_t nn_catchup_min_next_seq (const struct nn_catchup *c)
+{
+  const struct nn_catchup_cursor *cur = ddsrt_avl_find_min (&catchup_cursors_treedef, &c->cursors);
+  return cur ? cur->next_seq : MAX_SEQ_NUMBER;
+}
+
+uint32_t nn_catchup_ncursors (const struct nn_catchup *c)
+{
+  return c->ncursors;
+}
+
+void nn_catchup_stats (const struct nn_catchup *c, uint64_t *discarded_bytes)
+{
+  *discarded_bytes = c->discarded_bytes;
+}
+
+static void fragchain_addref (struct nn_rdata *frag)
+{
+  /* The chain is already referenced by the sample index, so the rmsgs
+     can't disappear; they may be owned by another receive thread, but
+     a plain atomic increment is fine for committed and uncommitted
+     rmsgs alike */
+  while (frag)
+  {
+    ddsrt_atomic_inc32 (&frag->rmsg->refcount);
+    frag = frag->nextfrag;
+  }
+}
+
+static void catchup_advance (struct nn_catchup *c, struct catchup_run *run, struct nn_catchup_cursor *cur, seqno_t gap_min, seqno_t gap_maxp1)
+{
+  /* Moves the cursor past any samples present at its position and any
+     sequence numbers in [gap_min,gap_maxp1), building the chain of
+     samples to deliver.  The cursor must not be in the cursor index. */
+  struct nn_rsample_chain_elem *tail;
+  struct nn_rsample *s;
+  seqno_t pos = cur->next_seq;
+  if (run->keepalive == NULL && (run->keepalive = nn_rdata_newgap (run->rmsg)) == NULL)
+    return;
+  if ((tail = nn_rmsg_alloc (run->rmsg, sizeof (*tail))) == NULL)
+    return;
+  cur->sc.first = cur->sc.last = NULL;
+  cur->rres = 0;
+  s = ddsrt_avl_lookup_succ_eq (&reorder_sampleivtree_treedef, &c->samples, &pos);
+  while (1)
+  {
+    if (s && s->u.reorder.min == pos)
+    {
+      struct nn_rsample_chain_elem *sce;
+      if ((sce = nn_rmsg_alloc (run->rmsg, sizeof (*sce))) == NULL)
+        break;
+      *sce = *s->u.reorder.sc.first;
+      sce->next = NULL;
+      fragchain_addref (sce->fragchain);
+      if (cur->sc.first)
+        cur->sc.last->next = sce;
+      else
+        cur->sc.first = sce;
+      cur->sc.last = sce;
+      cur->rres++;
+      pos++;
+      s = ddsrt_avl_find_succ (&reorder_sampleivtree_treedef, &c->samples, s);
+    }
+    else if (gap_min <= pos && pos < gap_maxp1)
+    {
+      pos = (s && s->u.reorder.min < gap_maxp1) ? s->u.reorder.min : gap_maxp1;
+    }
+    else
+    {
+      break;
+    }
+  }
+  if (cur->rres > 0)
+  {
+    tail->fragchain = run->keepalive;
+    tail->sampleinfo = NULL;
+    tail->next = NULL;
+    cur->sc.last->next = tail;
+    cur->sc.last = tail;
+    cur->rres++;
+    run->keepalive_refs++;
+  }
+  TRACE (c, "  catchup: cursor %p #%"PRId64" -> #%"PRId64" (%"PRId32" elements)\n", (void *) cur, cur->next_seq, pos, cur->rres);
+  cur->next_seq = pos;
+  cur->ready_next = NULL;
+  *run->ready_tail = cur;
+  run->ready_tail = &cur->ready_next;
+}
+
+static void catchup_advance_range (struct nn_catchup *c, struct catchup_run *run, seqno_t lo, seqno_t hi, seqno_t gap_min, seqno_t gap_maxp1)
+{
+  /* Each cursor moves beyond hi, so the next one in [lo,hi) is always the
+     first one at or after lo */
+  struct nn_catchup_cursor *cur;
+  while ((cur = ddsrt_avl_lookup_succ_eq (&catchup_cursors_treedef, &c->cursors, &lo)) != NULL && cur->next_seq < hi)
+  {
+    const seqno_t seq0 = cur->next_seq;
+    ddsrt_avl_delete (&catchup_cursors_treedef, &c->cursors, cur);
+    catchup_advance (c, run, cur, gap_min, gap_maxp1);
+    ddsrt_avl_insert (&catchup_cursors_treedef, &c->cursors, cur);
+    if (cur->next_seq == seq0)
+      break; /* out of memory */
+  }
+}
+
+static void catchup_init_run (struct catchup_run *run, struct nn_rmsg *rmsg, struct nn_rdata *keepalive)
+{
+  run->rmsg = rmsg;
+  run->keepalive = keepalive;
+  run->keepalive_refs = 0;
+  run->ready = NULL;
+  run->ready_tail = &run->ready;
+}
+
+static void catchup_deliver (struct nn_catchup *c, struct catchup_run *run, nn_catchup_deliver_t deliver, void *deliver_arg)
+{
+  struct nn_catchup_cursor *cur, *next;
+  catchup_trim (c);
+  for (cur = run->ready; cur; cur = next)
+  {
+    struct nn_rsample_chain sc = cur->sc;
+    const nn_reorder_result_t rres = cur->rres;
+    next = cur->ready_next;
+    cur->sc.first = cur->sc.last = NULL;
+    cur->rres = 0;
+    deliver (cur->arg, &sc, rres, deliver_arg);
+  }
+}
+
+nn_reorder_result_t nn_catchup_rsample (struct nn_catchup *c, struct nn_rmsg *rmsg, struct nn_rsample *rsampleiv, int *refcount_adjust, int delivery_queue_full_p, nn_catchup_deliver_t deliver, void *deliver_arg)
+{
+  const struct nn_rsample_reorder *s = &rsampleiv->u.reorder;
+  const seqno_t seq = s->min;
+  const struct nn_catchup_cursor *cur;
+  const struct nn_rsample *max;
+  struct nn_rsample *dup;
+  struct catchup_run run;
+  bool deliverable;
+
+  /* rsampleiv may have become the head of a chain in the primary reorder admin,
+     only its first sample is of interest */
+  if (seq < nn_catchup_min_next_seq (c))
+  {
+    TRACE (c, "  catchup: #%"PRId64" too old\n", seq);
+    return NN_REORDER_TOO_OLD;
+  }
+  if (ddsrt_avl_lookup (&reorder_sampleivtree_treedef, &c->samples, &seq) != NULL)
+  {
+    TRACE (c, "  catchup: #%"PRId64" duplicate\n", seq);
+    return NN_REORDER_REJECT;
+  }
+  cur = ddsrt_avl_lookup_succ_eq (&catchup_cursors_treedef, &c->cursors, &seq);
+  deliverable = (cur != NULL && cur->next_seq == seq);
+  max = ddsrt_avl_find_max (&reorder_sampleivtree_treedef, &c->samples);
+  if ((delivery_queue_full_p && (deliverable || max == NULL || seq > max->u.reorder.min)) ||
+      (!deliverable && c->n_samples >= c->max_samples && (max == NULL || seq > max->u.reorder.min)))
+  {
+    /* same policy as a reorder admin: when the delivery queue is full
+       only fill holes, when the admin is full, prefer the lowest */
+    TRACE (c, "  catchup: discarding #%"PRId64"\n", seq);
+    c->discarded_bytes += s->sc.first->sampleinfo->size;
+    return NN_REORDER_REJECT;
+  }
+  if ((dup = nn_reorder_rsample_dup_first (rmsg, rsampleiv)) == NULL)
+    return NN_REORDER_REJECT;
+  ddsrt_avl_insert (&reorder_sampleivtree_treedef, &c->samples, dup);
+  c->n_samples++;
+  (*refcount_adjust)++;
+  catchup_init_run (&run, rmsg, NULL);
+  if (deliverable)
+    catchup_advance_range (c, &run, seq, seq + 1, 0, 0);
+  catchup_deliver (c, &run, deliver, deliver_arg);
+  if (run.keepalive)
+    nn_fragchain_adjust_refcount (run.keepalive, run.keepalive_refs);
+  return NN_REORDER_ACCEPT;
+}
+
+uint32_t nn_catchup_gap (struct nn_catchup *c, struct nn_rdata *rdata, seqno_t min, seqno_t maxp1, int *refcount_adjust, nn_catchup_deliver_t deliver, void *deliver_arg)
+{
+  struct catchup_run run;
+  uint32_t n = 0;
+  catchup_init_run (&run, rdata->rmsg, rdata);
+  catchup_advance_range (c, &run, min, maxp1, min, maxp1);
+  for (const struct nn_catchup_cursor *cur = run.ready; cur; cur = cur->ready_next)
+    n++;
+  catchup_deliver (c, &run, deliver, deliver_arg);
+  *refcount_adjust += run.keepalive_refs;
+  return n;
+}
+
+nn_reorder_result_t nn_catchup_cursor_gap (struct nn_catchup *c, struct nn_catchup_cursor *cur, struct nn_rdata *rdata, seqno_t min, seqno_t maxp1, int *refcount_adjust, nn_catchup_deliver_t deliver, void *deliver_arg)
+{
+  struct catchup_run run;
+  if (maxp1 <= cur->next_seq)
+    return NN_REORDER_TOO_OLD;
+  else if (min > cur->next_seq)
+    return NN_REORDER_REJECT;
+  catchup_init_run (&run, rdata->rmsg, rdata);
+  ddsrt_avl_delete (&catchup_cursors_treedef, &c->cursors, cur);
+  catchup_advance (c, &run, cur, min, maxp1);
+  ddsrt_avl_insert (&catchup_cursors_treedef, &c->cursors, cur);
+  catchup_deliver (c, &run, deliver, deliver_arg);
+  *refcount_adjust += run.keepalive_refs;
+  return NN_REORDER_ACCEPT;
+}
+
+int nn_catchup_wantsample (const struct nn_catchup *c, const struct nn_catchup_cursor *cur, seqno_t seq)
+{
+  return seq >= cur->next_seq && ddsrt_avl_lookup (&reorder_sampleivtree_treedef, &c->samples, &seq) == NULL;
+}
+
+unsigned nn_catchup_nackmap (const struct nn_catchup *c, const struct nn_catchup_cursor *cur, seqno_t maxseq, struct nn_sequence_number_set_header *map, uint32_t *mapbits, uint32_t maxsz, int notail)
+{
+  /* Same as nn_reorder_nackmap with base = next_seq of the cursor */
+  const seqno_t base = cur->next_seq;
+  const struct nn_rsample *s;
+  seqno_t i;
+  assert (maxsz <= 256);
+  if (maxsz > c->max_samples)
+    maxsz = c->max_samples;
+  if (maxseq + 1 < base)
+    maxseq = base - 1;
+  map->bitmap_base = toSN (base);
+  if (maxseq + 1 - base > maxsz)
+    map->numbits = maxsz;
+  else
+    map->numbits = (uint32_t) (maxseq + 1 - base);
+  nn_bitset_zero (map->numbits, mapbits);
+  i = base;
+  s = ddsrt_avl_lookup_succ_eq (&reorder_sampleivtree_treedef, &c->samples, &base);
+  while (s && i < base + map->numbits)
+  {
+    for (; i < base + map->numbits && i < s->u.reorder.min; i++)
+      nn_bitset_set (map->numbits, mapbits, (unsigned) (i - base));
+    i = s->u.reorder.maxp1;
+    s = ddsrt_avl_find_succ (&reorder_sampleivtree_treedef, &c->samples, s);
+  }
+  if (notail && i < base + map->numbits)
+    map->numbits = (unsigned) (i - base);
+  else
+  {
+    for (; i < base + map->numbits; i++)
+      nn_bitset_set (map->numbits, mapbits, (unsigned) (i - base));
+  }
+  return map->numbits;
+}
+
 /* DQUEUE -------------------------------------------------------------- */
 
 struct nn_dqueue {
@@ -2469,6 +3566,7 @@ struct nn_dqueue {
   char *name;
   uint32_t max_samples;
   ddsrt_atomic_uint32_t nof_samples;
+  bool timestamp_samples; /* for Internal/MeasureReceiveLatency */
 };
 
 enum dqueue_elem_kind {
@@ -2619,6 +3717,7 @@ struct nn_dqueue *nn_dqueue_new (const char *name, const struct ddsi_domaingv *g
   q->handler = handler;
   q->handler_arg = arg;
   q->sc.first = q->sc.last = NULL;
+  q->timestamp_samples = gv->config.meas_receive_latency;
 
   ddsrt_mutex_init (&q->lock);
   ddsrt_cond_init (&q->cond);
@@ -2644,6 +3743,19 @@ struct nn_dqueue *nn_dqueue_new (const char *name, const struct ddsi_domaingv *g
   return NULL;
 }
 
+static void nn_dqueue_timestamp_samples (struct nn_rsample_chain *sc)
+{
+  /* Only the first time a sample is queued counts: the same sample info
+     may be queued again later for another reader, and it may concurrently
+     be in use by the delivery thread */
+  const ddsrt_wctime_t tnow = ddsrt_time_wallclock ();
+  for (struct nn_rsample_chain_elem *e = sc->first; e; e = e->next)
+  {
+    if (e->sampleinfo && e->sampleinfo->enqueue_timestamp.v == 0)
+      e->sampleinfo->enqueue_timestamp = tnow;
+  }
+}
+
 static int nn_dqueue_enqueue_locked (struct nn_dqueue *q, struct nn_rsample_chain *sc)
 {
   int must_signal;
@@ -2667,6 +3779,8 @@ bool nn_dqueue_enqueue_deferred_wakeup (struct nn_dqueue *q, struct nn_rsample_c
   assert (rres > 0);
   assert (sc->first);
   assert (sc->last->next == NULL);
+  if (q->timestamp_samples)
+    nn_dqueue_timestamp_samples (sc);
   ddsrt_mutex_lock (&q->lock);
   ddsrt_atomic_add32 (&q->nof_samples, (uint32_t) rres);
   signal = nn_dqueue_enqueue_locked (q, sc);
@@ -2686,6 +3800,8 @@ void nn_dqueue_enqueue (struct nn_dqueue *q, struct nn_rsample_chain *sc, nn_reo
   assert (rres > 0);
   assert (sc->first);
   assert (sc->last->next == NULL);
+  if (q->timestamp_samples)
+    nn_dqueue_timestamp_samples (sc);
   ddsrt_mutex_lock (&q->lock);
   ddsrt_atomic_add32 (&q->nof_samples, (uint32_t) rres);
   if (nn_dqueue_enqueue_locked (q, sc))
@@ -2735,6 +3851,8 @@ void nn_dqueue_enqueue1 (struct nn_dqueue *q, const ddsi_guid_t *rdguid, struct
   assert (rdguid != NULL);
   assert (sc->first);
   assert (sc->last->next == NULL);
+  if (q->timestamp_samples)
+    nn_dqueue_timestamp_samples (sc);
   ddsrt_mutex_lock (&q->lock);
   ddsrt_atomic_add32 (&q->nof_samples, 1 + (uint32_t) rres);
   if (nn_dqueue_enqueue_bubble_locked (q, b))
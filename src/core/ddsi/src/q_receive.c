@@ -56,6 +56,9 @@
 #include "dds/ddsi/ddsi_serdata_default.h" /* FIXME: get rid of this */
 #include "dds/ddsi/ddsi_security_omg.h"
 #include "dds/ddsi/ddsi_acknack.h"
+#include "dds/ddsi/ddsi_fec.h"
+#include "dds/ddsi/ddsi_statistics.h"
+#include "dds/ddsi/ddsi_uring.h"
 
 #include "dds/ddsi/sysdeps.h"
 #include "dds__whc.h"
@@ -79,6 +82,22 @@ Notes:
 
 static void deliver_user_data_synchronously (struct nn_rsample_chain *sc, const ddsi_guid_t *rdguid);
 
+static seqno_t out_of_sync_next_seq (const struct pwr_rd_match *wn)
+{
+  if (wn->u.not_in_sync.cursor)
+    return nn_catchup_cursor_next_seq (wn->u.not_in_sync.cursor);
+  else
+    return nn_reorder_next_seq (wn->u.not_in_sync.reorder);
+}
+
+static int out_of_sync_wantsample (const struct proxy_writer *pwr, const struct pwr_rd_match *wn, seqno_t seq)
+{
+  if (wn->u.not_in_sync.cursor)
+    return nn_catchup_wantsample (pwr->catchup, wn->u.not_in_sync.cursor, seq);
+  else
+    return nn_reorder_wantsample (wn->u.not_in_sync.reorder, seq);
+}
+
 static void maybe_set_reader_in_sync (struct proxy_writer *pwr, struct pwr_rd_match *wn, seqno_t last_deliv_seq)
 {
   switch (wn->in_sync)
@@ -90,6 +109,11 @@ static void maybe_set_reader_in_sync (struct proxy_writer *pwr, struct pwr_rd_ma
       if (last_deliv_seq >= wn->u.not_in_sync.end_of_tl_seq)
       {
         wn->in_sync = PRMSS_SYNC;
+        if (wn->u.not_in_sync.cursor)
+        {
+          nn_catchup_remove_cursor (pwr->catchup, wn->u.not_in_sync.cursor);
+          wn->u.not_in_sync.cursor = NULL;
+        }
         if (--pwr->n_readers_out_of_sync == 0)
           local_reader_ary_setfastpath_ok (&pwr->rdary, true);
       }
@@ -97,7 +121,7 @@ static void maybe_set_reader_in_sync (struct proxy_writer *pwr, struct pwr_rd_ma
     case PRMSS_OUT_OF_SYNC:
       if (!wn->filtered)
       {
-        if (pwr->have_seen_heartbeat && nn_reorder_next_seq (wn->u.not_in_sync.reorder) == nn_reorder_next_seq (pwr->reorder))
+        if (pwr->have_seen_heartbeat && out_of_sync_next_seq (wn) == nn_reorder_next_seq (pwr->reorder))
         {
           ETRACE (pwr, " msr_in_sync("PGUIDFMT" out-of-sync to tlcatchup)", PGUID (wn->rd_guid));
           wn->in_sync = PRMSS_TLCATCHUP;
@@ -108,6 +132,35 @@ static void maybe_set_reader_in_sync (struct proxy_writer *pwr, struct pwr_rd_ma
   }
 }
 
+struct catchup_deliver_arg {
+  struct proxy_writer *pwr;
+  struct nn_dqueue **deferred_wakeup;
+};
+
+static void catchup_deliver (void *vwn, struct nn_rsample_chain *sc, nn_reorder_result_t rres, void *varg)
+{
+  /* Delivery to an out-of-sync reader served from pwr->catchup, see the
+     out-of-sync readers in handle_regular for the details */
+  struct pwr_rd_match * const wn = vwn;
+  struct catchup_deliver_arg const * const arg = varg;
+  struct proxy_writer * const pwr = arg->pwr;
+  if (rres > 0)
+  {
+    if (pwr->deliver_synchronously)
+      deliver_user_data_synchronously (sc, &wn->rd_guid);
+    else
+    {
+      if (arg->deferred_wakeup && *arg->deferred_wakeup && *arg->deferred_wakeup != pwr->dqueue)
+      {
+        dd_dqueue_enqueue_trigger (*arg->deferred_wakeup);
+        *arg->deferred_wakeup = NULL;
+      }
+      nn_dqueue_enqueue1 (pwr->dqueue, &wn->rd_guid, sc, rres);
+    }
+  }
+  maybe_set_reader_in_sync (pwr, wn, nn_catchup_cursor_next_seq (wn->u.not_in_sync.cursor) - 1);
+}
+
 static int valid_sequence_number_set (const nn_sequence_number_set_header_t *snset)
 {
   return (fromSN (snset->bitmap_base) > 0 && snset->numbits <= 256);
@@ -279,6 +332,36 @@ static int valid_NackFrag (NackFrag_t *msg, size_t size, int byteswap)
   return 1;
 }
 
+static int valid_FecParity (FecParity_t *msg, size_t size, int byteswap)
+{
+  if (size < offsetof (FecParity_t, members))
+    return 0;
+  if (byteswap)
+  {
+    msg->groupSize = ddsrt_bswap2u (msg->groupSize);
+    msg->paritySize = ddsrt_bswap4u (msg->paritySize);
+  }
+  msg->writerId = nn_ntoh_entityid (msg->writerId);
+  if (msg->groupSize == 0 || msg->paritySize > size || size < FEC_PARITY_SIZE ((size_t) msg->groupSize, msg->paritySize))
+    return 0;
+  for (uint16_t i = 0; i < msg->groupSize; i++)
+  {
+    FecMember_t * const m = &msg->members[i];
+    if (byteswap)
+    {
+      bswapSN (&m->writerSN);
+      m->fragmentStartingNum = ddsrt_bswap4u (m->fragmentStartingNum);
+      m->length = ddsrt_bswap4u (m->length);
+      m->checksum = ddsrt_bswap4u (m->checksum);
+      m->timestamp.seconds = ddsrt_bswap4 (m->timestamp.seconds);
+      m->timestamp.fraction = ddsrt_bswap4u (m->timestamp.fraction);
+    }
+    if (m->length < sizeof (Data_t) || m->length > msg->paritySize || fromSN (m->writerSN) <= 0)
+      return 0;
+  }
+  return 1;
+}
+
 static void set_sampleinfo_proxy_writer (struct nn_rsample_info *sampleinfo, ddsi_guid_t *pwr_guid)
 {
   struct proxy_writer * pwr = entidx_lookup_proxy_writer_guid (sampleinfo->rst->gv->entity_index, pwr_guid);
@@ -728,6 +811,7 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
   uint32_t msgs_sent, msgs_lost;
   seqno_t max_seq_in_reply;
   struct whc_node *deferred_free_list = NULL;
+  uint32_t n_dropped = 0;
   struct whc_state whcst;
   int hb_sent_in_response = 0;
   countp = (nn_count_t *) ((char *) msg + offsetof (AckNack_t, bits) + NN_SEQUENCE_NUMBER_SET_BITS_SIZE (msg->readerSNState.numbits));
@@ -825,6 +909,8 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
       rn->hb_to_ack_latency_tlastlog = tstamp_now;
     }
   }
+  if (rst->gv->config.hb_intv_adaptive && !is_preemptive_ack)
+    writer_hbcontrol_note_acknack (wr, rn, ddsrt_time_monotonic ());
 
   /* First, the ACK part: if the AckNack advances the highest sequence
      number ack'd by the remote reader, update state & try dropping
@@ -832,7 +918,6 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
   if (seqbase - 1 > rn->seq)
   {
     int64_t n_ack = (seqbase - 1) - rn->seq;
-    unsigned n;
     rn->seq = seqbase - 1;
     if (rn->seq > wr->seq) {
       /* Prevent a reader from ACKing future samples (is only malicious because we require
@@ -840,8 +925,8 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
       rn->seq = wr->seq;
     }
     ddsrt_avl_augment_update (&wr_readers_treedef, rn);
-    n = remove_acked_messages (wr, &whcst, &deferred_free_list);
-    RSTTRACE (" ACK%"PRId64" RM%u", n_ack, n);
+    n_dropped = remove_acked_messages (wr, &whcst, &deferred_free_list);
+    RSTTRACE (" ACK%"PRId64" RM%"PRIu32, n_ack, n_dropped);
   }
   else
   {
@@ -969,7 +1054,10 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
         if (!wr->retransmitting && sample.unacked)
           writer_set_retransmitting (wr);
 
-        if (rst->gv->config.retransmit_merging != DDSI_REXMIT_MERGE_NEVER && rn->assumed_in_sync && !prd->filter)
+        /* Merged retransmits go to all readers, which is not allowed if any of
+           them has a content filter that may reject the sample */
+        if (rst->gv->config.retransmit_merging != DDSI_REXMIT_MERGE_NEVER && rn->assumed_in_sync && !prd->filter &&
+            ddsrt_atomic_ld32 (&wr->num_readers_content_filtered) == 0)
         {
           /* send retransmit to all receivers, but skip if recently done */
           ddsrt_mtime_t tstamp = ddsrt_time_monotonic ();
@@ -1080,7 +1168,7 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
   RSTTRACE (")");
  out:
   ddsrt_mutex_unlock (&wr->e.lock);
-  whc_free_deferred_free_list (wr->whc, deferred_free_list);
+  writer_free_deferred_free_list (wr, deferred_free_list, n_dropped);
   return 1;
 }
 
@@ -1168,7 +1256,7 @@ static void handle_Heartbeat_helper (struct pwr_rd_match * const wn, struct hand
     if (wn->in_sync != PRMSS_OUT_OF_SYNC && !wn->filtered)
       refseq = nn_reorder_next_seq (pwr->reorder);
     else
-      refseq = nn_reorder_next_seq (wn->u.not_in_sync.reorder);
+      refseq = out_of_sync_next_seq (wn);
     RSTTRACE (" "PGUIDFMT"@%"PRId64"%s", PGUID (wn->rd_guid), refseq - 1, (wn->in_sync == PRMSS_SYNC) ? "(sync)" : (wn->in_sync == PRMSS_TLCATCHUP) ? "(tlcatchup)" : "");
   }
 
@@ -1316,6 +1404,11 @@ static int handle_Heartbeat (struct receiver_state *rst, ddsrt_etime_t tnow, str
         else
           nn_dqueue_enqueue (pwr->dqueue, &sc, res);
       }
+      if (pwr->catchup)
+      {
+        struct catchup_deliver_arg cdarg = { .pwr = pwr, .deferred_wakeup = NULL };
+        (void) nn_catchup_gap (pwr->catchup, gap, 1, firstseq, &refc_adjust, catchup_deliver, &cdarg);
+      }
       for (wn = ddsrt_avl_find_min (&pwr_readers_treedef, &pwr->readers); wn; wn = ddsrt_avl_find_succ (&pwr_readers_treedef, &pwr->readers, wn))
       {
         if (wn->in_sync != PRMSS_SYNC)
@@ -1330,15 +1423,16 @@ static int handle_Heartbeat (struct receiver_state *rst, ddsrt_etime_t tnow, str
               last_deliv_seq = nn_reorder_next_seq (pwr->reorder) - 1;
               break;
             case PRMSS_OUT_OF_SYNC: {
+              /* readers with a cursor have already been dealt with above */
               struct nn_reorder *ro = wn->u.not_in_sync.reorder;
-              if ((res = nn_reorder_gap (&sc, ro, gap, 1, firstseq, &refc_adjust)) > 0)
+              if (ro && (res = nn_reorder_gap (&sc, ro, gap, 1, firstseq, &refc_adjust)) > 0)
               {
                 if (pwr->deliver_synchronously)
                   deliver_user_data_synchronously (&sc, &wn->rd_guid);
                 else
                   nn_dqueue_enqueue1 (pwr->dqueue, &wn->rd_guid, &sc, res);
               }
-              last_deliv_seq = nn_reorder_next_seq (wn->u.not_in_sync.reorder) - 1;
+              last_deliv_seq = out_of_sync_next_seq (wn) - 1;
             }
           }
           if (wn->u.not_in_sync.end_of_tl_seq == MAX_SEQ_NUMBER)
@@ -1466,7 +1560,7 @@ static int handle_HeartbeatFrag (struct receiver_state *rst, UNUSED_ARG(ddsrt_et
       if (directed_heartbeat)
       {
         m = ddsrt_avl_lookup (&pwr_readers_treedef, &pwr->readers, &dst);
-        if (m && !(m->in_sync == PRMSS_OUT_OF_SYNC && m->acknack_xevent != NULL && nn_reorder_wantsample (m->u.not_in_sync.reorder, seq)))
+        if (m && !(m->in_sync == PRMSS_OUT_OF_SYNC && m->acknack_xevent != NULL && out_of_sync_wantsample (pwr, m, seq)))
         {
           /* Ignore if reader is happy or not best-effort */
           m = NULL;
@@ -1479,7 +1573,7 @@ static int handle_HeartbeatFrag (struct receiver_state *rst, UNUSED_ARG(ddsrt_et
         m = ddsrt_avl_find_min (&pwr_readers_treedef, &pwr->readers);
         while (m)
         {
-          if (m->in_sync == PRMSS_OUT_OF_SYNC && m->acknack_xevent != NULL && nn_reorder_wantsample (m->u.not_in_sync.reorder, seq))
+          if (m->in_sync == PRMSS_OUT_OF_SYNC && m->acknack_xevent != NULL && out_of_sync_wantsample (pwr, m, seq))
           {
             /* If reader is out-of-sync, and reader is realiable, and
              reader still wants this particular sample, then use this
@@ -1605,7 +1699,7 @@ static int handle_NackFrag (struct receiver_state *rst, ddsrt_etime_t tnow, cons
         struct nn_xmsg *reply;
         if (create_fragment_message (wr, seq, sample.plist, sample.serdata, base + i, 1, prd, &reply, 0, 0) < 0)
           nfrags_lim = 0;
-        else if (!qxev_msg_rexmit_wrlock_held (wr->evq, reply, 0))
+        else if (!qxev_msg_rexmit_wrlock_held (wr->evq, reply, 0, prd))
           nfrags_lim = 0;
         else
         {
@@ -1699,6 +1793,109 @@ static int handle_InfoTS (const struct receiver_state *rst, const InfoTS_t *msg,
   return 1;
 }
 
+struct fec_recovered {
+  struct fec_recovered *next;
+  ddsi_guid_prefix_t src_prefix;
+  uint32_t size;
+  /* followed by a complete RTPS message of "size" bytes */
+};
+
+static struct fec_recovered *fec_recover (const struct receiver_state *rst, const Header_t *hdr, struct proxy_writer *pwr, const FecParity_t *msg, uint32_t idx)
+{
+  /* Reconstructs the missing submessage as an RTPS message of its own, so
+     that it can be processed exactly as if it had been received */
+  const size_t maxsz = rst->gv->config.rmsg_chunk_size < 65536 ? rst->gv->config.rmsg_chunk_size : 65536;
+  const FecMember_t * const m = &msg->members[idx];
+  const bool have_ts = ddsi_is_valid_timestamp (m->timestamp);
+  const size_t size = RTPS_MESSAGE_HEADER_SIZE + (have_ts ? sizeof (InfoTS_t) : 0) + m->length;
+  struct fec_recovered *r;
+  unsigned char *p;
+  if (size > maxsz)
+    return NULL;
+  r = ddsrt_malloc (sizeof (*r) + size);
+  p = (unsigned char *) (r + 1);
+  memcpy (p, hdr, RTPS_MESSAGE_HEADER_SIZE);
+  p += RTPS_MESSAGE_HEADER_SIZE;
+  if (have_ts)
+  {
+    InfoTS_t ts;
+    ts.smhdr.submessageId = SMID_INFO_TS;
+    ts.smhdr.flags = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN ? SMFLAG_ENDIANNESS : 0);
+    ts.smhdr.octetsToNextHeader = sizeof (ts.time);
+    ts.time = m->timestamp;
+    memcpy (p, &ts, sizeof (ts));
+    p += sizeof (ts);
+  }
+  if (!ddsi_fec_decoder_recover (pwr->fec, msg, idx, p))
+  {
+    ddsrt_free (r);
+    return NULL;
+  }
+  r->next = NULL;
+  r->src_prefix = rst->src_guid_prefix;
+  r->size = (uint32_t) size;
+  return r;
+}
+
+static void handle_FecParity (struct receiver_state *rst, const Header_t *hdr, const FecParity_t *msg, struct fec_recovered **recovered)
+{
+  struct ddsi_domaingv * const gv = rst->gv;
+  struct proxy_writer *pwr;
+  ddsi_guid_t pwr_guid;
+  uint32_t idx;
+
+  pwr_guid.prefix = rst->src_guid_prefix;
+  pwr_guid.entityid = msg->writerId;
+  RSTTRACE ("FEC("PGUIDFMT" #%"PRId64"..#%"PRId64" n %"PRIu16, PGUID (pwr_guid),
+            fromSN (msg->members[0].writerSN), fromSN (msg->members[msg->groupSize - 1].writerSN), msg->groupSize);
+  if (recovered == NULL || rst->rtps_encoded)
+  {
+    RSTTRACE (" ignored)");
+    return;
+  }
+  if ((pwr = entidx_lookup_proxy_writer_guid (gv->entity_index, &pwr_guid)) == NULL)
+  {
+    RSTTRACE (" "PGUIDFMT"?)", PGUID (pwr_guid));
+    return;
+  }
+  if (q_omg_proxy_participant_is_secure (pwr->c.proxypp))
+  {
+    RSTTRACE (" secure)");
+    return;
+  }
+
+  ddsrt_mutex_lock (&pwr->e.lock);
+  if (pwr->fec == NULL)
+  {
+    /* Only from now on will the data be cached, so this group is a lost cause */
+    pwr->fec = ddsi_fec_decoder_new ();
+    RSTTRACE (" start");
+  }
+  else if ((idx = ddsi_fec_decoder_missing (pwr->fec, msg)) == UINT32_MAX)
+  {
+    /* nothing or too much missing */
+  }
+  else if (!nn_reorder_wantsample (pwr->reorder, fromSN (msg->members[idx].writerSN)))
+  {
+    RSTTRACE (" have #%"PRId64, fromSN (msg->members[idx].writerSN));
+  }
+  else
+  {
+    struct fec_recovered *r;
+    if ((r = fec_recover (rst, hdr, pwr, msg, idx)) == NULL)
+      RSTTRACE (" recovery of #%"PRId64"/%"PRIu32" failed", fromSN (msg->members[idx].writerSN), msg->members[idx].fragmentStartingNum);
+    else
+    {
+      RSTTRACE (" recovered #%"PRId64"/%"PRIu32, fromSN (msg->members[idx].writerSN), msg->members[idx].fragmentStartingNum);
+      while (*recovered)
+        recovered = &(*recovered)->next;
+      *recovered = r;
+    }
+  }
+  ddsrt_mutex_unlock (&pwr->e.lock);
+  RSTTRACE (")");
+}
+
 static int handle_one_gap (struct proxy_writer *pwr, struct pwr_rd_match *wn, seqno_t a, seqno_t b, struct nn_rdata *gap, int *refc_adjust)
 {
   struct nn_rsample_chain sc;
@@ -1745,7 +1942,12 @@ static int handle_one_gap (struct proxy_writer *pwr, struct pwr_rd_match *wn, se
       case PRMSS_TLCATCHUP:
         break;
       case PRMSS_OUT_OF_SYNC:
-        if ((res = nn_reorder_gap (&sc, wn->u.not_in_sync.reorder, gap, a, b, refc_adjust)) > 0)
+        if (wn->u.not_in_sync.cursor)
+        {
+          struct catchup_deliver_arg cdarg = { .pwr = pwr, .deferred_wakeup = NULL };
+          res = nn_catchup_cursor_gap (pwr->catchup, wn->u.not_in_sync.cursor, gap, a, b, refc_adjust, catchup_deliver, &cdarg);
+        }
+        else if ((res = nn_reorder_gap (&sc, wn->u.not_in_sync.reorder, gap, a, b, refc_adjust)) > 0)
         {
           if (pwr->deliver_synchronously)
             deliver_user_data_synchronously (&sc, &wn->rd_guid);
@@ -1760,8 +1962,10 @@ static int handle_one_gap (struct proxy_writer *pwr, struct pwr_rd_match *wn, se
     /* Upon receipt of data a reader can only become in-sync if there
        is something to deliver; for missing data, you just don't know.
        The return value of reorder_gap _is_ sufficiently precise, but
-       why not simply check?  It isn't a very expensive test. */
-    maybe_set_reader_in_sync (pwr, wn, b-1);
+       why not simply check?  It isn't a very expensive test.  (Delivery from
+       the shared admin may already have made it in-sync.) */
+    if (wn->in_sync != PRMSS_SYNC)
+      maybe_set_reader_in_sync (pwr, wn, b-1);
   }
 
   return gap_was_valuable;
@@ -2098,6 +2302,20 @@ static dds_return_t remote_on_delivery_failure_fastpath (struct entity_common *s
   return DDS_RETCODE_TRY_AGAIN;
 }
 
+static void record_receive_latency (struct ddsi_latency_hist *hist, const struct nn_rsample_info *sampleinfo, const struct nn_rmsg *rmsg, ddsrt_wctime_t tdequeue)
+{
+  /* Samples delivered synchronously never got enqueued, those spent no time
+     in a delivery queue */
+  const ddsrt_wctime_t tstored = ddsrt_time_wallclock ();
+  const ddsrt_wctime_t tenqueue = sampleinfo->enqueue_timestamp.v ? sampleinfo->enqueue_timestamp : tdequeue;
+  if (rmsg->timestamp.v)
+    ddsi_latency_hist_add (hist, DDSI_LATENCY_KERNEL, sampleinfo->reception_timestamp.v - rmsg->timestamp.v);
+  ddsi_latency_hist_add (hist, DDSI_LATENCY_RECEIVE, tenqueue.v - sampleinfo->reception_timestamp.v);
+  if (sampleinfo->enqueue_timestamp.v)
+    ddsi_latency_hist_add (hist, DDSI_LATENCY_DQUEUE, tdequeue.v - tenqueue.v);
+  ddsi_latency_hist_add (hist, DDSI_LATENCY_RHC, tstored.v - tdequeue.v);
+}
+
 static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, const ddsi_guid_t *rdguid, int pwr_locked)
 {
   static const struct deliver_locally_ops deliver_locally_ops = {
@@ -2121,6 +2339,29 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
     return 0;
   }
 
+  /* Samples pass through here with rdguid = NULL for delivery to the in-sync
+     readers (even if there are none), and once per reader that is still
+     catching up; only the ones actually delivered to some reader count */
+  ddsrt_wctime_t tdequeue = { 0 };
+  bool meas_latency = false;
+  if (pwr->latency_hist != NULL)
+  {
+    if (rdguid != NULL)
+      meas_latency = true;
+    else
+    {
+      if (!pwr_locked)
+        ddsrt_mutex_lock (&pwr->e.lock);
+      ddsrt_mutex_lock (&pwr->rdary.rdary_lock);
+      meas_latency = (pwr->rdary.n_readers > (uint32_t) pwr->n_readers_out_of_sync);
+      ddsrt_mutex_unlock (&pwr->rdary.rdary_lock);
+      if (!pwr_locked)
+        ddsrt_mutex_unlock (&pwr->e.lock);
+    }
+    if (meas_latency)
+      tdequeue = ddsrt_time_wallclock ();
+  }
+
   /* FIXME: fragments are now handled by copying the message to
      freshly malloced memory (see defragment()) ... that'll have to
      change eventually */
@@ -2193,6 +2434,8 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
     ddsrt_atomic_st32 (&pwr->next_deliv_seq_lowword, (uint32_t) (sampleinfo->seq + 1));
   }
 
+  if (meas_latency)
+    record_receive_latency (pwr->latency_hist, sampleinfo, fragchain->rmsg, tdequeue);
   ddsi_plist_fini (&qos);
   return 0;
 }
@@ -2225,12 +2468,19 @@ static void deliver_user_data_synchronously (struct nn_rsample_chain *sc, const
 static void clean_defrag (struct proxy_writer *pwr)
 {
   seqno_t seq = nn_reorder_next_seq (pwr->reorder);
-  if (pwr->n_readers_out_of_sync > 0)
+  uint32_t ncursors = 0;
+  if (pwr->catchup && (ncursors = nn_catchup_ncursors (pwr->catchup)) > 0)
+  {
+    seqno_t seq1 = nn_catchup_min_next_seq (pwr->catchup);
+    if (seq1 < seq)
+      seq = seq1;
+  }
+  if (pwr->n_readers_out_of_sync > (int32_t) ncursors)
   {
     struct pwr_rd_match *wn;
     for (wn = ddsrt_avl_find_min (&pwr_readers_treedef, &pwr->readers); wn != NULL; wn = ddsrt_avl_find_succ (&pwr_readers_treedef, &pwr->readers, wn))
     {
-      if (wn->in_sync == PRMSS_OUT_OF_SYNC)
+      if (wn->in_sync == PRMSS_OUT_OF_SYNC && wn->u.not_in_sync.cursor == NULL)
       {
         seqno_t seq1 = nn_reorder_next_seq (wn->u.not_in_sync.reorder);
         if (seq1 < seq)
@@ -2241,7 +2491,7 @@ static void clean_defrag (struct proxy_writer *pwr)
   nn_defrag_notegap (pwr->defrag, 1, seq);
 }
 
-static void handle_regular (struct receiver_state *rst, ddsrt_etime_t tnow, struct nn_rmsg *rmsg, const Data_DataFrag_common_t *msg, const struct nn_rsample_info *sampleinfo,
+static void handle_regular (struct receiver_state *rst, ddsrt_etime_t tnow, struct nn_rmsg *rmsg, const Data_DataFrag_common_t *msg, size_t size, const struct nn_rsample_info *sampleinfo,
     uint32_t max_fragnum_in_msg, struct nn_rdata *rdata, struct nn_dqueue **deferred_wakeup, bool renew_manbypp_lease)
 {
   struct proxy_writer *pwr;
@@ -2277,6 +2527,12 @@ static void handle_regular (struct receiver_state *rst, ddsrt_etime_t tnow, stru
   /* Shouldn't lock the full writer, but will do so for now */
   ddsrt_mutex_lock (&pwr->e.lock);
 
+  /* Reconstructing lost data requires a copy of the other members of the FEC
+     group, which covers only data sent to all readers, whether or not this
+     data is accepted below */
+  if (pwr->fec && msg->readerId.u == NN_ENTITYID_UNKNOWN && !rst->rtps_encoded)
+    ddsi_fec_decoder_note (pwr->fec, (const unsigned char *) msg, (uint32_t) size);
+
   /* A change in transition from not-alive to alive is relatively complicated
      and may involve temporarily unlocking the proxy writer during the process
      (to avoid unnecessarily holding pwr->e.lock while invoking listeners on
@@ -2405,7 +2661,16 @@ static void handle_regular (struct receiver_state *rst, ddsrt_etime_t tnow, stru
         }
       }
 
-      if (pwr->n_readers_out_of_sync > 0)
+      if (pwr->catchup && nn_catchup_ncursors (pwr->catchup) > 0)
+      {
+        /* Out-of-sync readers sharing the proxy writer's secondary admin:
+           one insert regardless of the number of readers, delivery (and
+           the transition to in-sync) is done by catchup_deliver */
+        struct catchup_deliver_arg cdarg = { .pwr = pwr, .deferred_wakeup = deferred_wakeup };
+        (void) nn_catchup_rsample (pwr->catchup, rmsg, rsample, &refc_adjust, nn_dqueue_is_full (pwr->dqueue), catchup_deliver, &cdarg);
+      }
+
+      if (pwr->n_readers_out_of_sync > (pwr->catchup ? (int32_t) nn_catchup_ncursors (pwr->catchup) : 0))
       {
         /* Those readers catching up with TL but in sync with the proxy
            writer may have become in sync with the proxy writer and the
@@ -2416,7 +2681,7 @@ static void handle_regular (struct receiver_state *rst, ddsrt_etime_t tnow, stru
         int reuse_rsample_dup = 0;
         for (wn = ddsrt_avl_iter_first (&pwr_readers_treedef, &pwr->readers, &it); wn != NULL; wn = ddsrt_avl_iter_next (&it))
         {
-          if (wn->in_sync == PRMSS_SYNC)
+          if (wn->in_sync == PRMSS_SYNC || wn->u.not_in_sync.cursor)
             continue;
           /* only need to get a copy of the first sample, because that's the one
              that triggered delivery */
@@ -2595,12 +2860,12 @@ static int handle_Data (struct receiver_state *rst, ddsrt_etime_t tnow, struct n
           renew_manbypp_lease = false;
         /* fall through */
         default:
-          handle_regular (rst, tnow, rmsg, &msg->x, sampleinfo, UINT32_MAX, rdata, deferred_wakeup, renew_manbypp_lease);
+          handle_regular (rst, tnow, rmsg, &msg->x, size, sampleinfo, UINT32_MAX, rdata, deferred_wakeup, renew_manbypp_lease);
       }
     }
     else
     {
-      handle_regular (rst, tnow, rmsg, &msg->x, sampleinfo, UINT32_MAX, rdata, deferred_wakeup, true);
+      handle_regular (rst, tnow, rmsg, &msg->x, size, sampleinfo, UINT32_MAX, rdata, deferred_wakeup, true);
     }
   }
   RSTTRACE (")");
@@ -2697,7 +2962,7 @@ static int handle_DataFrag (struct receiver_state *rst, ddsrt_etime_t tnow, stru
        wrong, it'll simply generate a request for retransmitting a
        non-existent fragment.  The other side SHOULD be capable of
        dealing with that. */
-    handle_regular (rst, tnow, rmsg, &msg->x, sampleinfo, msg->fragmentStartingNum + msg->fragmentsInSubmessage - 2, rdata, deferred_wakeup, renew_manbypp_lease);
+    handle_regular (rst, tnow, rmsg, &msg->x, size, sampleinfo, msg->fragmentStartingNum + msg->fragmentsInSubmessage - 2, rdata, deferred_wakeup, renew_manbypp_lease);
   }
   RSTTRACE (")");
   return 1;
@@ -2846,7 +3111,8 @@ static int handle_submsg_sequence
   const size_t len,
   unsigned char * submsg /* aliases somewhere in msg */,
   struct nn_rmsg * const rmsg,
-  bool rtps_encoded /* indicate if the message was rtps encoded */
+  bool rtps_encoded /* indicate if the message was rtps encoded */,
+  struct fec_recovered **recovered /* appended to if FEC allowed reconstructing lost data, NULL if not allowed */
 )
 {
   const char *state;
@@ -3040,6 +3306,7 @@ static int handle_submsg_sequence
           }
           sampleinfo.timestamp = timestamp;
           sampleinfo.reception_timestamp = tnowWC;
+          sampleinfo.enqueue_timestamp.v = 0;
           handle_DataFrag (rst, tnowE, rmsg, &sm->datafrag, submsg_len, &sampleinfo, keyhash, datap, &deferred_wakeup, prev_smid);
           rst_live = 1;
           ts_for_latmeas = 0;
@@ -3064,6 +3331,7 @@ static int handle_submsg_sequence
             goto malformed;
           sampleinfo.timestamp = timestamp;
           sampleinfo.reception_timestamp = tnowWC;
+          sampleinfo.enqueue_timestamp.v = 0;
           handle_Data (rst, tnowE, rmsg, &sm->data, submsg_len, &sampleinfo, keyhash, datap, &deferred_wakeup, prev_smid);
           rst_live = 1;
           ts_for_latmeas = 0;
@@ -3085,6 +3353,19 @@ static int handle_submsg_sequence
         GVTRACE ("ENTITY_ID");
         break;
       }
+      case SMID_ADLINK_FEC:
+        if (!vendor_is_eclipse (rst->vendor))
+        {
+          /* Other vendors' private submessages are to be ignored */
+          GVTRACE ("UNDEFINED(%x)", sm->smhdr.submessageId);
+          break;
+        }
+        state = "parse:fec";
+        if (!valid_FecParity (&sm->fec, submsg_size, byteswap))
+          goto malformed;
+        handle_FecParity (rst, hdr, &sm->fec, recovered);
+        ts_for_latmeas = 0;
+        break;
       case SMID_SEC_PREFIX:
         state = "parse:sec_prefix";
         {
@@ -3175,6 +3456,29 @@ malformed:
   return -1;
 }
 
+static void handle_fec_recovered (struct thread_state1 * const ts1, struct ddsi_domaingv *gv, ddsi_tran_conn_t conn, const ddsi_locator_t *srcloc, const ddsi_guid_prefix_t *guidprefix, struct nn_rbufpool *rbpool, struct fec_recovered *recovered)
+{
+  /* Reconstructed data is processed as if received in a packet of its own,
+     immediately following the one containing the FEC submessage */
+  while (recovered)
+  {
+    struct fec_recovered * const r = recovered;
+    struct nn_rmsg *rmsg;
+    recovered = r->next;
+    if ((rmsg = nn_rmsg_new (rbpool)) != NULL)
+    {
+      unsigned char *buff = (unsigned char *) NN_RMSG_PAYLOAD (rmsg);
+      memcpy (buff, r + 1, r->size);
+      nn_rmsg_setsize (rmsg, r->size);
+      GVTRACE ("HDR(%"PRIx32":%"PRIx32":%"PRIx32" vendor %d.%d) len %"PRIu32" recovered\n",
+               PGUIDPREFIX (r->src_prefix), ((Header_t *) buff)->vendorid.id[0], ((Header_t *) buff)->vendorid.id[1], r->size);
+      handle_submsg_sequence (ts1, gv, conn, srcloc, ddsrt_time_wallclock (), ddsrt_time_elapsed (), &r->src_prefix, guidprefix, buff, r->size, buff + RTPS_MESSAGE_HEADER_SIZE, rmsg, false, NULL);
+      nn_rmsg_commit (rmsg);
+    }
+    ddsrt_free (r);
+  }
+}
+
 static bool do_packet (struct thread_state1 * const ts1, struct ddsi_domaingv *gv, ddsi_tran_conn_t conn, const ddsi_guid_prefix_t *guidprefix, struct nn_rbufpool *rbpool)
 {
   /* UDP max packet size is 64kB */
@@ -3188,6 +3492,7 @@ static bool do_packet (struct thread_state1 * const ts1, struct ddsi_domaingv *g
   size_t buff_len = maxsz;
   Header_t * hdr;
   ddsi_locator_t srcloc;
+  struct fec_recovered *recovered = NULL;
 
   if (rmsg == NULL)
   {
@@ -3291,7 +3596,9 @@ static bool do_packet (struct thread_state1 * const ts1, struct ddsi_domaingv *g
       nn_rtps_msg_state_t res = decode_rtps_message (ts1, gv, &rmsg, &hdr, &buff, &sz, rbpool, conn->m_stream);
       if (res != NN_RTPS_MSG_STATE_ERROR)
       {
-        handle_submsg_sequence (ts1, gv, conn, &srcloc, ddsrt_time_wallclock (), ddsrt_time_elapsed (), &hdr->guid_prefix, guidprefix, buff, (size_t) sz, buff + RTPS_MESSAGE_HEADER_SIZE, rmsg, res == NN_RTPS_MSG_STATE_ENCODED);
+        if (gv->config.meas_receive_latency)
+          rmsg->timestamp = conn->m_rx_timestamp;
+        handle_submsg_sequence (ts1, gv, conn, &srcloc, ddsrt_time_wallclock (), ddsrt_time_elapsed (), &hdr->guid_prefix, guidprefix, buff, (size_t) sz, buff + RTPS_MESSAGE_HEADER_SIZE, rmsg, res == NN_RTPS_MSG_STATE_ENCODED, &recovered);
       }
       else
       {
@@ -3301,6 +3608,8 @@ static bool do_packet (struct thread_state1 * const ts1, struct ddsi_domaingv *g
     }
   }
   nn_rmsg_commit (rmsg);
+  if (recovered)
+    handle_fec_recovered (ts1, gv, conn, &srcloc, guidprefix, rbpool, recovered);
   return (sz > 0);
 }
 
@@ -3447,18 +3756,26 @@ uint32_t listen_thread (struct ddsi_tran_listener *listener)
   return 0;
 }
 
+static bool conn_has_dedicated_recv_thread (const struct ddsi_domaingv *gv, const struct ddsi_tran_conn *conn)
+{
+  for (uint32_t i = 0; i < gv->n_recv_threads; i++)
+    if (gv->recv_threads[i].arg.mode == RTM_SINGLE && gv->recv_threads[i].arg.u.single.conn == conn)
+      return true;
+  return false;
+}
+
 static int recv_thread_waitset_add_conn (os_sockWaitset ws, ddsi_tran_conn_t conn)
 {
-  if (conn == NULL)
+  if (conn == NULL || conn_has_dedicated_recv_thread (conn->m_base.gv, conn))
     return 0;
   else
-  {
-    struct ddsi_domaingv *gv = conn->m_base.gv;
-    for (uint32_t i = 0; i < gv->n_recv_threads; i++)
-      if (gv->recv_threads[i].arg.mode == RTM_SINGLE && gv->recv_threads[i].arg.u.single.conn == conn)
-        return 0;
     return os_sockWaitsetAdd (ws, conn);
-  }
+}
+
+static void recv_thread_uring_add_conn (struct ddsi_uring_rx *rx, ddsi_tran_conn_t conn)
+{
+  if (conn != NULL && !conn_has_dedicated_recv_thread (conn->m_base.gv, conn))
+    (void) ddsi_uring_rx_add (rx, conn);
 }
 
 void trigger_recv_threads (const struct ddsi_domaingv *gv)
@@ -3467,6 +3784,12 @@ void trigger_recv_threads (const struct ddsi_domaingv *gv)
   {
     if (gv->recv_threads[i].ts == NULL)
       continue;
+    if (gv->recv_threads[i].arg.uring_rx)
+    {
+      GVTRACE ("trigger_recv_threads: %"PRIu32" io_uring\n", i);
+      ddsi_uring_rx_trigger (gv->recv_threads[i].arg.uring_rx);
+      continue;
+    }
     switch (gv->recv_threads[i].arg.mode)
     {
       case RTM_SINGLE: {
@@ -3490,6 +3813,45 @@ void trigger_recv_threads (const struct ddsi_domaingv *gv)
   }
 }
 
+static void recv_thread_uring (struct thread_state1 * const ts1, struct recv_thread_arg *recv_thread_arg)
+{
+  struct ddsi_domaingv * const gv = recv_thread_arg->gv;
+  struct nn_rbufpool * const rbpool = recv_thread_arg->rbpool;
+  struct ddsi_uring_rx * const rx = recv_thread_arg->uring_rx;
+  ddsrt_mtime_t next_thread_cputime = { 0 };
+
+  /* Same sockets as with a waitset, but ManySocketsMode is always "single"
+     when using io_uring, so there are no participant sockets to track */
+  if (recv_thread_arg->mode == RTM_SINGLE)
+    (void) ddsi_uring_rx_add (rx, recv_thread_arg->u.single.conn);
+  else
+  {
+    recv_thread_uring_add_conn (rx, gv->disc_conn_uc);
+    recv_thread_uring_add_conn (rx, gv->data_conn_uc);
+    recv_thread_uring_add_conn (rx, gv->disc_conn_mc);
+    recv_thread_uring_add_conn (rx, gv->data_conn_mc);
+    for (int i = 0; i < gv->n_interfaces; i++)
+    {
+      if (ddsi_conn_handle (gv->xmit_conns[i]) == DDSRT_INVALID_SOCKET)
+        continue;
+      recv_thread_uring_add_conn (rx, gv->xmit_conns[i]);
+      for (uint32_t k = 0; gv->xmit_conn_pool && k < gv->config.xmit_conn_pool_size - 1; k++)
+        recv_thread_uring_add_conn (rx, gv->xmit_conn_pool[(uint32_t) i * (gv->config.xmit_conn_pool_size - 1) + k]);
+    }
+  }
+
+  while (ddsrt_atomic_ld32 (&gv->rtps_keepgoing))
+  {
+    LOG_THREAD_CPUTIME (&gv->logconfig, next_thread_cputime);
+    if (ddsi_uring_rx_wait (rx) == 0)
+    {
+      ddsi_tran_conn_t conn;
+      while ((conn = ddsi_uring_rx_next (rx)) != NULL)
+        (void) do_packet (ts1, gv, conn, NULL, rbpool);
+    }
+  }
+}
+
 uint32_t recv_thread (void *vrecv_thread_arg)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
@@ -3500,7 +3862,11 @@ uint32_t recv_thread (void *vrecv_thread_arg)
   ddsrt_mtime_t next_thread_cputime = { 0 };
 
   nn_rbufpool_setowner (rbpool, ddsrt_thread_self ());
-  if (waitset == NULL)
+  if (recv_thread_arg->uring_rx)
+  {
+    recv_thread_uring (ts1, recv_thread_arg);
+  }
+  else if (waitset == NULL)
   {
     struct ddsi_tran_conn *conn = recv_thread_arg->u.single.conn;
     while (ddsrt_atomic_ld32 (&gv->rtps_keepgoing))
@@ -3531,6 +3897,12 @@ uint32_t recv_thread (void *vrecv_thread_arg)
       if ((rc = recv_thread_waitset_add_conn (waitset, gv->data_conn_mc)) < 0)
         DDS_FATAL("recv_thread: failed to add data_conn_mc to waitset\n");
       num_fixed += (unsigned)rc;
+      if ((rc = recv_thread_waitset_add_conn (waitset, gv->disc_conn_shmem)) < 0)
+        DDS_FATAL("recv_thread: failed to add disc_conn_shmem to waitset\n");
+      num_fixed += (unsigned)rc;
+      if ((rc = recv_thread_waitset_add_conn (waitset, gv->data_conn_shmem)) < 0)
+        DDS_FATAL("recv_thread: failed to add data_conn_shmem to waitset\n");
+      num_fixed += (unsigned)rc;
 
       // OpenDDS doesn't respect the locator lists and insists on sending to the
       // socket it received packets from
@@ -3543,6 +3915,15 @@ uint32_t recv_thread (void *vrecv_thread_arg)
         if ((rc = recv_thread_waitset_add_conn (waitset, gv->xmit_conns[i])) < 0)
           DDS_FATAL("recv_thread: failed to add transmit_conn[%d] to waitset\n", i);
         num_fixed += (unsigned)rc;
+        for (uint32_t k = 0; gv->xmit_conn_pool && k < gv->config.xmit_conn_pool_size - 1; k++)
+        {
+          struct ddsi_tran_conn * const conn = gv->xmit_conn_pool[(uint32_t) i * (gv->config.xmit_conn_pool_size - 1) + k];
+          if (conn == gv->xmit_conns[i])
+            continue;
+          if ((rc = recv_thread_waitset_add_conn (waitset, conn)) < 0)
+            DDS_FATAL("recv_thread: failed to add transmit_conn[%d] pool entry %"PRIu32" to waitset\n", i, k);
+          num_fixed += (unsigned)rc;
+        }
       }
     }
 
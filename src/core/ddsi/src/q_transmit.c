@@ -38,6 +38,8 @@
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_sertype.h"
 #include "dds/ddsi/ddsi_security_omg.h"
+#include "dds/ddsi/ddsi_content_filter.h"
+#include "dds/ddsi/ddsi_fec.h"
 
 #include "dds/ddsi/sysdeps.h"
 #include "dds__whc.h"
@@ -63,6 +65,34 @@ void writer_hbcontrol_init (struct hbcontrol *hbc)
   hbc->tsched = DDSRT_MTIME_NEVER;
   hbc->hbs_since_last_write = 0;
   hbc->last_packetid = 0;
+  hbc->ackhb = 0;
+}
+
+static int64_t writer_hbcontrol_ack_latency (const struct writer *wr)
+{
+  /* Latency with which the slowest reader responds to a heartbeat, or 0 if
+     not using adaptive heartbeats or nothing known yet */
+  if (!wr->e.gv->config.hb_intv_adaptive || ddsrt_avl_is_empty (&wr->readers))
+    return 0;
+  return root_rdmatch (wr)->max_ack_latency;
+}
+
+static int64_t writer_hbcontrol_base_intv (const struct writer *wr)
+{
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  const int64_t ack_latency = writer_hbcontrol_ack_latency (wr);
+  int64_t ret;
+  if (ack_latency == 0)
+    return gv->config.const_hb_intv_sched;
+  /* By the time twice the latency has passed without an ACK, it is likely
+     something got lost and it is better to send another heartbeat than to
+     wait for the fixed interval, but never less often than that */
+  ret = 2 * ack_latency;
+  if (ret < gv->config.const_hb_intv_sched_min)
+    ret = gv->config.const_hb_intv_sched_min;
+  else if (ret > gv->config.const_hb_intv_sched)
+    ret = gv->config.const_hb_intv_sched;
+  return ret;
 }
 
 static void writer_hbcontrol_note_hb (struct writer *wr, ddsrt_mtime_t tnow, int ansreq)
@@ -70,7 +100,10 @@ static void writer_hbcontrol_note_hb (struct writer *wr, ddsrt_mtime_t tnow, int
   struct hbcontrol * const hbc = &wr->hbcontrol;
 
   if (ansreq)
+  {
     hbc->t_of_last_ackhb = tnow;
+    hbc->ackhb = wr->hbcount;
+  }
   hbc->t_of_last_hb = tnow;
 
   /* Count number of heartbeats since last write, used to lower the
@@ -83,7 +116,7 @@ int64_t writer_hbcontrol_intv (const struct writer *wr, const struct whc_state *
 {
   struct ddsi_domaingv const * const gv = wr->e.gv;
   struct hbcontrol const * const hbc = &wr->hbcontrol;
-  int64_t ret = gv->config.const_hb_intv_sched;
+  int64_t ret = writer_hbcontrol_base_intv (wr);
   size_t n_unacked;
 
   if (hbc->hbs_since_last_write > 5)
@@ -107,7 +140,6 @@ int64_t writer_hbcontrol_intv (const struct writer *wr, const struct whc_state *
 
 void writer_hbcontrol_note_asyncwrite (struct writer *wr, ddsrt_mtime_t tnow)
 {
-  struct ddsi_domaingv const * const gv = wr->e.gv;
   struct hbcontrol * const hbc = &wr->hbcontrol;
   ddsrt_mtime_t tnext;
 
@@ -117,7 +149,7 @@ void writer_hbcontrol_note_asyncwrite (struct writer *wr, ddsrt_mtime_t tnow)
 
   /* We know this is new data, so we want a heartbeat event after one
      base interval */
-  tnext.v = tnow.v + gv->config.const_hb_intv_sched;
+  tnext.v = tnow.v + writer_hbcontrol_base_intv (wr);
   if (tnext.v < hbc->tsched.v)
   {
     /* Insertion of a message with WHC locked => must now have at
@@ -128,6 +160,29 @@ void writer_hbcontrol_note_asyncwrite (struct writer *wr, ddsrt_mtime_t tnow)
   }
 }
 
+void writer_hbcontrol_note_acknack (struct writer *wr, struct wr_prd_match *rn, ddsrt_mtime_t tnow)
+{
+  struct hbcontrol const * const hbc = &wr->hbcontrol;
+  int64_t ack_latency;
+
+  /* An ACKNACK is taken to be the response to the most recent heartbeat
+     requesting one if the reader hasn't responded to that heartbeat yet.
+     It may also have been triggered by another heartbeat or by the
+     reader's own timers, but those are outliers the median filter in the
+     latency estimator takes care of. */
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  if (hbc->ackhb == 0 || rn->ackhb_answered == hbc->ackhb)
+    return;
+  rn->ackhb_answered = hbc->ackhb;
+  nn_lat_estim_update (&rn->ack_latency_estim, tnow.v - hbc->t_of_last_ackhb.v);
+  ack_latency = (int64_t) (nn_lat_estim_current (&rn->ack_latency_estim) * 1e3);
+  if (ack_latency != rn->ack_latency)
+  {
+    rn->ack_latency = ack_latency;
+    ddsrt_avl_augment_update (&wr_readers_treedef, rn);
+  }
+}
+
 int writer_hbcontrol_must_send (const struct writer *wr, const struct whc_state *whcst, ddsrt_mtime_t tnow /* monotonic */)
 {
   struct hbcontrol const * const hbc = &wr->hbcontrol;
@@ -228,7 +283,8 @@ static int writer_hbcontrol_ack_required_generic (const struct writer *wr, const
 {
   struct ddsi_domaingv const * const gv = wr->e.gv;
   struct hbcontrol const * const hbc = &wr->hbcontrol;
-  const int64_t hb_intv_ack = gv->config.const_hb_intv_sched;
+  const int64_t hb_intv_ack = writer_hbcontrol_base_intv (wr);
+  const int64_t ack_latency = writer_hbcontrol_ack_latency (wr);
   assert(wr->heartbeat_xevent != NULL && whcst != NULL);
 
   if (piggyback)
@@ -251,9 +307,13 @@ static int writer_hbcontrol_ack_required_generic (const struct writer *wr, const
 
   if (whcst->unacked_bytes >= wr->whc_low + (wr->whc_high - wr->whc_low) / 2)
   {
-    if (tnow.v >= hbc->t_of_last_ackhb.v + gv->config.const_hb_intv_sched_min)
+    /* Requesting another ACK while the response to the previous request
+       is still expected only results in duplicate ACKs */
+    const int64_t intv_sched_min = (ack_latency > gv->config.const_hb_intv_sched_min) ? ack_latency : gv->config.const_hb_intv_sched_min;
+    const int64_t intv_min = (ack_latency > gv->config.const_hb_intv_min) ? ack_latency : gv->config.const_hb_intv_min;
+    if (tnow.v >= hbc->t_of_last_ackhb.v + intv_sched_min)
       return 2;
-    else if (tnow.v >= hbc->t_of_last_ackhb.v + gv->config.const_hb_intv_min)
+    else if (tnow.v >= hbc->t_of_last_ackhb.v + intv_min)
       return 1;
   }
 
@@ -272,6 +332,7 @@ struct nn_xmsg *writer_hbcontrol_piggyback (struct writer *wr, const struct whc_
   uint32_t last_packetid;
   ddsrt_mtime_t tlast;
   ddsrt_mtime_t t_of_last_hb;
+  int64_t min_hb_spacing;
   struct nn_xmsg *msg;
 
   tlast = hbc->t_of_last_write;
@@ -286,12 +347,18 @@ struct nn_xmsg *writer_hbcontrol_piggyback (struct writer *wr, const struct whc_
      reuse the async version. */
   writer_hbcontrol_note_asyncwrite (wr, tnow);
 
+  /* Heartbeats sent much more often than readers can respond to them
+     don't speed up recovery, they only add to the control traffic */
+  min_hb_spacing = writer_hbcontrol_ack_latency (wr) / 4;
+  if (min_hb_spacing < DDS_USECS (100))
+    min_hb_spacing = DDS_USECS (100);
+
   *hbansreq = writer_hbcontrol_ack_required_generic (wr, whcst, tlast, tnow, 1);
   if (*hbansreq >= 2) {
     /* So we force a heartbeat in - but we also rely on our caller to
        send the packet out */
     msg = writer_hbcontrol_create_heartbeat (wr, whcst, tnow, *hbansreq, 1);
-  } else if (last_packetid != packetid && tnow.v - t_of_last_hb.v > DDS_USECS (100)) {
+  } else if (last_packetid != packetid && tnow.v - t_of_last_hb.v > min_hb_spacing) {
     /* If we crossed a packet boundary since the previous write,
        piggyback a heartbeat, with *hbansreq determining whether or
        not an ACK is needed.  We don't force the packet out either:
@@ -304,6 +371,10 @@ struct nn_xmsg *writer_hbcontrol_piggyback (struct writer *wr, const struct whc_
        a *large* amount of time because there are out-of-order readers
        present. */
     msg = writer_hbcontrol_create_heartbeat (wr, whcst, tnow, *hbansreq, 1);
+    /* A piggybacked heartbeat is in no more of a hurry than the data it
+       accompanies, it mustn't cut short adaptive batching */
+    if (msg)
+      nn_xmsg_setmaxdelay (msg, wr->xqos->latency_budget.duration);
   } else {
     *hbansreq = 0;
     msg = NULL;
@@ -753,6 +824,41 @@ static int must_skip_frag (const char *frags_to_skip, unsigned frag)
 }
 #endif
 
+static struct nn_xmsg *writer_fec_note_data (struct writer *wr, const struct nn_xmsg *msg)
+{
+  /* Only for new data addressed to all readers: that's where a single parity
+     submessage serves many readers (especially when multicasting) */
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  struct nn_xmsg_marker sm_marker;
+  struct nn_xmsg *pmsg;
+  ddsrt_iovec_t iov[2];
+  uint32_t niov;
+  ddsi_time_t timestamp;
+  FecParity_t *fec;
+  size_t sz;
+
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  if (wr->fec == NULL || msg == NULL || !nn_xmsg_data_submsg (msg, iov, &niov, &timestamp))
+    return NULL;
+  if (!ddsi_fec_encoder_add (wr->fec, iov, niov, timestamp))
+    return NULL;
+  sz = ddsi_fec_encoder_parity_size (wr->fec);
+  if ((pmsg = nn_xmsg_new (gv->xmsgpool, &wr->e.guid, wr->c.pp, sz, NN_XMSG_KIND_CONTROL)) == NULL)
+  {
+    /* ignore out-of-memory: FEC is only an optimisation */
+    ddsi_fec_encoder_reset (wr->fec);
+    return NULL;
+  }
+  nn_xmsg_setdstN (pmsg, wr->as, wr->as_group);
+  nn_xmsg_setmaxdelay (pmsg, wr->xqos->latency_budget.duration);
+  fec = nn_xmsg_append (pmsg, &sm_marker, sz);
+  nn_xmsg_submsg_init (pmsg, sm_marker, SMID_ADLINK_FEC);
+  fec->writerId = nn_hton_entityid (wr->e.guid.entityid);
+  ddsi_fec_encoder_fill (wr->fec, fec);
+  nn_xmsg_submsg_setnext (pmsg, sm_marker);
+  return pmsg;
+}
+
 static void transmit_sample_lgmsg_unlocks_wr (struct nn_xpack *xp, struct writer *wr, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, int isnew, uint32_t nfrags, uint32_t nfrags_lim)
 {
 #if 0
@@ -769,6 +875,7 @@ static void transmit_sample_lgmsg_unlocks_wr (struct nn_xpack *xp, struct writer
   {
     struct nn_xmsg *fmsg = NULL;
     struct nn_xmsg *hmsg = NULL;
+    struct nn_xmsg *pmsg = NULL;
     int ret;
 #if 0
     if (must_skip_frag (frags_to_skip, i))
@@ -783,6 +890,8 @@ static void transmit_sample_lgmsg_unlocks_wr (struct nn_xpack *xp, struct writer
        we haven't yet completed transmitting a fragmented message, add
        a HeartbeatFrag. */
     ret = create_fragment_message (wr, seq, plist, serdata, i, (uint16_t) nf_in_submsg, prd, &fmsg, isnew, i + nf_in_submsg == nfrags_lim ? nfrags - 1 : UINT32_MAX);
+    if (ret >= 0 && isnew && prd == NULL)
+      pmsg = writer_fec_note_data (wr, fmsg);
     if (ret >= 0 && i + nf_in_submsg < nfrags_lim && wr->heartbeat_xevent)
     {
       // more fragment messages to come
@@ -791,6 +900,7 @@ static void transmit_sample_lgmsg_unlocks_wr (struct nn_xpack *xp, struct writer
     ddsrt_mutex_unlock (&wr->e.lock);
 
     if(fmsg) nn_xpack_addmsg (xp, fmsg, 0);
+    if(pmsg) nn_xpack_addmsg (xp, pmsg, 0);
     if(hmsg) nn_xpack_addmsg (xp, hmsg, 0);
 
     ddsrt_mutex_lock (&wr->e.lock);
@@ -802,6 +912,7 @@ static void transmit_sample_unlocks_wr (struct nn_xpack *xp, struct writer *wr,
   /* on entry: &wr->e.lock held; on exit: lock no longer held */
   struct ddsi_domaingv const * const gv = wr->e.gv;
   struct nn_xmsg *hmsg = NULL;
+  struct nn_xmsg *pmsg = NULL;
   int hbansreq = 0;
   uint32_t sz;
   assert(xp);
@@ -826,19 +937,237 @@ static void transmit_sample_unlocks_wr (struct nn_xpack *xp, struct writer *wr,
   {
     struct nn_xmsg *fmsg;
     if (create_fragment_message_simple (wr, seq, serdata, &fmsg) >= 0)
+    {
+      pmsg = writer_fec_note_data (wr, fmsg);
       nn_xpack_addmsg (xp, fmsg, 0);
+    }
   }
 
   if (wr->heartbeat_xevent)
     hmsg = writer_hbcontrol_piggyback (wr, whcst, serdata->twrite, nn_xpack_packetid (xp), &hbansreq);
   ddsrt_mutex_unlock (&wr->e.lock);
 
+  if(pmsg)
+    nn_xpack_addmsg (xp, pmsg, 0);
   if(hmsg)
     nn_xpack_addmsg (xp, hmsg, 0);
   if (hbansreq >= 2)
     nn_xpack_send (xp, true);
 }
 
+/* Writer-side content filtering: readers sharing a filter expression share the
+   result of evaluating it, memoizing this covers the common case of many
+   readers using a handful of distinct filters.  The sample is deserialized
+   only once for all filters, preferably before locking the writer. */
+#define CONTENT_FILTER_MEMO_SIZE 8
+
+enum content_filter_sample_state {
+  CFSS_NONE,     /* not (yet) deserialized */
+  CFSS_VALID,    /* sample contains the deserialized data */
+  CFSS_ACCEPT    /* not data or deserialization failed: everyone accepts it */
+};
+
+struct content_filter_memo {
+  enum content_filter_sample_state sample_state;
+  void *sample;
+  uint32_t n;
+  struct {
+    const struct ddsi_content_filter *cf;
+    bool accept;
+  } e[CONTENT_FILTER_MEMO_SIZE];
+};
+
+struct content_filter_msgs {
+  uint32_t n, size;
+  struct nn_xmsg **msgs;
+};
+
+static void content_filter_memo_deserialize (struct content_filter_memo *memo, const struct ddsi_serdata *serdata)
+{
+  assert (memo->sample_state == CFSS_NONE);
+  memo->sample_state = CFSS_ACCEPT;
+  if (serdata->kind == SDK_DATA)
+  {
+    memo->sample = ddsi_sertype_alloc_sample (serdata->type);
+    if (ddsi_serdata_to_sample (serdata, memo->sample, NULL, NULL))
+      memo->sample_state = CFSS_VALID;
+  }
+}
+
+static void content_filter_memo_init (struct content_filter_memo *memo, struct writer *wr, const struct ddsi_serdata *serdata)
+{
+  memo->sample_state = CFSS_NONE;
+  memo->sample = NULL;
+  memo->n = 0;
+  /* Unlocked check: if a content-filtered reader gets matched (or a filter
+     class gets registered) in the meantime the sample is deserialized when
+     it is needed; without any filter class, all filters accept everything */
+  if (ddsrt_atomic_ld32 (&wr->num_readers_content_filtered) > 0 && ddsi_content_filter_classes_registered (wr->e.gv))
+    content_filter_memo_deserialize (memo, serdata);
+}
+
+static void content_filter_memo_fini (struct content_filter_memo *memo, const struct ddsi_serdata *serdata)
+{
+  if (memo->sample)
+    ddsi_sertype_free_sample (serdata->type, memo->sample, DDS_FREE_ALL);
+}
+
+static bool prd_accepts_sample (struct writer *wr, struct proxy_reader *prd, struct ddsi_serdata *serdata, struct content_filter_memo *memo)
+{
+  bool accept;
+  if (prd->content_filter == NULL)
+    return true;
+  for (uint32_t i = 0; i < memo->n; i++)
+    if (ddsi_content_filter_equal (memo->e[i].cf, prd->content_filter))
+      return memo->e[i].accept;
+  /* an unknown filter class accepts everything: don't deserialize for it */
+  if (!ddsi_content_filter_resolved (wr->e.gv, prd->content_filter))
+    accept = true;
+  else
+  {
+    if (memo->sample_state == CFSS_NONE)
+      content_filter_memo_deserialize (memo, serdata);
+    if (memo->sample_state == CFSS_ACCEPT)
+      accept = true;
+    else
+      accept = ddsi_content_filter_accepts_sample (wr->e.gv, prd->content_filter, memo->sample);
+  }
+  if (memo->n < CONTENT_FILTER_MEMO_SIZE)
+  {
+    memo->e[memo->n].cf = prd->content_filter;
+    memo->e[memo->n].accept = accept;
+    memo->n++;
+  }
+  return accept;
+}
+
+static bool content_filter_rejects_any (struct writer *wr, struct ddsi_serdata *serdata, struct content_filter_memo *memo)
+{
+  struct entity_index * const entidx = wr->e.gv->entity_index;
+  ddsrt_avl_iter_t it;
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  for (struct wr_prd_match *m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->readers, &it); m; m = ddsrt_avl_iter_next (&it))
+  {
+    struct proxy_reader *prd;
+    if ((prd = entidx_lookup_proxy_reader_guid (entidx, &m->prd_guid)) != NULL && !prd_accepts_sample (wr, prd, serdata, memo))
+      return true;
+  }
+  return false;
+}
+
+static void content_filter_msgs_add (struct content_filter_msgs *cfm, struct nn_xmsg *msg)
+{
+  if (msg == NULL)
+    return;
+  if (cfm->n == cfm->size)
+  {
+    cfm->size = (cfm->size == 0) ? 8 : 2 * cfm->size;
+    cfm->msgs = ddsrt_realloc (cfm->msgs, cfm->size * sizeof (*cfm->msgs));
+  }
+  cfm->msgs[cfm->n++] = msg;
+}
+
+static void content_filter_data_msgs (struct writer *wr, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, struct content_filter_msgs *cfm)
+{
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  const uint32_t sz = ddsi_serdata_size (serdata);
+  const uint32_t nfrags = (sz == 0) ? 1 : (sz + gv->config.fragment_size - 1) / gv->config.fragment_size;
+  uint32_t nfrags_lim, nf_in_submsg;
+  if (sz <= wr->init_burst_size_limit || prd->c.xqos->reliability.kind == DDS_RELIABILITY_BEST_EFFORT)
+    nfrags_lim = nfrags;
+  else
+    nfrags_lim = (wr->init_burst_size_limit + gv->config.fragment_size - 1) / gv->config.fragment_size;
+  if ((nf_in_submsg = gv->config.max_msg_size / gv->config.fragment_size) == 0)
+    nf_in_submsg = 1;
+  else if (nf_in_submsg > UINT16_MAX)
+    nf_in_submsg = UINT16_MAX;
+  for (uint32_t i = 0; i < nfrags_lim; i += nf_in_submsg)
+  {
+    struct nn_xmsg *fmsg = NULL;
+    struct nn_xmsg *hmsg = NULL;
+    if (nf_in_submsg > nfrags_lim - i)
+      nf_in_submsg = nfrags_lim - i;
+    if (create_fragment_message (wr, seq, plist, serdata, i, (uint16_t) nf_in_submsg, prd, &fmsg, 1, i + nf_in_submsg == nfrags_lim ? nfrags - 1 : UINT32_MAX) >= 0 &&
+        i + nf_in_submsg < nfrags_lim && wr->heartbeat_xevent)
+      create_HeartbeatFrag (wr, seq, i + nf_in_submsg - 1, prd, &hmsg);
+    content_filter_msgs_add (cfm, fmsg);
+    content_filter_msgs_add (cfm, hmsg);
+  }
+}
+
+static void transmit_sample_content_filtered_unlocks_wr (struct nn_xpack *xp, struct writer *wr, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct content_filter_memo *memo)
+{
+  /* on entry: &wr->e.lock held; on exit: lock no longer held
+
+     Some matched readers reject the sample, so it can't be multicast to the
+     writer's address set: instead it gets unicast to all readers that accept
+     it and the others get a GAP.  Readers sharing a receiver with one that
+     accepts it get neither, as the data addressed to the one reader reaches
+     them as well, and the data need only be sent once to such a receiver.
+     Only new samples take this path, for retransmits the proxy reader's
+     filter function takes care of it. */
+  struct entity_index * const entidx = wr->e.gv->entity_index;
+  struct content_filter_msgs cfm = { 0, 0, NULL };
+  struct { struct wr_prd_match *m; struct proxy_reader *prd; bool accept; } *rds;
+  uint32_t nrds = 0;
+  bool data_sent = false;
+  ddsrt_avl_iter_t it;
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  rds = ddsrt_malloc (wr->num_readers * sizeof (*rds));
+  for (struct wr_prd_match *m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->readers, &it); m; m = ddsrt_avl_iter_next (&it))
+  {
+    struct proxy_reader *prd;
+    assert (nrds < wr->num_readers);
+    if ((prd = entidx_lookup_proxy_reader_guid (entidx, &m->prd_guid)) == NULL)
+      continue;
+    rds[nrds].m = m;
+    rds[nrds].prd = prd;
+    rds[nrds].accept = prd_accepts_sample (wr, prd, serdata, memo);
+    nrds++;
+  }
+  for (uint32_t i = 0; i < nrds; i++)
+  {
+    bool covered = false;
+    for (uint32_t j = 0; j < nrds && !covered; j++)
+      covered = rds[j].accept && (!rds[i].accept || j < i) && ddsi_content_filter_shared_receiver (rds[i].prd, rds[j].prd);
+    if (!covered)
+    {
+      if (rds[i].accept)
+      {
+        content_filter_data_msgs (wr, seq, plist, serdata, rds[i].prd, &cfm);
+        data_sent = true;
+      }
+      else
+      {
+        struct nn_gap_info gi;
+        nn_gap_info_init (&gi);
+        nn_gap_info_update (wr->e.gv, &gi, seq);
+        content_filter_msgs_add (&cfm, nn_gap_info_create_gap (wr, rds[i].prd, &gi));
+      }
+    }
+    rds[i].m->last_seq = seq;
+  }
+  ddsrt_free (rds);
+  /* Data messages update seq_xmit when they go out, but GAPs don't */
+  if (!data_sent)
+    writer_update_seq_xmit (wr, seq);
+  if (wr->heartbeat_xevent)
+    writer_hbcontrol_note_asyncwrite (wr, serdata->twrite);
+  if (xp == NULL)
+  {
+    for (uint32_t i = 0; i < cfm.n; i++)
+      qxev_msg (wr->evq, cfm.msgs[i]);
+    ddsrt_mutex_unlock (&wr->e.lock);
+  }
+  else
+  {
+    ddsrt_mutex_unlock (&wr->e.lock);
+    for (uint32_t i = 0; i < cfm.n; i++)
+      nn_xpack_addmsg (xp, cfm.msgs[i], 0);
+  }
+  ddsrt_free (cfm.msgs);
+}
+
 void enqueue_spdp_sample_wrlock_held (struct writer *wr, seqno_t seq, struct ddsi_serdata *serdata, struct proxy_reader *prd)
 {
   assert (wr->e.guid.entityid.u == NN_ENTITYID_SPDP_BUILTIN_PARTICIPANT_WRITER);
@@ -888,7 +1217,7 @@ int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct dds
       const int force = 0;
       if(fmsg)
       {
-        enqueued = qxev_msg_rexmit_wrlock_held (wr->evq, fmsg, force);
+        enqueued = qxev_msg_rexmit_wrlock_held (wr->evq, fmsg, force, prd);
       }
       /* Functioning of the system is not dependent on getting the
          HeartbeatFrags out, so never force them into the queue. */
@@ -1087,6 +1416,33 @@ static dds_return_t throttle_writer (struct thread_state1 * const ts1, struct nn
   return result;
 }
 
+static dds_return_t writer_would_block (struct nn_xpack *xp, struct writer *wr)
+{
+  /* Non-blocking alternative to throttle_writer: rather than waiting for the
+     WHC to shrink, get the readers to acknowledge the data in the same way and
+     let remove_acked_messages signal the writer is ready again once the WHC
+     has dropped below the low-water mark */
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  struct whc_state whcst;
+  whc_get_state (wr->whc, &whcst);
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  GVLOG (DDS_LC_THROTTLE,
+         "writer "PGUIDFMT" would block waiting for whc to shrink below low-water mark (whc %"PRIuSIZE" low=%"PRIu32" high=%"PRIu32")\n",
+         PGUID (wr->e.guid), whcst.unacked_bytes, wr->whc_low, wr->whc_high);
+  wr->throttle_count++;
+  writer_set_would_block (wr);
+  if (xp)
+  {
+    struct nn_xmsg *hbmsg = writer_hbcontrol_create_heartbeat (wr, &whcst, ddsrt_time_monotonic (), 1, 1);
+    ddsrt_mutex_unlock (&wr->e.lock);
+    if (hbmsg)
+      nn_xpack_addmsg (xp, hbmsg, 0);
+    nn_xpack_send (xp, true);
+    ddsrt_mutex_lock (&wr->e.lock);
+  }
+  return DDS_RETCODE_TRY_AGAIN;
+}
+
 static int maybe_grow_whc (struct writer *wr)
 {
   struct ddsi_domaingv const * const gv = wr->e.gv;
@@ -1173,13 +1529,39 @@ prd_is_deleting:
   return r;
 }
 
-static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk, int end_of_txn, int gc_allowed)
+static dds_return_t writer_throttle_if_whc_full (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, int nonblocking)
+{
+  /* on entry and on exit: &wr->e.lock held, but it may be released in between */
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  struct whc_state whcst;
+  whc_get_state(wr->whc, &whcst);
+  if (whcst.unacked_bytes <= wr->whc_high)
+    return DDS_RETCODE_OK;
+  if (!(gv->config.prioritize_retransmit && wr->retransmitting))
+  {
+    maybe_grow_whc (wr);
+    if (whcst.unacked_bytes <= wr->whc_high)
+      return DDS_RETCODE_OK;
+  }
+  return nonblocking ? writer_would_block (xp, wr) : throttle_writer (ts1, xp, wr);
+}
+
+static void writer_renew_manual_lease (struct writer *wr)
+{
+  struct lease *lease;
+  if (wr->xqos->liveliness.kind == DDS_LIVELINESS_MANUAL_BY_PARTICIPANT && ((lease = ddsrt_atomic_ldvoidp (&wr->c.pp->minl_man)) != NULL))
+    lease_renew (lease, ddsrt_time_elapsed());
+  else if (wr->xqos->liveliness.kind == DDS_LIVELINESS_MANUAL_BY_TOPIC && wr->lease != NULL)
+    lease_renew (wr->lease, ddsrt_time_elapsed());
+}
+
+static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk, int end_of_txn, int gc_allowed, int nonblocking)
 {
   struct ddsi_domaingv const * const gv = wr->e.gv;
   int r;
   seqno_t seq;
   ddsrt_mtime_t tnow;
-  struct lease *lease;
+  struct content_filter_memo memo = { .sample_state = CFSS_NONE, .sample = NULL, .n = 0 };
 
   /* If GC not allowed, we must be sure to never block when writing.  That is only the case for (true, aggressive) KEEP_LAST writers, and also only if there is no limit to how much unacknowledged data the WHC may contain. */
   assert (gc_allowed || (wr->xqos->history.kind == DDS_HISTORY_KEEP_LAST && wr->whc_low == INT32_MAX));
@@ -1199,11 +1581,9 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
     goto drop;
   }
 
-  if (wr->xqos->liveliness.kind == DDS_LIVELINESS_MANUAL_BY_PARTICIPANT && ((lease = ddsrt_atomic_ldvoidp (&wr->c.pp->minl_man)) != NULL))
-    lease_renew (lease, ddsrt_time_elapsed());
-  else if (wr->xqos->liveliness.kind == DDS_LIVELINESS_MANUAL_BY_TOPIC && wr->lease != NULL)
-    lease_renew (wr->lease, ddsrt_time_elapsed());
+  writer_renew_manual_lease (wr);
 
+  content_filter_memo_init (&memo, wr, serdata);
   ddsrt_mutex_lock (&wr->e.lock);
 
   if (!wr->alive)
@@ -1214,31 +1594,11 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
     wr->cs_seq = 0;
   }
 
-  /* If WHC overfull, block. */
+  /* If WHC overfull, block (or refuse if non-blocking). */
+  if ((r = writer_throttle_if_whc_full (ts1, xp, wr, nonblocking)) != DDS_RETCODE_OK)
   {
-    struct whc_state whcst;
-    whc_get_state(wr->whc, &whcst);
-    if (whcst.unacked_bytes > wr->whc_high)
-    {
-      dds_return_t ores;
-      assert(gc_allowed); /* also see beginning of the function */
-      if (gv->config.prioritize_retransmit && wr->retransmitting)
-        ores = throttle_writer (ts1, xp, wr);
-      else
-      {
-        maybe_grow_whc (wr);
-        if (whcst.unacked_bytes <= wr->whc_high)
-          ores = DDS_RETCODE_OK;
-        else
-          ores = throttle_writer (ts1, xp, wr);
-      }
-      if (ores == DDS_RETCODE_TIMEOUT)
-      {
-        ddsrt_mutex_unlock (&wr->e.lock);
-        r = DDS_RETCODE_TIMEOUT;
-        goto drop;
-      }
-    }
+    ddsrt_mutex_unlock (&wr->e.lock);
+    goto drop;
   }
 
   if (wr->state != WRST_OPERATIONAL)
@@ -1307,7 +1667,11 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
     /* Note the subtlety of enqueueing with the lock held but
        transmitting without holding the lock. Still working on
        cleaning that up. */
-    if (xp)
+    if (ddsrt_atomic_ld32 (&wr->num_readers_content_filtered) > 0 && content_filter_rejects_any (wr, serdata, &memo))
+    {
+      transmit_sample_content_filtered_unlocks_wr (xp, wr, seq, plist, serdata, &memo);
+    }
+    else if (xp)
     {
       /* If all reliable readers disappear between unlocking the writer and
        * creating the message, the WHC will free the plist (if any). Currently,
@@ -1353,6 +1717,7 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
   }
 
 drop:
+  content_filter_memo_fini (&memo, serdata);
   /* FIXME: shouldn't I move the ddsi_serdata_unref call to the callers? */
   ddsi_serdata_unref (serdata);
   return r;
@@ -1360,12 +1725,149 @@ drop:
 
 int write_sample_gc (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
 {
-  return write_sample_eot (ts1, xp, wr, NULL, serdata, tk, 0, 1);
+  return write_sample_eot (ts1, xp, wr, NULL, serdata, tk, 0, 1, 0);
+}
+
+int write_sample_gc_nonblocking (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
+{
+  return write_sample_eot (ts1, xp, wr, NULL, serdata, tk, 0, 1, 1);
+}
+
+static bool write_sample_batch_is_simple (const struct writer *wr, const struct nn_xpack *xp, uint32_t n, struct ddsi_serdata **serdata)
+{
+  /* Only the common case of small samples going out in a single DATA submessage
+     to all readers is handled in a single pass, anything else takes the regular
+     path sample by sample */
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  if (xp == NULL || q_omg_writer_is_submessage_protected (wr))
+    return false;
+  for (uint32_t i = 0; i < n; i++)
+  {
+    const uint32_t sz = ddsi_serdata_size (serdata[i]);
+    if (sz > gv->config.fragment_size || sz > gv->config.max_sample_size)
+      return false;
+  }
+  return true;
+}
+
+dds_return_t write_sample_batch_gc (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, uint32_t n, struct ddsi_serdata **serdata, struct ddsi_tkmap_instance **tk, uint32_t *nwritten)
+{
+  struct { struct nn_xmsg *data, *parity; } *msgs;
+  uint32_t i, nbatched = 0;
+  dds_return_t r = DDS_RETCODE_OK;
+
+  *nwritten = 0;
+  if (!write_sample_batch_is_simple (wr, xp, n, serdata))
+    goto one_by_one;
+
+  /* Consecutive sequence numbers, WHC insertion and message construction all
+     under one lock hold; the messages get packed after releasing the lock, with
+     only a single heartbeat per chunk.  A chunk ends when the WHC goes over
+     the high-water mark, so that the next one gets throttled the same way a
+     single write would */
+  msgs = ddsrt_malloc (n * sizeof (*msgs));
+  while (nbatched < n && r == DDS_RETCODE_OK)
+  {
+    struct nn_xmsg *hmsg = NULL;
+    struct whc_state whcst;
+    uint32_t nmsgs = 0;
+    int hbansreq = 0;
+
+    ddsrt_mutex_lock (&wr->e.lock);
+    if (!wr->alive)
+      writer_set_alive_may_unlock (wr, true);
+    if ((r = writer_throttle_if_whc_full (ts1, xp, wr, 0)) != DDS_RETCODE_OK)
+    {
+      ddsrt_mutex_unlock (&wr->e.lock);
+      break;
+    }
+    if (wr->state != WRST_OPERATIONAL)
+    {
+      r = DDS_RETCODE_PRECONDITION_NOT_MET;
+      ddsrt_mutex_unlock (&wr->e.lock);
+      break;
+    }
+    if (wr->cs_seq != 0 || ddsrt_atomic_ld32 (&wr->num_readers_content_filtered) > 0 || wr->test_drop_outgoing_data)
+    {
+      ddsrt_mutex_unlock (&wr->e.lock);
+      ddsrt_free (msgs);
+      goto one_by_one;
+    }
+    writer_renew_manual_lease (wr);
+
+    const ddsrt_mtime_t tnow = ddsrt_time_monotonic ();
+    const bool nodst = addrset_empty (wr->as) && (wr->as_group == NULL || addrset_empty (wr->as_group));
+    const uint32_t chunk_start = nbatched;
+    while (nbatched < n)
+    {
+      /* after throttling, a sample always goes in, as it does for a single write;
+         the WHC's accounting includes overhead, so ask it rather than estimate */
+      if (nbatched > chunk_start)
+      {
+        whc_get_state (wr->whc, &whcst);
+        if (whcst.unacked_bytes > wr->whc_high)
+          break;
+      }
+      const seqno_t seq = ++wr->seq;
+      serdata[nbatched]->twrite = tnow;
+      if ((r = insert_sample_in_whc (wr, seq, NULL, serdata[nbatched], tk[nbatched])) < 0)
+        break;
+      r = DDS_RETCODE_OK;
+      if (nodst)
+        writer_update_seq_xmit (wr, seq);
+      else if (create_fragment_message_simple (wr, seq, serdata[nbatched], &msgs[nmsgs].data) >= 0)
+      {
+        msgs[nmsgs].parity = writer_fec_note_data (wr, msgs[nmsgs].data);
+        nmsgs++;
+      }
+      nbatched++;
+      (*nwritten)++;
+    }
+    if (nmsgs > 0 && wr->heartbeat_xevent)
+    {
+      whc_get_state (wr->whc, &whcst);
+      hmsg = writer_hbcontrol_piggyback (wr, &whcst, tnow, nn_xpack_packetid (xp), &hbansreq);
+    }
+    ddsrt_mutex_unlock (&wr->e.lock);
+
+    for (i = 0; i < nmsgs; i++)
+    {
+      nn_xpack_addmsg (xp, msgs[i].data, 0);
+      if (msgs[i].parity)
+        nn_xpack_addmsg (xp, msgs[i].parity, 0);
+    }
+    if (hmsg)
+      nn_xpack_addmsg (xp, hmsg, 0);
+    if (hbansreq >= 2)
+      nn_xpack_send (xp, true);
+  }
+  ddsrt_free (msgs);
+  goto drop;
+
+one_by_one:
+  /* the WHC took its own references to the ones written in a batch */
+  for (i = 0; i < nbatched; i++)
+    ddsi_serdata_unref (serdata[i]);
+  serdata += nbatched;
+  n -= nbatched;
+  for (i = 0, r = DDS_RETCODE_OK; i < n && r >= 0; i++)
+  {
+    if ((r = write_sample_eot (ts1, xp, wr, NULL, serdata[i], tk[nbatched + i], 0, 1, 0)) >= 0)
+      (*nwritten)++;
+  }
+  /* write_sample_eot consumed the ones it was given */
+  serdata += i;
+  n -= i;
+
+drop:
+  for (i = 0; i < n; i++)
+    ddsi_serdata_unref (serdata[i]);
+  return (r < 0) ? r : DDS_RETCODE_OK;
 }
 
 int write_sample_nogc (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
 {
-  return write_sample_eot (ts1, xp, wr, NULL, serdata, tk, 0, 0);
+  return write_sample_eot (ts1, xp, wr, NULL, serdata, tk, 0, 0, 0);
 }
 
 int write_sample_gc_notk (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata)
@@ -1374,7 +1876,7 @@ int write_sample_gc_notk (struct thread_state1 * const ts1, struct nn_xpack *xp,
   int res;
   assert (thread_is_awake ());
   tk = ddsi_tkmap_lookup_instance_ref (wr->e.gv->m_tkmap, serdata);
-  res = write_sample_eot (ts1, xp, wr, NULL, serdata, tk, 0, 1);
+  res = write_sample_eot (ts1, xp, wr, NULL, serdata, tk, 0, 1, 0);
   ddsi_tkmap_instance_unref (wr->e.gv->m_tkmap, tk);
   return res;
 }
@@ -1385,7 +1887,7 @@ int write_sample_nogc_notk (struct thread_state1 * const ts1, struct nn_xpack *x
   int res;
   assert (thread_is_awake ());
   tk = ddsi_tkmap_lookup_instance_ref (wr->e.gv->m_tkmap, serdata);
-  res = write_sample_eot (ts1, xp, wr, NULL, serdata, tk, 0, 0);
+  res = write_sample_eot (ts1, xp, wr, NULL, serdata, tk, 0, 0, 0);
   ddsi_tkmap_instance_unref (wr->e.gv->m_tkmap, tk);
   return res;
 }
@@ -11,6 +11,7 @@
  */
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "dds/ddsrt/atomics.h"
 #include "dds/ddsrt/heap.h"
@@ -140,11 +141,38 @@ struct xevent_nt
   } u;
 };
 
+/* Retransmits are queued per destination rather than in the non-timed list, with the
+   destination the proxy reader for which they are intended, or the all-zero GUID if they
+   are addressed to all readers of the writer.  The queues are serviced round-robin, each
+   one limited by its own token bucket, so that a single reader on a bad link can't claim
+   all of the retransmit capacity.  A bucket without any queued messages retains its
+   tokens and statistics until the destination is forgotten. */
+struct rexmit_bucket {
+  ddsrt_avl_node_t avlnode;
+  ddsi_guid_t dst;
+  struct rexmit_bucket *rr_next; /* next in ring of buckets with queued messages, NULL if not in ring */
+  struct xevent_nt *oldest;
+  struct xevent_nt *newest; /* undefined if oldest == NULL */
+  size_t queued_bytes;
+  int64_t tokens; /* bytes, negative if a message larger than what was available has been sent */
+  ddsrt_mtime_t tlast; /* time tokens was last updated */
+  ddsrt_mtime_t twindow; /* start of window for estimating the rate */
+  uint64_t window_bytes;
+  bool forget; /* free once no more messages are queued */
+  struct xeventq_rexmit_stats stats;
+};
+
 struct xeventq {
   ddsrt_fibheap_t xevents;
   ddsrt_avl_tree_t msg_xevents;
   struct xevent_nt *non_timed_xmit_list_oldest;
   struct xevent_nt *non_timed_xmit_list_newest; /* undefined if ..._oldest == NULL */
+  ddsrt_avl_tree_t rexmit_buckets;
+  struct rexmit_bucket *rexmit_rr_prev; /* predecessor of next bucket to service, NULL if none queued */
+  uint32_t rexmit_nactive; /* number of buckets with queued messages */
+  ddsrt_mtime_t rexmit_tnext; /* earliest time a queued retransmit may be sent */
+  int64_t rexmit_rate; /* bytes/s per destination, 0 if unlimited */
+  int64_t rexmit_burst;
   size_t queued_rexmit_bytes;
   size_t queued_rexmit_msgs;
   size_t max_queued_rexmit_bytes;
@@ -156,6 +184,16 @@ struct xeventq {
   ddsrt_cond_t cond;
   uint32_t auxiliary_bandwidth_limit;
 
+  /* Heartbeats generated while handling a batch of timed events are held
+     back until the batch is complete, then sent grouped by destination.
+     Only accessed by the event thread. */
+  struct nn_xmsg **hb_staged;
+  uint32_t *hb_group; /* scratch space for grouping */
+  uint32_t hb_nstaged;
+  uint32_t hb_staged_size;
+  int64_t hb_window;
+  struct xeventq_heartbeat_stats hb_stats;
+
   size_t cum_rexmit_bytes;
 };
 
@@ -167,6 +205,13 @@ static void handle_nontimed_xevent (struct xevent_nt *xev, struct nn_xpack *xp);
 
 static const ddsrt_avl_treedef_t msg_xevents_treedef = DDSRT_AVL_TREEDEF_INITIALIZER_INDKEY (offsetof (struct xevent_nt, u.msg_rexmit.msg_avlnode), offsetof (struct xevent_nt, u.msg_rexmit.msg), msg_xevents_cmp, 0);
 
+static int compare_guid (const void *va, const void *vb)
+{
+  return memcmp (va, vb, sizeof (ddsi_guid_t));
+}
+
+static const ddsrt_avl_treedef_t rexmit_buckets_treedef = DDSRT_AVL_TREEDEF_INITIALIZER (offsetof (struct rexmit_bucket, avlnode), offsetof (struct rexmit_bucket, dst), compare_guid, 0);
+
 static const ddsrt_fibheap_def_t evq_xevents_fhdef = DDSRT_FIBHEAPDEF_INITIALIZER(offsetof (struct xevent, heapnode), compare_xevent_tsched);
 
 static int compare_xevent_tsched (const void *va, const void *vb)
@@ -296,6 +341,196 @@ static int compute_non_timed_xmit_list_size (struct xeventq *evq)
   return i;
 }
 
+static struct rexmit_bucket *lookup_rexmit_bucket (struct xeventq *evq, const ddsi_guid_t *dst, ddsrt_mtime_t tnow)
+{
+  struct rexmit_bucket *b;
+  ddsrt_avl_ipath_t path;
+  ASSERT_MUTEX_HELD (&evq->lock);
+  if ((b = ddsrt_avl_lookup_ipath (&rexmit_buckets_treedef, &evq->rexmit_buckets, dst, &path)) == NULL)
+  {
+    b = ddsrt_malloc (sizeof (*b));
+    b->dst = *dst;
+    b->rr_next = NULL;
+    b->oldest = b->newest = NULL;
+    b->queued_bytes = 0;
+    b->tokens = evq->rexmit_burst;
+    b->tlast = b->twindow = tnow;
+    b->window_bytes = 0;
+    b->forget = false;
+    memset (&b->stats, 0, sizeof (b->stats));
+    ddsrt_avl_insert_ipath (&rexmit_buckets_treedef, &evq->rexmit_buckets, b, &path);
+  }
+  return b;
+}
+
+static void refill_rexmit_bucket (const struct xeventq *evq, struct rexmit_bucket *b, ddsrt_mtime_t tnow)
+{
+  if (evq->rexmit_rate == 0)
+    b->tokens = evq->rexmit_burst;
+  else if (tnow.v > b->tlast.v)
+  {
+    /* cap the interval to avoid overflow, anything beyond a few seconds fills it anyway */
+    const int64_t dt = (tnow.v - b->tlast.v < DDS_SECS (1000)) ? tnow.v - b->tlast.v : DDS_SECS (1000);
+    b->tokens += (int64_t) ((double) evq->rexmit_rate * (double) dt / 1e9);
+    if (b->tokens > evq->rexmit_burst)
+      b->tokens = evq->rexmit_burst;
+  }
+  b->tlast = tnow;
+}
+
+static void update_rexmit_rate (struct rexmit_bucket *b, size_t bytes, ddsrt_mtime_t tnow)
+{
+  if (tnow.v - b->twindow.v >= DDS_SECS (1))
+  {
+    b->stats.rate = (uint32_t) ((double) b->window_bytes * 1e9 / (double) (tnow.v - b->twindow.v));
+    b->twindow = tnow;
+    b->window_bytes = 0;
+  }
+  b->window_bytes += bytes;
+}
+
+static bool rexmit_bucket_over_fair_share (const struct xeventq *evq, const struct rexmit_bucket *b)
+{
+  /* Once the retransmit queue is half full, a destination holding more than its share of
+     the queue gets its further retransmits dropped, so that a slowly drained queue for one
+     reader doesn't cause the retransmits for the others to be dropped */
+  if (evq->queued_rexmit_bytes <= evq->max_queued_rexmit_bytes / 2)
+    return false;
+  const uint32_t n = evq->rexmit_nactive + (b->oldest == NULL ? 1 : 0);
+  return b->queued_bytes >= evq->max_queued_rexmit_bytes / n;
+}
+
+static void add_to_rexmit_bucket (struct xeventq *evq, struct rexmit_bucket *b, struct xevent_nt *ev)
+{
+  ev->listnode.next = NULL;
+  if (b->oldest == NULL)
+  {
+    b->oldest = ev;
+    /* join the ring just before the next one in line, so it gets its turn last */
+    if (evq->rexmit_rr_prev == NULL)
+      b->rr_next = b;
+    else
+    {
+      b->rr_next = evq->rexmit_rr_prev->rr_next;
+      evq->rexmit_rr_prev->rr_next = b;
+    }
+    evq->rexmit_rr_prev = b;
+    evq->rexmit_nactive++;
+  }
+  else
+  {
+    b->newest->listnode.next = ev;
+  }
+  b->newest = ev;
+  b->queued_bytes += ev->u.msg_rexmit.queued_rexmit_bytes;
+  b->stats.queued++;
+
+  if (ev->kind == XEVK_MSG_REXMIT)
+    remember_msg (evq, ev);
+
+  evq->rexmit_tnext.v = 0;
+  ddsrt_cond_broadcast (&evq->cond);
+}
+
+static struct xevent_nt *getnext_from_rexmit_buckets (struct xeventq *evq, ddsrt_mtime_t tnow, bool ignore_limit)
+{
+  /* Visits the buckets with queued messages in round-robin order, returning the oldest
+     message of the first one with tokens available and advancing the ring.  If none has
+     tokens, it sets rexmit_tnext to the earliest time at which one will. */
+  ddsrt_mtime_t tnext = DDSRT_MTIME_NEVER;
+  struct rexmit_bucket *prev, *stop;
+  ASSERT_MUTEX_HELD (&evq->lock);
+  if ((prev = stop = evq->rexmit_rr_prev) == NULL)
+  {
+    evq->rexmit_tnext = DDSRT_MTIME_NEVER;
+    return NULL;
+  }
+  do {
+    struct rexmit_bucket * const b = prev->rr_next;
+    refill_rexmit_bucket (evq, b, tnow);
+    if (b->tokens > 0 || ignore_limit)
+    {
+      struct xevent_nt * const ev = b->oldest;
+      const size_t size = nn_xmsg_size (ev->u.msg_rexmit.msg);
+      if ((b->oldest = ev->listnode.next) != NULL)
+        evq->rexmit_rr_prev = b;
+      else
+      {
+        if (b == prev)
+          evq->rexmit_rr_prev = NULL;
+        else
+        {
+          prev->rr_next = b->rr_next;
+          evq->rexmit_rr_prev = prev;
+        }
+        b->rr_next = NULL;
+        evq->rexmit_nactive--;
+      }
+      if (ev->kind == XEVK_MSG_REXMIT)
+      {
+        assert (lookup_msg (evq, ev->u.msg_rexmit.msg) == ev);
+        forget_msg (evq, ev);
+      }
+      if (evq->rexmit_rate > 0)
+        b->tokens -= (int64_t) size;
+      b->queued_bytes -= ev->u.msg_rexmit.queued_rexmit_bytes;
+      b->stats.queued--;
+      b->stats.msgs++;
+      b->stats.bytes += size;
+      update_rexmit_rate (b, size, tnow);
+      if (b->oldest == NULL && b->forget)
+      {
+        ddsrt_avl_delete (&rexmit_buckets_treedef, &evq->rexmit_buckets, b);
+        ddsrt_free (b);
+      }
+      return ev;
+    }
+    else
+    {
+      const double dt = (double) (1 - b->tokens) * 1e9 / (double) evq->rexmit_rate;
+      const ddsrt_mtime_t t = ddsrt_mtime_add_duration (tnow, (dt < (double) DDS_SECS (1000)) ? (dds_duration_t) dt + 1 : DDS_SECS (1000));
+      if (t.v < tnext.v)
+        tnext = t;
+    }
+    prev = b;
+  } while (prev != stop);
+  evq->rexmit_tnext = tnext;
+  return NULL;
+}
+
+bool xeventq_get_rexmit_stats (struct xeventq *evq, const ddsi_guid_t *dst, struct xeventq_rexmit_stats *st)
+{
+  struct rexmit_bucket *b;
+  ddsrt_mutex_lock (&evq->lock);
+  if ((b = ddsrt_avl_lookup (&rexmit_buckets_treedef, &evq->rexmit_buckets, dst)) != NULL)
+  {
+    const ddsrt_mtime_t tnow = ddsrt_time_monotonic ();
+    *st = b->stats;
+    /* the rate is only updated when something is sent, so let it decay if nothing is */
+    if (tnow.v - b->twindow.v >= DDS_SECS (1))
+      st->rate = (uint32_t) ((double) b->window_bytes * 1e9 / (double) (tnow.v - b->twindow.v));
+  }
+  ddsrt_mutex_unlock (&evq->lock);
+  return b != NULL;
+}
+
+void xeventq_forget_rexmit_destination (struct xeventq *evq, const ddsi_guid_t *dst)
+{
+  struct rexmit_bucket *b;
+  ddsrt_mutex_lock (&evq->lock);
+  if ((b = ddsrt_avl_lookup (&rexmit_buckets_treedef, &evq->rexmit_buckets, dst)) != NULL)
+  {
+    if (b->oldest != NULL)
+      b->forget = true;
+    else
+    {
+      ddsrt_avl_delete (&rexmit_buckets_treedef, &evq->rexmit_buckets, b);
+      ddsrt_free (b);
+    }
+  }
+  ddsrt_mutex_unlock (&evq->lock);
+}
+
 #ifndef NDEBUG
 static int nontimed_xevent_in_queue (struct xeventq *evq, struct xevent_nt *ev)
 {
@@ -513,6 +748,12 @@ struct xeventq * xeventq_new (struct ddsi_domaingv *gv, size_t max_queued_rexmit
   ddsrt_avl_init (&msg_xevents_treedef, &evq->msg_xevents);
   evq->non_timed_xmit_list_oldest = NULL;
   evq->non_timed_xmit_list_newest = NULL;
+  ddsrt_avl_init (&rexmit_buckets_treedef, &evq->rexmit_buckets);
+  evq->rexmit_rr_prev = NULL;
+  evq->rexmit_nactive = 0;
+  evq->rexmit_tnext = DDSRT_MTIME_NEVER;
+  evq->rexmit_rate = gv->config.rexmit_reader_bandwidth_limit;
+  evq->rexmit_burst = (gv->config.rexmit_reader_burst_size > 0) ? gv->config.rexmit_reader_burst_size : 1;
   evq->terminate = 0;
   evq->ts = NULL;
   evq->max_queued_rexmit_bytes = max_queued_rexmit_bytes;
@@ -520,6 +761,12 @@ struct xeventq * xeventq_new (struct ddsi_domaingv *gv, size_t max_queued_rexmit
   evq->auxiliary_bandwidth_limit = auxiliary_bandwidth_limit;
   evq->queued_rexmit_bytes = 0;
   evq->queued_rexmit_msgs = 0;
+  evq->hb_staged = NULL;
+  evq->hb_group = NULL;
+  evq->hb_nstaged = 0;
+  evq->hb_staged_size = 0;
+  evq->hb_window = gv->config.hb_aggregation_window;
+  memset (&evq->hb_stats, 0, sizeof (evq->hb_stats));
   evq->gv = gv;
   ddsrt_mutex_init (&evq->lock);
   ddsrt_cond_init (&evq->cond);
@@ -578,6 +825,12 @@ void xeventq_free (struct xeventq *evq)
       thread_state_awake_to_awake_no_nest (lookup_thread_state ());
       handle_nontimed_xevent (getnext_from_non_timed_xmit_list (evq), xp);
     }
+    struct xevent_nt *xev;
+    while ((xev = getnext_from_rexmit_buckets (evq, ddsrt_time_monotonic (), true)) != NULL)
+    {
+      thread_state_awake_to_awake_no_nest (lookup_thread_state ());
+      handle_nontimed_xevent (xev, xp);
+    }
     ddsrt_mutex_unlock (&evq->lock);
     nn_xpack_send (xp, false);
     nn_xpack_free (xp);
@@ -585,6 +838,10 @@ void xeventq_free (struct xeventq *evq)
   }
 
   assert (ddsrt_avl_is_empty (&evq->msg_xevents));
+  assert (evq->hb_nstaged == 0);
+  ddsrt_avl_free (&rexmit_buckets_treedef, &evq->rexmit_buckets, ddsrt_free);
+  ddsrt_free (evq->hb_staged);
+  ddsrt_free (evq->hb_group);
   ddsrt_cond_destroy (&evq->cond);
   ddsrt_mutex_destroy (&evq->lock);
   ddsrt_free (evq);
@@ -706,6 +963,71 @@ static void send_heartbeat_to_all_readers (struct nn_xpack *xp, struct xevent *e
 }
 #endif
 
+static void stage_heartbeat (struct xeventq *evq, struct nn_xmsg *msg)
+{
+  if (evq->hb_nstaged == evq->hb_staged_size)
+  {
+    evq->hb_staged_size = (evq->hb_staged_size == 0) ? 16 : 2 * evq->hb_staged_size;
+    evq->hb_staged = ddsrt_realloc (evq->hb_staged, evq->hb_staged_size * sizeof (*evq->hb_staged));
+    evq->hb_group = ddsrt_realloc (evq->hb_group, evq->hb_staged_size * sizeof (*evq->hb_group));
+  }
+  evq->hb_staged[evq->hb_nstaged++] = msg;
+}
+
+static void send_staged_heartbeats (struct xeventq *evq, struct nn_xpack *xp)
+{
+  /* Messages to the same destination added to the xpack one after the other
+     end up in the same RTPS message (as far as the size limit allows).  Address
+     sets have no cheap total order, so the grouping is done by pairwise
+     comparison, but the number of distinct destinations is typically small. */
+  struct nn_xmsg ** const staged = evq->hb_staged;
+  uint32_t * const group = evq->hb_group;
+  const uint32_t n = evq->hb_nstaged;
+  uint32_t npackets = 0;
+
+  ASSERT_MUTEX_HELD (&evq->lock);
+  if (n == 0)
+    return;
+  for (uint32_t i = 0; i < n; i++)
+    group[i] = UINT32_MAX;
+  for (uint32_t i = 0; i < n; i++)
+  {
+    if (group[i] != UINT32_MAX)
+      continue;
+    group[i] = i;
+    for (uint32_t j = i + 1; j < n; j++)
+      if (group[j] == UINT32_MAX && nn_xmsg_same_dst_onesidederr (staged[i], staged[j]))
+        group[j] = i;
+  }
+
+  /* Adding to the xpack may sleep for bandwidth limiting */
+  ddsrt_mutex_unlock (&evq->lock);
+  for (uint32_t i = 0; i < n; i++)
+  {
+    if (group[i] != i)
+      continue;
+    for (uint32_t j = i; j < n; j++)
+    {
+      if (group[j] == i && (nn_xpack_addmsg (xp, staged[j], 0) > 0 || npackets == 0))
+        npackets++;
+    }
+  }
+  ddsrt_mutex_lock (&evq->lock);
+
+  if (n > 1)
+    EVQTRACE ("heartbeats: %"PRIu32" in %"PRIu32" packets\n", n, npackets);
+  evq->hb_stats.heartbeats += n;
+  evq->hb_stats.packets_saved += n - npackets;
+  evq->hb_nstaged = 0;
+}
+
+void xeventq_get_heartbeat_stats (struct xeventq *evq, struct xeventq_heartbeat_stats *st)
+{
+  ddsrt_mutex_lock (&evq->lock);
+  *st = evq->hb_stats;
+  ddsrt_mutex_unlock (&evq->lock);
+}
+
 static void handle_xevk_heartbeat (struct nn_xpack *xp, struct xevent *ev, ddsrt_mtime_t tnow)
 {
   struct ddsi_domaingv const * const gv = ev->evq->gv;
@@ -771,7 +1093,7 @@ static void handle_xevk_heartbeat (struct nn_xpack *xp, struct xevent *ev, ddsrt
   if (msg)
   {
     if (!wr->test_suppress_heartbeat)
-      nn_xpack_addmsg (xp, msg, 0);
+      stage_heartbeat (ev->evq, msg);
     else
     {
       GVTRACE ("test_suppress_heartbeat\n");
@@ -1216,16 +1538,47 @@ static void handle_xevents (struct thread_state1 * const ts1, struct xeventq *xe
       tnow = ddsrt_time_monotonic ();
     }
 
+    /* Heartbeats due within the aggregation window are handled now as well
+       (as if it were the time they were scheduled for) if that allows them
+       to share packets with the heartbeats just generated */
+    while (xevq->hb_nstaged > 0)
+    {
+      struct xevent *xev = ddsrt_fibheap_min (&evq_xevents_fhdef, &xevq->xevents);
+      if (xev == NULL || xev->kind != XEVK_HEARTBEAT)
+        break;
+      const ddsrt_mtime_t tsched = xev->tsched;
+      if (tsched.v == TSCHED_DELETE || tsched.v > tnow.v + xevq->hb_window)
+        break;
+      (void) ddsrt_fibheap_extract_min (&evq_xevents_fhdef, &xevq->xevents);
+      xev->tsched.v = DDS_NEVER;
+      thread_state_awake_to_awake_no_nest (ts1);
+      handle_timed_xevent (ts1, xev, xp, tsched);
+    }
+    send_staged_heartbeats (xevq, xp);
+
+    xeventsToProcess = 0;
     if (!non_timed_xmit_list_is_empty (xevq))
     {
       struct xevent_nt *xev = getnext_from_non_timed_xmit_list (xevq);
       thread_state_awake_to_awake_no_nest (ts1);
       handle_nontimed_xevent (xev, xp);
       tnow = ddsrt_time_monotonic ();
+      xeventsToProcess = 1;
     }
-    else
+
+    /* Interleave retransmits with the other non-timed events, these are taken from
+       the per-destination queues in round-robin order as far as their token buckets
+       allow */
+    if (xevq->rexmit_tnext.v <= tnow.v)
     {
-      xeventsToProcess = 0;
+      struct xevent_nt *xev;
+      if ((xev = getnext_from_rexmit_buckets (xevq, tnow, false)) != NULL)
+      {
+        thread_state_awake_to_awake_no_nest (ts1);
+        handle_nontimed_xevent (xev, xp);
+        tnow = ddsrt_time_monotonic ();
+        xeventsToProcess = 1;
+      }
     }
   }
 
@@ -1262,6 +1615,8 @@ static uint32_t xevent_thread (struct xeventq * xevq)
     else
     {
       ddsrt_mtime_t twakeup = earliest_in_xeventq (xevq);
+      if (xevq->rexmit_tnext.v < twakeup.v)
+        twakeup = xevq->rexmit_tnext;
       if (twakeup.v == DDS_NEVER)
       {
         /* no scheduled events nor any non-timed events */
@@ -1356,11 +1711,13 @@ void qxev_pwr_entityid (struct proxy_writer *pwr, const ddsi_guid_t *guid)
   }
 }
 
-int qxev_msg_rexmit_wrlock_held (struct xeventq *evq, struct nn_xmsg *msg, int force)
+int qxev_msg_rexmit_wrlock_held (struct xeventq *evq, struct nn_xmsg *msg, int force, const struct proxy_reader *prd)
 {
+  static const ddsi_guid_t all_readers;
   struct ddsi_domaingv * const gv = evq->gv;
   size_t msg_size = nn_xmsg_size (msg);
   struct xevent_nt *ev;
+  struct rexmit_bucket *b;
 
   assert (evq);
   assert (nn_xmsg_kind (msg) == NN_XMSG_KIND_DATA_REXMIT || nn_xmsg_kind (msg) == NN_XMSG_KIND_DATA_REXMIT_NOMERGE);
@@ -1372,11 +1729,15 @@ int qxev_msg_rexmit_wrlock_held (struct xeventq *evq, struct nn_xmsg *msg, int f
     nn_xmsg_free (msg);
     return 1;
   }
-  else if ((evq->queued_rexmit_bytes > evq->max_queued_rexmit_bytes ||
-            evq->queued_rexmit_msgs == evq->max_queued_rexmit_msgs) &&
-           !force)
+
+  b = lookup_rexmit_bucket (evq, prd ? &prd->e.guid : &all_readers, ddsrt_time_monotonic ());
+  if ((evq->queued_rexmit_bytes > evq->max_queued_rexmit_bytes ||
+       evq->queued_rexmit_msgs == evq->max_queued_rexmit_msgs ||
+       rexmit_bucket_over_fair_share (evq, b)) &&
+      !force)
   {
     /* drop it if insufficient resources available */
+    b->stats.dropped++;
     ddsrt_mutex_unlock (&evq->lock);
     nn_xmsg_free (msg);
 #if 0
@@ -1394,7 +1755,7 @@ int qxev_msg_rexmit_wrlock_held (struct xeventq *evq, struct nn_xmsg *msg, int f
     ev->u.msg_rexmit.queued_rexmit_bytes = msg_size;
     evq->queued_rexmit_bytes += msg_size;
     evq->queued_rexmit_msgs++;
-    qxev_insert_nt (ev);
+    add_to_rexmit_bucket (evq, b, ev);
 #if 0
     GVTRACE ("AAA(%p,%"PA_PRIuSIZE")", (void *) ev, msg_size);
 #endif
@@ -22,6 +22,7 @@
 #include "dds/ddsrt/atomics.h"
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/random.h"
+#include "dds/ddsrt/mh3.h"
 
 #include "dds/ddsrt/avl.h"
 
@@ -39,8 +40,10 @@
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/ddsi_entity_index.h"
 #include "dds/ddsi/q_freelist.h"
+#include "dds/ddsi/sysdeps.h"
 #include "dds/ddsi/ddsi_serdata_default.h"
 #include "dds/ddsi/ddsi_security_omg.h"
+#include "dds/ddsi/ddsi_uring.h"
 
 #define NN_XMSG_MAX_ALIGN 8
 #define NN_XMSG_CHUNK_SIZE 128
@@ -162,6 +165,7 @@ struct nn_xpack
   ddsrt_iovec_t *iov;
   enum nn_xmsg_dstmode dstmode;
   struct ddsi_domaingv *gv;
+  uint32_t xmit_conn_idx; /* socket in the interface's transmit pool, 0 = the default one */
 
   union
   {
@@ -190,6 +194,16 @@ struct nn_xpack
 #ifdef DDS_HAS_SECURITY
   nn_msg_sec_info_t sec_info;
 #endif
+
+  /* Adaptive batching (see nn_xpack_send_or_defer), owner_lock is the lock
+     protecting the xpack and NULL if adaptive batching is disabled */
+  ddsrt_mutex_t *owner_lock;
+  ddsrt_mtime_t tdeadline;        /* [owner_lock] latest time for sending pending data */
+  ddsrt_mtime_t tlast;            /* [owner_lock] time of previous nn_xpack_send_or_defer */
+  int64_t intv_estim;             /* [owner_lock] smoothed interval between writes */
+  struct nn_xpack *deferred_next; /* [sendq_lock] */
+  ddsrt_mtime_t tdeferred;        /* [sendq_lock] time at which the sendq thread flushes it */
+  bool deferred;                  /* [sendq_lock] in the sendq's list of deferred flushes */
 };
 
 static size_t align4u (size_t x)
@@ -375,6 +389,7 @@ static int submsg_is_compatible (const struct nn_xmsg *msg, SubmessageKind_t smk
         case SMID_HEARTBEAT_FRAG:
         case SMID_ADLINK_MSG_LEN:
         case SMID_ADLINK_ENTITY_ID:
+        case SMID_ADLINK_FEC:
           /* normal control stuff is ok */
           return 1;
         case SMID_DATA: case SMID_DATA_FRAG:
@@ -423,6 +438,7 @@ static int submsg_is_compatible (const struct nn_xmsg *msg, SubmessageKind_t smk
         case SMID_HEARTBEAT_FRAG:
         case SMID_ADLINK_MSG_LEN:
         case SMID_ADLINK_ENTITY_ID:
+        case SMID_ADLINK_FEC:
           /* anything else is strictly verboten */
           return 0;
       }
@@ -476,6 +492,37 @@ void *nn_xmsg_payload (size_t *sz, struct nn_xmsg *m)
   return m->data->payload;
 }
 
+bool nn_xmsg_data_submsg (const struct nn_xmsg *m, ddsrt_iovec_t iov[2], uint32_t *niov, ddsi_time_t *timestamp)
+{
+  /* The xmsg was constructed locally, so all submessage headers are in
+     native byte order and always have a valid octetsToNextHeader */
+  size_t off = 0;
+  *timestamp = DDSI_TIME_INVALID;
+  while (off + RTPS_SUBMESSAGE_HEADER_SIZE <= m->sz)
+  {
+    const SubmessageHeader_t *hdr = (const SubmessageHeader_t *) (m->data->payload + off);
+    switch (hdr->submessageId)
+    {
+      case SMID_INFO_TS:
+        if (!(hdr->flags & INFOTS_INVALIDATE_FLAG))
+          *timestamp = ((const InfoTimestamp_t *) hdr)->time;
+        break;
+      case SMID_DATA:
+      case SMID_DATA_FRAG:
+        iov[0].iov_base = m->data->payload + off;
+        iov[0].iov_len = (ddsrt_iov_len_t) (m->sz - off);
+        *niov = 1;
+        if (m->refd_payload)
+          iov[(*niov)++] = m->refd_payload_iov;
+        return true;
+      default:
+        break;
+    }
+    off += RTPS_SUBMESSAGE_HEADER_SIZE + hdr->octetsToNextHeader;
+  }
+  return false;
+}
+
 void nn_xmsg_payload_to_plistsample (struct ddsi_plist_sample *dst, nn_parameterid_t keyparam, const struct nn_xmsg *m)
 {
   dst->blob = m->data->payload;
@@ -1126,6 +1173,7 @@ static void nn_xpack_reinit (struct nn_xpack *xp)
   xp->includes_rexmit = false;
   xp->included_msgs.latest = NULL;
   xp->maxdelay = DDS_INFINITY;
+  xp->tdeadline.v = DDS_NEVER;
 #ifdef DDS_HAS_SECURITY
   xp->sec_info.use_rtps_encoding = 0;
 #endif
@@ -1144,6 +1192,7 @@ struct nn_xpack * nn_xpack_new (struct ddsi_domaingv *gv, uint32_t bw_limit, boo
   xp->async_mode = async_mode;
   xp->iov = NULL;
   xp->gv = gv;
+  xp->owner_lock = NULL;
 
   /* Fixed header fields, initialized just once */
   xp->hdr.protocol.id[0] = 'R';
@@ -1178,9 +1227,35 @@ void nn_xpack_free (struct nn_xpack *xp)
   ddsrt_free (xp);
 }
 
+void nn_xpack_select_xmit_conn (struct nn_xpack *xp, const ddsi_guid_t *guid)
+{
+  struct ddsi_domaingv const * const gv = xp->gv;
+  if (gv->xmit_conn_pool == NULL)
+    xp->xmit_conn_idx = 0;
+  else
+    xp->xmit_conn_idx = ddsrt_mh3 (guid, sizeof (*guid), 0) % gv->config.xmit_conn_pool_size;
+}
+
+static struct ddsi_tran_conn *nn_xpack_xmit_conn (const struct nn_xpack *xp, struct ddsi_tran_conn *conn)
+{
+  /* Locators reference the default transmit socket of the interface, so
+     that's the one to replace by the selected one of that interface; any
+     other socket (TCP, for example) is used as-is */
+  struct ddsi_domaingv const * const gv = xp->gv;
+  if (xp->xmit_conn_idx == 0)
+    return conn;
+  for (int i = 0; i < gv->n_interfaces; i++)
+  {
+    if (conn == gv->xmit_conns[i])
+      return gv->xmit_conn_pool[(uint32_t) i * (gv->config.xmit_conn_pool_size - 1) + xp->xmit_conn_idx - 1];
+  }
+  return conn;
+}
+
 static ssize_t nn_xpack_send_rtps(struct nn_xpack * xp, const ddsi_xlocator_t *loc)
 {
   ssize_t ret = -1;
+  struct ddsi_tran_conn * const conn = nn_xpack_xmit_conn (xp, loc->conn);
 
 #ifdef DDS_HAS_SECURITY
   /* Only encode when needed. */
@@ -1188,7 +1263,7 @@ static ssize_t nn_xpack_send_rtps(struct nn_xpack * xp, const ddsi_xlocator_t *l
   {
     ret = secure_conn_write(
                       xp->gv,
-                      loc->conn,
+                      conn,
                       &loc->c,
                       xp->niov,
                       xp->iov,
@@ -1201,7 +1276,7 @@ static ssize_t nn_xpack_send_rtps(struct nn_xpack * xp, const ddsi_xlocator_t *l
   else
 #endif /* DDS_HAS_SECURITY */
   {
-    ret = ddsi_conn_write (loc->conn, &loc->c, xp->niov, xp->iov, xp->call_flags);
+    ret = ddsi_conn_write (conn, &loc->c, xp->niov, xp->iov, xp->call_flags);
   }
 
   return ret;
@@ -1301,6 +1376,17 @@ static void nn_xpack_send_real (struct nn_xpack *xp)
     }
   }
 
+  /* With io_uring, the sends to all destinations are submitted at once; not
+     when encoding the message for security, as that uses a temporary buffer
+     for each send */
+  bool batch = gv->config.use_io_uring;
+#ifdef DDS_HAS_SECURITY
+  if (xp->sec_info.use_rtps_encoding)
+    batch = false;
+#endif
+  if (batch)
+    ddsi_uring_tx_begin ();
+
   GVTRACE (" [");
   if (xp->dstmode == NN_XMSG_DST_ONE)
   {
@@ -1331,6 +1417,12 @@ static void nn_xpack_send_real (struct nn_xpack *xp)
     }
   }
   GVTRACE (" ]\n");
+  if (batch)
+  {
+    const uint32_t nfailed = ddsi_uring_tx_end ();
+    if (nfailed > 0)
+      GVTRACE ("nn_xpack_send: %"PRIu32" sends failed\n", nfailed);
+  }
   if (calls)
   {
     GVLOG (DDS_LC_TRAFFIC, "traffic-xmit (%lu) %"PRIu32"\n", (unsigned long) calls, xp->msg_len.length);
@@ -1343,30 +1435,175 @@ static void nn_xpack_send_real (struct nn_xpack *xp)
 #define SENDQ_HW 10
 #define SENDQ_LW 0
 
+static struct nn_xpack *nn_xpack_detach (struct nn_xpack *xp)
+{
+  /* Moves the contents of xp to a new xpack for the sendq thread */
+  struct nn_xpack *xp1 = ddsrt_malloc (sizeof (*xp));
+  memcpy (xp1, xp, sizeof (*xp1));
+  if (xp->iov != NULL) {
+    xp1->iov = ddsrt_malloc (xp->niov * sizeof (*xp->iov));
+    memcpy (xp1->iov, xp->iov, (xp->niov * sizeof (*xp->iov)));
+  }
+  nn_xpack_reinit (xp);
+  xp1->sendq_next = NULL;
+  xp1->owner_lock = NULL;
+  return xp1;
+}
+
+static uint32_t nn_xpack_sendq_push (struct ddsi_domaingv *gv, struct nn_xpack *xp1)
+{
+  /* Any number of threads may push, the sendq thread always takes all of
+     them at once (nn_xpack_sendq_take_all), so there is no ABA problem.
+     Returns the length of the queue before pushing xp1. */
+  const uint32_t len = ddsrt_atomic_inc32_nv (&gv->sendq_length) - 1;
+  void *head;
+  do {
+    head = ddsrt_atomic_ldvoidp (&gv->sendq_head);
+    xp1->sendq_next = head;
+  } while (!ddsrt_atomic_casvoidp (&gv->sendq_head, head, xp1));
+  return len;
+}
+
+static struct nn_xpack *nn_xpack_sendq_take_all (struct ddsi_domaingv *gv)
+{
+  void *head;
+  do {
+    head = ddsrt_atomic_ldvoidp (&gv->sendq_head);
+  } while (head != NULL && !ddsrt_atomic_casvoidp (&gv->sendq_head, head, NULL));
+  /* Pushing yields the reverse order */
+  struct nn_xpack *xp = head, *fifo = NULL;
+  while (xp)
+  {
+    struct nn_xpack * const next = xp->sendq_next;
+    xp->sendq_next = fifo;
+    fifo = xp;
+    xp = next;
+  }
+  return fifo;
+}
+
+static void nn_xpack_sendq_link_deferred (struct ddsi_domaingv *gv, struct nn_xpack *xp, ddsrt_mtime_t tflush)
+{
+  xp->tdeferred = tflush;
+  if (!xp->deferred)
+  {
+    xp->deferred = true;
+    xp->deferred_next = gv->sendq_deferred;
+    gv->sendq_deferred = xp;
+  }
+}
+
+static void nn_xpack_sendq_unlink_deferred (struct ddsi_domaingv *gv, struct nn_xpack *xp)
+{
+  struct nn_xpack **pxp = &gv->sendq_deferred;
+  assert (xp->deferred);
+  while (*pxp != xp)
+    pxp = &(*pxp)->deferred_next;
+  *pxp = xp->deferred_next;
+  xp->deferred = false;
+}
+
+static ddsrt_mtime_t nn_xpack_sendq_flush_deferred (struct ddsi_domaingv *gv)
+{
+  /* Appends the deferred xpacks of which the deadline has expired to the
+     queue and returns the earliest deadline of the remaining ones; sendq_lock
+     must be held.  The lock order is owner_lock -> sendq_lock and the owner
+     may be blocked in nn_xpack_send waiting for this thread to drain the
+     queue, hence the trylock.  That fails only while the owner is busy, so
+     retrying a little later is good enough. */
+  const ddsrt_mtime_t tnow = ddsrt_time_monotonic ();
+  ddsrt_mtime_t tmin = DDSRT_MTIME_NEVER;
+  struct nn_xpack **pxp = &gv->sendq_deferred;
+  while (*pxp)
+  {
+    struct nn_xpack * const xp = *pxp;
+    bool keep = true;
+    if (xp->tdeferred.v <= tnow.v)
+    {
+      if (!ddsrt_mutex_trylock (xp->owner_lock))
+        xp->tdeferred = ddsrt_mtime_add_duration (tnow, DDS_USECS (100));
+      else
+      {
+        if (xp->niov > 0 && xp->tdeadline.v > tnow.v)
+          xp->tdeferred = xp->tdeadline;
+        else
+        {
+          if (xp->niov > 0)
+          {
+            /* Pushing never blocks: the queue is drained by this very thread */
+            GVTRACE ("xpack %p: latency budget expired, flushing %"PRIu32" bytes\n", (void *) xp, xp->msg_len.length);
+            (void) nn_xpack_sendq_push (gv, nn_xpack_detach (xp));
+          }
+          keep = false;
+        }
+        ddsrt_mutex_unlock (xp->owner_lock);
+      }
+    }
+    if (!keep)
+    {
+      *pxp = xp->deferred_next;
+      xp->deferred = false;
+    }
+    else
+    {
+      if (xp->tdeferred.v < tmin.v)
+        tmin = xp->tdeferred;
+      pxp = &xp->deferred_next;
+    }
+  }
+  return tmin;
+}
+
 static uint32_t nn_xpack_sendq_thread (void *vgv)
 {
   struct ddsi_domaingv *gv = vgv;
   struct thread_state1 * const ts1 = lookup_thread_state ();
   thread_state_awake_fixed_domain (ts1);
   ddsrt_mutex_lock (&gv->sendq_lock);
-  while (!(gv->sendq_stop && gv->sendq_head == NULL))
+  while (true)
   {
-    struct nn_xpack *xp;
-    if ((xp = gv->sendq_head) == NULL)
+    const ddsrt_mtime_t tflush = nn_xpack_sendq_flush_deferred (gv);
+    struct nn_xpack *xp = nn_xpack_sendq_take_all (gv);
+    if (xp == NULL)
     {
-      thread_state_asleep (ts1);
-      (void) ddsrt_cond_wait (&gv->sendq_cond, &gv->sendq_lock);
-      thread_state_awake_fixed_domain (ts1);
+      if (gv->sendq_stop)
+        break;
+      if (gv->sendq_nblocked > 0)
+        ddsrt_cond_broadcast (&gv->sendq_cond);
+      /* Writers push without taking the lock and only wake this thread if
+         they see sendq_idle set after pushing, so it must be set before
+         checking the queue one last time */
+      ddsrt_atomic_st32 (&gv->sendq_idle, 1);
+      ddsrt_atomic_fence ();
+      if (ddsrt_atomic_ldvoidp (&gv->sendq_head) == NULL)
+      {
+        thread_state_asleep (ts1);
+        if (tflush.v == DDS_NEVER)
+          (void) ddsrt_cond_wait (&gv->sendq_cond, &gv->sendq_lock);
+        else
+        {
+          const ddsrt_mtime_t tnow = ddsrt_time_monotonic ();
+          if (tflush.v > tnow.v)
+            (void) ddsrt_cond_waitfor (&gv->sendq_cond, &gv->sendq_lock, tflush.v - tnow.v);
+        }
+        thread_state_awake_fixed_domain (ts1);
+      }
+      ddsrt_atomic_st32 (&gv->sendq_idle, 0);
     }
     else
     {
-      gv->sendq_head = xp->sendq_next;
-      if (--gv->sendq_length == SENDQ_LW)
-        ddsrt_cond_broadcast (&gv->sendq_cond);
       ddsrt_mutex_unlock (&gv->sendq_lock);
-      nn_xpack_send_real (xp);
-      nn_xpack_free (xp);
+      while (xp)
+      {
+        struct nn_xpack * const next = xp->sendq_next;
+        nn_xpack_send_real (xp);
+        nn_xpack_free (xp);
+        ddsrt_atomic_dec32 (&gv->sendq_length);
+        xp = next;
+      }
       ddsrt_mutex_lock (&gv->sendq_lock);
+      if (gv->sendq_nblocked > 0 && ddsrt_atomic_ld32 (&gv->sendq_length) <= SENDQ_LW)
+        ddsrt_cond_broadcast (&gv->sendq_cond);
     }
   }
   ddsrt_mutex_unlock (&gv->sendq_lock);
@@ -1377,9 +1614,11 @@ static uint32_t nn_xpack_sendq_thread (void *vgv)
 void nn_xpack_sendq_init (struct ddsi_domaingv *gv)
 {
   gv->sendq_stop = 0;
-  gv->sendq_head = NULL;
-  gv->sendq_tail = NULL;
-  gv->sendq_length = 0;
+  ddsrt_atomic_stvoidp (&gv->sendq_head, NULL);
+  ddsrt_atomic_st32 (&gv->sendq_length, 0);
+  ddsrt_atomic_st32 (&gv->sendq_idle, 0);
+  gv->sendq_nblocked = 0;
+  gv->sendq_deferred = NULL;
   ddsrt_mutex_init (&gv->sendq_lock);
   ddsrt_cond_init (&gv->sendq_cond);
 }
@@ -1402,7 +1641,8 @@ void nn_xpack_sendq_stop (struct ddsi_domaingv *gv)
 void nn_xpack_sendq_fini (struct ddsi_domaingv *gv)
 {
   join_thread (gv->sendq_ts);
-  assert (gv->sendq_head == NULL);
+  assert (ddsrt_atomic_ldvoidp (&gv->sendq_head) == NULL);
+  assert (gv->sendq_deferred == NULL);
   ddsrt_cond_destroy (&gv->sendq_cond);
   ddsrt_mutex_destroy (&gv->sendq_lock);
 }
@@ -1416,32 +1656,95 @@ void nn_xpack_send (struct nn_xpack *xp, bool immediately)
   else
   {
     struct ddsi_domaingv * const gv = xp->gv;
-    // copy xp
-    struct nn_xpack *xp1 = ddsrt_malloc (sizeof (*xp));
-    memcpy(xp1, xp, sizeof(*xp1));
-    if (xp->iov != NULL) {
-      xp1->iov = ddsrt_malloc(xp->niov * sizeof(*xp->iov));
-      memcpy(xp1->iov, xp->iov, (xp->niov * sizeof(*xp->iov)));
-    }
-    nn_xpack_reinit (xp);
-    xp1->sendq_next = NULL;
-    ddsrt_mutex_lock (&gv->sendq_lock);
-    if (immediately || gv->sendq_length > SENDQ_LW)
-      ddsrt_cond_broadcast (&gv->sendq_cond);
-    if (gv->sendq_length >= SENDQ_MAX)
+    struct nn_xpack *xp1 = nn_xpack_detach (xp);
+    if (ddsrt_atomic_ld32 (&gv->sendq_length) >= SENDQ_MAX)
     {
+      /* Rare, so no harm in taking the lock */
+      ddsrt_mutex_lock (&gv->sendq_lock);
+      if (ddsrt_atomic_ld32 (&gv->sendq_length) >= SENDQ_MAX)
+      {
+        gv->sendq_nblocked++;
+        ddsrt_cond_broadcast (&gv->sendq_cond);
         ddsrt_cond_wait (&gv->sendq_cond, &gv->sendq_lock);
+        gv->sendq_nblocked--;
+      }
+      ddsrt_mutex_unlock (&gv->sendq_lock);
     }
-    if (gv->sendq_head)
-      gv->sendq_tail->sendq_next = xp1;
-    else
+    const uint32_t len = nn_xpack_sendq_push (gv, xp1);
+    ddsrt_atomic_fence ();
+    if ((immediately || len > SENDQ_LW) && ddsrt_atomic_ld32 (&gv->sendq_idle))
     {
-      gv->sendq_head = xp1;
+      ddsrt_mutex_lock (&gv->sendq_lock);
+      ddsrt_cond_broadcast (&gv->sendq_cond);
+      ddsrt_mutex_unlock (&gv->sendq_lock);
     }
-    gv->sendq_tail = xp1;
-    gv->sendq_length++;
+  }
+}
+
+void nn_xpack_enable_adaptive (struct nn_xpack *xp, ddsrt_mutex_t *owner_lock)
+{
+  assert (xp->async_mode);
+  assert (xp->owner_lock == NULL);
+  xp->owner_lock = owner_lock;
+  xp->tlast = ddsrt_time_monotonic ();
+  xp->intv_estim = DDS_INFINITY;
+  xp->deferred_next = NULL;
+  xp->deferred = false;
+}
+
+void nn_xpack_disable_adaptive (struct nn_xpack *xp)
+{
+  struct ddsi_domaingv * const gv = xp->gv;
+  if (xp->owner_lock == NULL)
+    return;
+  ddsrt_mutex_lock (&gv->sendq_lock);
+  if (xp->deferred)
+    nn_xpack_sendq_unlink_deferred (gv, xp);
+  ddsrt_mutex_unlock (&gv->sendq_lock);
+  xp->owner_lock = NULL;
+}
+
+void nn_xpack_send_or_defer (struct nn_xpack *xp)
+{
+  /* Nagle's algorithm with a deadline: the first message added after the
+     previous send determines the deadline, the packet goes out when that
+     expires (at the latest) or when it is full; but if the writes come in
+     so slowly that nothing will be added before the deadline passes anyway,
+     delaying it gains nothing */
+  struct ddsi_domaingv * const gv = xp->gv;
+  if (xp->owner_lock == NULL)
+  {
+    nn_xpack_send (xp, false);
+    return;
+  }
+  ASSERT_MUTEX_HELD (xp->owner_lock);
+  const ddsrt_mtime_t tnow = ddsrt_time_monotonic ();
+  const int64_t budget = (xp->maxdelay == DDS_INFINITY) ? 0 : xp->maxdelay;
+  int64_t intv = tnow.v - xp->tlast.v;
+  xp->tlast = tnow;
+  /* Anything longer than twice the budget counts the same, this limits how
+     long it takes to adapt to an increase in rate */
+  const int64_t intv_max = (budget < INT64_MAX / 16) ? 2 * budget : INT64_MAX / 8;
+  if (intv > intv_max)
+    intv = intv_max;
+  if (xp->intv_estim > intv_max)
+    xp->intv_estim = intv_max;
+  xp->intv_estim = (7 * xp->intv_estim + intv) / 8;
+
+  if (xp->niov == 0)
+    return;
+  else if (budget <= 0 || xp->intv_estim >= budget)
+    nn_xpack_send (xp, true);
+  else if (xp->tdeadline.v == DDS_NEVER)
+  {
+    xp->tdeadline = ddsrt_mtime_add_duration (tnow, budget);
+    ddsrt_mutex_lock (&gv->sendq_lock);
+    nn_xpack_sendq_link_deferred (gv, xp, xp->tdeadline);
+    ddsrt_cond_broadcast (&gv->sendq_cond);
     ddsrt_mutex_unlock (&gv->sendq_lock);
   }
+  else if (tnow.v >= xp->tdeadline.v)
+    nn_xpack_send (xp, true);
 }
 
 static void copy_addressing_info (struct nn_xpack *xp, const struct nn_xmsg *m)
@@ -1485,6 +1788,31 @@ static int addressing_info_eq_onesidederr (const struct nn_xpack *xp, const stru
   return 0;
 }
 
+bool nn_xmsg_same_dst_onesidederr (const struct nn_xmsg *a, const struct nn_xmsg *b)
+{
+  if (a->dstmode != b->dstmode)
+    return false;
+#ifdef DDS_HAS_SECURITY
+  if (a->sec_info.use_rtps_encoding != b->sec_info.use_rtps_encoding)
+    return false;
+#endif
+  switch (a->dstmode)
+  {
+    case NN_XMSG_DST_UNSET:
+      assert (0);
+      return false;
+    case NN_XMSG_DST_ONE:
+      return (memcmp (&a->dstaddr.one.loc, &b->dstaddr.one.loc, sizeof (a->dstaddr.one.loc)) == 0);
+    case NN_XMSG_DST_ALL:
+      return (addrset_eq_onesidederr (a->dstaddr.all.as, b->dstaddr.all.as) &&
+              addrset_eq_onesidederr (a->dstaddr.all.as_group, b->dstaddr.all.as_group));
+    case NN_XMSG_DST_ALL_UC:
+      return addrset_eq_onesidederr (a->dstaddr.all_uc.as, b->dstaddr.all_uc.as);
+  }
+  assert (0);
+  return false;
+}
+
 static int nn_xmsg_is_rexmit (const struct nn_xmsg *m)
 {
   switch (m->kind)
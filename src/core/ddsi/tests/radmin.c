@@ -0,0 +1,636 @@
+/*
+ * Copyright(c) 2021 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/log.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsi/q_protocol.h"
+#include "dds/ddsi/q_misc.h"
+#include "dds/ddsi/q_radmin.h"
+#include "dds/ddsi/q_bitset.h"
+#include "CUnit/Theory.h"
+
+/* Simulates a reliable flow of samples over a lossy network: lost samples
+   and samples the reorder admin rejected are retransmitted some time
+   later, either because the reader NACK'd them or spontaneously.  The
+   same input is fed into all reorder admins in a run, which must all
+   come to exactly the same conclusions. */
+
+#define MAX_REORDERS 2
+#define MAX_PENDING 65536
+
+struct pending {
+  uint32_t step;
+  seqno_t seq;
+  seqno_t gap_maxp1; /* 0 if data */
+};
+
+struct sim {
+  ddsrt_log_cfg_t logcfg;
+  struct nn_rbufpool *rbp;
+  struct nn_defrag *defrag;
+  struct nn_reorder *reorder[MAX_REORDERS];
+  int nreorders;
+  uint32_t rng;
+  uint32_t step;
+  seqno_t next_delivered[MAX_REORDERS];
+  struct pending pending[MAX_PENDING];
+  uint32_t npending;
+};
+
+static uint32_t sim_random (struct sim *sim)
+{
+  sim->rng = sim->rng * 1103515245u + 12345u;
+  return sim->rng >> 8;
+}
+
+static void sim_init (struct sim *sim, int nreorders, const uint32_t *window_sizes, uint32_t max_samples)
+{
+  memset (sim, 0, sizeof (*sim));
+  dds_log_cfg_init (&sim->logcfg, 0, 0, 0, 0);
+  sim->rbp = nn_rbufpool_new (&sim->logcfg, 1048576, 65536, 0, false);
+  CU_ASSERT_FATAL (sim->rbp != NULL);
+  sim->defrag = nn_defrag_new (&sim->logcfg, NN_DEFRAG_DROP_LATEST, 1);
+  CU_ASSERT_FATAL (sim->defrag != NULL);
+  sim->nreorders = nreorders;
+  for (int i = 0; i < nreorders; i++)
+  {
+    sim->reorder[i] = nn_reorder_new (&sim->logcfg, NN_REORDER_MODE_NORMAL, max_samples, window_sizes[i], false);
+    CU_ASSERT_FATAL (sim->reorder[i] != NULL);
+    sim->next_delivered[i] = 1;
+  }
+  sim->rng = 1;
+}
+
+static void sim_fini (struct sim *sim)
+{
+  for (int i = 0; i < sim->nreorders; i++)
+    nn_reorder_free (sim->reorder[i]);
+  nn_defrag_free (sim->defrag);
+  nn_rbufpool_free (sim->rbp);
+}
+
+static void sim_schedule (struct sim *sim, seqno_t seq, seqno_t gap_maxp1, uint32_t delay)
+{
+  CU_ASSERT_FATAL (sim->npending < MAX_PENDING);
+  sim->pending[sim->npending].step = sim->step + delay;
+  sim->pending[sim->npending].seq = seq;
+  sim->pending[sim->npending].gap_maxp1 = gap_maxp1;
+  sim->npending++;
+}
+
+static void sim_consume (struct sim *sim, int i, nn_reorder_result_t res, struct nn_rsample_chain *sc)
+{
+  /* Delivered samples must be consecutive, gaps may skip some */
+  if (res <= 0)
+    return;
+  struct nn_rsample_chain_elem *e = sc->first;
+  while (e)
+  {
+    struct nn_rsample_chain_elem * const e1 = e->next;
+    if (e->sampleinfo)
+    {
+      CU_ASSERT_FATAL (e->sampleinfo->seq >= sim->next_delivered[i]);
+      sim->next_delivered[i] = e->sampleinfo->seq + 1;
+    }
+    nn_fragchain_unref (e->fragchain);
+    e = e1;
+  }
+}
+
+static void sim_check_same (struct sim *sim, const nn_reorder_result_t *res)
+{
+  for (int i = 1; i < sim->nreorders; i++)
+  {
+    CU_ASSERT_FATAL (res[i] == res[0]);
+    CU_ASSERT_FATAL (nn_reorder_next_seq (sim->reorder[i]) == nn_reorder_next_seq (sim->reorder[0]));
+  }
+}
+
+static void sim_data (struct sim *sim, seqno_t seq)
+{
+  struct nn_rmsg *rmsg;
+  struct nn_rdata *rdata, *fragchain;
+  struct nn_rsample *rsample;
+  struct nn_rsample_chain sc[MAX_REORDERS];
+  nn_reorder_result_t res[MAX_REORDERS];
+  struct nn_rsample_info si;
+  int refc_adjust = 0;
+
+  memset (&si, 0, sizeof (si));
+  si.seq = seq;
+  si.size = si.fragsize = 4;
+  rmsg = nn_rmsg_new (sim->rbp);
+  CU_ASSERT_FATAL (rmsg != NULL);
+  nn_rmsg_setsize (rmsg, 4);
+  rdata = nn_rdata_new (rmsg, 0, 4, 0, 0, 0);
+  rsample = nn_defrag_rsample (sim->defrag, rdata, &si);
+  CU_ASSERT_FATAL (rsample != NULL);
+  fragchain = nn_rsample_fragchain (rsample);
+  for (int i = 0; i < sim->nreorders; i++)
+  {
+    /* like the receive path, check whether the sample is wanted first */
+    if (!nn_reorder_wantsample (sim->reorder[i], seq))
+      res[i] = NN_REORDER_REJECT;
+    else
+    {
+      struct nn_rsample *rs = (i == 0) ? rsample : nn_reorder_rsample_dup_first (rmsg, rsample);
+      res[i] = nn_reorder_rsample (&sc[i], sim->reorder[i], rs, &refc_adjust, 0);
+    }
+  }
+  sim_check_same (sim, res);
+  if (res[0] == NN_REORDER_REJECT && seq >= nn_reorder_next_seq (sim->reorder[0]) && nn_reorder_wantsample (sim->reorder[0], seq))
+    sim_schedule (sim, seq, 0, 20 + sim_random (sim) % 100);
+  nn_fragchain_adjust_refcount (fragchain, refc_adjust);
+  for (int i = 0; i < sim->nreorders; i++)
+    sim_consume (sim, i, res[i], &sc[i]);
+  nn_rmsg_commit (rmsg);
+}
+
+static void sim_gap (struct sim *sim, seqno_t min, seqno_t maxp1)
+{
+  struct nn_rmsg *rmsg;
+  struct nn_rdata *gap;
+  struct nn_rsample_chain sc[MAX_REORDERS];
+  nn_reorder_result_t res[MAX_REORDERS];
+  int refc_adjust = 0;
+  rmsg = nn_rmsg_new (sim->rbp);
+  CU_ASSERT_FATAL (rmsg != NULL);
+  nn_rmsg_setsize (rmsg, 4);
+  gap = nn_rdata_newgap (rmsg);
+  for (int i = 0; i < sim->nreorders; i++)
+    res[i] = nn_reorder_gap (&sc[i], sim->reorder[i], gap, min, maxp1, &refc_adjust);
+  sim_check_same (sim, res);
+  if (res[0] == NN_REORDER_REJECT && min > nn_reorder_next_seq (sim->reorder[0]))
+    sim_schedule (sim, min, maxp1, 20 + sim_random (sim) % 100);
+  nn_fragchain_adjust_refcount (gap, refc_adjust);
+  for (int i = 0; i < sim->nreorders; i++)
+    sim_consume (sim, i, res[i], &sc[i]);
+  nn_rmsg_commit (rmsg);
+}
+
+static void sim_nack (struct sim *sim, seqno_t maxseq)
+{
+  /* All reorder admins must request the same samples, retransmits arrive
+     after a round-trip */
+  struct nn_sequence_number_set_header map[MAX_REORDERS];
+  uint32_t bits[MAX_REORDERS][8];
+  const seqno_t base = nn_reorder_next_seq (sim->reorder[0]);
+  if (maxseq < base - 1)
+    maxseq = base - 1;
+  for (int i = 0; i < sim->nreorders; i++)
+    nn_reorder_nackmap (sim->reorder[i], base, maxseq, &map[i], bits[i], 256, 0);
+  for (int i = 1; i < sim->nreorders; i++)
+  {
+    CU_ASSERT_FATAL (map[i].numbits == map[0].numbits);
+    CU_ASSERT_FATAL (memcmp (bits[i], bits[0], 4 * ((map[0].numbits + 31) / 32)) == 0);
+  }
+  for (uint32_t k = 0; k < map[0].numbits; k++)
+    if (nn_bitset_isset (map[0].numbits, bits[0], k))
+      sim_schedule (sim, base + (seqno_t) k, 0, 10);
+}
+
+static void sim_run (struct sim *sim, seqno_t nsamples, uint32_t loss_permille, uint32_t dup_permille, uint32_t gap_permille)
+{
+  seqno_t next_new = 1;
+  while (nn_reorder_next_seq (sim->reorder[0]) <= nsamples)
+  {
+    CU_ASSERT_FATAL (sim->step < 100 * (uint32_t) nsamples);
+    if (next_new <= nsamples)
+    {
+      const seqno_t seq = next_new++;
+      const uint32_t r = sim_random (sim) % 1000;
+      if (r < loss_permille)
+        sim_schedule (sim, seq, 0, 20 + sim_random (sim) % 200);
+      else if (r < loss_permille + gap_permille)
+        sim_gap (sim, seq, seq + 1 + (seqno_t) (sim_random (sim) % 3));
+      else
+        sim_data (sim, seq);
+      if (sim_random (sim) % 1000 < dup_permille && seq > 10)
+        sim_data (sim, seq - (seqno_t) (sim_random (sim) % 10));
+    }
+    for (uint32_t k = 0; k < sim->npending; )
+    {
+      if (sim->pending[k].step > sim->step)
+        k++;
+      else
+      {
+        const struct pending p = sim->pending[k];
+        sim->pending[k] = sim->pending[--sim->npending];
+        if (p.gap_maxp1)
+          sim_gap (sim, p.seq, p.gap_maxp1);
+        else
+          sim_data (sim, p.seq);
+      }
+    }
+    if ((sim->step % 64) == 0)
+      sim_nack (sim, next_new - 1);
+    sim->step++;
+  }
+  for (int i = 0; i < sim->nreorders; i++)
+    CU_ASSERT_FATAL (nn_reorder_next_seq (sim->reorder[i]) == nsamples + 1);
+}
+
+CU_Test(ddsi_radmin, reorder_window_equivalence)
+{
+  /* A window smaller than max_samples forces frequent overflows into the
+     interval tree, a small max_samples forces dropping samples (but
+     dropping the last sample of the tree can't handle gaps) */
+  static const struct { uint32_t max_samples, gap_permille; } cases[] = {
+    { 16, 0 }, { 128, 0 }, { 1024, 2 }
+  };
+  for (size_t k = 0; k < sizeof (cases) / sizeof (cases[0]); k++)
+  {
+    struct sim sim;
+    const uint32_t window_sizes[] = { 0, 64 };
+    sim_init (&sim, 2, window_sizes, cases[k].max_samples);
+    sim_run (&sim, 20000, 20, 5, cases[k].gap_permille);
+    for (int i = 0; i < sim.nreorders; i++)
+    {
+      uint64_t discarded_bytes;
+      nn_reorder_stats (sim.reorder[i], &discarded_bytes);
+      printf ("max_samples %"PRIu32" window %"PRIu32": discarded %"PRIu64" bytes\n", cases[k].max_samples, window_sizes[i], discarded_bytes);
+    }
+    sim_fini (&sim);
+  }
+}
+
+CU_Test(ddsi_radmin, reorder_window_loss_benchmark, .timeout = 60)
+{
+  /* Loss and large delays so there are nearly always some holes in the
+     receive window; best of a few runs, but no timing requirement as that
+     would be too fragile in a test */
+#define NSAMPLES 200000
+  const uint32_t loss_permille[] = { 10, 50 };
+  const uint32_t window_sizes[] = { 0, 256, 1024 };
+  for (size_t l = 0; l < sizeof (loss_permille) / sizeof (loss_permille[0]); l++)
+  {
+    for (size_t k = 0; k < sizeof (window_sizes) / sizeof (window_sizes[0]); k++)
+    {
+      int64_t tbest = INT64_MAX;
+      for (int rep = 0; rep < 3; rep++)
+      {
+        struct sim sim;
+        sim_init (&sim, 1, &window_sizes[k], 1024);
+        const ddsrt_mtime_t t0 = ddsrt_time_monotonic ();
+        sim_run (&sim, NSAMPLES, loss_permille[l], 0, 0);
+        const ddsrt_mtime_t t1 = ddsrt_time_monotonic ();
+        if (t1.v - t0.v < tbest)
+          tbest = t1.v - t0.v;
+        sim_fini (&sim);
+      }
+      printf ("loss %.1f%% window %"PRIu32": %.1f ns/sample\n",
+              loss_permille[l] / 10.0, window_sizes[k], (double) tbest / NSAMPLES);
+    }
+  }
+#undef NSAMPLES
+}
+
+/* Large samples, fed to the defragmenter one fragment (or a few
+   consecutive ones) at a time in a random order, which is where the
+   bitmap of received fragments is used */
+
+#define DEFRAG_FRAGSIZE 100
+#define DEFRAG_NFRAGS 200
+#define DEFRAG_SIZE (DEFRAG_NFRAGS * DEFRAG_FRAGSIZE - 37)
+
+static struct nn_rsample *defrag_feed (struct nn_rbufpool *rbp, struct nn_defrag *defrag, seqno_t seq, uint32_t size, uint32_t fragsize, uint32_t min, uint32_t maxp1)
+{
+  struct nn_rsample_info si;
+  struct nn_rmsg *rmsg;
+  struct nn_rdata *rdata;
+  struct nn_rsample *rsample;
+  memset (&si, 0, sizeof (si));
+  si.seq = seq;
+  si.size = size;
+  si.fragsize = fragsize;
+  rmsg = nn_rmsg_new (rbp);
+  CU_ASSERT_FATAL (rmsg != NULL);
+  nn_rmsg_setsize (rmsg, 16);
+  rdata = nn_rdata_new (rmsg, min, maxp1, 0, 0, 0);
+  rsample = nn_defrag_rsample (defrag, rdata, &si);
+  nn_rmsg_commit (rmsg);
+  return rsample;
+}
+
+static void defrag_check_and_release (struct nn_rsample *rsample, uint32_t size)
+{
+  /* the deserializer requires the chain to be ordered on the first byte,
+     any overlap gets skipped */
+  struct nn_rdata *fragchain = nn_rsample_fragchain (rsample);
+  uint32_t off = 0;
+  for (struct nn_rdata *frag = fragchain; frag; frag = frag->nextfrag)
+  {
+    CU_ASSERT_FATAL (frag->min <= off);
+    if (frag->maxp1 > off)
+      off = frag->maxp1;
+  }
+  CU_ASSERT_FATAL (off == size);
+  nn_fragchain_adjust_refcount (fragchain, 0);
+}
+
+static void defrag_check_nackmap (struct nn_defrag *defrag, seqno_t seq, const bool *have, uint32_t maxfragnum)
+{
+  /* Missing fragments up to maxfragnum and the highest one received must
+     be requested, starting at the first missing one */
+  struct nn_fragment_number_set_header map;
+  uint32_t bits[8];
+  uint32_t base = 0, limit = maxfragnum, end;
+  enum nn_defrag_nackmap_result res = nn_defrag_nackmap (defrag, seq, maxfragnum, &map, bits, 256);
+  for (uint32_t i = 0; i < DEFRAG_NFRAGS; i++)
+    if (have[i] && i > limit)
+      limit = i;
+  while (base <= limit && have[base])
+    base++;
+  if (base > limit)
+  {
+    CU_ASSERT_FATAL (res == DEFRAG_NACKMAP_ALL_ADVERTISED_FRAGMENTS_KNOWN);
+    return;
+  }
+  CU_ASSERT_FATAL (res == DEFRAG_NACKMAP_FRAGMENTS_MISSING);
+  for (end = limit; have[end]; end--)
+    ;
+  CU_ASSERT_FATAL (map.bitmap_base == base);
+  CU_ASSERT_FATAL (map.numbits == ((end - base + 1 > 256) ? 256 : end - base + 1));
+  for (uint32_t i = 0; i < map.numbits; i++)
+    CU_ASSERT_FATAL (!nn_bitset_isset (map.numbits, bits, i) == have[base + i]);
+}
+
+CU_Test(ddsi_radmin, defrag_fragmap)
+{
+  /* Runs of 1-3 fragments starting at random fragment numbers, so there
+     are duplicates and partial overlaps; in some of the runs, a fragment
+     that isn't aligned on the fragment size switches to the interval tree
+     halfway */
+  ddsrt_log_cfg_t logcfg;
+  struct nn_rbufpool *rbp;
+  struct nn_defrag *defrag;
+  uint32_t rng = 1;
+  dds_log_cfg_init (&logcfg, 0, 0, 0, 0);
+  rbp = nn_rbufpool_new (&logcfg, 1048576, 65536, 0, false);
+  CU_ASSERT_FATAL (rbp != NULL);
+  defrag = nn_defrag_new (&logcfg, NN_DEFRAG_DROP_OLDEST, 4);
+  CU_ASSERT_FATAL (defrag != NULL);
+  for (seqno_t seq = 1; seq <= 100; seq++)
+  {
+    const bool misaligned = (seq % 4) == 0;
+    bool have[DEFRAG_NFRAGS] = { false };
+    uint32_t nhave = 0, n = 0;
+    struct nn_rsample *rsample = NULL;
+    while (rsample == NULL)
+    {
+      CU_ASSERT_FATAL (nhave < DEFRAG_NFRAGS);
+      rng = rng * 1103515245u + 12345u;
+      uint32_t f0 = (rng >> 8) % DEFRAG_NFRAGS, f1 = f0 + 1 + (rng >> 20) % 3;
+      if (f1 > DEFRAG_NFRAGS)
+        f1 = DEFRAG_NFRAGS;
+      uint32_t min = f0 * DEFRAG_FRAGSIZE, maxp1 = (f1 == DEFRAG_NFRAGS) ? DEFRAG_SIZE : f1 * DEFRAG_FRAGSIZE;
+      if (misaligned && ++n == DEFRAG_NFRAGS / 2 && f1 < DEFRAG_NFRAGS)
+        maxp1 += DEFRAG_FRAGSIZE / 2;
+      rsample = defrag_feed (rbp, defrag, seq, DEFRAG_SIZE, DEFRAG_FRAGSIZE, min, maxp1);
+      for (uint32_t i = f0; i < f1; i++)
+      {
+        if (!have[i])
+          nhave++;
+        have[i] = true;
+      }
+      if (rsample == NULL)
+        defrag_check_nackmap (defrag, seq, have, (rng >> 4) % DEFRAG_NFRAGS);
+    }
+    CU_ASSERT_FATAL (nhave == DEFRAG_NFRAGS);
+    defrag_check_and_release (rsample, DEFRAG_SIZE);
+    struct nn_fragment_number_set_header map;
+    uint32_t bits[8];
+    CU_ASSERT_FATAL (nn_defrag_nackmap (defrag, seq, UINT32_MAX, &map, bits, 256) == DEFRAG_NACKMAP_UNKNOWN_SAMPLE);
+  }
+
+  /* incomplete samples must be released by a gap and when freeing the
+     defragmenter */
+  for (seqno_t seq = 101; seq <= 104; seq++)
+    for (uint32_t f = 1; f < DEFRAG_NFRAGS - 1; f += 2)
+      CU_ASSERT_FATAL (defrag_feed (rbp, defrag, seq, DEFRAG_SIZE, DEFRAG_FRAGSIZE, f * DEFRAG_FRAGSIZE, (f + 1) * DEFRAG_FRAGSIZE) == NULL);
+  /* the sample and fragment sizes come from the peer: a huge sample of tiny
+     fragments must not result in a correspondingly huge fragmap */
+  CU_ASSERT_FATAL (defrag_feed (rbp, defrag, 105, INT32_MAX, 1, 0, 100) == NULL);
+  CU_ASSERT_FATAL (defrag_feed (rbp, defrag, 105, INT32_MAX, 1, 1000, 1100) == NULL);
+  nn_defrag_notegap (defrag, 101, 103);
+  nn_defrag_free (defrag);
+  nn_rbufpool_free (rbp);
+}
+
+CU_Test(ddsi_radmin, defrag_fragmap_benchmark, .timeout = 60)
+{
+  /* An 8MB sample in 1400 byte fragments arriving in a random order,
+     with and without the fragment bitmap (it can't be used if the
+     fragment size is 0), best of a few runs but no timing requirement */
+#define NFRAGS 6000
+  static uint32_t order[NFRAGS];
+  ddsrt_log_cfg_t logcfg;
+  struct nn_rbufpool *rbp;
+  uint32_t rng = 1;
+  dds_log_cfg_init (&logcfg, 0, 0, 0, 0);
+  rbp = nn_rbufpool_new (&logcfg, 1048576, 65536, 0, false);
+  CU_ASSERT_FATAL (rbp != NULL);
+  for (uint32_t i = 0; i < NFRAGS; i++)
+    order[i] = i;
+  for (uint32_t i = NFRAGS - 1; i > 0; i--)
+  {
+    rng = rng * 1103515245u + 12345u;
+    const uint32_t j = (rng >> 8) % (i + 1), t = order[i];
+    order[i] = order[j];
+    order[j] = t;
+  }
+  for (uint32_t fragsize = 0; fragsize <= 1400; fragsize += 1400)
+  {
+    int64_t tbest = INT64_MAX;
+    for (int rep = 0; rep < 3; rep++)
+    {
+      struct nn_defrag *defrag = nn_defrag_new (&logcfg, NN_DEFRAG_DROP_OLDEST, 1);
+      struct nn_rsample *rsample = NULL;
+      CU_ASSERT_FATAL (defrag != NULL);
+      const ddsrt_mtime_t t0 = ddsrt_time_monotonic ();
+      for (uint32_t i = 0; i < NFRAGS; i++)
+      {
+        CU_ASSERT_FATAL (rsample == NULL);
+        rsample = defrag_feed (rbp, defrag, 1, NFRAGS * 1400, fragsize, order[i] * 1400, (order[i] + 1) * 1400);
+      }
+      const ddsrt_mtime_t t1 = ddsrt_time_monotonic ();
+      CU_ASSERT_FATAL (rsample != NULL);
+      defrag_check_and_release (rsample, NFRAGS * 1400);
+      nn_defrag_free (defrag);
+      if (t1.v - t0.v < tbest)
+        tbest = t1.v - t0.v;
+    }
+    printf ("%s: %.1f ns/fragment\n", fragsize ? "fragment bitmap" : "interval tree", (double) tbest / NFRAGS);
+  }
+  nn_rbufpool_free (rbp);
+#undef NFRAGS
+}
+
+/* Readers joining at different times, all served from a single shared
+   secondary admin: samples before CATCHUP_FIRST are no longer available
+   (the writer responds with a Gap), everything from there on must be
+   delivered exactly once and in-order to every reader */
+
+#define CATCHUP_NREADERS 8
+#define CATCHUP_FIRST 100
+#define CATCHUP_NSAMPLES 5000
+
+struct catchup_reader {
+  struct nn_catchup_cursor *cur;
+  seqno_t next_delivered; /* 0 if nothing delivered yet */
+};
+
+static void catchup_deliver (void *varg, struct nn_rsample_chain *sc, nn_reorder_result_t rres, void *arg)
+{
+  struct catchup_reader * const rd = varg;
+  nn_reorder_result_t n = 0;
+  (void) arg;
+  for (struct nn_rsample_chain_elem *e = sc->first, *e1; e; e = e1)
+  {
+    e1 = e->next;
+    if (e->sampleinfo)
+    {
+      CU_ASSERT_FATAL (e->sampleinfo->seq == (rd->next_delivered ? rd->next_delivered : CATCHUP_FIRST));
+      rd->next_delivered = e->sampleinfo->seq + 1;
+    }
+    nn_fragchain_unref (e->fragchain);
+    n++;
+  }
+  CU_ASSERT_FATAL (n == rres);
+  if (rres > 0)
+    CU_ASSERT_FATAL (nn_catchup_cursor_next_seq (rd->cur) == rd->next_delivered);
+}
+
+static void catchup_data (struct sim *sim, struct nn_catchup *c, seqno_t seq)
+{
+  struct nn_rmsg *rmsg;
+  struct nn_rdata *rdata, *fragchain;
+  struct nn_rsample *rsample;
+  struct nn_rsample_info si;
+  int refc_adjust = 0;
+  memset (&si, 0, sizeof (si));
+  si.seq = seq;
+  si.size = si.fragsize = 4;
+  rmsg = nn_rmsg_new (sim->rbp);
+  CU_ASSERT_FATAL (rmsg != NULL);
+  nn_rmsg_setsize (rmsg, 4);
+  rdata = nn_rdata_new (rmsg, 0, 4, 0, 0, 0);
+  rsample = nn_defrag_rsample (sim->defrag, rdata, &si);
+  CU_ASSERT_FATAL (rsample != NULL);
+  fragchain = nn_rsample_fragchain (rsample);
+  (void) nn_catchup_rsample (c, rmsg, rsample, &refc_adjust, 0, catchup_deliver, NULL);
+  nn_fragchain_adjust_refcount (fragchain, refc_adjust);
+  nn_rmsg_commit (rmsg);
+}
+
+static void catchup_gap (struct sim *sim, struct nn_catchup *c, struct nn_catchup_cursor *cur, seqno_t min, seqno_t maxp1)
+{
+  struct nn_rmsg *rmsg;
+  struct nn_rdata *gap;
+  int refc_adjust = 0;
+  rmsg = nn_rmsg_new (sim->rbp);
+  CU_ASSERT_FATAL (rmsg != NULL);
+  nn_rmsg_setsize (rmsg, 4);
+  gap = nn_rdata_newgap (rmsg);
+  if (cur)
+    (void) nn_catchup_cursor_gap (c, cur, gap, min, maxp1, &refc_adjust, catchup_deliver, NULL);
+  else
+    (void) nn_catchup_gap (c, gap, min, maxp1, &refc_adjust, catchup_deliver, NULL);
+  nn_fragchain_adjust_refcount (gap, refc_adjust);
+  nn_rmsg_commit (rmsg);
+}
+
+CU_Test(ddsi_radmin, catchup_late_joiners, .timeout = 60)
+{
+  struct catchup_reader rds[CATCHUP_NREADERS];
+  struct nn_catchup *c;
+  struct sim sim;
+  int nrds = 0, ndone = 0;
+  seqno_t next_new = CATCHUP_FIRST;
+  sim_init (&sim, 0, NULL, 0);
+  c = nn_catchup_new (&sim.logcfg, 1000000);
+  CU_ASSERT_FATAL (c != NULL);
+  while (ndone < CATCHUP_NREADERS)
+  {
+    CU_ASSERT_FATAL (sim.step < 100 * CATCHUP_NSAMPLES);
+    if (nrds < CATCHUP_NREADERS && sim.step == (uint32_t) nrds * 300)
+    {
+      rds[nrds].cur = nn_catchup_add_cursor (c, &rds[nrds]);
+      CU_ASSERT_FATAL (rds[nrds].cur != NULL);
+      rds[nrds].next_delivered = 0;
+      nrds++;
+      CU_ASSERT_FATAL (nn_catchup_ncursors (c) == (uint32_t) nrds);
+      CU_ASSERT_FATAL (nn_catchup_min_next_seq (c) == 1);
+    }
+    if (next_new <= CATCHUP_NSAMPLES)
+    {
+      const seqno_t seq = next_new++;
+      if (sim_random (&sim) % 1000 < 20)
+        sim_schedule (&sim, seq, 0, 20 + sim_random (&sim) % 200);
+      else
+        catchup_data (&sim, c, seq);
+    }
+    for (uint32_t k = 0; k < sim.npending; )
+    {
+      if (sim.pending[k].step > sim.step)
+        k++;
+      else
+      {
+        const struct pending p = sim.pending[k];
+        sim.pending[k] = sim.pending[--sim.npending];
+        catchup_data (&sim, c, p.seq);
+      }
+    }
+    if ((sim.step % 64) == 0)
+    {
+      /* heartbeat, then a NACK from each reader: a Gap in response if
+         it requests unavailable data, a retransmit otherwise */
+      catchup_gap (&sim, c, NULL, 1, CATCHUP_FIRST);
+      for (int i = 0; i < nrds; i++)
+      {
+        struct nn_sequence_number_set_header map;
+        uint32_t bits[8];
+        const seqno_t base = nn_catchup_cursor_next_seq (rds[i].cur);
+        nn_catchup_nackmap (c, rds[i].cur, next_new - 1, &map, bits, 256, 0);
+        CU_ASSERT_FATAL (fromSN (map.bitmap_base) == base);
+        for (uint32_t k = 0; k < map.numbits; k++)
+        {
+          if (!nn_bitset_isset (map.numbits, bits, k))
+            continue;
+          CU_ASSERT_FATAL (nn_catchup_wantsample (c, rds[i].cur, base + (seqno_t) k));
+          if (base + (seqno_t) k < CATCHUP_FIRST)
+          {
+            catchup_gap (&sim, c, rds[i].cur, 1, CATCHUP_FIRST);
+            break;
+          }
+          else
+            sim_schedule (&sim, base + (seqno_t) k, 0, 10);
+        }
+      }
+    }
+    ndone = 0;
+    for (int i = 0; i < nrds; i++)
+      if (rds[i].next_delivered == CATCHUP_NSAMPLES + 1)
+        ndone++;
+    sim.step++;
+  }
+  printf ("all readers caught up after %"PRIu32" steps\n", sim.step);
+  for (int i = 0; i < nrds; i++)
+    nn_catchup_remove_cursor (c, rds[i].cur);
+  CU_ASSERT (nn_catchup_min_next_seq (c) == MAX_SEQ_NUMBER);
+  nn_catchup_free (c);
+  sim_fini (&sim);
+}
@@ -299,17 +299,21 @@ ddsrt_setsockopt(
 # endif /* SO_REUSE */
 #endif /* LWIP_SOCKET */
 
-  switch (optname) {
-    case SO_SNDBUF:
-    case SO_RCVBUF:
-      /* optlen == 4 && optval == 0 does not work. */
-      if (!(optlen == 4 && *((unsigned *)optval) == 0)) {
-        break;
-      }
-      /* falls through */
-    case SO_DONTROUTE:
-      /* SO_DONTROUTE causes problems on macOS (e.g. no multicasting). */
-      return DDS_RETCODE_OK;
+  /* option numbers are only unique within a level (e.g. PACKET_RX_RING
+     equals SO_DONTROUTE on Linux) */
+  if (level == SOL_SOCKET) {
+    switch (optname) {
+      case SO_SNDBUF:
+      case SO_RCVBUF:
+        /* optlen == 4 && optval == 0 does not work. */
+        if (!(optlen == 4 && *((unsigned *)optval) == 0)) {
+          break;
+        }
+        /* falls through */
+      case SO_DONTROUTE:
+        /* SO_DONTROUTE causes problems on macOS (e.g. no multicasting). */
+        return DDS_RETCODE_OK;
+    }
   }
 
   if (setsockopt(sock, level, optname, optval, optlen) == -1) {
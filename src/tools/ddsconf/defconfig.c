@@ -122,11 +122,9 @@ void gendef_pf_tracemask (FILE *out, void *parent, struct cfgelem const * const
 void gendef_pf_xcheck (FILE *out, void *parent, struct cfgelem const * const cfgelem) {
   gendef_pf_uint32 (out, parent, cfgelem);
 }
-#ifdef DDS_HAS_BANDWIDTH_LIMITING
 void gendef_pf_bandwidth (FILE *out, void *parent, struct cfgelem const * const cfgelem) {
   gendef_pf_uint32 (out, parent, cfgelem);
 }
-#endif
 void gendef_pf_memsize (FILE *out, void *parent, struct cfgelem const * const cfgelem) {
   gendef_pf_uint32 (out, parent, cfgelem);
 }